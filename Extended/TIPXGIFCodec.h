@@ -0,0 +1,43 @@
+//
+//  TIPXGIFCodec.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import <TwitterImagePipeline/TIPImageCodecs.h>
+
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Convenience codec for decoding and encoding static and animated GIFs with giflib, in place of ImageIO.
+ Requires giflib 5.2 or later (its `gif_lib.h` header and `libgif` library).
+ This codec is not bundled with __TIP__ to avoid bloating the framework with giflib,
+ but there's nothing preventing a consumer from using this codec.
+
+ The decoder keeps track of the frames as the data arrives and renders the first frame as a preview
+ once it has completely loaded.  The full animation is decoded when the data completes, honoring the
+ disposal method, delay and transparency of each frame and the loop count of the `NETSCAPE2.0`
+ extension (no extension loops forever, like ImageIO).  Delays under 10 milliseconds play at 100
+ milliseconds, like ImageIO and browsers.
+
+ The encoder encodes every frame of animated images with their durations and loop count.
+ It supports `TIPImageEncodingProgressive` (interlacing), `TIPImageEncodingGrayscale` and
+ `TIPImageEncodingNoAlpha`.  Each frame is quantized to its own palette of up to 256 colors (255 with
+ a transparent color), the suggested quality scales the size of the palette down to 16 colors.
+ The orientation of the image is applied to the pixels since GIF has no orientation metadata.
+
+    [[TIPImageCodecCatalogue sharedInstance] setCodec:[[TIPXGIFCodec alloc] init]
+                                         forImageType:TIPImageTypeGIF];
+ */
+@interface TIPXGIFCodec : NSObject <TIPImageCodec>
+/** giflib decoder */
+@property (nonatomic, readonly) id<TIPImageDecoder> tip_decoder;
+/** giflib encoder */
+@property (nonatomic, readonly) id<TIPImageEncoder> tip_encoder;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,854 @@
+//
+//  TIPXGIFCodec.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#pragma mark imports
+
+#import <TwitterImagePipeline/TwitterImagePipeline.h>
+
+#import "TIPXGIFCodec.h"
+#import "TIPXUtils.h"
+
+#pragma mark giflib includes
+
+#include <gif_lib.h>
+
+#if !defined(GIFLIB_MAJOR) || GIFLIB_MAJOR < 5 || (GIFLIB_MAJOR == 5 && GIFLIB_MINOR < 2)
+#error TIPXGIFCodec requires giflib 5.2 or later (for GifQuantizeBuffer in libgif)
+#endif
+
+NS_ASSUME_NONNULL_BEGIN
+
+#pragma mark - Declarations
+
+#define kGIF_HEADER_LENGTH              (13) // signature, version and logical screen descriptor
+#define kGIF_IMAGE_DESCRIPTOR_LENGTH    (10) // including the image separator
+#define kGIF_BLOCK_IMAGE                (0x2C)
+#define kGIF_BLOCK_EXTENSION            (0x21)
+#define kGIF_BLOCK_TRAILER              (0x3B)
+#define kGIF_MINIMUM_PALETTE_SIZE       (16)
+
+// Incremental reader of the GIF blocks, to find the dimensions and the boundaries of frames
+typedef struct {
+    NSUInteger offset; // where the next read resumes
+    NSUInteger completedFrameCount;
+    NSUInteger firstFrameEndOffset; // offset after the data of the first frame
+    size_t width;
+    size_t height;
+    BOOL didReadHeader;
+    BOOL isInSubBlocks; // reading the data sub-blocks of an extension or image
+    BOOL isInImageData;
+    BOOL didReadEnd;
+    BOOL isCorrupt;
+} TIPXGIFBlockReader;
+
+// giflib input over memory, optionally ending the data with a trailer to decode the frames so far
+typedef struct {
+    const Byte *bytes;
+    size_t length;
+    size_t offset;
+    BOOL appendsTrailer;
+} TIPXGIFReadBuffer;
+
+// giflib output to memory
+typedef struct {
+    Byte * __nullable bytes;
+    size_t length;
+    size_t capacity;
+} TIPXGIFWriteBuffer;
+
+static void TIPXGIFBlockReaderRead(TIPXGIFBlockReader *reader,
+                                   const Byte *bytes,
+                                   size_t length);
+static TIPImageContainer * __nullable TIPXGIFDecodeImage(const Byte *bytes,
+                                                         size_t length,
+                                                         BOOL appendsTrailer,
+                                                         BOOL justFirstFrame,
+                                                         BOOL * __nullable hasAlphaOut);
+static NSUInteger TIPXGIFReadLoopCount(const GifFileType *gif);
+static int TIPXGIFWrite(GifFileType *gif,
+                        const GifByteType *bytes,
+                        int length);
+static BOOL TIPXGIFWriteFrame(GifFileType *gif,
+                              CGImageRef imageRef,
+                              size_t width,
+                              size_t height,
+                              NSTimeInterval duration,
+                              int paletteSize,
+                              BOOL grayscale,
+                              BOOL noAlpha,
+                              BOOL interlaced);
+
+@interface TIPXGIFDecoderContext : NSObject <TIPImageDecoderContext>
+
+@property (nonatomic, readonly) NSData *tip_data;
+@property (nonatomic, readonly) CGSize tip_dimensions;
+@property (nonatomic, readonly) NSUInteger tip_frameCount;
+@property (nonatomic, readonly) BOOL tip_isAnimated;
+@property (nonatomic, readonly) BOOL tip_hasAlpha;
+
+- (instancetype)initWithExpectedContentLength:(NSUInteger)length
+                                       buffer:(nullable NSMutableData *)buffer;
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+- (TIPImageDecoderAppendResult)append:(NSData *)data TIPX_OBJC_DIRECT;
+- (nullable TIPImageContainer *)renderImage:(TIPImageDecoderRenderMode)renderMode
+                           targetDimensions:(CGSize)targetDimensions
+                          targetContentMode:(UIViewContentMode)targetContentMode TIPX_OBJC_DIRECT;
+- (TIPImageDecoderAppendResult)finalizeDecoding TIPX_OBJC_DIRECT;
+
+@end
+
+@interface TIPXGIFDecoder : NSObject <TIPImageDecoder>
+@end
+
+@interface TIPXGIFEncoder : NSObject <TIPImageEncoder>
+@end
+
+#pragma mark - Implementations
+
+@implementation TIPXGIFCodec
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _tip_decoder = [[TIPXGIFDecoder alloc] init];
+        _tip_encoder = [[TIPXGIFEncoder alloc] init];
+    }
+    return self;
+}
+
+- (BOOL)tip_isAnimated
+{
+    return YES;
+}
+
+@end
+
+@implementation TIPXGIFDecoder
+
+- (TIPImageDecoderDetectionResult)tip_detectDecodableData:(NSData *)data
+                                           isCompleteData:(BOOL)complete
+                                      earlyGuessImageType:(nullable NSString *)imageType
+{
+    if (data.length < 6) {
+        return (complete) ? TIPImageDecoderDetectionResultNoMatch : TIPImageDecoderDetectionResultNeedMoreData;
+    }
+
+    const Byte *bytes = data.bytes;
+    if (0 == memcmp(bytes, "GIF87a", 6) || 0 == memcmp(bytes, "GIF89a", 6)) {
+        return TIPImageDecoderDetectionResultMatch;
+    }
+    return TIPImageDecoderDetectionResultNoMatch;
+}
+
+- (id<TIPImageDecoderContext>)tip_initiateDecoding:(nullable id __unused)config
+                                expectedDataLength:(NSUInteger)expectedDataLength
+                                            buffer:(nullable NSMutableData *)buffer
+{
+    return [[TIPXGIFDecoderContext alloc] initWithExpectedContentLength:expectedDataLength
+                                                                 buffer:buffer];
+}
+
+- (TIPImageDecoderAppendResult)tip_append:(TIPXGIFDecoderContext *)context
+                                     data:(NSData *)data
+{
+    return [context append:data];
+}
+
+- (nullable TIPImageContainer *)tip_renderImage:(TIPXGIFDecoderContext *)context
+                                     renderMode:(TIPImageDecoderRenderMode)renderMode
+                               targetDimensions:(CGSize)targetDimensions
+                              targetContentMode:(UIViewContentMode)targetContentMode
+{
+    return [context renderImage:renderMode targetDimensions:targetDimensions targetContentMode:targetContentMode];
+}
+
+- (TIPImageDecoderAppendResult)tip_finalizeDecoding:(TIPXGIFDecoderContext *)context
+{
+    return [context finalizeDecoding];
+}
+
+- (BOOL)tip_supportsProgressiveDecoding
+{
+    return NO;
+}
+
+- (nullable TIPImageContainer *)tip_decodeImageWithData:(NSData *)imageData
+                                       targetDimensions:(CGSize)targetDimensions
+                                      targetContentMode:(UIViewContentMode)targetContentMode
+                                                 config:(nullable id)config
+{
+    return TIPXGIFDecodeImage(imageData.bytes, imageData.length, NO /*appendsTrailer*/, NO /*justFirstFrame*/, NULL);
+}
+
+@end
+
+@implementation TIPXGIFEncoder
+
+- (nullable NSData *)tip_writeDataWithImage:(TIPImageContainer *)imageContainer
+                            encodingOptions:(TIPImageEncodingOptions)encodingOptions
+                           suggestedQuality:(float)quality
+                                      error:(out NSError * __nullable __autoreleasing * __nullable)error
+{
+    __block GifFileType *gif = NULL;
+    __block TIPXGIFWriteBuffer buffer = { 0 };
+    __block TIPErrorCode errorCode = TIPErrorCodeUnknown;
+    __block NSData *outputData = nil;
+    tipx_defer(^{
+        if (gif) {
+            EGifCloseFile(gif, NULL);
+        }
+        if (!outputData) {
+            free(buffer.bytes);
+            if (error) {
+                *error = [NSError errorWithDomain:TIPErrorDomain
+                                             code:errorCode
+                                         userInfo:nil];
+            }
+        }
+    });
+
+    NSArray<UIImage *> *frames = (imageContainer.animated) ? imageContainer.frames : nil;
+    if (!frames.count) {
+        frames = @[imageContainer.image];
+    }
+    NSArray<NSNumber *> *frameDurations = imageContainer.frameDurations;
+
+    UIImage *firstFrame = frames.firstObject;
+    if (!firstFrame.CGImage) {
+        errorCode = TIPErrorCodeMissingCGImage;
+        return nil;
+    }
+    const size_t width = CGImageGetWidth(firstFrame.CGImage);
+    const size_t height = CGImageGetHeight(firstFrame.CGImage);
+    if (width > UINT16_MAX || height > UINT16_MAX) {
+        errorCode = TIPErrorCodeEncodingUnsupported;
+        return nil;
+    }
+    const BOOL orientationAdjusted = firstFrame.imageOrientation == UIImageOrientationLeft ||
+                                     firstFrame.imageOrientation == UIImageOrientationLeftMirrored ||
+                                     firstFrame.imageOrientation == UIImageOrientationRight ||
+                                     firstFrame.imageOrientation == UIImageOrientationRightMirrored;
+    const size_t canvasWidth = (orientationAdjusted) ? height : width;
+    const size_t canvasHeight = (orientationAdjusted) ? width : height;
+
+    int errorValue = 0;
+    gif = EGifOpen(&buffer, TIPXGIFWrite, &errorValue);
+    if (!gif) {
+        return nil;
+    }
+    EGifSetGifVersion(gif, true /* GIF89 for the extensions */);
+    if (GIF_OK != EGifPutScreenDesc(gif, (int)canvasWidth, (int)canvasHeight, 8 /* colorResolution */, 0 /* backgroundColor */, NULL)) {
+        return nil;
+    }
+
+    if (frames.count > 1) {
+        // NETSCAPE2.0 application extension with the loop count
+        const NSUInteger loopCount = MIN(imageContainer.loopCount, (NSUInteger)UINT16_MAX);
+        const Byte loopBlock[3] = { 1, (Byte)(loopCount & 0xFF), (Byte)((loopCount >> 8) & 0xFF) };
+        if (GIF_OK != EGifPutExtensionLeader(gif, APPLICATION_EXT_FUNC_CODE) ||
+            GIF_OK != EGifPutExtensionBlock(gif, 11, "NETSCAPE2.0") ||
+            GIF_OK != EGifPutExtensionBlock(gif, sizeof(loopBlock), loopBlock) ||
+            GIF_OK != EGifPutExtensionTrailer(gif)) {
+            return nil;
+        }
+    }
+
+    // GIF palettes are at most 256 colors, lower qualities use smaller palettes
+    const int paletteSize = MAX(kGIF_MINIMUM_PALETTE_SIZE, MIN(256, (int)lroundf(quality * 256.f)));
+    for (NSUInteger i = 0; i < frames.count; i++) {
+        @autoreleasepool {
+            UIImage *frame = frames[i];
+            if (frame.imageOrientation != UIImageOrientationUp) {
+                frame = [frame tip_orientationAdjustedImage];
+            }
+            CGImageRef imageRef = frame.CGImage;
+            if (!imageRef) {
+                errorCode = TIPErrorCodeMissingCGImage;
+                return nil;
+            }
+            const NSTimeInterval duration = (i < frameDurations.count) ? frameDurations[i].doubleValue : 0;
+            if (!TIPXGIFWriteFrame(gif,
+                                   imageRef,
+                                   canvasWidth,
+                                   canvasHeight,
+                                   duration,
+                                   paletteSize,
+                                   (encodingOptions & TIPImageEncodingGrayscale) != 0,
+                                   (encodingOptions & TIPImageEncodingNoAlpha) != 0,
+                                   (encodingOptions & TIPImageEncodingProgressive) != 0)) {
+                return nil;
+            }
+        }
+    }
+
+    // closing writes the trailer and frees the GIF, even when it fails
+    GifFileType *finishedGIF = gif;
+    gif = NULL;
+    if (GIF_OK != EGifCloseFile(finishedGIF, &errorValue)) {
+        return nil;
+    }
+
+    outputData = [NSData dataWithBytesNoCopy:buffer.bytes length:buffer.length freeWhenDone:YES];
+    return outputData;
+}
+
+@end
+
+@implementation TIPXGIFDecoderContext
+{
+    struct {
+        BOOL didEncounterFailure:1;
+        BOOL didLoadHeaders:1;
+        BOOL didLoadFirstFrame:1;
+        BOOL didComplete:1;
+        BOOL isCachedImageComplete:1;
+    } _flags;
+
+    NSMutableData *_dataBuffer;
+    TIPXGIFBlockReader _blockReader;
+    TIPImageContainer *_cachedImageContainer;
+}
+
+@synthesize tip_data = _dataBuffer;
+
+- (nullable id)tip_config
+{
+    return nil;
+}
+
+- (BOOL)tip_isAnimated
+{
+    return _blockReader.completedFrameCount > 1;
+}
+
+- (NSUInteger)tip_frameCount
+{
+    return _blockReader.completedFrameCount;
+}
+
+- (instancetype)initWithExpectedContentLength:(NSUInteger)length
+                                       buffer:(nullable NSMutableData *)buffer
+{
+    if (self = [super init]) {
+        if (buffer) {
+            _dataBuffer = buffer;
+        } else if (length > 0) {
+            _dataBuffer = [NSMutableData dataWithCapacity:length];
+        } else {
+            _dataBuffer = [NSMutableData data];
+        }
+    }
+    return self;
+}
+
+- (TIPImageDecoderAppendResult)append:(NSData *)data
+{
+    if (_flags.didComplete) {
+        return TIPImageDecoderAppendResultDidCompleteLoading;
+    }
+
+    if (_flags.didEncounterFailure) {
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    [_dataBuffer appendData:data];
+
+    TIPXGIFBlockReaderRead(&_blockReader, _dataBuffer.bytes, _dataBuffer.length);
+    if (_blockReader.isCorrupt) {
+        _flags.didEncounterFailure = 1;
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    TIPImageDecoderAppendResult result = TIPImageDecoderAppendResultDidProgress;
+    if (!_flags.didLoadHeaders && _blockReader.didReadHeader) {
+        _tip_dimensions = CGSizeMake(_blockReader.width, _blockReader.height);
+        _flags.didLoadHeaders = 1;
+        result = TIPImageDecoderAppendResultDidLoadHeaders;
+    }
+    if (!_flags.didLoadFirstFrame && _blockReader.completedFrameCount > 0) {
+        _flags.didLoadFirstFrame = 1;
+        result = TIPImageDecoderAppendResultDidLoadFrame;
+    }
+    return result;
+}
+
+- (nullable TIPImageContainer *)renderImage:(TIPImageDecoderRenderMode)renderMode
+                           targetDimensions:(CGSize)targetDimensions
+                          targetContentMode:(UIViewContentMode)targetContentMode
+{
+    if (_flags.didEncounterFailure || !_flags.didLoadHeaders) {
+        return nil;
+    }
+
+    @autoreleasepool {
+        if (_flags.didComplete) {
+            if (!_cachedImageContainer || !_flags.isCachedImageComplete) {
+                BOOL hasAlpha = NO;
+                TIPImageContainer *container = TIPXGIFDecodeImage(_dataBuffer.bytes,
+                                                                  _dataBuffer.length,
+                                                                  NO /*appendsTrailer*/,
+                                                                  NO /*justFirstFrame*/,
+                                                                  &hasAlpha);
+                if (container) {
+                    _cachedImageContainer = container;
+                    _tip_hasAlpha = hasAlpha;
+                    _flags.isCachedImageComplete = 1;
+                } else {
+                    _flags.didEncounterFailure = 1;
+                }
+            }
+            return _cachedImageContainer;
+        }
+
+        if (TIPImageDecoderRenderModeCompleteImage == renderMode || !_flags.didLoadFirstFrame) {
+            return nil;
+        }
+
+        if (!_cachedImageContainer) {
+            // decode up to the end of the first frame, ending the data with a trailer as though the
+            // GIF has one frame
+            BOOL hasAlpha = NO;
+            _cachedImageContainer = TIPXGIFDecodeImage(_dataBuffer.bytes,
+                                                       _blockReader.firstFrameEndOffset,
+                                                       YES /*appendsTrailer*/,
+                                                       YES /*justFirstFrame*/,
+                                                       &hasAlpha);
+            _tip_hasAlpha = hasAlpha;
+        }
+        return _cachedImageContainer;
+    }
+}
+
+- (TIPImageDecoderAppendResult)finalizeDecoding
+{
+    if (_flags.didEncounterFailure) {
+        return TIPImageDecoderAppendResultDidCompleteLoading;
+    }
+
+    if (!_flags.didLoadHeaders) {
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    _flags.didComplete = 1;
+    return TIPImageDecoderAppendResultDidCompleteLoading;
+}
+
+@end
+
+#pragma mark - Functions
+
+static size_t TIPXGIFColorTableLength(Byte packedFields)
+{
+    // 3 bytes per color, 2^(N+1) colors
+    return (packedFields & 0x80) ? 3 * ((size_t)1 << ((packedFields & 0x07) + 1)) : 0;
+}
+
+static void TIPXGIFBlockReaderRead(TIPXGIFBlockReader *reader,
+                                   const Byte *bytes,
+                                   size_t length)
+{
+    NSUInteger offset = reader->offset;
+
+    if (!reader->didReadHeader) {
+        if (length < kGIF_HEADER_LENGTH) {
+            return;
+        }
+        reader->width = (size_t)bytes[6] | ((size_t)bytes[7] << 8);
+        reader->height = (size_t)bytes[8] | ((size_t)bytes[9] << 8);
+        if (!reader->width || !reader->height) {
+            reader->isCorrupt = YES;
+            return;
+        }
+        offset = kGIF_HEADER_LENGTH + TIPXGIFColorTableLength(bytes[10]);
+        reader->didReadHeader = YES;
+    }
+
+    while (!reader->didReadEnd && !reader->isCorrupt) {
+        if (reader->isInSubBlocks) {
+            // sub-blocks are a size byte followed by that many bytes, a size of 0 ends them
+            if (offset >= length) {
+                break;
+            }
+            const size_t subBlockLength = bytes[offset];
+            if (0 == subBlockLength) {
+                offset += 1;
+                reader->isInSubBlocks = NO;
+                if (reader->isInImageData) {
+                    reader->isInImageData = NO;
+                    reader->completedFrameCount++;
+                    if (1 == reader->completedFrameCount) {
+                        reader->firstFrameEndOffset = offset;
+                    }
+                }
+                continue;
+            }
+            if (offset + 1 + subBlockLength > length) {
+                break;
+            }
+            offset += 1 + subBlockLength;
+            continue;
+        }
+
+        if (offset >= length) {
+            break;
+        }
+        const Byte blockType = bytes[offset];
+        if (kGIF_BLOCK_TRAILER == blockType) {
+            reader->didReadEnd = YES;
+            offset += 1;
+        } else if (kGIF_BLOCK_EXTENSION == blockType) {
+            // introducer and label, then sub-blocks
+            if (offset + 2 > length) {
+                break;
+            }
+            offset += 2;
+            reader->isInSubBlocks = YES;
+        } else if (kGIF_BLOCK_IMAGE == blockType) {
+            // descriptor, optional local color table and LZW minimum code size, then sub-blocks
+            if (offset + kGIF_IMAGE_DESCRIPTOR_LENGTH > length) {
+                break;
+            }
+            const size_t imageHeaderLength = kGIF_IMAGE_DESCRIPTOR_LENGTH + TIPXGIFColorTableLength(bytes[offset + 9]) + 1;
+            if (offset + imageHeaderLength > length) {
+                break;
+            }
+            offset += imageHeaderLength;
+            reader->isInSubBlocks = YES;
+            reader->isInImageData = YES;
+        } else {
+            reader->isCorrupt = YES;
+        }
+    }
+
+    reader->offset = offset;
+}
+
+static int TIPXGIFRead(GifFileType *gif, GifByteType *bytes, int length)
+{
+    TIPXGIFReadBuffer *buffer = gif->UserData;
+    size_t count = MIN((size_t)length, buffer->length - buffer->offset);
+    memcpy(bytes, buffer->bytes + buffer->offset, count);
+    buffer->offset += count;
+    if (count < (size_t)length && buffer->appendsTrailer) {
+        bytes[count++] = kGIF_BLOCK_TRAILER;
+        buffer->appendsTrailer = NO;
+    }
+    return (int)count;
+}
+
+static int TIPXGIFWrite(GifFileType *gif, const GifByteType *bytes, int length)
+{
+    TIPXGIFWriteBuffer *buffer = gif->UserData;
+    if (buffer->length + (size_t)length > buffer->capacity) {
+        const size_t capacity = MAX(buffer->capacity * 2, buffer->length + (size_t)length);
+        Byte *newBytes = realloc(buffer->bytes, capacity);
+        if (!newBytes) {
+            return 0;
+        }
+        buffer->bytes = newBytes;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->bytes + buffer->length, bytes, (size_t)length);
+    buffer->length += (size_t)length;
+    return length;
+}
+
+static void TIPXGIFReleasePixels(void * __nullable info, const void *data, size_t size)
+{
+    free((void *)data);
+}
+
+static UIImage * __nullable TIPXGIFCreateFrameImage(const Byte *canvas,
+                                                    size_t width,
+                                                    size_t height,
+                                                    CGColorSpaceRef colorSpace)
+{
+    const size_t byteCount = width * height * 4;
+    Byte *pixels = malloc(byteCount);
+    if (!pixels) {
+        return nil;
+    }
+    memcpy(pixels, canvas, byteCount);
+    CGDataProviderRef provider = CGDataProviderCreateWithData(NULL, pixels, byteCount, TIPXGIFReleasePixels);
+    TIPXDeferRelease(provider);
+    if (!provider) {
+        free(pixels);
+        return nil;
+    }
+
+    // transparent pixels are all 0 and the others are opaque, so the pixels are premultiplied as is
+    CGImageRef imageRef = CGImageCreate(width,
+                                        height,
+                                        8 /* bitsPerComponent */,
+                                        32 /* bitsPerPixel */,
+                                        width * 4,
+                                        colorSpace,
+                                        (CGBitmapInfo)kCGImageAlphaPremultipliedLast,
+                                        provider,
+                                        NULL /* decode */,
+                                        false /* shouldInterpolate */,
+                                        kCGRenderingIntentDefault);
+    TIPXDeferRelease(imageRef);
+    return (imageRef) ? [UIImage imageWithCGImage:imageRef] : nil;
+}
+
+static TIPImageContainer * __nullable TIPXGIFDecodeImage(const Byte *bytes,
+                                                         size_t length,
+                                                         BOOL appendsTrailer,
+                                                         BOOL justFirstFrame,
+                                                         BOOL * __nullable hasAlphaOut)
+{
+    TIPXGIFReadBuffer readBuffer = { .bytes = bytes, .length = length, .offset = 0, .appendsTrailer = appendsTrailer };
+    int errorValue = 0;
+    GifFileType *gif = DGifOpen(&readBuffer, TIPXGIFRead, &errorValue);
+    if (!gif) {
+        return nil;
+    }
+    tipx_defer(^{
+        DGifCloseFile(gif, NULL);
+    });
+    if (GIF_OK != DGifSlurp(gif) || gif->ImageCount < 1 || gif->SWidth < 1 || gif->SHeight < 1) {
+        return nil;
+    }
+
+    const size_t width = (size_t)gif->SWidth;
+    const size_t height = (size_t)gif->SHeight;
+    const size_t canvasByteCount = width * height * 4;
+    Byte *canvas = calloc(1, canvasByteCount);
+    __block Byte *previousCanvas = NULL; // for frames that dispose to the previous frame
+    tipx_defer(^{
+        free(canvas);
+        free(previousCanvas);
+    });
+    if (!canvas) {
+        return nil;
+    }
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    TIPXDeferRelease(colorSpace);
+
+    const NSUInteger frameCount = (justFirstFrame) ? 1 : (NSUInteger)gif->ImageCount;
+    NSMutableArray<UIImage *> *frames = [[NSMutableArray alloc] initWithCapacity:frameCount];
+    NSMutableArray<NSNumber *> *frameDurations = [[NSMutableArray alloc] initWithCapacity:frameCount];
+    NSTimeInterval totalDuration = 0;
+    BOOL hasAlpha = NO;
+    for (NSUInteger i = 0; i < frameCount; i++) {
+        const SavedImage *savedImage = &gif->SavedImages[i];
+        const GifImageDesc *descriptor = &savedImage->ImageDesc;
+        const ColorMapObject *colorMap = descriptor->ColorMap ?: gif->SColorMap;
+        if (!colorMap || !savedImage->RasterBits) {
+            return nil;
+        }
+        GraphicsControlBlock controlBlock;
+        DGifSavedExtensionToGCB(gif, (int)i, &controlBlock);
+
+        // frames can extend past the canvas, only draw the part on the canvas
+        const size_t left = (size_t)MAX(0, descriptor->Left);
+        const size_t top = (size_t)MAX(0, descriptor->Top);
+        const size_t right = (size_t)MIN((NSInteger)width, (NSInteger)descriptor->Left + descriptor->Width);
+        const size_t bottom = (size_t)MIN((NSInteger)height, (NSInteger)descriptor->Top + descriptor->Height);
+        if (controlBlock.TransparentColor != NO_TRANSPARENT_COLOR || (0 == i && (left > 0 || top > 0 || right < width || bottom < height))) {
+            hasAlpha = YES;
+        }
+
+        if (DISPOSE_PREVIOUS == controlBlock.DisposalMode) {
+            if (!previousCanvas) {
+                previousCanvas = malloc(canvasByteCount);
+                if (!previousCanvas) {
+                    return nil;
+                }
+            }
+            memcpy(previousCanvas, canvas, canvasByteCount);
+        }
+
+        for (size_t y = top; y < bottom; y++) {
+            const GifByteType *indexes = savedImage->RasterBits + ((y - (size_t)descriptor->Top) * (size_t)descriptor->Width);
+            Byte *pixel = canvas + ((y * width + left) * 4);
+            for (size_t x = left; x < right; x++, pixel += 4) {
+                const int index = indexes[x - (size_t)descriptor->Left];
+                if (index == controlBlock.TransparentColor || index >= colorMap->ColorCount) {
+                    continue;
+                }
+                const GifColorType color = colorMap->Colors[index];
+                pixel[0] = color.Red;
+                pixel[1] = color.Green;
+                pixel[2] = color.Blue;
+                pixel[3] = 0xFF;
+            }
+        }
+
+        UIImage *frame = TIPXGIFCreateFrameImage(canvas, width, height, colorSpace);
+        if (!frame) {
+            return nil;
+        }
+        NSTimeInterval duration = (NSTimeInterval)controlBlock.DelayTime / 100.;
+        if (duration < 0.01 + DBL_EPSILON) {
+            duration = 0.1;
+        }
+        [frames addObject:frame];
+        [frameDurations addObject:@(duration)];
+        totalDuration += duration;
+
+        if (DISPOSE_BACKGROUND == controlBlock.DisposalMode) {
+            // browsers (and ImageIO) clear to transparent rather than to the background color
+            for (size_t y = top; y < bottom; y++) {
+                memset(canvas + ((y * width + left) * 4), 0, (right - left) * 4);
+            }
+        } else if (DISPOSE_PREVIOUS == controlBlock.DisposalMode) {
+            memcpy(canvas, previousCanvas, canvasByteCount);
+        }
+    }
+
+    if (hasAlphaOut) {
+        *hasAlphaOut = hasAlpha;
+    }
+    if (1 == frames.count) {
+        return [[TIPImageContainer alloc] initWithImage:frames.firstObject];
+    }
+    UIImage *image = [UIImage animatedImageWithImages:frames
+                                             duration:totalDuration];
+    return (image) ? [[TIPImageContainer alloc] initWithAnimatedImage:image
+                                                            loopCount:TIPXGIFReadLoopCount(gif)
+                                                       frameDurations:frameDurations] : nil;
+}
+
+static NSUInteger TIPXGIFReadLoopCountInBlocks(const ExtensionBlock * __nullable blocks, int blockCount)
+{
+    for (int i = 0; i + 1 < blockCount; i++) {
+        const ExtensionBlock *block = &blocks[i];
+        if (block->Function != APPLICATION_EXT_FUNC_CODE || block->ByteCount != 11) {
+            continue;
+        }
+        if (0 != memcmp(block->Bytes, "NETSCAPE2.0", 11) && 0 != memcmp(block->Bytes, "ANIMEXTS1.0", 11)) {
+            continue;
+        }
+        const ExtensionBlock *loopBlock = &blocks[i + 1];
+        if (loopBlock->Function == CONTINUE_EXT_FUNC_CODE && loopBlock->ByteCount >= 3 && 1 == (loopBlock->Bytes[0] & 0x07)) {
+            return (NSUInteger)loopBlock->Bytes[1] | ((NSUInteger)loopBlock->Bytes[2] << 8);
+        }
+    }
+    return NSNotFound;
+}
+
+static NSUInteger TIPXGIFReadLoopCount(const GifFileType *gif)
+{
+    // giflib attaches the extensions before the first frame to the first frame
+    NSUInteger loopCount = TIPXGIFReadLoopCountInBlocks(gif->SavedImages[0].ExtensionBlocks, gif->SavedImages[0].ExtensionBlockCount);
+    if (NSNotFound == loopCount) {
+        loopCount = TIPXGIFReadLoopCountInBlocks(gif->ExtensionBlocks, gif->ExtensionBlockCount);
+    }
+    // no loop count loops forever, like ImageIO
+    return (NSNotFound == loopCount) ? 0 : loopCount;
+}
+
+static BOOL TIPXGIFWriteFrame(GifFileType *gif,
+                              CGImageRef imageRef,
+                              size_t width,
+                              size_t height,
+                              NSTimeInterval duration,
+                              int paletteSize,
+                              BOOL grayscale,
+                              BOOL noAlpha,
+                              BOOL interlaced)
+{
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    TIPXDeferRelease(colorSpace);
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, width * 4, colorSpace, (CGBitmapInfo)kCGImageAlphaPremultipliedLast);
+    TIPXDeferRelease(context);
+    if (!context) {
+        return NO;
+    }
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+    const Byte *pixels = CGBitmapContextGetData(context);
+    const size_t bytesPerRow = CGBitmapContextGetBytesPerRow(context);
+
+    // giflib quantizes planes of red, green and blue, and mostly transparent pixels become the transparent color
+    const size_t pixelCount = width * height;
+    NSMutableData *planes = [NSMutableData dataWithLength:pixelCount * 4];
+    GifByteType *reds = planes.mutableBytes;
+    GifByteType *greens = reds + pixelCount;
+    GifByteType *blues = greens + pixelCount;
+    GifByteType *indexes = blues + pixelCount;
+    BOOL hasTransparency = NO;
+    for (size_t y = 0; y < height; y++) {
+        const Byte *rgba = pixels + (y * bytesPerRow);
+        for (size_t x = 0; x < width; x++, rgba += 4) {
+            const size_t i = (y * width) + x;
+            if (!noAlpha && rgba[3] < 0x80) {
+                hasTransparency = YES;
+                continue; // left black, which costs the palette at most 1 color
+            }
+            if (grayscale) {
+                reds[i] = greens[i] = blues[i] = (GifByteType)((54 * rgba[0] + 183 * rgba[1] + 19 * rgba[2]) >> 8);
+            } else {
+                reds[i] = rgba[0];
+                greens[i] = rgba[1];
+                blues[i] = rgba[2];
+            }
+        }
+    }
+
+    // reserve the last palette entry for the transparent color
+    GifColorType colors[256] = { 0 };
+    int colorCount = (hasTransparency) ? MIN(paletteSize, 255) : paletteSize;
+    if (GIF_OK != GifQuantizeBuffer((unsigned int)width, (unsigned int)height, &colorCount, reds, greens, blues, indexes, colors)) {
+        return NO;
+    }
+    const int transparentColor = (hasTransparency) ? 255 : NO_TRANSPARENT_COLOR;
+    if (hasTransparency) {
+        for (size_t y = 0; y < height; y++) {
+            const Byte *rgba = pixels + (y * bytesPerRow);
+            for (size_t x = 0; x < width; x++, rgba += 4) {
+                if (rgba[3] < 0x80) {
+                    indexes[(y * width) + x] = (GifByteType)transparentColor;
+                }
+            }
+        }
+    }
+
+    // full canvas frames cleared when done, so transparent pixels don't show the previous frame
+    GraphicsControlBlock controlBlock = {
+        .DisposalMode = DISPOSE_BACKGROUND,
+        .UserInputFlag = false,
+        .DelayTime = (int)MIN(lround(duration * 100.), (long)UINT16_MAX),
+        .TransparentColor = transparentColor,
+    };
+    GifByteType extension[4];
+    const size_t extensionLength = EGifGCBToExtension(&controlBlock, extension);
+    if (GIF_OK != EGifPutExtension(gif, GRAPHICS_EXT_FUNC_CODE, (int)extensionLength, extension)) {
+        return NO;
+    }
+
+    ColorMapObject *colorMap = GifMakeMapObject(256, colors);
+    if (!colorMap) {
+        return NO;
+    }
+    tipx_defer(^{
+        GifFreeMapObject(colorMap);
+    });
+    if (GIF_OK != EGifPutImageDesc(gif, 0, 0, (int)width, (int)height, interlaced, colorMap)) {
+        return NO;
+    }
+
+    // interlaced rows are written in the order of the 4 interlacing passes
+    static const size_t sInterlacedOffsets[] = { 0, 4, 2, 1 };
+    static const size_t sInterlacedSteps[] = { 8, 8, 4, 2 };
+    const size_t passCount = (interlaced) ? 4 : 1;
+    for (size_t pass = 0; pass < passCount; pass++) {
+        const size_t step = (interlaced) ? sInterlacedSteps[pass] : 1;
+        for (size_t y = (interlaced) ? sInterlacedOffsets[pass] : 0; y < height; y += step) {
+            if (GIF_OK != EGifPutLine(gif, indexes + (y * width), (int)width)) {
+                return NO;
+            }
+        }
+    }
+    return YES;
+}
+
+NS_ASSUME_NONNULL_END
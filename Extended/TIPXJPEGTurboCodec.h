@@ -0,0 +1,68 @@
+//
+//  TIPXJPEGTurboCodec.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import <TwitterImagePipeline/TIPImageCodecs.h>
+
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Convenience codec for decoding and encoding JPEGs with libjpeg-turbo, in place of ImageIO.
+ Requires libjpeg-turbo 2.0 or later (its `jpeglib.h` headers and `libjpeg` library).
+ This codec is not bundled with __TIP__ to avoid bloating the framework with libjpeg-turbo,
+ but there's nothing preventing a consumer from using this codec.
+
+ The decoder decodes directly at 1/2, 1/4 or 1/8 of the full size when the target sizing permits
+ (scaling in the DCT domain), so decoding a large JPEG for a small target never produces a full size
+ bitmap.  Pixels are converted from YCbCr straight into the native BGRX layout by libjpeg-turbo's SIMD
+ color conversion.  Progressive JPEGs are rendered each time a scan completes.
+ Large baseline JPEGs with restart markers at the start of MCU rows (common for camera photos) are
+ split into bands of rows that decode concurrently, other JPEGs decode sequentially (see
+ `concurrentDecodingEnabled`).
+ Regions of an image (`TIPDecodeImageRegionFromData`) are decoded without converting the pixels
+ outside of the region, and with DCT scaling when the target sizing of the region permits.
+ libjpeg-turbo can't convert CMYK and YCCK JPEGs to RGB, those are decoded by the decoder of the
+ preferred codec (see `initWithPreferredCodec:`), or not matched at all when there is no preferred codec.
+
+ The encoder supports `TIPImageEncodingProgressive` and `TIPImageEncodingGrayscale`, maps the
+ suggested quality to a libjpeg quality of `1` to `100` (JPEG has no lossless mode) and writes the
+ orientation of the image as EXIF.  Images are encoded in the device RGB (sRGB) color space.
+ Large baseline JPEGs are written with a restart marker at the start of each MCU row, so that they
+ decode concurrently.
+
+    [[TIPImageCodecCatalogue sharedInstance] replaceCodecForImageType:TIPImageTypeJPEG
+                                                           usingBlock:^id<TIPImageCodec>(id<TIPImageCodec> existingCodec) {
+        return [[TIPXJPEGTurboCodec alloc] initWithPreferredCodec:existingCodec];
+    }];
+ */
+@interface TIPXJPEGTurboCodec : NSObject <TIPImageCodec>
+/** libjpeg-turbo decoder */
+@property (nonatomic, readonly) id<TIPImageDecoder> tip_decoder;
+/** libjpeg-turbo encoder */
+@property (nonatomic, readonly) id<TIPImageEncoder> tip_encoder;
+
+/**
+ Initializer
+ @param preferredCodec Pass the codec being replaced (the default system codec) if possible. Its
+ decoder decodes the JPEGs that libjpeg-turbo can't (CMYK and YCCK), its encoder is not used.
+ @return a new `TIPXJPEGTurboCodec` instance
+ */
+- (instancetype)initWithPreferredCodec:(nullable id<TIPImageCodec>)preferredCodec NS_DESIGNATED_INITIALIZER;
+/** Initializer without a preferred codec, CMYK and YCCK JPEGs will not be matched by the decoder */
+- (instancetype)init;
+
+/**
+ Whether large baseline JPEGs with restart markers at the start of MCU rows are decoded in concurrent
+ bands of rows, `YES` by default.  Disable to decode each JPEG on one thread (such as when many JPEGs
+ decode at once), the decoded pixels are the same either way.
+ */
+@property (class, atomic, getter=isConcurrentDecodingEnabled) BOOL concurrentDecodingEnabled;
+
+@end
+
+NS_ASSUME_NONNULL_END
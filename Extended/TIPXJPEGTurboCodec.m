@@ -0,0 +1,1424 @@
+//
+//  TIPXJPEGTurboCodec.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#pragma mark imports
+
+#include <stdatomic.h>
+
+#import <TwitterImagePipeline/TwitterImagePipeline.h>
+
+#import "TIPXJPEGTurboCodec.h"
+#import "TIPXUtils.h"
+
+#pragma mark libjpeg-turbo includes
+
+#include <setjmp.h>
+#include <stdio.h> // jpeglib.h needs FILE declared
+#include <jpeglib.h>
+
+#if !defined(JCS_EXTENSIONS)
+#error TIPXJPEGTurboCodec requires libjpeg-turbo (for JCS_EXT_BGRX)
+#endif
+
+NS_ASSUME_NONNULL_BEGIN
+
+#pragma mark - Declarations
+
+#define kJPEG_MARKER_SPECIAL_BYTE   (0xFF)
+#define kJPEG_MARKER_SOI            (0xD8)
+#define kJPEG_MARKER_EOI            (0xD9)
+#define kJPEG_MARKER_SOS            (0xDA)
+#define kJPEG_MARKER_RST0           (0xD0)
+#define kJPEG_MARKER_RST7           (0xD7)
+#define kJPEG_MARKER_TEM            (0x01)
+
+// Incremental reader of the JPEG markers, to find the frame header and the boundaries of scans
+typedef struct {
+    NSUInteger offset; // where the next read resumes
+    NSUInteger completedScanCount;
+    NSUInteger completedScanEndOffset; // offset of the marker that ended the last completed scan
+    NSUInteger frameHeaderOffset; // offset of the SOF marker
+    size_t width;
+    size_t height;
+    NSUInteger componentCount;
+    BOOL didReadFrameHeader;
+    BOOL isProgressive;
+    BOOL isInEntropyCodedData;
+    BOOL didReadEnd;
+    BOOL isCorrupt;
+} TIPXJPEGMarkerReader;
+
+typedef struct {
+    struct jpeg_error_mgr manager;
+    jmp_buf jump;
+} TIPXJPEGErrorManager;
+
+typedef struct {
+    size_t width;
+    size_t height;
+    CGImagePropertyOrientation orientation;
+    CGColorSpaceRef colorSpace; // retained
+
+    // restart interval geometry, all 0 if the image cannot be decoded in bands
+    size_t entropyCodedDataOffset;
+    size_t restartInterval; // in MCUs
+    size_t mcusPerRow;
+    size_t mcuHeight;
+} TIPXJPEGHeader;
+
+// Images with fewer pixels are quicker to decode sequentially than to split into bands
+static const size_t kTIPXJPEGConcurrentDecodingMinimumPixels = 2048 * 2048;
+static atomic_bool sConcurrentDecodingEnabled = true;
+// Widest iMCU column (4x horizontal sampling of 8 pixel blocks), cropped decoding starts at the iMCU
+// column of the first pixel
+static const size_t kTIPXJPEGMaximumCropAlignment = 32;
+
+static void TIPXJPEGMarkerReaderRead(TIPXJPEGMarkerReader *reader,
+                                     const Byte *bytes,
+                                     NSUInteger length);
+static BOOL TIPXJPEGIsDecodableComponentCount(NSUInteger componentCount);
+static BOOL TIPXJPEGIsDecodableData(NSData *data);
+static TIPImageContainer * __nullable TIPXJPEGTurboDecodeImage(NSData *data,
+                                                               NSUInteger length,
+                                                               CGRect region,
+                                                               CGSize targetDimensions,
+                                                               UIViewContentMode targetContentMode);
+static CGImageRef __nullable TIPXJPEGTurboCreateImage(const Byte *bytes,
+                                                      size_t length,
+                                                      CGRect region,
+                                                      CGSize targetDimensions,
+                                                      UIViewContentMode targetContentMode,
+                                                      CGImagePropertyOrientation *orientationOut) CF_RETURNS_RETAINED;
+static CGImageRef __nullable TIPXJPEGTurboCreateRegionImage(const Byte *bytes,
+                                                            size_t length,
+                                                            const TIPXJPEGHeader *header,
+                                                            CGRect region,
+                                                            CGSize targetDimensions,
+                                                            UIViewContentMode targetContentMode) CF_RETURNS_RETAINED;
+static BOOL TIPXJPEGTurboReadHeader(const Byte *bytes,
+                                    size_t length,
+                                    TIPXJPEGHeader *header);
+static BOOL TIPXJPEGTurboDecodePixels(const Byte *bytes,
+                                      size_t length,
+                                      unsigned int scaleDenominator,
+                                      size_t skippedRowCount,
+                                      Byte *pixels,
+                                      size_t width,
+                                      size_t height,
+                                      size_t bytesPerRow);
+static BOOL TIPXJPEGTurboDecodePixelsConcurrently(const Byte *bytes,
+                                                  size_t length,
+                                                  const TIPXJPEGHeader *header,
+                                                  unsigned int scaleDenominator,
+                                                  Byte *pixels,
+                                                  size_t width,
+                                                  size_t height,
+                                                  size_t bytesPerRow);
+static BOOL TIPXJPEGTurboDecodePixelRegion(const Byte *bytes,
+                                           size_t length,
+                                           unsigned int scaleDenominator,
+                                           size_t x,
+                                           size_t y,
+                                           size_t width,
+                                           size_t height,
+                                           Byte *pixels,
+                                           size_t bytesPerRow,
+                                           size_t *columnOffsetOut);
+static CGRect TIPXJPEGUnorientedRect(CGRect rect,
+                                     size_t width,
+                                     size_t height,
+                                     CGImagePropertyOrientation orientation);
+static unsigned int TIPXJPEGScaleDenominator(CGSize dimensions,
+                                             CGSize targetDimensions,
+                                             UIViewContentMode targetContentMode,
+                                             CGImagePropertyOrientation orientation);
+static CGImagePropertyOrientation TIPXJPEGReadOrientation(j_decompress_ptr decompress);
+static BOOL TIPXJPEGTurboCompress(const Byte *pixels,
+                                  size_t width,
+                                  size_t height,
+                                  size_t bytesPerRow,
+                                  BOOL grayscale,
+                                  int quality,
+                                  BOOL progressive,
+                                  CGImagePropertyOrientation orientation,
+                                  Byte * __nullable * __nonnull bufferOut,
+                                  unsigned long *lengthOut);
+
+@interface TIPXJPEGTurboDecoderContext : NSObject <TIPImageDecoderContext>
+
+@property (nonatomic, readonly) NSData *tip_data;
+@property (nonatomic, readonly) CGSize tip_dimensions;
+@property (nonatomic, readonly) NSUInteger tip_frameCount;
+@property (nonatomic, readonly) BOOL tip_isProgressive;
+@property (nonatomic, readonly) BOOL tip_hasAlpha;
+
+- (instancetype)initWithExpectedContentLength:(NSUInteger)length
+                                       buffer:(nullable NSMutableData *)buffer
+                                       config:(nullable id)config
+                                fallbackCodec:(nullable id<TIPImageCodec>)fallbackCodec;
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+- (TIPImageDecoderAppendResult)append:(NSData *)data TIPX_OBJC_DIRECT;
+- (nullable TIPImageContainer *)renderImage:(TIPImageDecoderRenderMode)renderMode
+                           targetDimensions:(CGSize)targetDimensions
+                          targetContentMode:(UIViewContentMode)targetContentMode TIPX_OBJC_DIRECT;
+- (TIPImageDecoderAppendResult)finalizeDecoding TIPX_OBJC_DIRECT;
+
+@end
+
+@interface TIPXJPEGTurboDecoder : NSObject <TIPImageDecoder>
+- (instancetype)initWithFallbackCodec:(nullable id<TIPImageCodec>)fallbackCodec;
+@end
+
+@interface TIPXJPEGTurboEncoder : NSObject <TIPImageEncoder>
+@end
+
+#pragma mark - Implementations
+
+@implementation TIPXJPEGTurboCodec
+
++ (BOOL)isConcurrentDecodingEnabled
+{
+    return atomic_load(&sConcurrentDecodingEnabled);
+}
+
++ (void)setConcurrentDecodingEnabled:(BOOL)concurrentDecodingEnabled
+{
+    atomic_store(&sConcurrentDecodingEnabled, concurrentDecodingEnabled);
+}
+
+- (instancetype)init
+{
+    return [self initWithPreferredCodec:nil];
+}
+
+- (instancetype)initWithPreferredCodec:(nullable id<TIPImageCodec>)preferredCodec
+{
+    if (self = [super init]) {
+        // only the decoder falls back, libjpeg-turbo encodes anything that can be drawn to RGB
+        _tip_decoder = [[TIPXJPEGTurboDecoder alloc] initWithFallbackCodec:(preferredCodec.tip_decoder) ? preferredCodec : nil];
+        _tip_encoder = [[TIPXJPEGTurboEncoder alloc] init];
+    }
+    return self;
+}
+
+@end
+
+@implementation TIPXJPEGTurboDecoder
+{
+    id<TIPImageCodec> _fallbackCodec;
+}
+
+- (instancetype)initWithFallbackCodec:(nullable id<TIPImageCodec>)fallbackCodec
+{
+    if (self = [super init]) {
+        _fallbackCodec = fallbackCodec;
+    }
+    return self;
+}
+
+- (TIPImageDecoderDetectionResult)tip_detectDecodableData:(NSData *)data
+                                           isCompleteData:(BOOL)complete
+                                      earlyGuessImageType:(nullable NSString *)imageType
+{
+    if (data.length < 3) {
+        return (complete) ? TIPImageDecoderDetectionResultNoMatch : TIPImageDecoderDetectionResultNeedMoreData;
+    }
+
+    const Byte *bytes = data.bytes;
+    if (bytes[0] != kJPEG_MARKER_SPECIAL_BYTE || bytes[1] != kJPEG_MARKER_SOI || bytes[2] != kJPEG_MARKER_SPECIAL_BYTE) {
+        return TIPImageDecoderDetectionResultNoMatch;
+    }
+
+    // read up to the frame header, CMYK and YCCK JPEGs (which libjpeg-turbo can't convert to RGB)
+    // are only matched when the fallback decoder matches them
+    TIPXJPEGMarkerReader reader = { 0 };
+    TIPXJPEGMarkerReaderRead(&reader, bytes, data.length);
+    if (reader.isCorrupt) {
+        return TIPImageDecoderDetectionResultNoMatch;
+    }
+    if (reader.didReadFrameHeader) {
+        if (TIPXJPEGIsDecodableComponentCount(reader.componentCount)) {
+            return TIPImageDecoderDetectionResultMatch;
+        }
+        id<TIPImageDecoder> fallbackDecoder = _fallbackCodec.tip_decoder;
+        if (!fallbackDecoder) {
+            return TIPImageDecoderDetectionResultNoMatch;
+        }
+        return [fallbackDecoder tip_detectDecodableData:data
+                                         isCompleteData:complete
+                                    earlyGuessImageType:imageType];
+    }
+    return (complete) ? TIPImageDecoderDetectionResultNoMatch : TIPImageDecoderDetectionResultNeedMoreData;
+}
+
+- (id<TIPImageDecoderContext>)tip_initiateDecoding:(nullable id)config
+                                expectedDataLength:(NSUInteger)expectedDataLength
+                                            buffer:(nullable NSMutableData *)buffer
+{
+    return [[TIPXJPEGTurboDecoderContext alloc] initWithExpectedContentLength:expectedDataLength
+                                                                       buffer:buffer
+                                                                       config:config
+                                                                fallbackCodec:_fallbackCodec];
+}
+
+- (TIPImageDecoderAppendResult)tip_append:(TIPXJPEGTurboDecoderContext *)context
+                                     data:(NSData *)data
+{
+    return [context append:data];
+}
+
+- (nullable TIPImageContainer *)tip_renderImage:(TIPXJPEGTurboDecoderContext *)context
+                                     renderMode:(TIPImageDecoderRenderMode)renderMode
+                               targetDimensions:(CGSize)targetDimensions
+                              targetContentMode:(UIViewContentMode)targetContentMode
+{
+    return [context renderImage:renderMode targetDimensions:targetDimensions targetContentMode:targetContentMode];
+}
+
+- (TIPImageDecoderAppendResult)tip_finalizeDecoding:(TIPXJPEGTurboDecoderContext *)context
+{
+    return [context finalizeDecoding];
+}
+
+- (BOOL)tip_supportsProgressiveDecoding
+{
+    return YES;
+}
+
+- (nullable TIPImageContainer *)tip_decodeImageWithData:(NSData *)imageData
+                                       targetDimensions:(CGSize)targetDimensions
+                                      targetContentMode:(UIViewContentMode)targetContentMode
+                                                 config:(nullable id)config
+{
+    if (_fallbackCodec && !TIPXJPEGIsDecodableData(imageData)) {
+        return TIPDecodeImageFromData(_fallbackCodec, config, imageData, targetDimensions, targetContentMode);
+    }
+    return TIPXJPEGTurboDecodeImage(imageData, imageData.length, CGRectNull, targetDimensions, targetContentMode);
+}
+
+- (nullable TIPImageContainer *)tip_decodeImageRegion:(CGRect)region
+                                             fromData:(NSData *)imageData
+                                     targetDimensions:(CGSize)targetDimensions
+                                    targetContentMode:(UIViewContentMode)targetContentMode
+                                               config:(nullable id)config
+{
+    if (CGRectIsNull(region)) {
+        return nil;
+    }
+    if (_fallbackCodec && !TIPXJPEGIsDecodableData(imageData)) {
+        return TIPDecodeImageRegionFromData(_fallbackCodec, config, imageData, region, targetDimensions, targetContentMode);
+    }
+    return TIPXJPEGTurboDecodeImage(imageData, imageData.length, region, targetDimensions, targetContentMode);
+}
+
+@end
+
+@implementation TIPXJPEGTurboEncoder
+
+- (nullable NSData *)tip_writeDataWithImage:(TIPImageContainer *)imageContainer
+                            encodingOptions:(TIPImageEncodingOptions)encodingOptions
+                           suggestedQuality:(float)quality
+                                      error:(out NSError * __nullable __autoreleasing * __nullable)error
+{
+    __block TIPErrorCode errorCode = TIPErrorCodeUnknown;
+    __block NSData *outputData = nil;
+    tipx_defer(^{
+        if (error && !outputData) {
+            *error = [NSError errorWithDomain:TIPErrorDomain
+                                         code:errorCode
+                                     userInfo:nil];
+        }
+    });
+
+    UIImage *image = imageContainer.image;
+    if (imageContainer.animated) {
+        image = image.images.firstObject;
+    }
+
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef) {
+        errorCode = TIPErrorCodeMissingCGImage;
+        return nil;
+    }
+
+    // draw into the layout libjpeg-turbo reads natively (BGRX or 8-bit gray)
+    const BOOL grayscale = (encodingOptions & TIPImageEncodingGrayscale) != 0;
+    const size_t width = CGImageGetWidth(imageRef);
+    const size_t height = CGImageGetHeight(imageRef);
+    const size_t bytesPerRow = width * ((grayscale) ? 1 : 4);
+    CGColorSpaceRef colorSpace = (grayscale) ? CGColorSpaceCreateDeviceGray() : CGColorSpaceCreateDeviceRGB();
+    TIPXDeferRelease(colorSpace);
+    const CGBitmapInfo bitmapInfo = (grayscale) ? (CGBitmapInfo)kCGImageAlphaNone : (kCGBitmapByteOrder32Little | kCGImageAlphaNoneSkipFirst);
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, bytesPerRow, colorSpace, bitmapInfo);
+    TIPXDeferRelease(context);
+    if (!context) {
+        return nil;
+    }
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+
+    // JPEG has no lossless mode, a quality of 1 is the best quality
+    const int jpegQuality = MAX(1, MIN(100, (int)lroundf(quality * 100.f)));
+    Byte *buffer = NULL;
+    unsigned long length = 0;
+    if (!TIPXJPEGTurboCompress(CGBitmapContextGetData(context),
+                               width,
+                               height,
+                               CGBitmapContextGetBytesPerRow(context),
+                               grayscale,
+                               jpegQuality,
+                               (encodingOptions & TIPImageEncodingProgressive) != 0,
+                               TIPCGImageOrientationFromUIImageOrientation(image.imageOrientation),
+                               &buffer,
+                               &length)) {
+        return nil;
+    }
+
+    outputData = [NSData dataWithBytesNoCopy:buffer length:length freeWhenDone:YES];
+    return outputData;
+}
+
+@end
+
+@implementation TIPXJPEGTurboDecoderContext
+{
+    struct {
+        BOOL didEncounterFailure:1;
+        BOOL didLoadHeaders:1;
+        BOOL didComplete:1;
+        BOOL isCachedImageComplete:1;
+    } _flags;
+
+    NSMutableData *_dataBuffer;
+    NSUInteger _expectedContentLength;
+    id _config;
+    TIPXJPEGMarkerReader _markerReader;
+    TIPImageContainer *_cachedImageContainer;
+    NSUInteger _cachedImageScanCount;
+
+    // decodes CMYK and YCCK JPEGs, once the frame header reveals one
+    id<TIPImageCodec> _fallbackCodec;
+    id<TIPImageDecoderContext> _fallbackContext;
+}
+
+@synthesize tip_dimensions = _tip_dimensions;
+
+- (NSData *)tip_data
+{
+    return (_fallbackContext) ? _fallbackContext.tip_data : _dataBuffer;
+}
+
+- (CGSize)tip_dimensions
+{
+    return (_fallbackContext) ? _fallbackContext.tip_dimensions : _tip_dimensions;
+}
+
+- (BOOL)tip_hasAlpha
+{
+    return (_fallbackContext) ? _fallbackContext.tip_hasAlpha : NO;
+}
+
+- (nullable id)tip_config
+{
+    return _config;
+}
+
+- (BOOL)tip_isProgressive
+{
+    if (_fallbackContext) {
+        return _fallbackContext.tip_isProgressive;
+    }
+    return _markerReader.isProgressive;
+}
+
+- (NSUInteger)tip_frameCount
+{
+    if (_fallbackContext) {
+        return _fallbackContext.tip_frameCount;
+    }
+    if (_markerReader.isProgressive) {
+        return _markerReader.completedScanCount;
+    }
+    return (_flags.didComplete) ? 1 : 0;
+}
+
+- (instancetype)initWithExpectedContentLength:(NSUInteger)length
+                                       buffer:(nullable NSMutableData *)buffer
+                                       config:(nullable id)config
+                                fallbackCodec:(nullable id<TIPImageCodec>)fallbackCodec
+{
+    if (self = [super init]) {
+        _expectedContentLength = length;
+        _config = config;
+        _fallbackCodec = fallbackCodec;
+        if (buffer) {
+            _dataBuffer = buffer;
+        } else if (length > 0) {
+            _dataBuffer = [NSMutableData dataWithCapacity:length];
+        } else {
+            _dataBuffer = [NSMutableData data];
+        }
+    }
+    return self;
+}
+
+- (TIPImageDecoderAppendResult)append:(NSData *)data
+{
+    if (_fallbackContext) {
+        return [_fallbackCodec.tip_decoder tip_append:_fallbackContext data:data];
+    }
+
+    if (_flags.didComplete) {
+        return TIPImageDecoderAppendResultDidCompleteLoading;
+    }
+
+    if (_flags.didEncounterFailure) {
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    [_dataBuffer appendData:data];
+
+    const NSUInteger previousCompletedScanCount = _markerReader.completedScanCount;
+    TIPXJPEGMarkerReaderRead(&_markerReader, _dataBuffer.bytes, _dataBuffer.length);
+    if (_markerReader.isCorrupt) {
+        _flags.didEncounterFailure = 1;
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    if (_markerReader.didReadFrameHeader && !TIPXJPEGIsDecodableComponentCount(_markerReader.componentCount)) {
+        id<TIPImageDecoder> fallbackDecoder = _fallbackCodec.tip_decoder;
+        if (!fallbackDecoder) {
+            _flags.didEncounterFailure = 1;
+            return TIPImageDecoderAppendResultDidProgress;
+        }
+
+        // hand everything read so far to the fallback decoder and forward to it from now on
+        _fallbackContext = [fallbackDecoder tip_initiateDecoding:_config
+                                              expectedDataLength:_expectedContentLength
+                                                          buffer:nil];
+        NSData *bufferedData = [_dataBuffer copy];
+        _dataBuffer = nil;
+        return [fallbackDecoder tip_append:_fallbackContext data:bufferedData];
+    }
+
+    TIPImageDecoderAppendResult result = TIPImageDecoderAppendResultDidProgress;
+    if (!_flags.didLoadHeaders && _markerReader.didReadFrameHeader) {
+        _tip_dimensions = CGSizeMake(_markerReader.width, _markerReader.height);
+        _flags.didLoadHeaders = 1;
+        result = TIPImageDecoderAppendResultDidLoadHeaders;
+    }
+    if (_markerReader.isProgressive && _markerReader.completedScanCount > previousCompletedScanCount) {
+        result = TIPImageDecoderAppendResultDidLoadFrame;
+    }
+    return result;
+}
+
+- (nullable TIPImageContainer *)renderImage:(TIPImageDecoderRenderMode)renderMode
+                           targetDimensions:(CGSize)targetDimensions
+                          targetContentMode:(UIViewContentMode)targetContentMode
+{
+    if (_fallbackContext) {
+        return [_fallbackCodec.tip_decoder tip_renderImage:_fallbackContext
+                                                renderMode:renderMode
+                                          targetDimensions:targetDimensions
+                                         targetContentMode:targetContentMode];
+    }
+
+    if (_flags.didEncounterFailure || !_flags.didLoadHeaders) {
+        return nil;
+    }
+
+    @autoreleasepool {
+        if (_flags.didComplete) {
+            if (!_cachedImageContainer || !_flags.isCachedImageComplete) {
+                TIPImageContainer *container = TIPXJPEGTurboDecodeImage(_dataBuffer,
+                                                                        _dataBuffer.length,
+                                                                        CGRectNull,
+                                                                        targetDimensions,
+                                                                        targetContentMode);
+                if (container) {
+                    _cachedImageContainer = container;
+                    _flags.isCachedImageComplete = 1;
+                } else {
+                    _flags.didEncounterFailure = 1;
+                }
+            }
+            return _cachedImageContainer;
+        }
+
+        if (TIPImageDecoderRenderModeCompleteImage == renderMode || !_markerReader.isProgressive || !_markerReader.completedScanCount) {
+            return nil;
+        }
+
+        if (!_cachedImageContainer || _cachedImageScanCount != _markerReader.completedScanCount) {
+            // decode up to the end of the last completed scan, libjpeg-turbo ends the data with a
+            // fake end of image marker and renders the scans it has
+            TIPImageContainer *container = TIPXJPEGTurboDecodeImage(_dataBuffer,
+                                                                    _markerReader.completedScanEndOffset,
+                                                                    CGRectNull,
+                                                                    targetDimensions,
+                                                                    targetContentMode);
+            if (container) {
+                _cachedImageContainer = container;
+                _cachedImageScanCount = _markerReader.completedScanCount;
+            }
+        }
+        return _cachedImageContainer;
+    }
+}
+
+- (TIPImageDecoderAppendResult)finalizeDecoding
+{
+    if (_fallbackContext) {
+        return [_fallbackCodec.tip_decoder tip_finalizeDecoding:_fallbackContext];
+    }
+
+    if (_flags.didEncounterFailure) {
+        return TIPImageDecoderAppendResultDidCompleteLoading;
+    }
+
+    if (!_flags.didLoadHeaders) {
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    _flags.didComplete = 1;
+    return TIPImageDecoderAppendResultDidCompleteLoading;
+}
+
+@end
+
+#pragma mark - Functions
+
+static BOOL TIPXJPEGIsStartOfFrameMarker(Byte marker)
+{
+    // SOF0 through SOF15, except DHT (0xC4), JPG (0xC8) and DAC (0xCC)
+    return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+static BOOL TIPXJPEGIsDecodableComponentCount(NSUInteger componentCount)
+{
+    // grayscale or YCbCr, libjpeg-turbo can't convert CMYK or YCCK to RGB
+    return 1 == componentCount || 3 == componentCount;
+}
+
+static BOOL TIPXJPEGIsDecodableData(NSData *data)
+{
+    TIPXJPEGMarkerReader reader = { 0 };
+    TIPXJPEGMarkerReaderRead(&reader, data.bytes, data.length);
+    return !reader.didReadFrameHeader || TIPXJPEGIsDecodableComponentCount(reader.componentCount);
+}
+
+static void TIPXJPEGMarkerReaderRead(TIPXJPEGMarkerReader *reader,
+                                     const Byte *bytes,
+                                     NSUInteger length)
+{
+    NSUInteger offset = reader->offset;
+    if (0 == offset) {
+        if (length < 2) {
+            return;
+        }
+        if (bytes[0] != kJPEG_MARKER_SPECIAL_BYTE || bytes[1] != kJPEG_MARKER_SOI) {
+            reader->isCorrupt = YES;
+            return;
+        }
+        offset = 2;
+    }
+
+    while (offset < length && !reader->didReadEnd && !reader->isCorrupt) {
+        if (reader->isInEntropyCodedData) {
+            // 0xFF bytes in entropy coded data are stuffed with 0x00, so only a restart marker or
+            // the marker that ends the scan can follow one
+            const Byte *specialByte = memchr(bytes + offset, kJPEG_MARKER_SPECIAL_BYTE, length - offset);
+            if (!specialByte) {
+                offset = length;
+                break;
+            }
+            const NSUInteger markerOffset = (NSUInteger)(specialByte - bytes);
+            if (markerOffset + 1 >= length) {
+                offset = markerOffset;
+                break;
+            }
+            const Byte marker = bytes[markerOffset + 1];
+            if (0x00 == marker || (marker >= kJPEG_MARKER_RST0 && marker <= kJPEG_MARKER_RST7)) {
+                offset = markerOffset + 2;
+            } else if (kJPEG_MARKER_SPECIAL_BYTE == marker) {
+                offset = markerOffset + 1; // fill byte
+            } else {
+                reader->isInEntropyCodedData = NO;
+                reader->completedScanCount++;
+                reader->completedScanEndOffset = markerOffset;
+                offset = markerOffset;
+            }
+            continue;
+        }
+
+        if (offset + 1 >= length) {
+            break;
+        }
+        if (bytes[offset] != kJPEG_MARKER_SPECIAL_BYTE) {
+            reader->isCorrupt = YES;
+            break;
+        }
+
+        const Byte marker = bytes[offset + 1];
+        if (kJPEG_MARKER_SPECIAL_BYTE == marker) {
+            offset++; // fill byte
+            continue;
+        }
+        if (kJPEG_MARKER_EOI == marker) {
+            reader->didReadEnd = YES;
+            offset += 2;
+            break;
+        }
+        if (kJPEG_MARKER_TEM == marker || (marker >= kJPEG_MARKER_RST0 && marker <= kJPEG_MARKER_RST7)) {
+            offset += 2; // no segment
+            continue;
+        }
+
+        // wait for the whole segment
+        if (offset + 3 >= length) {
+            break;
+        }
+        const NSUInteger segmentLength = ((NSUInteger)bytes[offset + 2] << 8) | bytes[offset + 3];
+        const NSUInteger segmentEnd = offset + 2 + segmentLength;
+        if (segmentLength < 2) {
+            reader->isCorrupt = YES;
+            break;
+        }
+        if (segmentEnd > length) {
+            break;
+        }
+
+        if (TIPXJPEGIsStartOfFrameMarker(marker)) {
+            if (segmentLength < 8) {
+                reader->isCorrupt = YES;
+                break;
+            }
+            reader->frameHeaderOffset = offset;
+            reader->height = ((size_t)bytes[offset + 5] << 8) | bytes[offset + 6];
+            reader->width = ((size_t)bytes[offset + 7] << 8) | bytes[offset + 8];
+            reader->componentCount = bytes[offset + 9];
+            reader->isProgressive = (0xC2 == marker || 0xC6 == marker || 0xCA == marker || 0xCE == marker);
+            reader->didReadFrameHeader = YES;
+        } else if (kJPEG_MARKER_SOS == marker) {
+            reader->isInEntropyCodedData = YES;
+        }
+        offset = segmentEnd;
+    }
+
+    reader->offset = offset;
+}
+
+static void TIPXJPEGErrorExit(j_common_ptr cinfo)
+{
+    longjmp(((TIPXJPEGErrorManager *)cinfo->err)->jump, 1);
+}
+
+static void TIPXJPEGEmitMessage(j_common_ptr cinfo, int msgLevel)
+{
+    // warnings are expected, such as the premature end of data of progressive renders
+}
+
+static TIPImageContainer * __nullable TIPXJPEGTurboDecodeImage(NSData *data,
+                                                               NSUInteger length,
+                                                               CGRect region,
+                                                               CGSize targetDimensions,
+                                                               UIViewContentMode targetContentMode)
+{
+    CGImagePropertyOrientation orientation = kCGImagePropertyOrientationUp;
+    CGImageRef imageRef = TIPXJPEGTurboCreateImage(data.bytes,
+                                                   MIN(length, data.length),
+                                                   region,
+                                                   targetDimensions,
+                                                   targetContentMode,
+                                                   &orientation);
+    TIPXDeferRelease(imageRef);
+    if (!imageRef) {
+        return nil;
+    }
+
+    UIImage *image = [UIImage imageWithCGImage:imageRef
+                                         scale:1.0
+                                   orientation:TIPUIImageOrientationFromCGImageOrientation(orientation)];
+    return [[TIPImageContainer alloc] initWithImage:image];
+}
+
+static CGImageRef __nullable TIPXJPEGTurboCreateImage(const Byte *bytes,
+                                                      size_t length,
+                                                      CGRect region,
+                                                      CGSize targetDimensions,
+                                                      UIViewContentMode targetContentMode,
+                                                      CGImagePropertyOrientation *orientationOut)
+{
+    TIPXJPEGHeader header;
+    if (!TIPXJPEGTurboReadHeader(bytes, length, &header)) {
+        return NULL;
+    }
+    CGColorSpaceRef colorSpace = header.colorSpace;
+    TIPXDeferRelease(colorSpace);
+
+    if (!CGRectIsNull(region)) {
+        *orientationOut = header.orientation;
+        return TIPXJPEGTurboCreateRegionImage(bytes, length, &header, region, targetDimensions, targetContentMode);
+    }
+
+    const unsigned int scaleDenominator = TIPXJPEGScaleDenominator(CGSizeMake(header.width, header.height),
+                                                                   targetDimensions,
+                                                                   targetContentMode,
+                                                                   header.orientation);
+    // libjpeg rounds scaled dimensions up
+    const size_t width = (header.width + scaleDenominator - 1) / scaleDenominator;
+    const size_t height = (header.height + scaleDenominator - 1) / scaleDenominator;
+    const size_t bytesPerRow = width * 4;
+    Byte *pixels = malloc(bytesPerRow * height);
+    if (!pixels) {
+        return NULL;
+    }
+
+    if (!TIPXJPEGTurboDecodePixelsConcurrently(bytes, length, &header, scaleDenominator, pixels, width, height, bytesPerRow)) {
+        if (!TIPXJPEGTurboDecodePixels(bytes, length, scaleDenominator, 0, pixels, width, height, bytesPerRow)) {
+            free(pixels);
+            return NULL;
+        }
+    }
+
+    CFDataRef pixelData = CFDataCreateWithBytesNoCopy(NULL, pixels, (CFIndex)(bytesPerRow * height), kCFAllocatorMalloc);
+    TIPXDeferRelease(pixelData);
+    if (!pixelData) {
+        free(pixels);
+        return NULL;
+    }
+    CGDataProviderRef provider = CGDataProviderCreateWithCFData(pixelData);
+    TIPXDeferRelease(provider);
+    if (!provider) {
+        return NULL;
+    }
+
+    *orientationOut = header.orientation;
+    return CGImageCreate(width,
+                         height,
+                         8 /* bitsPerComponent */,
+                         32 /* bitsPerPixel */,
+                         bytesPerRow,
+                         colorSpace,
+                         kCGBitmapByteOrder32Little | kCGImageAlphaNoneSkipFirst,
+                         provider,
+                         NULL /* decode */,
+                         true /* shouldInterpolate */,
+                         kCGRenderingIntentDefault);
+}
+
+static void TIPXJPEGReleasePixels(void * __nullable info, const void *data, size_t size)
+{
+    free(info);
+}
+
+static CGImageRef __nullable TIPXJPEGTurboCreateRegionImage(const Byte *bytes,
+                                                            size_t length,
+                                                            const TIPXJPEGHeader *header,
+                                                            CGRect region,
+                                                            CGSize targetDimensions,
+                                                            UIViewContentMode targetContentMode)
+{
+    // the region is of the oriented image, decode the region of the encoded pixels it covers
+    const CGRect pixelRegion = CGRectIntersection(TIPXJPEGUnorientedRect(CGRectIntegral(region), header->width, header->height, header->orientation),
+                                                  CGRectMake(0, 0, header->width, header->height));
+    if (CGRectIsEmpty(pixelRegion)) {
+        return NULL;
+    }
+
+    const unsigned int scaleDenominator = TIPXJPEGScaleDenominator(pixelRegion.size,
+                                                                   targetDimensions,
+                                                                   targetContentMode,
+                                                                   header->orientation);
+    const size_t scaledImageWidth = (header->width + scaleDenominator - 1) / scaleDenominator;
+    const size_t scaledImageHeight = (header->height + scaleDenominator - 1) / scaleDenominator;
+    const size_t x = (size_t)CGRectGetMinX(pixelRegion) / scaleDenominator;
+    const size_t y = (size_t)CGRectGetMinY(pixelRegion) / scaleDenominator;
+    const size_t width = MIN(scaledImageWidth, ((size_t)CGRectGetMaxX(pixelRegion) + scaleDenominator - 1) / scaleDenominator) - x;
+    const size_t height = MIN(scaledImageHeight, ((size_t)CGRectGetMaxY(pixelRegion) + scaleDenominator - 1) / scaleDenominator) - y;
+    const size_t bytesPerRow = (width + kTIPXJPEGMaximumCropAlignment + 2) * 4;
+    Byte *pixels = malloc(bytesPerRow * height);
+    if (!pixels) {
+        return NULL;
+    }
+
+    size_t columnOffset = 0;
+    if (!TIPXJPEGTurboDecodePixelRegion(bytes, length, scaleDenominator, x, y, width, height, pixels, bytesPerRow, &columnOffset)) {
+        free(pixels);
+        return NULL;
+    }
+
+    // the decoded rows start at the iMCU column of the region's first pixel
+    CGDataProviderRef provider = CGDataProviderCreateWithData(pixels,
+                                                              pixels + (columnOffset * 4),
+                                                              (bytesPerRow * height) - (columnOffset * 4),
+                                                              TIPXJPEGReleasePixels);
+    TIPXDeferRelease(provider);
+    if (!provider) {
+        free(pixels);
+        return NULL;
+    }
+
+    return CGImageCreate(width,
+                         height,
+                         8 /* bitsPerComponent */,
+                         32 /* bitsPerPixel */,
+                         bytesPerRow,
+                         header->colorSpace,
+                         kCGBitmapByteOrder32Little | kCGImageAlphaNoneSkipFirst,
+                         provider,
+                         NULL /* decode */,
+                         true /* shouldInterpolate */,
+                         kCGRenderingIntentDefault);
+}
+
+static BOOL TIPXJPEGTurboReadHeader(const Byte *bytes,
+                                    size_t length,
+                                    TIPXJPEGHeader *header)
+{
+    // No Objective-C objects in here, libjpeg errors longjmp out of the decoding
+    struct jpeg_decompress_struct decompress;
+    TIPXJPEGErrorManager errorManager;
+    JOCTET * volatile iccProfile = NULL;
+
+    decompress.err = jpeg_std_error(&errorManager.manager);
+    errorManager.manager.error_exit = TIPXJPEGErrorExit;
+    errorManager.manager.emit_message = TIPXJPEGEmitMessage;
+    if (setjmp(errorManager.jump)) {
+        jpeg_destroy_decompress(&decompress);
+        free(iccProfile);
+        return NO;
+    }
+
+    jpeg_create_decompress(&decompress);
+    jpeg_mem_src(&decompress, bytes, (unsigned long)length);
+    jpeg_save_markers(&decompress, JPEG_APP0 + 1, 0xFFFF); // EXIF (orientation)
+    jpeg_save_markers(&decompress, JPEG_APP0 + 2, 0xFFFF); // ICC profile
+    if (JPEG_HEADER_OK != jpeg_read_header(&decompress, TRUE) || JCS_CMYK == decompress.jpeg_color_space || JCS_YCCK == decompress.jpeg_color_space) {
+        jpeg_destroy_decompress(&decompress);
+        return NO;
+    }
+
+    header->width = decompress.image_width;
+    header->height = decompress.image_height;
+    header->orientation = TIPXJPEGReadOrientation(&decompress);
+    header->entropyCodedDataOffset = 0;
+    header->restartInterval = 0;
+    header->mcusPerRow = 0;
+    header->mcuHeight = 0;
+    if (!decompress.progressive_mode && decompress.restart_interval > 0 && decompress.comps_in_scan == decompress.num_components) {
+        // a single scan with all the components, a scan with one component has MCUs of one block
+        const size_t mcuWidth = (1 == decompress.comps_in_scan) ? DCTSIZE : (size_t)decompress.max_h_samp_factor * DCTSIZE;
+        header->mcuHeight = (1 == decompress.comps_in_scan) ? DCTSIZE : (size_t)decompress.max_v_samp_factor * DCTSIZE;
+        header->mcusPerRow = (header->width + mcuWidth - 1) / mcuWidth;
+        header->restartInterval = decompress.restart_interval;
+        header->entropyCodedDataOffset = (size_t)(decompress.src->next_input_byte - bytes);
+    }
+
+    JOCTET *profile = NULL;
+    unsigned int profileLength = 0;
+    if (jpeg_read_icc_profile(&decompress, &profile, &profileLength)) {
+        iccProfile = profile;
+    }
+    jpeg_destroy_decompress(&decompress);
+
+    CGColorSpaceRef colorSpace = NULL;
+    if (iccProfile) {
+        CFDataRef iccData = CFDataCreate(NULL, iccProfile, profileLength);
+        TIPXDeferRelease(iccData);
+        free(iccProfile);
+        if (iccData) {
+            colorSpace = CGColorSpaceCreateWithICCData(iccData);
+        }
+    }
+    if (colorSpace && CGColorSpaceGetModel(colorSpace) != kCGColorSpaceModelRGB) {
+        // such as the profile of a grayscale JPEG, the pixels are RGB
+        CGColorSpaceRelease(colorSpace);
+        colorSpace = NULL;
+    }
+    header->colorSpace = colorSpace ?: CGColorSpaceCreateDeviceRGB();
+    return YES;
+}
+
+static BOOL TIPXJPEGTurboDecodePixels(const Byte *bytes,
+                                      size_t length,
+                                      unsigned int scaleDenominator,
+                                      size_t skippedRowCount,
+                                      Byte *pixels,
+                                      size_t width,
+                                      size_t height,
+                                      size_t bytesPerRow)
+{
+    // No Objective-C objects in here, libjpeg errors longjmp out of the decoding
+    struct jpeg_decompress_struct decompress;
+    TIPXJPEGErrorManager errorManager;
+
+    decompress.err = jpeg_std_error(&errorManager.manager);
+    errorManager.manager.error_exit = TIPXJPEGErrorExit;
+    errorManager.manager.emit_message = TIPXJPEGEmitMessage;
+    if (setjmp(errorManager.jump)) {
+        jpeg_destroy_decompress(&decompress);
+        return NO;
+    }
+
+    jpeg_create_decompress(&decompress);
+    jpeg_mem_src(&decompress, bytes, (unsigned long)length);
+    if (JPEG_HEADER_OK != jpeg_read_header(&decompress, TRUE)) {
+        jpeg_destroy_decompress(&decompress);
+        return NO;
+    }
+
+    decompress.scale_num = 1;
+    decompress.scale_denom = scaleDenominator;
+    // converted by libjpeg-turbo's SIMD color conversion into the layout iOS renders natively
+    decompress.out_color_space = JCS_EXT_BGRX;
+    jpeg_start_decompress(&decompress);
+    if (decompress.output_width != width || decompress.output_height < skippedRowCount + height) {
+        jpeg_destroy_decompress(&decompress);
+        return NO;
+    }
+
+    // skipped rows are read into the first row, which is overwritten after
+    while (decompress.output_scanline < skippedRowCount) {
+        JSAMPROW row = pixels;
+        jpeg_read_scanlines(&decompress, &row, 1);
+    }
+
+    const JDIMENSION endRow = (JDIMENSION)(skippedRowCount + height);
+    while (decompress.output_scanline < endRow) {
+        JSAMPROW rows[4];
+        const JDIMENSION rowCount = MIN((JDIMENSION)4, endRow - decompress.output_scanline);
+        for (JDIMENSION i = 0; i < rowCount; i++) {
+            rows[i] = pixels + ((decompress.output_scanline - skippedRowCount + i) * bytesPerRow);
+        }
+        jpeg_read_scanlines(&decompress, rows, rowCount);
+    }
+
+    // rows after the end row are left undecoded
+    if (decompress.output_scanline == decompress.output_height) {
+        jpeg_finish_decompress(&decompress);
+    }
+    jpeg_destroy_decompress(&decompress);
+    return YES;
+}
+
+static BOOL TIPXJPEGTurboDecodePixelRegion(const Byte *bytes,
+                                           size_t length,
+                                           unsigned int scaleDenominator,
+                                           size_t x,
+                                           size_t y,
+                                           size_t width,
+                                           size_t height,
+                                           Byte *pixels,
+                                           size_t bytesPerRow,
+                                           size_t *columnOffsetOut)
+{
+    // No Objective-C objects in here, libjpeg errors longjmp out of the decoding
+    struct jpeg_decompress_struct decompress;
+    TIPXJPEGErrorManager errorManager;
+
+    decompress.err = jpeg_std_error(&errorManager.manager);
+    errorManager.manager.error_exit = TIPXJPEGErrorExit;
+    errorManager.manager.emit_message = TIPXJPEGEmitMessage;
+    if (setjmp(errorManager.jump)) {
+        jpeg_destroy_decompress(&decompress);
+        return NO;
+    }
+
+    jpeg_create_decompress(&decompress);
+    jpeg_mem_src(&decompress, bytes, (unsigned long)length);
+    if (JPEG_HEADER_OK != jpeg_read_header(&decompress, TRUE)) {
+        jpeg_destroy_decompress(&decompress);
+        return NO;
+    }
+
+    decompress.scale_num = 1;
+    decompress.scale_denom = scaleDenominator;
+    decompress.out_color_space = JCS_EXT_BGRX;
+    jpeg_start_decompress(&decompress);
+    if (x + width > decompress.output_width || y + height > decompress.output_height) {
+        jpeg_destroy_decompress(&decompress);
+        return NO;
+    }
+
+    // only the iMCU columns of the region are converted and upsampled, and rows above the region are
+    // only entropy decoded.  The crop has a column of margin so that chroma upsampling at the edges of
+    // the region reads the neighboring columns like it does when decoding the whole width.
+    const JDIMENSION firstColumn = (x > 0) ? (JDIMENSION)x - 1 : 0;
+    const JDIMENSION endColumn = MIN(decompress.output_width, (JDIMENSION)(x + width + 1));
+    JDIMENSION columnOffset = firstColumn;
+    JDIMENSION columnCount = endColumn - firstColumn;
+    jpeg_crop_scanline(&decompress, &columnOffset, &columnCount);
+    if (columnCount * 4 > bytesPerRow) {
+        jpeg_destroy_decompress(&decompress);
+        return NO;
+    }
+    if (y > 0 && jpeg_skip_scanlines(&decompress, (JDIMENSION)y) != y) {
+        jpeg_destroy_decompress(&decompress);
+        return NO;
+    }
+
+    const JDIMENSION endRow = (JDIMENSION)(y + height);
+    while (decompress.output_scanline < endRow) {
+        JSAMPROW rows[4];
+        const JDIMENSION rowCount = MIN((JDIMENSION)4, endRow - decompress.output_scanline);
+        for (JDIMENSION i = 0; i < rowCount; i++) {
+            rows[i] = pixels + ((decompress.output_scanline - y + i) * bytesPerRow);
+        }
+        jpeg_read_scanlines(&decompress, rows, rowCount);
+    }
+
+    // rows below the region are left undecoded
+    jpeg_destroy_decompress(&decompress);
+    *columnOffsetOut = x - columnOffset;
+    return YES;
+}
+
+static BOOL TIPXJPEGTurboDecodePixelsConcurrently(const Byte *bytes,
+                                                  size_t length,
+                                                  const TIPXJPEGHeader *header,
+                                                  unsigned int scaleDenominator,
+                                                  Byte *pixels,
+                                                  size_t width,
+                                                  size_t height,
+                                                  size_t bytesPerRow)
+{
+    /*
+     The entropy coded data of a JPEG with restart markers can be decoded starting at any restart
+     marker.  When restart markers fall at the start of MCU rows, each band of MCU rows is decoded as
+     its own JPEG: the headers (with the height of the band), the entropy coded data of the band (with
+     its restart markers renumbered from 0) and an end of image marker.  The bands decode concurrently
+     into their rows of the bitmap.
+     Chroma upsampling reads the neighboring rows, so each band also decodes the MCU rows (up to the
+     next restart marker) around it and drops their pixels, which keeps the seams identical to a
+     sequential decode.
+     */
+
+    const size_t interval = header->restartInterval;
+    const size_t mcusPerRow = header->mcusPerRow;
+    const size_t processorCount = [NSProcessInfo processInfo].activeProcessorCount;
+    if (!atomic_load(&sConcurrentDecodingEnabled)) {
+        return NO;
+    }
+    if (!interval || processorCount < 2 || header->width * header->height < kTIPXJPEGConcurrentDecodingMinimumPixels) {
+        return NO;
+    }
+    if (header->mcuHeight % scaleDenominator != 0) {
+        return NO;
+    }
+
+    // the MCU rows that start with a restart marker
+    size_t mcuRowsPerGroup;
+    if (interval >= mcusPerRow) {
+        if (interval % mcusPerRow != 0) {
+            return NO;
+        }
+        mcuRowsPerGroup = interval / mcusPerRow;
+    } else {
+        if (mcusPerRow % interval != 0) {
+            return NO;
+        }
+        mcuRowsPerGroup = 1;
+    }
+    const size_t mcuRowCount = (header->height + header->mcuHeight - 1) / header->mcuHeight;
+    const size_t groupCount = (mcuRowCount + mcuRowsPerGroup - 1) / mcuRowsPerGroup;
+    const size_t restartIntervalCount = ((mcuRowCount * mcusPerRow) + interval - 1) / interval;
+    if (groupCount < 2) {
+        return NO;
+    }
+
+    // find the restart markers (and the end of the scan), a truncated scan is decoded sequentially
+    size_t *restartMarkerOffsets = malloc(sizeof(size_t) * (restartIntervalCount - 1));
+    tipx_defer(^{
+        free(restartMarkerOffsets);
+    });
+    if (!restartMarkerOffsets) {
+        return NO;
+    }
+    size_t restartMarkerCount = 0;
+    size_t scanEndOffset = 0;
+    size_t offset = header->entropyCodedDataOffset;
+    while (offset + 1 < length) {
+        const Byte *specialByte = memchr(bytes + offset, kJPEG_MARKER_SPECIAL_BYTE, length - offset - 1);
+        if (!specialByte) {
+            break;
+        }
+        const size_t markerOffset = (size_t)(specialByte - bytes);
+        const Byte marker = bytes[markerOffset + 1];
+        if (0x00 == marker) {
+            offset = markerOffset + 2;
+        } else if (kJPEG_MARKER_SPECIAL_BYTE == marker) {
+            offset = markerOffset + 1; // fill byte
+        } else if (marker >= kJPEG_MARKER_RST0 && marker <= kJPEG_MARKER_RST7) {
+            if (restartMarkerCount == restartIntervalCount - 1) {
+                return NO;
+            }
+            restartMarkerOffsets[restartMarkerCount++] = markerOffset;
+            offset = markerOffset + 2;
+        } else {
+            scanEndOffset = markerOffset;
+            break;
+        }
+    }
+    if (!scanEndOffset || restartMarkerCount != restartIntervalCount - 1) {
+        return NO;
+    }
+
+    TIPXJPEGMarkerReader reader = { 0 };
+    TIPXJPEGMarkerReaderRead(&reader, bytes, header->entropyCodedDataOffset);
+    if (!reader.didReadFrameHeader) {
+        return NO;
+    }
+    const size_t headerLength = header->entropyCodedDataOffset;
+    const size_t heightOffset = reader.frameHeaderOffset + 5;
+
+    const size_t mcuRowsPerBand = ((groupCount + MIN(processorCount, groupCount) - 1) / MIN(processorCount, groupCount)) * mcuRowsPerGroup;
+    const size_t bandCount = (mcuRowCount + mcuRowsPerBand - 1) / mcuRowsPerBand;
+    const size_t rowsPerMCURow = header->mcuHeight / scaleDenominator;
+    const size_t sourceHeight = header->height;
+    const size_t mcuHeight = header->mcuHeight;
+
+    volatile atomic_bool failed = false;
+    volatile atomic_bool *failedPtr = &failed;
+    dispatch_apply(bandCount, DISPATCH_APPLY_AUTO, ^(size_t band) {
+        const size_t firstMCURow = band * mcuRowsPerBand;
+        const size_t endMCURow = MIN(mcuRowCount, firstMCURow + mcuRowsPerBand);
+        const size_t firstDecodedMCURow = (band > 0) ? firstMCURow - mcuRowsPerGroup : 0;
+        const size_t endDecodedMCURow = MIN(mcuRowCount, endMCURow + mcuRowsPerGroup);
+        const size_t firstInterval = (firstDecodedMCURow * mcusPerRow) / interval;
+        const size_t endInterval = (endDecodedMCURow * mcusPerRow) / interval;
+        const size_t dataOffset = (firstInterval > 0) ? restartMarkerOffsets[firstInterval - 1] + 2 : headerLength;
+        const size_t dataEndOffset = (endDecodedMCURow == mcuRowCount) ? scanEndOffset : restartMarkerOffsets[endInterval - 1];
+        const size_t bandHeight = MIN(sourceHeight, endDecodedMCURow * mcuHeight) - (firstDecodedMCURow * mcuHeight);
+
+        const size_t bandLength = headerLength + (dataEndOffset - dataOffset) + 2;
+        Byte *bandBytes = malloc(bandLength);
+        if (!bandBytes) {
+            atomic_store(failedPtr, true);
+            return;
+        }
+        memcpy(bandBytes, bytes, headerLength);
+        bandBytes[heightOffset] = (Byte)(bandHeight >> 8);
+        bandBytes[heightOffset + 1] = (Byte)bandHeight;
+        memcpy(bandBytes + headerLength, bytes + dataOffset, dataEndOffset - dataOffset);
+        bandBytes[bandLength - 2] = kJPEG_MARKER_SPECIAL_BYTE;
+        bandBytes[bandLength - 1] = kJPEG_MARKER_EOI;
+
+        // libjpeg expects the restart markers to count up from RST0
+        unsigned int restartNumber = 0;
+        size_t bandOffset = headerLength;
+        while (bandOffset + 2 < bandLength) {
+            Byte *specialByte = memchr(bandBytes + bandOffset, kJPEG_MARKER_SPECIAL_BYTE, bandLength - 2 - bandOffset);
+            if (!specialByte) {
+                break;
+            }
+            const Byte marker = specialByte[1];
+            if (marker >= kJPEG_MARKER_RST0 && marker <= kJPEG_MARKER_RST7) {
+                specialByte[1] = (Byte)(kJPEG_MARKER_RST0 + (restartNumber++ & 7));
+                bandOffset = (size_t)(specialByte - bandBytes) + 2;
+            } else {
+                bandOffset = (size_t)(specialByte - bandBytes) + ((kJPEG_MARKER_SPECIAL_BYTE == marker) ? 1 : 2);
+            }
+        }
+
+        Byte *bandPixels = pixels + (firstMCURow * rowsPerMCURow * bytesPerRow);
+        const size_t skippedRowCount = (firstMCURow - firstDecodedMCURow) * rowsPerMCURow;
+        const size_t bandRowCount = MIN(height, endMCURow * rowsPerMCURow) - (firstMCURow * rowsPerMCURow);
+        if (!TIPXJPEGTurboDecodePixels(bandBytes, bandLength, scaleDenominator, skippedRowCount, bandPixels, width, bandRowCount, bytesPerRow)) {
+            atomic_store(failedPtr, true);
+        }
+        free(bandBytes);
+    });
+
+    return !atomic_load(failedPtr);
+}
+
+static unsigned int TIPXJPEGScaleDenominator(CGSize dimensions,
+                                             CGSize targetDimensions,
+                                             UIViewContentMode targetContentMode,
+                                             CGImagePropertyOrientation orientation)
+{
+    if (targetDimensions.width <= 0 || targetDimensions.height <= 0) {
+        return 1;
+    }
+
+    // the target sizing is of the oriented image
+    const BOOL isTransposed = orientation >= kCGImagePropertyOrientationLeftMirrored;
+    const CGSize orientedDimensions = (isTransposed) ? CGSizeMake(dimensions.height, dimensions.width) : dimensions;
+    CGSize scaledDimensions = TIPDimensionsScaledToTargetSizing(orientedDimensions, targetDimensions, targetContentMode);
+    if (isTransposed) {
+        scaledDimensions = CGSizeMake(scaledDimensions.height, scaledDimensions.width);
+    }
+
+    // the smallest DCT scaling that is no smaller than the scaled dimensions (libjpeg rounds up),
+    // TIP scales the rest of the way
+    for (unsigned int denominator = 8; denominator > 1; denominator /= 2) {
+        if (ceil(dimensions.width / denominator) >= scaledDimensions.width && ceil(dimensions.height / denominator) >= scaledDimensions.height) {
+            return denominator;
+        }
+    }
+    return 1;
+}
+
+static BOOL TIPXJPEGTurboCompress(const Byte *pixels,
+                                  size_t width,
+                                  size_t height,
+                                  size_t bytesPerRow,
+                                  BOOL grayscale,
+                                  int quality,
+                                  BOOL progressive,
+                                  CGImagePropertyOrientation orientation,
+                                  Byte * __nullable * __nonnull bufferOut,
+                                  unsigned long *lengthOut)
+{
+    // No Objective-C objects in here, libjpeg errors longjmp out of the encoding
+    struct jpeg_compress_struct compress;
+    TIPXJPEGErrorManager errorManager;
+    unsigned char *buffer = NULL;
+    unsigned long length = 0;
+
+    compress.err = jpeg_std_error(&errorManager.manager);
+    errorManager.manager.error_exit = TIPXJPEGErrorExit;
+    errorManager.manager.emit_message = TIPXJPEGEmitMessage;
+    if (setjmp(errorManager.jump)) {
+        // the memory destination leaves freeing its buffer to the caller
+        jpeg_destroy_compress(&compress);
+        free(buffer);
+        return NO;
+    }
+
+    jpeg_create_compress(&compress);
+    jpeg_mem_dest(&compress, &buffer, &length);
+    compress.image_width = (JDIMENSION)width;
+    compress.image_height = (JDIMENSION)height;
+    compress.input_components = (grayscale) ? 1 : 4;
+    compress.in_color_space = (grayscale) ? JCS_GRAYSCALE : JCS_EXT_BGRX;
+    jpeg_set_defaults(&compress);
+    jpeg_set_quality(&compress, quality, TRUE /* force_baseline */);
+    compress.optimize_coding = TRUE;
+    if (progressive) {
+        jpeg_simple_progression(&compress);
+    } else if (width * height >= kTIPXJPEGConcurrentDecodingMinimumPixels) {
+        // a restart marker at the start of each MCU row lets the decoder split the image into bands
+        compress.restart_in_rows = 1;
+    }
+    jpeg_start_compress(&compress, TRUE);
+
+    if (orientation != kCGImagePropertyOrientationUp) {
+        // minimal big endian EXIF with only the orientation in IFD0
+        const JOCTET exif[] = {
+            'E', 'x', 'i', 'f', 0, 0,
+            'M', 'M', 0, 42, 0, 0, 0, 8, // TIFF header, IFD0 at offset 8
+            0, 1, // entry count
+            0x01, 0x12, 0, 3, 0, 0, 0, 1, 0, (JOCTET)orientation, 0, 0, // Orientation, SHORT, 1 value
+            0, 0, 0, 0, // no next IFD
+        };
+        jpeg_write_marker(&compress, JPEG_APP0 + 1, exif, sizeof(exif));
+    }
+
+    while (compress.next_scanline < compress.image_height) {
+        JSAMPROW row = (JSAMPROW)(pixels + (compress.next_scanline * bytesPerRow));
+        jpeg_write_scanlines(&compress, &row, 1);
+    }
+
+    jpeg_finish_compress(&compress);
+    jpeg_destroy_compress(&compress);
+
+    *bufferOut = buffer;
+    *lengthOut = length;
+    return YES;
+}
+
+static CGRect TIPXJPEGUnorientedRect(CGRect rect,
+                                     size_t width,
+                                     size_t height,
+                                     CGImagePropertyOrientation orientation)
+{
+    // width and height are of the encoded pixels, rect is of the image as displayed
+    const CGFloat w = width;
+    const CGFloat h = height;
+    const CGFloat x = rect.origin.x;
+    const CGFloat y = rect.origin.y;
+    const CGFloat rw = rect.size.width;
+    const CGFloat rh = rect.size.height;
+    switch (orientation) {
+        case kCGImagePropertyOrientationUpMirrored:
+            return CGRectMake(w - x - rw, y, rw, rh);
+        case kCGImagePropertyOrientationDown:
+            return CGRectMake(w - x - rw, h - y - rh, rw, rh);
+        case kCGImagePropertyOrientationDownMirrored:
+            return CGRectMake(x, h - y - rh, rw, rh);
+        case kCGImagePropertyOrientationLeftMirrored:
+            return CGRectMake(y, x, rh, rw);
+        case kCGImagePropertyOrientationRight:
+            return CGRectMake(y, h - x - rw, rh, rw);
+        case kCGImagePropertyOrientationRightMirrored:
+            return CGRectMake(w - y - rh, h - x - rw, rh, rw);
+        case kCGImagePropertyOrientationLeft:
+            return CGRectMake(w - y - rh, x, rh, rw);
+        case kCGImagePropertyOrientationUp:
+        default:
+            return rect;
+    }
+}
+
+static NSUInteger TIPXReadExifInteger(const JOCTET *bytes, size_t byteCount, BOOL isBigEndian)
+{
+    NSUInteger value = 0;
+    for (size_t i = 0; i < byteCount; i++) {
+        const size_t index = (isBigEndian) ? i : byteCount - 1 - i;
+        value = (value << 8) | bytes[index];
+    }
+    return value;
+}
+
+static CGImagePropertyOrientation TIPXJPEGReadOrientation(j_decompress_ptr decompress)
+{
+    for (jpeg_saved_marker_ptr marker = decompress->marker_list; marker != NULL; marker = marker->next) {
+        if (marker->marker != JPEG_APP0 + 1 || marker->data_length < 14 || 0 != memcmp(marker->data, "Exif\0\0", 6)) {
+            continue;
+        }
+
+        // TIFF header: byte order, 42, offset of the first IFD
+        const JOCTET *tiff = marker->data + 6;
+        const size_t tiffLength = marker->data_length - 6;
+        BOOL isBigEndian;
+        if (0 == memcmp(tiff, "MM", 2)) {
+            isBigEndian = YES;
+        } else if (0 == memcmp(tiff, "II", 2)) {
+            isBigEndian = NO;
+        } else {
+            continue;
+        }
+
+        const NSUInteger ifdOffset = TIPXReadExifInteger(tiff + 4, 4, isBigEndian);
+        if (ifdOffset + 2 > tiffLength) {
+            continue;
+        }
+        const NSUInteger entryCount = TIPXReadExifInteger(tiff + ifdOffset, 2, isBigEndian);
+        for (NSUInteger i = 0; i < entryCount; i++) {
+            // entry: tag, type, count, value
+            const NSUInteger entryOffset = ifdOffset + 2 + (i * 12);
+            if (entryOffset + 12 > tiffLength) {
+                break;
+            }
+            if (0x0112 /* Orientation */ == TIPXReadExifInteger(tiff + entryOffset, 2, isBigEndian)) {
+                const NSUInteger value = TIPXReadExifInteger(tiff + entryOffset + 8, 2, isBigEndian);
+                if (value >= kCGImagePropertyOrientationUp && value <= kCGImagePropertyOrientationLeft) {
+                    return (CGImagePropertyOrientation)value;
+                }
+                break;
+            }
+        }
+    }
+    return kCGImagePropertyOrientationUp;
+}
+
+NS_ASSUME_NONNULL_END
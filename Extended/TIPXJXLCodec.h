@@ -0,0 +1,56 @@
+//
+//  TIPXJXLCodec.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import <TwitterImagePipeline/TIPImageCodecs.h>
+
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Convenience codec for decoding and encoding JPEG XL images with libjxl.
+ Requires libjxl 0.9 or later (its `jxl/decode.h`, `jxl/encode.h` and `jxl/resizable_parallel_runner.h`
+ headers and its `libjxl` and `libjxl_threads` libraries).
+ This codec is not bundled with __TIP__ to avoid bloating the framework with libjxl,
+ but there's nothing preventing a consumer from using this codec.
+
+ The decoder supports progressive loading: the DC (1/8 resolution) of a still image is rendered as
+ soon as it has loaded, followed by a render each time another pass of detail has loaded.
+ When the target sizing is a 1/2, 1/4 or 1/8 of the image (or smaller), decoding stops at the first
+ pass with enough detail for that resolution instead of decoding the remaining passes, and the
+ image is output at the reduced resolution.
+ Animations are supported, with the first frame rendered as a preview while the rest loads.
+ Decoding is spread over multiple threads with libjxl's resizable parallel runner.
+
+ The encoder supports `TIPImageEncodingProgressive` (progressive DC and AC passes) and
+ `TIPImageEncodingNoAlpha`, maps the suggested quality to a libjxl distance (a quality of `1` is
+ lossless) and writes the orientation of the image in the codestream.  Animated images are not
+ encoded (failing with `TIPErrorCodeEncodingUnsupported`).  Images are encoded in the sRGB color space.
+
+    [[TIPImageCodecCatalogue sharedInstance] setCodec:[[TIPXJXLCodec alloc] initWithPreferredCodec:nil]
+                                         forImageType:TIPImageTypeJXL];
+ */
+@interface TIPXJXLCodec : NSObject <TIPImageCodec>
+
+/** libjxl decoder (or preferred decoder) */
+@property (nonatomic, readonly) id<TIPImageDecoder> tip_decoder;
+/** libjxl encoder (or preferred encoder) */
+@property (nonatomic, readonly) id<TIPImageEncoder> tip_encoder;
+/** supports animation */
+@property (nonatomic, readonly) BOOL tip_isAnimated;
+
+/**
+ Initializer
+ @param preferredCodec A codec whose encoder and/or decoder should be used instead of the libjxl ones (such as the ImageIO decoder on iOS 17+, at the expense of progressive loading). If they are not provided (including if a nil `tip_decoder` or `tip_encoder` are found), use the `TIPXJXLCodec` implementations.
+ @return a new `TIPXJXLCodec` instance
+ */
+- (instancetype)initWithPreferredCodec:(nullable id<TIPImageCodec>)preferredCodec NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
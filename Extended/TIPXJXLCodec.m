@@ -0,0 +1,989 @@
+//
+//  TIPXJXLCodec.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#pragma mark imports
+
+#import <Accelerate/Accelerate.h>
+#import <TwitterImagePipeline/TwitterImagePipeline.h>
+
+#import "TIPXJXLCodec.h"
+#import "TIPXUtils.h"
+
+#pragma mark libjxl includes
+
+#include <jxl/decode.h>
+#include <jxl/encode.h>
+#include <jxl/resizable_parallel_runner.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+#pragma mark - Declarations
+
+// libjxl decodes to RGBA, 8 bits per channel (alpha is 0xFF for opaque images)
+static const JxlPixelFormat kTIPXJXLPixelFormat = {
+    .num_channels = 4,
+    .data_type = JXL_TYPE_UINT8,
+    .endianness = JXL_NATIVE_ENDIAN,
+    .align = 0,
+};
+
+static const int kTIPXJXLDecoderEvents = JXL_DEC_BASIC_INFO | JXL_DEC_COLOR_ENCODING | JXL_DEC_FRAME | JXL_DEC_FRAME_PROGRESSION | JXL_DEC_FULL_IMAGE;
+
+static size_t TIPXJXLDownsamplingRatio(CGSize dimensions,
+                                       CGSize targetDimensions,
+                                       UIViewContentMode targetContentMode,
+                                       JxlOrientation orientation);
+static CGColorSpaceRef __nullable TIPXJXLCreateColorSpace(JxlDecoder *decoder,
+                                                          const JxlBasicInfo *basicInfo);
+static UIImage * __nullable TIPXJXLCreateImage(Byte *pixels,
+                                               size_t width,
+                                               size_t height,
+                                               CGColorSpaceRef colorSpace,
+                                               const JxlBasicInfo *basicInfo);
+static Byte * __nullable TIPXJXLCopyPixels(const Byte *pixels,
+                                           size_t width,
+                                           size_t height,
+                                           size_t sampling,
+                                           size_t *widthOut,
+                                           size_t *heightOut);
+static NSData * __nullable TIPXJXLEncode(const Byte *pixels,
+                                         size_t width,
+                                         size_t height,
+                                         BOOL hasAlpha,
+                                         float quality,
+                                         BOOL progressive,
+                                         JxlOrientation orientation);
+
+@interface TIPXJXLDecoderContext : NSObject <TIPImageDecoderContext>
+
+@property (nonatomic, readonly) NSData *tip_data;
+@property (nonatomic, readonly) CGSize tip_dimensions;
+@property (nonatomic, readonly) NSUInteger tip_frameCount;
+@property (nonatomic, readonly) BOOL tip_isProgressive;
+@property (nonatomic, readonly) BOOL tip_isAnimated;
+@property (nonatomic, readonly) BOOL tip_hasAlpha;
+
+- (instancetype)initWithExpectedContentLength:(NSUInteger)length
+                                       buffer:(nullable NSMutableData *)buffer;
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+- (TIPImageDecoderAppendResult)append:(NSData *)data TIPX_OBJC_DIRECT;
+- (nullable TIPImageContainer *)renderImage:(TIPImageDecoderRenderMode)renderMode
+                           targetDimensions:(CGSize)targetDimensions
+                          targetContentMode:(UIViewContentMode)targetContentMode TIPX_OBJC_DIRECT;
+- (TIPImageDecoderAppendResult)finalizeDecoding TIPX_OBJC_DIRECT;
+- (nullable TIPImageContainer *)decodeImageWithData:(NSData *)data
+                                   targetDimensions:(CGSize)targetDimensions
+                                  targetContentMode:(UIViewContentMode)targetContentMode TIPX_OBJC_DIRECT;
+
+@end
+
+@interface TIPXJXLDecoder : NSObject <TIPImageDecoder>
+@end
+
+@interface TIPXJXLEncoder : NSObject <TIPImageEncoder>
+@end
+
+#pragma mark - Implementations
+
+@implementation TIPXJXLCodec
+
+- (instancetype)init
+{
+    // Shouldn't be called, but will permit in case of type erasure
+    return [self initWithPreferredCodec:nil];
+}
+
+- (instancetype)initWithPreferredCodec:(nullable id<TIPImageCodec>)preferredCodec
+{
+    if (self = [super init]) {
+        _tip_decoder = preferredCodec.tip_decoder ?: [[TIPXJXLDecoder alloc] init];
+        _tip_encoder = preferredCodec.tip_encoder ?: [[TIPXJXLEncoder alloc] init];
+    }
+    return self;
+}
+
+- (BOOL)tip_isAnimated
+{
+    return YES;
+}
+
+@end
+
+@implementation TIPXJXLDecoder
+
+- (TIPImageDecoderDetectionResult)tip_detectDecodableData:(NSData *)data
+                                           isCompleteData:(BOOL)complete
+                                      earlyGuessImageType:(nullable NSString *)imageType
+{
+    switch (JxlSignatureCheck(data.bytes, data.length)) {
+        case JXL_SIG_CODESTREAM:
+        case JXL_SIG_CONTAINER:
+            return TIPImageDecoderDetectionResultMatch;
+        case JXL_SIG_NOT_ENOUGH_BYTES:
+            return (complete) ? TIPImageDecoderDetectionResultNoMatch : TIPImageDecoderDetectionResultNeedMoreData;
+        case JXL_SIG_INVALID:
+        default:
+            return TIPImageDecoderDetectionResultNoMatch;
+    }
+}
+
+- (id<TIPImageDecoderContext>)tip_initiateDecoding:(nullable id __unused)config
+                                expectedDataLength:(NSUInteger)expectedDataLength
+                                            buffer:(nullable NSMutableData *)buffer
+{
+    return [[TIPXJXLDecoderContext alloc] initWithExpectedContentLength:expectedDataLength
+                                                                 buffer:buffer];
+}
+
+- (TIPImageDecoderAppendResult)tip_append:(TIPXJXLDecoderContext *)context
+                                     data:(NSData *)data
+{
+    return [context append:data];
+}
+
+- (nullable TIPImageContainer *)tip_renderImage:(TIPXJXLDecoderContext *)context
+                                     renderMode:(TIPImageDecoderRenderMode)renderMode
+                               targetDimensions:(CGSize)targetDimensions
+                              targetContentMode:(UIViewContentMode)targetContentMode
+{
+    return [context renderImage:renderMode targetDimensions:targetDimensions targetContentMode:targetContentMode];
+}
+
+- (TIPImageDecoderAppendResult)tip_finalizeDecoding:(TIPXJXLDecoderContext *)context
+{
+    return [context finalizeDecoding];
+}
+
+- (BOOL)tip_supportsProgressiveDecoding
+{
+    return YES;
+}
+
+- (nullable TIPImageContainer *)tip_decodeImageWithData:(NSData *)imageData
+                                       targetDimensions:(CGSize)targetDimensions
+                                      targetContentMode:(UIViewContentMode)targetContentMode
+                                                 config:(nullable id)config
+{
+    TIPXJXLDecoderContext *context = [[TIPXJXLDecoderContext alloc] initWithExpectedContentLength:0
+                                                                                          buffer:nil];
+    return [context decodeImageWithData:imageData
+                       targetDimensions:targetDimensions
+                      targetContentMode:targetContentMode];
+}
+
+@end
+
+@implementation TIPXJXLEncoder
+
+- (nullable NSData *)tip_writeDataWithImage:(TIPImageContainer *)imageContainer
+                            encodingOptions:(TIPImageEncodingOptions)encodingOptions
+                           suggestedQuality:(float)quality
+                                      error:(out NSError * __nullable __autoreleasing * __nullable)error
+{
+    __block TIPErrorCode errorCode = TIPErrorCodeUnknown;
+    __block NSData *outputData = nil;
+    tipx_defer(^{
+        if (error && !outputData) {
+            *error = [NSError errorWithDomain:TIPErrorDomain
+                                         code:errorCode
+                                     userInfo:nil];
+        }
+    });
+
+    if (imageContainer.animated) {
+        // the encoder only writes still images, don't silently drop the other frames
+        errorCode = TIPErrorCodeEncodingUnsupported;
+        return nil;
+    }
+
+    UIImage *image = imageContainer.image;
+
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef) {
+        errorCode = TIPErrorCodeMissingCGImage;
+        return nil;
+    }
+
+    // draw into sRGB RGBA (CoreGraphics only draws premultiplied alpha, libjxl encodes straight alpha)
+    const BOOL hasAlpha = (encodingOptions & TIPImageEncodingNoAlpha) == 0 && TIPCGImageHasAlpha(imageRef, NO);
+    const size_t width = CGImageGetWidth(imageRef);
+    const size_t height = CGImageGetHeight(imageRef);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    TIPXDeferRelease(colorSpace);
+    const CGBitmapInfo bitmapInfo = kCGBitmapByteOrderDefault | ((hasAlpha) ? kCGImageAlphaPremultipliedLast : kCGImageAlphaNoneSkipLast);
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, width * 4, colorSpace, bitmapInfo);
+    TIPXDeferRelease(context);
+    if (!context) {
+        return nil;
+    }
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+
+    vImage_Buffer buffer = {
+        .data = CGBitmapContextGetData(context),
+        .width = width,
+        .height = height,
+        .rowBytes = CGBitmapContextGetBytesPerRow(context),
+    };
+    if (hasAlpha && kvImageNoError != vImageUnpremultiplyData_RGBA8888(&buffer, &buffer, kvImageNoFlags)) {
+        return nil;
+    }
+
+    outputData = TIPXJXLEncode(buffer.data,
+                               width,
+                               height,
+                               hasAlpha,
+                               quality,
+                               (encodingOptions & TIPImageEncodingProgressive) != 0,
+                               (JxlOrientation)TIPCGImageOrientationFromUIImageOrientation(image.imageOrientation));
+    return outputData;
+}
+
+@end
+
+@implementation TIPXJXLDecoderContext
+{
+    struct {
+        BOOL didEncounterFailure:1;
+        BOOL didLoadHeaders:1;
+        BOOL didDecodeImage:1;
+        BOOL didDecodeAllFrames:1;
+        BOOL didComplete:1;
+        BOOL isAnimated:1;
+        BOOL isCachedImageComplete:1;
+        BOOL shouldStopAtTargetDownsampling:1;
+    } _flags;
+
+    NSMutableData *_dataBuffer;
+    NSUInteger _inputOffset;
+    JxlDecoder *_decoder;
+    void *_runner;
+    JxlBasicInfo _basicInfo;
+    CGColorSpaceRef _colorSpace;
+
+    // the pixels of the frame being decoded (or of the decoded image)
+    Byte *_pixels;
+    size_t _pixelsLength;
+    size_t _outputDownsamplingRatio;
+    size_t _targetDownsamplingRatio;
+    CGSize _targetDimensions;
+    UIViewContentMode _targetContentMode;
+    NSUInteger _passCount;
+
+    NSMutableArray<UIImage *> *_frames;
+    NSMutableArray<NSNumber *> *_frameDurations;
+    NSTimeInterval _frameDuration;
+
+    TIPImageContainer *_cachedImageContainer;
+    NSUInteger _cachedImagePassCount;
+}
+
+@synthesize tip_data = _dataBuffer;
+
+- (nullable id)tip_config
+{
+    return nil;
+}
+
+- (BOOL)tip_isAnimated
+{
+    return _flags.isAnimated;
+}
+
+- (BOOL)tip_isProgressive
+{
+    // every still image can render its passes (the DC first) as they load
+    return _flags.didLoadHeaders && !_flags.isAnimated;
+}
+
+- (NSUInteger)tip_frameCount
+{
+    if (_flags.isAnimated) {
+        // JPEG XL animations do not have a header indicating the number of frames,
+        // report at least 2 frames until all frames are decoded
+        return (_flags.didDecodeAllFrames) ? _frames.count : MAX(_frames.count, (NSUInteger)2);
+    }
+    return _passCount;
+}
+
+- (instancetype)initWithExpectedContentLength:(NSUInteger)length
+                                       buffer:(nullable NSMutableData *)buffer
+{
+    if (self = [super init]) {
+        if (buffer) {
+            _dataBuffer = buffer;
+        } else if (length > 0) {
+            _dataBuffer = [NSMutableData dataWithCapacity:length];
+        } else {
+            _dataBuffer = [NSMutableData data];
+        }
+        _outputDownsamplingRatio = 1;
+        _targetDownsamplingRatio = 1;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self _cleanup];
+    free(_pixels);
+    if (_colorSpace) {
+        CFRelease(_colorSpace);
+    }
+}
+
+- (TIPImageDecoderAppendResult)append:(NSData *)data
+{
+    if (_flags.didComplete) {
+        return TIPImageDecoderAppendResultDidCompleteLoading;
+    }
+
+    if (_flags.didEncounterFailure) {
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    [_dataBuffer appendData:data];
+    return [self _decodeBytes:_dataBuffer.bytes length:_dataBuffer.length isComplete:NO];
+}
+
+- (nullable TIPImageContainer *)renderImage:(TIPImageDecoderRenderMode)renderMode
+                           targetDimensions:(CGSize)targetDimensions
+                          targetContentMode:(UIViewContentMode)targetContentMode
+{
+    if (_flags.didEncounterFailure || !_flags.didLoadHeaders) {
+        return nil;
+    }
+
+    @autoreleasepool {
+        if (_flags.isAnimated) {
+            return [self _renderAnimatedImage:renderMode];
+        }
+
+        if (_flags.didDecodeImage) {
+            if (!_cachedImageContainer || !_flags.isCachedImageComplete) {
+                UIImage *image = [self _createImageWithSampling:_outputDownsamplingRatio
+                                                   consumePixels:YES];
+                if (image) {
+                    _cachedImageContainer = [[TIPImageContainer alloc] initWithImage:image];
+                    _flags.isCachedImageComplete = 1;
+                    [self _cleanup];
+                } else {
+                    _flags.didEncounterFailure = 1;
+                }
+            }
+            return _cachedImageContainer;
+        }
+
+        if (_flags.didComplete || TIPImageDecoderRenderModeCompleteImage == renderMode || !_passCount) {
+            return nil;
+        }
+
+        if (!_cachedImageContainer || _cachedImagePassCount != _passCount) {
+            // the flushed passes are upsampled to the full size, TIP scales them to the target sizing
+            UIImage *image = [self _createImageWithSampling:1
+                                               consumePixels:NO];
+            if (image) {
+                _cachedImageContainer = [[TIPImageContainer alloc] initWithImage:image];
+                _cachedImagePassCount = _passCount;
+            }
+        }
+        return _cachedImageContainer;
+    }
+}
+
+- (TIPImageDecoderAppendResult)finalizeDecoding
+{
+    if (_flags.didEncounterFailure) {
+        return TIPImageDecoderAppendResultDidCompleteLoading;
+    }
+
+    if (!_flags.didLoadHeaders) {
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    // close the input for the decoder to finish up (or fail on truncated data)
+    [self _decodeBytes:_dataBuffer.bytes length:_dataBuffer.length isComplete:YES];
+    const BOOL didDecode = (_flags.isAnimated) ? (_flags.didDecodeAllFrames && _frames.count > 0) : _flags.didDecodeImage;
+    if (!didDecode) {
+        _flags.didEncounterFailure = 1;
+    }
+
+    _flags.didComplete = 1;
+    return TIPImageDecoderAppendResultDidCompleteLoading;
+}
+
+- (nullable TIPImageContainer *)decodeImageWithData:(NSData *)data
+                                   targetDimensions:(CGSize)targetDimensions
+                                  targetContentMode:(UIViewContentMode)targetContentMode
+{
+    // decode directly from the given data and stop at the first pass with enough detail for the target sizing
+    _flags.shouldStopAtTargetDownsampling = 1;
+    _targetDimensions = targetDimensions;
+    _targetContentMode = targetContentMode;
+    [self _decodeBytes:data.bytes length:data.length isComplete:YES];
+    if (_flags.didEncounterFailure || !_flags.didLoadHeaders) {
+        return nil;
+    }
+
+    const BOOL didDecode = (_flags.isAnimated) ? (_flags.didDecodeAllFrames && _frames.count > 0) : _flags.didDecodeImage;
+    if (!didDecode) {
+        return nil;
+    }
+
+    _flags.didComplete = 1;
+    return [self renderImage:TIPImageDecoderRenderModeCompleteImage
+            targetDimensions:targetDimensions
+           targetContentMode:targetContentMode];
+}
+
+#pragma mark Private
+
+- (BOOL)_setupDecoder TIPX_OBJC_DIRECT
+{
+    _decoder = JxlDecoderCreate(NULL);
+    _runner = JxlResizableParallelRunnerCreate(NULL);
+    if (!_decoder || !_runner) {
+        return NO;
+    }
+
+    if (JXL_DEC_SUCCESS != JxlDecoderSubscribeEvents(_decoder, kTIPXJXLDecoderEvents)) {
+        return NO;
+    }
+    if (JXL_DEC_SUCCESS != JxlDecoderSetParallelRunner(_decoder, JxlResizableParallelRunner, _runner)) {
+        return NO;
+    }
+    // a progression event for the DC and then for each pass of AC
+    if (JXL_DEC_SUCCESS != JxlDecoderSetProgressiveDetail(_decoder, kPasses)) {
+        return NO;
+    }
+    // let UIImage apply the orientation
+    if (JXL_DEC_SUCCESS != JxlDecoderSetKeepOrientation(_decoder, JXL_TRUE)) {
+        return NO;
+    }
+    return YES;
+}
+
+- (TIPImageDecoderAppendResult)_decodeBytes:(const Byte *)bytes
+                                     length:(NSUInteger)length
+                                 isComplete:(BOOL)isComplete TIPX_OBJC_DIRECT
+{
+    TIPImageDecoderAppendResult result = TIPImageDecoderAppendResultDidProgress;
+    if (_flags.didEncounterFailure || _flags.didDecodeAllFrames || (_flags.didDecodeImage && !_flags.isAnimated)) {
+        return result;
+    }
+
+    if (!_decoder && !_flags.didLoadHeaders) {
+        if (![self _setupDecoder]) {
+            _flags.didEncounterFailure = 1;
+            return result;
+        }
+    }
+    if (!_decoder || (_inputOffset >= length && !isComplete)) {
+        return result;
+    }
+
+    // libjxl reads the input in place, so it has to be released before returning since the buffer
+    // can be reallocated by the next append (the unconsumed bytes are provided again then)
+    if (JXL_DEC_SUCCESS != JxlDecoderSetInput(_decoder, bytes + _inputOffset, length - _inputOffset)) {
+        _flags.didEncounterFailure = 1;
+        return result;
+    }
+    if (isComplete) {
+        JxlDecoderCloseInput(_decoder);
+    }
+
+    BOOL keepDecoding = YES;
+    while (keepDecoding) {
+        const JxlDecoderStatus status = JxlDecoderProcessInput(_decoder);
+        switch (status) {
+            case JXL_DEC_BASIC_INFO:
+            {
+                if (JXL_DEC_SUCCESS != JxlDecoderGetBasicInfo(_decoder, &_basicInfo)) {
+                    keepDecoding = NO;
+                    _flags.didEncounterFailure = 1;
+                    break;
+                }
+                JxlResizableParallelRunnerSetThreads(_runner, JxlResizableParallelRunnerSuggestThreads(_basicInfo.xsize, _basicInfo.ysize));
+                _tip_dimensions = CGSizeMake(_basicInfo.xsize, _basicInfo.ysize);
+                _tip_hasAlpha = _basicInfo.alpha_bits > 0;
+                if (_basicInfo.have_animation) {
+                    _flags.isAnimated = 1;
+                    _frames = [[NSMutableArray alloc] init];
+                    _frameDurations = [[NSMutableArray alloc] init];
+                } else if (_flags.shouldStopAtTargetDownsampling) {
+                    _targetDownsamplingRatio = TIPXJXLDownsamplingRatio(_tip_dimensions,
+                                                                        _targetDimensions,
+                                                                        _targetContentMode,
+                                                                        _basicInfo.orientation);
+                }
+                _flags.didLoadHeaders = 1;
+                result = TIPImageDecoderAppendResultDidLoadHeaders;
+                break;
+            }
+            case JXL_DEC_COLOR_ENCODING:
+            {
+                _colorSpace = TIPXJXLCreateColorSpace(_decoder, &_basicInfo);
+                if (!_colorSpace) {
+                    keepDecoding = NO;
+                    _flags.didEncounterFailure = 1;
+                }
+                break;
+            }
+            case JXL_DEC_FRAME:
+            {
+                _passCount = 0;
+                if (_flags.isAnimated) {
+                    JxlFrameHeader header;
+                    if (JXL_DEC_SUCCESS == JxlDecoderGetFrameHeader(_decoder, &header) && _basicInfo.animation.tps_numerator > 0) {
+                        _frameDuration = (NSTimeInterval)header.duration * _basicInfo.animation.tps_denominator / _basicInfo.animation.tps_numerator;
+                    } else {
+                        _frameDuration = 0;
+                    }
+                }
+                break;
+            }
+            case JXL_DEC_NEED_IMAGE_OUT_BUFFER:
+            {
+                size_t size = 0;
+                if (JXL_DEC_SUCCESS != JxlDecoderImageOutBufferSize(_decoder, &kTIPXJXLPixelFormat, &size)) {
+                    keepDecoding = NO;
+                    _flags.didEncounterFailure = 1;
+                    break;
+                }
+                if (!_pixels || _pixelsLength != size) {
+                    free(_pixels);
+                    // zeroed so that the groups a flushed pass has not reached yet are transparent
+                    _pixels = calloc(1, size);
+                    _pixelsLength = (_pixels) ? size : 0;
+                }
+                if (!_pixels || JXL_DEC_SUCCESS != JxlDecoderSetImageOutBuffer(_decoder, &kTIPXJXLPixelFormat, _pixels, _pixelsLength)) {
+                    keepDecoding = NO;
+                    _flags.didEncounterFailure = 1;
+                }
+                break;
+            }
+            case JXL_DEC_FRAME_PROGRESSION:
+            {
+                if (_flags.isAnimated) {
+                    // only render complete frames of animations
+                    break;
+                }
+                const size_t ratio = JxlDecoderGetIntendedDownsamplingRatio(_decoder);
+                const BOOL canStop = _flags.shouldStopAtTargetDownsampling && _targetDownsamplingRatio > 1 && ratio <= _targetDownsamplingRatio;
+                if (!canStop && _flags.shouldStopAtTargetDownsampling) {
+                    // no previews are rendered when decoding all at once
+                    break;
+                }
+                if (JXL_DEC_SUCCESS == JxlDecoderFlushImage(_decoder)) {
+                    _passCount++;
+                    if (canStop) {
+                        // the pass has enough detail for the target sizing, skip decoding the rest
+                        _outputDownsamplingRatio = _targetDownsamplingRatio;
+                        _flags.didDecodeImage = 1;
+                        keepDecoding = NO;
+                    } else {
+                        result = TIPImageDecoderAppendResultDidLoadFrame;
+                    }
+                }
+                break;
+            }
+            case JXL_DEC_FULL_IMAGE:
+            {
+                if (_flags.isAnimated) {
+                    // the buffer is reused for the next frame, copy the frame out
+                    size_t width, height;
+                    Byte *pixels = TIPXJXLCopyPixels(_pixels, _basicInfo.xsize, _basicInfo.ysize, 1, &width, &height);
+                    UIImage *frame = (pixels) ? TIPXJXLCreateImage(pixels, width, height, _colorSpace, &_basicInfo) : nil;
+                    if (!frame) {
+                        keepDecoding = NO;
+                        _flags.didEncounterFailure = 1;
+                        break;
+                    }
+                    [_frames addObject:frame];
+                    [_frameDurations addObject:@(_frameDuration)];
+                    if (1 == _frames.count) {
+                        result = TIPImageDecoderAppendResultDidLoadFrame;
+                    }
+                } else {
+                    _passCount++;
+                    _flags.didDecodeImage = 1;
+                    keepDecoding = NO;
+                }
+                break;
+            }
+            case JXL_DEC_SUCCESS:
+            {
+                _flags.didDecodeAllFrames = 1;
+                keepDecoding = NO;
+                break;
+            }
+            case JXL_DEC_NEED_MORE_INPUT:
+            {
+                keepDecoding = NO;
+                break;
+            }
+            case JXL_DEC_ERROR:
+            default:
+            {
+                keepDecoding = NO;
+                _flags.didEncounterFailure = 1;
+                break;
+            }
+        }
+    }
+
+    const size_t unconsumedLength = JxlDecoderReleaseInput(_decoder);
+    _inputOffset = length - unconsumedLength;
+
+    if (_flags.didEncounterFailure || _flags.didDecodeAllFrames || (_flags.didDecodeImage && !_flags.isAnimated)) {
+        // done with the decoder, hold onto just the pixels (if any)
+        [self _cleanup];
+    }
+    return result;
+}
+
+- (nullable TIPImageContainer *)_renderAnimatedImage:(TIPImageDecoderRenderMode)renderMode TIPX_OBJC_DIRECT
+{
+    if (!_flags.didComplete) {
+        if (TIPImageDecoderRenderModeCompleteImage == renderMode || !_frames.count) {
+            return nil;
+        }
+        // just the first frame as a preview of the full animation
+        if (!_cachedImageContainer) {
+            _cachedImageContainer = [[TIPImageContainer alloc] initWithImage:_frames.firstObject];
+        }
+        return _cachedImageContainer;
+    }
+
+    if (!_cachedImageContainer || !_flags.isCachedImageComplete) {
+        NSTimeInterval totalDuration = 0;
+        for (NSNumber *duration in _frameDurations) {
+            totalDuration += duration.doubleValue;
+        }
+        UIImage *image = [UIImage animatedImageWithImages:_frames
+                                                 duration:totalDuration];
+        _cachedImageContainer = (image) ? [[TIPImageContainer alloc] initWithAnimatedImage:image
+                                                                                 loopCount:_basicInfo.animation.num_loops
+                                                                            frameDurations:_frameDurations] : nil;
+        if (_cachedImageContainer) {
+            _flags.isCachedImageComplete = 1;
+            free(_pixels);
+            _pixels = NULL;
+            _pixelsLength = 0;
+        } else {
+            _flags.didEncounterFailure = 1;
+        }
+    }
+    return _cachedImageContainer;
+}
+
+- (nullable UIImage *)_createImageWithSampling:(size_t)sampling
+                                 consumePixels:(BOOL)consumePixels TIPX_OBJC_DIRECT
+{
+    if (!_pixels || !_colorSpace) {
+        return nil;
+    }
+
+    size_t width = _basicInfo.xsize;
+    size_t height = _basicInfo.ysize;
+    Byte *pixels = NULL;
+    if (consumePixels && 1 == sampling) {
+        // no more decoding into the buffer, take ownership of it rather than copying it
+        pixels = _pixels;
+        _pixels = NULL;
+        _pixelsLength = 0;
+    } else {
+        pixels = TIPXJXLCopyPixels(_pixels, width, height, sampling, &width, &height);
+        if (!pixels) {
+            return nil;
+        }
+        if (consumePixels) {
+            free(_pixels);
+            _pixels = NULL;
+            _pixelsLength = 0;
+        }
+    }
+
+    return TIPXJXLCreateImage(pixels, width, height, _colorSpace, &_basicInfo);
+}
+
+- (void)_cleanup TIPX_OBJC_DIRECT
+{
+    if (_decoder) {
+        JxlDecoderDestroy(_decoder);
+        _decoder = NULL;
+    }
+    if (_runner) {
+        JxlResizableParallelRunnerDestroy(_runner);
+        _runner = NULL;
+    }
+}
+
+@end
+
+#pragma mark - Functions
+
+static size_t TIPXJXLDownsamplingRatio(CGSize dimensions,
+                                       CGSize targetDimensions,
+                                       UIViewContentMode targetContentMode,
+                                       JxlOrientation orientation)
+{
+    if (targetDimensions.width <= 0 || targetDimensions.height <= 0) {
+        return 1;
+    }
+
+    // the target sizing is of the oriented image
+    const BOOL isTransposed = orientation >= JXL_ORIENT_TRANSPOSE;
+    const CGSize orientedDimensions = (isTransposed) ? CGSizeMake(dimensions.height, dimensions.width) : dimensions;
+    CGSize scaledDimensions = TIPDimensionsScaledToTargetSizing(orientedDimensions, targetDimensions, targetContentMode);
+    if (isTransposed) {
+        scaledDimensions = CGSizeMake(scaledDimensions.height, scaledDimensions.width);
+    }
+
+    // the smallest downsampling (of the DC and AC passes) that is no smaller than the scaled
+    // dimensions, TIP scales the rest of the way
+    for (size_t ratio = 8; ratio > 1; ratio /= 2) {
+        if (ceil(dimensions.width / ratio) >= scaledDimensions.width && ceil(dimensions.height / ratio) >= scaledDimensions.height) {
+            return ratio;
+        }
+    }
+    return 1;
+}
+
+static CGColorSpaceRef __nullable TIPXJXLCreateColorSpace(JxlDecoder *decoder,
+                                                          const JxlBasicInfo *basicInfo)
+{
+    if (!basicInfo->uses_original_profile) {
+        // XYB encoded images can be output in any color space, have libjxl convert to sRGB
+        JxlColorEncoding colorEncoding;
+        JxlColorEncodingSetToSRGB(&colorEncoding, JXL_FALSE);
+        if (JXL_DEC_SUCCESS == JxlDecoderSetPreferredColorProfile(decoder, &colorEncoding)) {
+            return CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+        }
+    }
+
+    // the pixels are in the color space of the image, use its ICC profile if it is RGB
+    size_t profileSize = 0;
+    if (JXL_DEC_SUCCESS == JxlDecoderGetICCProfileSize(decoder, JXL_COLOR_PROFILE_TARGET_DATA, &profileSize) && profileSize > 0) {
+        NSMutableData *profile = [NSMutableData dataWithLength:profileSize];
+        if (JXL_DEC_SUCCESS == JxlDecoderGetColorAsICCProfile(decoder, JXL_COLOR_PROFILE_TARGET_DATA, profile.mutableBytes, profileSize)) {
+            CGColorSpaceRef colorSpace = CGColorSpaceCreateWithICCData((__bridge CFDataRef)profile);
+            if (colorSpace && kCGColorSpaceModelRGB == CGColorSpaceGetModel(colorSpace)) {
+                return colorSpace;
+            }
+            if (colorSpace) {
+                CFRelease(colorSpace);
+            }
+        }
+    }
+
+    // grayscale is output as RGB
+    return CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+}
+
+static UIImage * __nullable TIPXJXLCreateImage(Byte *pixels,
+                                               size_t width,
+                                               size_t height,
+                                               CGColorSpaceRef colorSpace,
+                                               const JxlBasicInfo *basicInfo)
+{
+    const size_t bytesPerRow = width * kTIPXJXLPixelFormat.num_channels;
+    CFDataRef pixelData = CFDataCreateWithBytesNoCopy(NULL, pixels, (CFIndex)(bytesPerRow * height), kCFAllocatorMalloc);
+    TIPXDeferRelease(pixelData);
+    if (!pixelData) {
+        free(pixels);
+        return nil;
+    }
+    CGDataProviderRef provider = CGDataProviderCreateWithCFData(pixelData);
+    TIPXDeferRelease(provider);
+    if (!provider) {
+        return nil;
+    }
+
+    CGImageAlphaInfo alphaInfo = kCGImageAlphaNoneSkipLast;
+    if (basicInfo->alpha_bits > 0) {
+        alphaInfo = (basicInfo->alpha_premultiplied) ? kCGImageAlphaPremultipliedLast : kCGImageAlphaLast;
+    }
+    CGImageRef imageRef = CGImageCreate(width,
+                                        height,
+                                        8 /* bitsPerComponent */,
+                                        32 /* bitsPerPixel */,
+                                        bytesPerRow,
+                                        colorSpace,
+                                        kCGBitmapByteOrderDefault | alphaInfo,
+                                        provider,
+                                        NULL /* decode */,
+                                        true /* shouldInterpolate */,
+                                        kCGRenderingIntentDefault);
+    TIPXDeferRelease(imageRef);
+    if (!imageRef) {
+        return nil;
+    }
+
+    return [UIImage imageWithCGImage:imageRef
+                               scale:1.0
+                         orientation:TIPUIImageOrientationFromCGImageOrientation((CGImagePropertyOrientation)basicInfo->orientation)];
+}
+
+static Byte * __nullable TIPXJXLCopyPixels(const Byte *pixels,
+                                           size_t width,
+                                           size_t height,
+                                           size_t sampling,
+                                           size_t *widthOut,
+                                           size_t *heightOut)
+{
+    const size_t bytesPerPixel = kTIPXJXLPixelFormat.num_channels;
+    const size_t sampledWidth = (width + sampling - 1) / sampling;
+    const size_t sampledHeight = (height + sampling - 1) / sampling;
+    Byte *sampledPixels = malloc(sampledWidth * sampledHeight * bytesPerPixel);
+    if (!sampledPixels) {
+        return NULL;
+    }
+
+    if (1 == sampling) {
+        memcpy(sampledPixels, pixels, width * height * bytesPerPixel);
+    } else {
+        // a pass with a downsampling ratio is upsampled to the full size, so every nth pixel of it
+        // is the image at that ratio
+        const uint32_t *source = (const uint32_t *)pixels;
+        uint32_t *destination = (uint32_t *)sampledPixels;
+        for (size_t y = 0; y < sampledHeight; y++) {
+            const uint32_t *sourceRow = source + (y * sampling * width);
+            for (size_t x = 0; x < sampledWidth; x++) {
+                *destination++ = sourceRow[x * sampling];
+            }
+        }
+    }
+
+    *widthOut = sampledWidth;
+    *heightOut = sampledHeight;
+    return sampledPixels;
+}
+
+static NSData * __nullable TIPXJXLEncode(const Byte *pixels,
+                                         size_t width,
+                                         size_t height,
+                                         BOOL hasAlpha,
+                                         float quality,
+                                         BOOL progressive,
+                                         JxlOrientation orientation)
+{
+    JxlEncoder *encoder = JxlEncoderCreate(NULL);
+    tipx_defer(^{
+        if (encoder) {
+            JxlEncoderDestroy(encoder);
+        }
+    });
+    void *runner = JxlResizableParallelRunnerCreate(NULL);
+    tipx_defer(^{
+        if (runner) {
+            JxlResizableParallelRunnerDestroy(runner);
+        }
+    });
+    if (!encoder || !runner) {
+        return nil;
+    }
+    JxlResizableParallelRunnerSetThreads(runner, JxlResizableParallelRunnerSuggestThreads(width, height));
+    if (JXL_ENC_SUCCESS != JxlEncoderSetParallelRunner(encoder, JxlResizableParallelRunner, runner)) {
+        return nil;
+    }
+
+    // a quality of 1 is lossless, which keeps the original (sRGB) profile rather than encoding in XYB
+    const BOOL lossless = quality >= 1.f;
+
+    JxlBasicInfo basicInfo;
+    JxlEncoderInitBasicInfo(&basicInfo);
+    basicInfo.xsize = (uint32_t)width;
+    basicInfo.ysize = (uint32_t)height;
+    basicInfo.bits_per_sample = 8;
+    basicInfo.num_color_channels = 3;
+    basicInfo.num_extra_channels = (hasAlpha) ? 1 : 0;
+    basicInfo.alpha_bits = (hasAlpha) ? 8 : 0;
+    basicInfo.uses_original_profile = (lossless) ? JXL_TRUE : JXL_FALSE;
+    basicInfo.orientation = orientation;
+    if (JXL_ENC_SUCCESS != JxlEncoderSetBasicInfo(encoder, &basicInfo)) {
+        return nil;
+    }
+
+    JxlColorEncoding colorEncoding;
+    JxlColorEncodingSetToSRGB(&colorEncoding, JXL_FALSE);
+    if (JXL_ENC_SUCCESS != JxlEncoderSetColorEncoding(encoder, &colorEncoding)) {
+        return nil;
+    }
+
+    JxlEncoderFrameSettings *settings = JxlEncoderFrameSettingsCreate(encoder, NULL);
+    if (!settings) {
+        return nil;
+    }
+    if (lossless) {
+        if (JXL_ENC_SUCCESS != JxlEncoderSetFrameLossless(settings, JXL_TRUE)) {
+            return nil;
+        }
+    } else {
+        if (JXL_ENC_SUCCESS != JxlEncoderSetFrameDistance(settings, JxlEncoderDistanceFromQuality(MAX(0.f, quality) * 100.f))) {
+            return nil;
+        }
+    }
+    if (progressive) {
+        // a progressive DC for an earlier first render and AC in passes of increasing detail
+        // (responsive for lossless)
+        JxlEncoderFrameSettingsSetOption(settings, JXL_ENC_FRAME_SETTING_PROGRESSIVE_DC, 1);
+        JxlEncoderFrameSettingsSetOption(settings, JXL_ENC_FRAME_SETTING_QPROGRESSIVE_AC, 1);
+        JxlEncoderFrameSettingsSetOption(settings, JXL_ENC_FRAME_SETTING_RESPONSIVE, 1);
+    }
+
+    // the opaque pixels are packed down to RGB
+    const Byte *framePixels = pixels;
+    __block Byte *rgbPixels = NULL;
+    tipx_defer(^{
+        free(rgbPixels);
+    });
+    if (!hasAlpha) {
+        rgbPixels = malloc(width * height * 3);
+        if (!rgbPixels) {
+            return nil;
+        }
+        vImage_Buffer source = { .data = (void *)pixels, .width = width, .height = height, .rowBytes = width * 4 };
+        vImage_Buffer destination = { .data = rgbPixels, .width = width, .height = height, .rowBytes = width * 3 };
+        if (kvImageNoError != vImageConvert_RGBA8888toRGB888(&source, &destination, kvImageNoFlags)) {
+            return nil;
+        }
+        framePixels = rgbPixels;
+    }
+
+    const JxlPixelFormat format = {
+        .num_channels = (hasAlpha) ? 4 : 3,
+        .data_type = JXL_TYPE_UINT8,
+        .endianness = JXL_NATIVE_ENDIAN,
+        .align = 0,
+    };
+    if (JXL_ENC_SUCCESS != JxlEncoderAddImageFrame(settings, &format, framePixels, width * height * format.num_channels)) {
+        return nil;
+    }
+    JxlEncoderCloseInput(encoder);
+
+    NSMutableData *output = [NSMutableData dataWithLength:MAX((NSUInteger)(64 * 1024), width * height / 4)];
+    uint8_t *nextOutput = output.mutableBytes;
+    size_t availableOutput = output.length;
+    JxlEncoderStatus status;
+    while (JXL_ENC_NEED_MORE_OUTPUT == (status = JxlEncoderProcessOutput(encoder, &nextOutput, &availableOutput))) {
+        const size_t offset = (size_t)(nextOutput - (uint8_t *)output.mutableBytes);
+        output.length *= 2;
+        nextOutput = (uint8_t *)output.mutableBytes + offset;
+        availableOutput = output.length - offset;
+    }
+    if (JXL_ENC_SUCCESS != status) {
+        return nil;
+    }
+
+    output.length = (NSUInteger)(nextOutput - (uint8_t *)output.mutableBytes);
+    return output;
+}
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,57 @@
+//
+//  TIPXPNGCodec.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import <TwitterImagePipeline/TIPImageCodecs.h>
+
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Convenience codec for decoding and encoding static PNGs with libpng, in place of ImageIO.
+ Requires libpng 1.6 or later (its `png.h` header and `libpng16` library).
+ This codec is not bundled with __TIP__ to avoid bloating the framework with libpng,
+ but there's nothing preventing a consumer from using this codec.
+
+ The decoder feeds data to libpng's progressive reader as it arrives, so the image is fully decoded
+ by the time the data completes.  Adam7 interlaced PNGs are progressive: a preview is rendered each
+ time one of the first 6 passes completes, with each pixel decoded so far filling the block of
+ pixels that the later passes will fill in.  Palette, gray and 16-bit PNGs are expanded to 8-bit RGBA
+ (or RGBX when the PNG has no transparency).  Animated PNGs (APNG) are decoded by the decoder of the
+ preferred codec (see `initWithPreferredCodec:`), or not matched at all when there is no preferred codec.
+
+ The encoder supports `TIPImageEncodingProgressive` (Adam7 interlacing), `TIPImageEncodingGrayscale`
+ and `TIPImageEncodingNoAlpha`.  PNG is lossless, so the suggested quality only picks the zlib
+ compression level (`1` is the smallest output, lower qualities encode faster).  The orientation of
+ the image is applied to the pixels since PNG has no widely supported orientation metadata.
+ Images are encoded in the device RGB (sRGB) color space.  Animated images are encoded by the encoder of
+ the preferred codec, or fail with `TIPErrorCodeEncodingUnsupported` when there is no preferred codec.
+
+    [[TIPImageCodecCatalogue sharedInstance] replaceCodecForImageType:TIPImageTypePNG
+                                                           usingBlock:^id<TIPImageCodec>(id<TIPImageCodec> existingCodec) {
+        return [[TIPXPNGCodec alloc] initWithPreferredCodec:existingCodec];
+    }];
+ */
+@interface TIPXPNGCodec : NSObject <TIPImageCodec>
+/** libpng decoder */
+@property (nonatomic, readonly) id<TIPImageDecoder> tip_decoder;
+/** libpng encoder */
+@property (nonatomic, readonly) id<TIPImageEncoder> tip_encoder;
+
+/**
+ Initializer
+ @param preferredCodec Pass the codec being replaced (the default system codec) if possible. Its
+ decoder and encoder handle the animated PNGs that libpng can't.
+ @return a new `TIPXPNGCodec` instance
+ */
+- (instancetype)initWithPreferredCodec:(nullable id<TIPImageCodec>)preferredCodec NS_DESIGNATED_INITIALIZER;
+/** Initializer without a preferred codec, animated PNGs will not be decoded or encoded */
+- (instancetype)init;
+
+@end
+
+NS_ASSUME_NONNULL_END
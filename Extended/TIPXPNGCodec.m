@@ -0,0 +1,923 @@
+//
+//  TIPXPNGCodec.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#pragma mark imports
+
+#import <Accelerate/Accelerate.h>
+#import <TwitterImagePipeline/TwitterImagePipeline.h>
+
+#import "TIPXPNGCodec.h"
+#import "TIPXUtils.h"
+
+#pragma mark libpng includes
+
+#include <png.h>
+
+#if PNG_LIBPNG_VER < 10600
+#error TIPXPNGCodec requires libpng 1.6 or later
+#endif
+
+NS_ASSUME_NONNULL_BEGIN
+
+#pragma mark - Declarations
+
+#define kPNG_SIGNATURE_LENGTH       (8)
+#define kPNG_ADAM7_PASS_COUNT       (7)
+
+// Incremental state of libpng's progressive reader
+typedef struct {
+    png_structp __nullable png;
+    png_infop __nullable info;
+    size_t width;
+    size_t height;
+    size_t bytesPerRow;
+    CGColorSpaceRef __nullable colorSpace; // retained
+    Byte * __nullable canvas; // allocated when the first row is decoded, RGBA or RGBX
+    NSUInteger completedPassCount; // Adam7 passes that have all of their rows decoded
+    BOOL hasAlpha;
+    BOOL isInterlaced;
+    BOOL didReadHeader;
+    BOOL didReadEnd;
+    BOOL isCorrupt;
+} TIPXPNGReader;
+
+// What the chunks before the image data reveal about a PNG
+typedef NS_ENUM(NSInteger, TIPXPNGImageKind) {
+    TIPXPNGImageKindUnknown = 0, // need more data
+    TIPXPNGImageKindInvalid,
+    TIPXPNGImageKindStatic,
+    TIPXPNGImageKindAnimated, // has an acTL chunk (APNG)
+};
+
+// A growable buffer for libpng to write to
+typedef struct {
+    Byte * __nullable bytes;
+    size_t length;
+    size_t capacity;
+} TIPXPNGWriteBuffer;
+
+static BOOL TIPXPNGReaderInit(TIPXPNGReader *reader);
+static void TIPXPNGReaderDestroy(TIPXPNGReader *reader);
+static void TIPXPNGReaderRead(TIPXPNGReader *reader,
+                              const Byte *bytes,
+                              size_t length);
+static CGImageRef __nullable TIPXPNGReaderCreateImage(TIPXPNGReader *reader);
+static CGImageRef __nullable TIPXPNGReaderCreatePreviewImage(const TIPXPNGReader *reader);
+static TIPImageContainer * __nullable TIPXPNGDecodeImage(NSData *data);
+static TIPXPNGImageKind TIPXPNGDetectImageKind(const Byte *bytes,
+                                               size_t length);
+static BOOL TIPXPNGCompress(const Byte *pixels,
+                            size_t width,
+                            size_t height,
+                            size_t bytesPerRow,
+                            int colorType,
+                            BOOL hasFiller,
+                            int compressionLevel,
+                            BOOL interlaced,
+                            Byte * __nullable * __nonnull bufferOut,
+                            size_t *lengthOut);
+
+@interface TIPXPNGDecoderContext : NSObject <TIPImageDecoderContext>
+
+@property (nonatomic, readonly) NSData *tip_data;
+@property (nonatomic, readonly) CGSize tip_dimensions;
+@property (nonatomic, readonly) NSUInteger tip_frameCount;
+@property (nonatomic, readonly) BOOL tip_isProgressive;
+@property (nonatomic, readonly) BOOL tip_hasAlpha;
+
+- (instancetype)initWithExpectedContentLength:(NSUInteger)length
+                                       buffer:(nullable NSMutableData *)buffer
+                                       config:(nullable id)config
+                                fallbackCodec:(nullable id<TIPImageCodec>)fallbackCodec;
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+- (TIPImageDecoderAppendResult)append:(NSData *)data TIPX_OBJC_DIRECT;
+- (nullable TIPImageContainer *)renderImage:(TIPImageDecoderRenderMode)renderMode
+                           targetDimensions:(CGSize)targetDimensions
+                          targetContentMode:(UIViewContentMode)targetContentMode TIPX_OBJC_DIRECT;
+- (TIPImageDecoderAppendResult)finalizeDecoding TIPX_OBJC_DIRECT;
+
+@end
+
+@interface TIPXPNGDecoder : NSObject <TIPImageDecoder>
+- (instancetype)initWithFallbackCodec:(nullable id<TIPImageCodec>)fallbackCodec;
+@end
+
+@interface TIPXPNGEncoder : NSObject <TIPImageEncoder>
+- (instancetype)initWithFallbackEncoder:(nullable id<TIPImageEncoder>)fallbackEncoder;
+@end
+
+#pragma mark - Implementations
+
+@implementation TIPXPNGCodec
+
+- (instancetype)init
+{
+    return [self initWithPreferredCodec:nil];
+}
+
+- (instancetype)initWithPreferredCodec:(nullable id<TIPImageCodec>)preferredCodec
+{
+    if (self = [super init]) {
+        _tip_decoder = [[TIPXPNGDecoder alloc] initWithFallbackCodec:(preferredCodec.tip_decoder) ? preferredCodec : nil];
+        _tip_encoder = [[TIPXPNGEncoder alloc] initWithFallbackEncoder:preferredCodec.tip_encoder];
+    }
+    return self;
+}
+
+@end
+
+@implementation TIPXPNGDecoder
+{
+    id<TIPImageCodec> _fallbackCodec;
+}
+
+- (instancetype)initWithFallbackCodec:(nullable id<TIPImageCodec>)fallbackCodec
+{
+    if (self = [super init]) {
+        _fallbackCodec = fallbackCodec;
+    }
+    return self;
+}
+
+- (TIPImageDecoderDetectionResult)tip_detectDecodableData:(NSData *)data
+                                           isCompleteData:(BOOL)complete
+                                      earlyGuessImageType:(nullable NSString *)imageType
+{
+    switch (TIPXPNGDetectImageKind(data.bytes, data.length)) {
+        case TIPXPNGImageKindStatic:
+            return TIPImageDecoderDetectionResultMatch;
+        case TIPXPNGImageKindAnimated:
+        {
+            // animated PNGs are only matched when the fallback decoder matches them
+            id<TIPImageDecoder> fallbackDecoder = _fallbackCodec.tip_decoder;
+            if (!fallbackDecoder) {
+                return TIPImageDecoderDetectionResultNoMatch;
+            }
+            return [fallbackDecoder tip_detectDecodableData:data
+                                             isCompleteData:complete
+                                        earlyGuessImageType:imageType];
+        }
+        case TIPXPNGImageKindInvalid:
+            return TIPImageDecoderDetectionResultNoMatch;
+        case TIPXPNGImageKindUnknown:
+            break;
+    }
+    return (complete) ? TIPImageDecoderDetectionResultNoMatch : TIPImageDecoderDetectionResultNeedMoreData;
+}
+
+- (id<TIPImageDecoderContext>)tip_initiateDecoding:(nullable id)config
+                                expectedDataLength:(NSUInteger)expectedDataLength
+                                            buffer:(nullable NSMutableData *)buffer
+{
+    return [[TIPXPNGDecoderContext alloc] initWithExpectedContentLength:expectedDataLength
+                                                                 buffer:buffer
+                                                                 config:config
+                                                          fallbackCodec:_fallbackCodec];
+}
+
+- (TIPImageDecoderAppendResult)tip_append:(TIPXPNGDecoderContext *)context
+                                     data:(NSData *)data
+{
+    return [context append:data];
+}
+
+- (nullable TIPImageContainer *)tip_renderImage:(TIPXPNGDecoderContext *)context
+                                     renderMode:(TIPImageDecoderRenderMode)renderMode
+                               targetDimensions:(CGSize)targetDimensions
+                              targetContentMode:(UIViewContentMode)targetContentMode
+{
+    return [context renderImage:renderMode targetDimensions:targetDimensions targetContentMode:targetContentMode];
+}
+
+- (TIPImageDecoderAppendResult)tip_finalizeDecoding:(TIPXPNGDecoderContext *)context
+{
+    return [context finalizeDecoding];
+}
+
+- (BOOL)tip_supportsProgressiveDecoding
+{
+    return YES;
+}
+
+- (nullable TIPImageContainer *)tip_decodeImageWithData:(NSData *)imageData
+                                       targetDimensions:(CGSize)targetDimensions
+                                      targetContentMode:(UIViewContentMode)targetContentMode
+                                                 config:(nullable id)config
+{
+    if (_fallbackCodec && TIPXPNGImageKindAnimated == TIPXPNGDetectImageKind(imageData.bytes, imageData.length)) {
+        return TIPDecodeImageFromData(_fallbackCodec, config, imageData, targetDimensions, targetContentMode);
+    }
+    return TIPXPNGDecodeImage(imageData);
+}
+
+@end
+
+@implementation TIPXPNGEncoder
+{
+    id<TIPImageEncoder> _fallbackEncoder;
+}
+
+- (instancetype)initWithFallbackEncoder:(nullable id<TIPImageEncoder>)fallbackEncoder
+{
+    if (self = [super init]) {
+        _fallbackEncoder = fallbackEncoder;
+    }
+    return self;
+}
+
+- (nullable NSData *)tip_writeDataWithImage:(TIPImageContainer *)imageContainer
+                            encodingOptions:(TIPImageEncodingOptions)encodingOptions
+                           suggestedQuality:(float)quality
+                                      error:(out NSError * __nullable __autoreleasing * __nullable)error
+{
+    __block TIPErrorCode errorCode = TIPErrorCodeUnknown;
+    __block NSData *outputData = nil;
+    tipx_defer(^{
+        if (error && !outputData) {
+            *error = [NSError errorWithDomain:TIPErrorDomain
+                                         code:errorCode
+                                     userInfo:nil];
+        }
+    });
+
+    if (imageContainer.animated) {
+        // libpng only writes static PNGs, leave animated PNGs (APNG) to the fallback encoder
+        if (_fallbackEncoder) {
+            return [_fallbackEncoder tip_writeDataWithImage:imageContainer
+                                            encodingOptions:encodingOptions
+                                           suggestedQuality:quality
+                                                      error:error];
+        }
+        errorCode = TIPErrorCodeEncodingUnsupported;
+        return nil;
+    }
+
+    UIImage *image = imageContainer.image;
+    if (image.imageOrientation != UIImageOrientationUp) {
+        image = [image tip_orientationAdjustedImage];
+    }
+
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef) {
+        errorCode = TIPErrorCodeMissingCGImage;
+        return nil;
+    }
+
+    // draw as RGBA (or RGBX without alpha) in the device RGB color space
+    const BOOL grayscale = (encodingOptions & TIPImageEncodingGrayscale) != 0;
+    const BOOL hasAlpha = (encodingOptions & TIPImageEncodingNoAlpha) == 0 && [image tip_hasAlpha:NO];
+    const size_t width = CGImageGetWidth(imageRef);
+    const size_t height = CGImageGetHeight(imageRef);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    TIPXDeferRelease(colorSpace);
+    const CGBitmapInfo bitmapInfo = (CGBitmapInfo)((hasAlpha) ? kCGImageAlphaPremultipliedLast : kCGImageAlphaNoneSkipLast);
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, width * 4, colorSpace, bitmapInfo);
+    TIPXDeferRelease(context);
+    if (!context) {
+        return nil;
+    }
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+
+    Byte *pixels = CGBitmapContextGetData(context);
+    size_t bytesPerRow = CGBitmapContextGetBytesPerRow(context);
+    if (hasAlpha) {
+        // PNG stores straight alpha
+        vImage_Buffer buffer = { .data = pixels, .height = height, .width = width, .rowBytes = bytesPerRow };
+        if (vImageUnpremultiplyData_RGBA8888(&buffer, &buffer, kvImageNoFlags) != kvImageNoError) {
+            return nil;
+        }
+    }
+
+    NSMutableData *grayPixels = nil;
+    if (grayscale) {
+        // libpng only converts RGB to gray when reading, so convert with Rec. 709 luma weights here
+        const size_t componentCount = (hasAlpha) ? 2 : 1;
+        grayPixels = [NSMutableData dataWithLength:width * height * componentCount];
+        Byte *gray = grayPixels.mutableBytes;
+        for (size_t y = 0; y < height; y++) {
+            const Byte *rgba = pixels + (y * bytesPerRow);
+            for (size_t x = 0; x < width; x++, rgba += 4, gray += componentCount) {
+                gray[0] = (Byte)((54 * rgba[0] + 183 * rgba[1] + 19 * rgba[2]) >> 8);
+                if (hasAlpha) {
+                    gray[1] = rgba[3];
+                }
+            }
+        }
+        pixels = grayPixels.mutableBytes;
+        bytesPerRow = width * componentCount;
+    }
+
+    const int colorType = (grayscale) ? ((hasAlpha) ? PNG_COLOR_TYPE_GRAY_ALPHA : PNG_COLOR_TYPE_GRAY) :
+                                        ((hasAlpha) ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB);
+
+    // PNG is lossless, a quality of 1 picks the best (slowest) zlib compression
+    const int compressionLevel = MAX(1, MIN(9, (int)lroundf(quality * 9.f)));
+    Byte *buffer = NULL;
+    size_t length = 0;
+    if (!TIPXPNGCompress(pixels,
+                         width,
+                         height,
+                         bytesPerRow,
+                         colorType,
+                         !grayscale && !hasAlpha /* hasFiller */,
+                         compressionLevel,
+                         (encodingOptions & TIPImageEncodingProgressive) != 0,
+                         &buffer,
+                         &length)) {
+        return nil;
+    }
+
+    outputData = [NSData dataWithBytesNoCopy:buffer length:length freeWhenDone:YES];
+    return outputData;
+}
+
+@end
+
+@implementation TIPXPNGDecoderContext
+{
+    struct {
+        BOOL didEncounterFailure:1;
+        BOOL didLoadHeaders:1;
+        BOOL didComplete:1;
+        BOOL isCachedImageComplete:1;
+    } _flags;
+
+    NSMutableData *_dataBuffer;
+    NSUInteger _expectedContentLength;
+    NSUInteger _readLength; // bytes of the buffer that libpng has read
+    id _config;
+    TIPXPNGReader _reader;
+    TIPImageContainer *_cachedImageContainer;
+    NSUInteger _cachedImagePassCount;
+    CGSize _cachedImageDimensions;
+
+    // decodes animated PNGs, once the chunks before the image data reveal one
+    id<TIPImageCodec> _fallbackCodec;
+    id<TIPImageDecoderContext> _fallbackContext;
+    BOOL _didDetectImageKind;
+}
+
+@synthesize tip_dimensions = _tip_dimensions;
+
+- (NSData *)tip_data
+{
+    return (_fallbackContext) ? _fallbackContext.tip_data : _dataBuffer;
+}
+
+- (CGSize)tip_dimensions
+{
+    return (_fallbackContext) ? _fallbackContext.tip_dimensions : _tip_dimensions;
+}
+
+- (nullable id)tip_config
+{
+    return _config;
+}
+
+- (BOOL)tip_isProgressive
+{
+    if (_fallbackContext) {
+        return _fallbackContext.tip_isProgressive;
+    }
+    return _reader.isInterlaced;
+}
+
+- (BOOL)tip_isAnimated
+{
+    if (_fallbackContext) {
+        return [_fallbackContext respondsToSelector:@selector(tip_isAnimated)] && _fallbackContext.tip_isAnimated;
+    }
+    return NO;
+}
+
+- (BOOL)tip_hasAlpha
+{
+    if (_fallbackContext) {
+        return _fallbackContext.tip_hasAlpha;
+    }
+    return _reader.hasAlpha;
+}
+
+- (NSUInteger)tip_frameCount
+{
+    if (_fallbackContext) {
+        return _fallbackContext.tip_frameCount;
+    }
+    if (_reader.isInterlaced) {
+        return _reader.completedPassCount;
+    }
+    return (_flags.didComplete) ? 1 : 0;
+}
+
+- (instancetype)initWithExpectedContentLength:(NSUInteger)length
+                                       buffer:(nullable NSMutableData *)buffer
+                                       config:(nullable id)config
+                                fallbackCodec:(nullable id<TIPImageCodec>)fallbackCodec
+{
+    if (self = [super init]) {
+        _expectedContentLength = length;
+        _config = config;
+        _fallbackCodec = fallbackCodec;
+        if (!TIPXPNGReaderInit(&_reader)) {
+            _flags.didEncounterFailure = 1;
+        }
+        if (buffer) {
+            // read on the next append, once it is known whether the PNG is animated
+            _dataBuffer = buffer;
+        } else if (length > 0) {
+            _dataBuffer = [NSMutableData dataWithCapacity:length];
+        } else {
+            _dataBuffer = [NSMutableData data];
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    TIPXPNGReaderDestroy(&_reader);
+}
+
+- (TIPImageDecoderAppendResult)append:(NSData *)data
+{
+    if (_fallbackContext) {
+        return [_fallbackCodec.tip_decoder tip_append:_fallbackContext data:data];
+    }
+
+    if (_flags.didComplete) {
+        return TIPImageDecoderAppendResultDidCompleteLoading;
+    }
+
+    if (_flags.didEncounterFailure) {
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    [_dataBuffer appendData:data];
+
+    if (!_didDetectImageKind) {
+        const TIPXPNGImageKind kind = TIPXPNGDetectImageKind(_dataBuffer.bytes, _dataBuffer.length);
+        if (TIPXPNGImageKindUnknown == kind) {
+            return TIPImageDecoderAppendResultDidProgress;
+        }
+        _didDetectImageKind = YES;
+
+        id<TIPImageDecoder> fallbackDecoder = _fallbackCodec.tip_decoder;
+        if (TIPXPNGImageKindAnimated == kind && fallbackDecoder) {
+            // hand everything read so far to the fallback decoder and forward to it from now on,
+            // without a fallback libpng decodes the default image of the animated PNG
+            _fallbackContext = [fallbackDecoder tip_initiateDecoding:_config
+                                                  expectedDataLength:_expectedContentLength
+                                                              buffer:nil];
+            NSData *bufferedData = [_dataBuffer copy];
+            _dataBuffer = nil;
+            return [fallbackDecoder tip_append:_fallbackContext data:bufferedData];
+        }
+    }
+
+    // libpng keeps its own state between chunks, so only the data it hasn't read is read
+    const NSUInteger previousCompletedPassCount = _reader.completedPassCount;
+    TIPXPNGReaderRead(&_reader, (const Byte *)_dataBuffer.bytes + _readLength, _dataBuffer.length - _readLength);
+    _readLength = _dataBuffer.length;
+    if (_reader.isCorrupt) {
+        _flags.didEncounterFailure = 1;
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    TIPImageDecoderAppendResult result = TIPImageDecoderAppendResultDidProgress;
+    if (!_flags.didLoadHeaders && _reader.didReadHeader) {
+        _tip_dimensions = CGSizeMake(_reader.width, _reader.height);
+        _flags.didLoadHeaders = 1;
+        result = TIPImageDecoderAppendResultDidLoadHeaders;
+    }
+    if (_reader.isInterlaced && !_reader.didReadEnd && _reader.completedPassCount > previousCompletedPassCount) {
+        result = TIPImageDecoderAppendResultDidLoadFrame;
+    }
+    return result;
+}
+
+- (nullable TIPImageContainer *)renderImage:(TIPImageDecoderRenderMode)renderMode
+                           targetDimensions:(CGSize)targetDimensions
+                          targetContentMode:(UIViewContentMode)targetContentMode
+{
+    if (_fallbackContext) {
+        return [_fallbackCodec.tip_decoder tip_renderImage:_fallbackContext
+                                                renderMode:renderMode
+                                          targetDimensions:targetDimensions
+                                         targetContentMode:targetContentMode];
+    }
+
+    if (_flags.didEncounterFailure || !_flags.didLoadHeaders) {
+        return nil;
+    }
+
+    @autoreleasepool {
+        if (_flags.didComplete) {
+            if (!_cachedImageContainer || !_flags.isCachedImageComplete) {
+                // the canvas is handed off to the image, the reader is done with it
+                CGImageRef imageRef = TIPXPNGReaderCreateImage(&_reader);
+                TIPXDeferRelease(imageRef);
+                if (imageRef) {
+                    _cachedImageContainer = [[TIPImageContainer alloc] initWithImage:[UIImage imageWithCGImage:imageRef]];
+                    _flags.isCachedImageComplete = 1;
+                } else {
+                    _cachedImageContainer = nil;
+                    _flags.didEncounterFailure = 1;
+                }
+            }
+            return _cachedImageContainer;
+        }
+
+        if (TIPImageDecoderRenderModeCompleteImage == renderMode || !_reader.isInterlaced || !_reader.completedPassCount || _reader.didReadEnd) {
+            return nil;
+        }
+
+        const CGSize scaledDimensions = TIPDimensionsScaledToTargetSizing(_tip_dimensions,
+                                                                          targetDimensions,
+                                                                          targetContentMode);
+        if (!_cachedImageContainer || _cachedImagePassCount != _reader.completedPassCount || !CGSizeEqualToSize(_cachedImageDimensions, scaledDimensions)) {
+            CGImageRef imageRef = TIPXPNGReaderCreatePreviewImage(&_reader);
+            TIPXDeferRelease(imageRef);
+            if (imageRef) {
+                // The preview has 1 pixel per block of pixels that the passes have filled in so far,
+                // scale it up to the dimensions of the image
+                UIImage *image = [[UIImage imageWithCGImage:imageRef] tip_scaledImageWithTargetDimensions:scaledDimensions
+                                                                                              contentMode:UIViewContentModeScaleToFill];
+                _cachedImageContainer = [[TIPImageContainer alloc] initWithImage:image];
+                _cachedImagePassCount = _reader.completedPassCount;
+                _cachedImageDimensions = scaledDimensions;
+            }
+        }
+        return _cachedImageContainer;
+    }
+}
+
+- (TIPImageDecoderAppendResult)finalizeDecoding
+{
+    if (_fallbackContext) {
+        return [_fallbackCodec.tip_decoder tip_finalizeDecoding:_fallbackContext];
+    }
+
+    if (_flags.didEncounterFailure) {
+        return TIPImageDecoderAppendResultDidCompleteLoading;
+    }
+
+    if (!_flags.didLoadHeaders) {
+        return TIPImageDecoderAppendResultDidProgress;
+    }
+
+    if (!_reader.didReadEnd) {
+        // truncated, libpng cannot finish the image
+        _flags.didEncounterFailure = 1;
+        return TIPImageDecoderAppendResultDidCompleteLoading;
+    }
+
+    _flags.didComplete = 1;
+    return TIPImageDecoderAppendResultDidCompleteLoading;
+}
+
+@end
+
+#pragma mark - Functions
+
+static void TIPXPNGErrorCallback(png_structp png, png_const_charp message)
+{
+    png_longjmp(png, 1);
+}
+
+static void TIPXPNGWarningCallback(png_structp png, png_const_charp message)
+{
+    // warnings are expected, such as for bad ancillary chunks that libpng skips
+}
+
+static uint32_t TIPXPNGReadUInt32(const Byte *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static TIPXPNGImageKind TIPXPNGDetectImageKind(const Byte *bytes,
+                                               size_t length)
+{
+    static const Byte sSignature[kPNG_SIGNATURE_LENGTH] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (length < kPNG_SIGNATURE_LENGTH) {
+        return TIPXPNGImageKindUnknown;
+    }
+    if (0 != memcmp(bytes, sSignature, kPNG_SIGNATURE_LENGTH)) {
+        return TIPXPNGImageKindInvalid;
+    }
+
+    // read the chunks up to the image data, animated PNGs have an acTL chunk before it
+    size_t offset = kPNG_SIGNATURE_LENGTH;
+    while (offset + 8 <= length) {
+        const Byte *chunkType = bytes + offset + 4;
+        if (0 == memcmp(chunkType, "acTL", 4)) {
+            return TIPXPNGImageKindAnimated;
+        }
+        if (0 == memcmp(chunkType, "IDAT", 4)) {
+            return TIPXPNGImageKindStatic;
+        }
+        offset += 12 /* length, type and CRC */ + TIPXPNGReadUInt32(bytes + offset);
+    }
+    return TIPXPNGImageKindUnknown;
+}
+
+static void TIPXPNGInfoCallback(png_structp png, png_infop info)
+{
+    TIPXPNGReader *reader = png_get_progressive_ptr(png);
+
+    png_uint_32 width = 0;
+    png_uint_32 height = 0;
+    int bitDepth = 0;
+    int colorType = 0;
+    int interlaceType = 0;
+    png_get_IHDR(png, info, &width, &height, &bitDepth, &colorType, &interlaceType, NULL, NULL);
+
+    // expand everything to 8-bit RGBA, or RGBX when there is no transparency
+    reader->hasAlpha = (colorType & PNG_COLOR_MASK_ALPHA) != 0 || png_get_valid(png, info, PNG_INFO_tRNS) != 0;
+    png_set_expand(png); // palette to RGB, gray to 8 bits, tRNS to alpha
+    png_set_scale_16(png);
+    png_set_gray_to_rgb(png);
+    if (!reader->hasAlpha) {
+        png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+    }
+    reader->isInterlaced = (png_set_interlace_handling(png) > 1);
+    png_read_update_info(png, info);
+
+    reader->width = width;
+    reader->height = height;
+    reader->bytesPerRow = png_get_rowbytes(png, info);
+    if (reader->bytesPerRow != (size_t)width * 4) {
+        png_error(png, "unexpected row layout");
+    }
+
+    png_charp profileName = NULL;
+    int compressionType = 0;
+    png_bytep profile = NULL;
+    png_uint_32 profileLength = 0;
+    if (png_get_iCCP(png, info, &profileName, &compressionType, &profile, &profileLength) && profileLength > 0) {
+        CFDataRef profileData = CFDataCreate(NULL, profile, (CFIndex)profileLength);
+        if (profileData) {
+            CGColorSpaceRef colorSpace = CGColorSpaceCreateWithICCData(profileData);
+            CFRelease(profileData);
+            // gray profiles don't apply to the expanded RGB pixels
+            if (colorSpace && CGColorSpaceGetModel(colorSpace) == kCGColorSpaceModelRGB) {
+                reader->colorSpace = colorSpace;
+            } else if (colorSpace) {
+                CFRelease(colorSpace);
+            }
+        }
+    }
+    if (!reader->colorSpace) {
+        reader->colorSpace = CGColorSpaceCreateDeviceRGB();
+    }
+
+    reader->didReadHeader = YES;
+}
+
+static void TIPXPNGRowCallback(png_structp png, png_bytep __nullable row, png_uint_32 rowIndex, int pass)
+{
+    TIPXPNGReader *reader = png_get_progressive_ptr(png);
+
+    // libpng only moves on to a pass once all of the rows of the previous passes are decoded
+    if (reader->isInterlaced && (NSUInteger)pass > reader->completedPassCount) {
+        reader->completedPassCount = (NSUInteger)pass;
+    }
+
+    if (!row) {
+        // interlaced rows without pixels in this pass
+        return;
+    }
+
+    if (!reader->canvas) {
+        reader->canvas = calloc(reader->height, reader->bytesPerRow);
+        if (!reader->canvas) {
+            png_error(png, "out of memory");
+        }
+    }
+
+    // combine with the pixels of the previous passes
+    png_progressive_combine_row(png, reader->canvas + (rowIndex * reader->bytesPerRow), row);
+}
+
+static void TIPXPNGEndCallback(png_structp png, png_infop info)
+{
+    TIPXPNGReader *reader = png_get_progressive_ptr(png);
+    if (reader->isInterlaced) {
+        reader->completedPassCount = kPNG_ADAM7_PASS_COUNT;
+    }
+    reader->didReadEnd = YES;
+}
+
+static BOOL TIPXPNGReaderInit(TIPXPNGReader *reader)
+{
+    *reader = (TIPXPNGReader){ 0 };
+    reader->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, TIPXPNGErrorCallback, TIPXPNGWarningCallback);
+    if (!reader->png) {
+        return NO;
+    }
+    reader->info = png_create_info_struct(reader->png);
+    if (!reader->info) {
+        png_destroy_read_struct(&reader->png, NULL, NULL);
+        return NO;
+    }
+    png_set_progressive_read_fn(reader->png, reader, TIPXPNGInfoCallback, TIPXPNGRowCallback, TIPXPNGEndCallback);
+    return YES;
+}
+
+static void TIPXPNGReaderDestroy(TIPXPNGReader *reader)
+{
+    if (reader->png) {
+        png_destroy_read_struct(&reader->png, &reader->info, NULL);
+    }
+    if (reader->colorSpace) {
+        CFRelease(reader->colorSpace);
+        reader->colorSpace = NULL;
+    }
+    free(reader->canvas);
+    reader->canvas = NULL;
+}
+
+static void TIPXPNGReaderRead(TIPXPNGReader *reader,
+                              const Byte *bytes,
+                              size_t length)
+{
+    // No Objective-C objects in here, libpng errors longjmp out of the reading
+    if (!reader->png || reader->isCorrupt || reader->didReadEnd || !length) {
+        return;
+    }
+    if (setjmp(png_jmpbuf(reader->png))) {
+        reader->isCorrupt = YES;
+        return;
+    }
+    png_process_data(reader->png, reader->info, (png_bytep)bytes, length);
+}
+
+static void TIPXPNGReleasePixels(void * __nullable info, const void *data, size_t size)
+{
+    free((void *)data);
+}
+
+static CGImageRef __nullable TIPXPNGCreateImageWithPixels(Byte *pixels,
+                                                          const TIPXPNGReader *reader)
+{
+    CGDataProviderRef provider = CGDataProviderCreateWithData(NULL,
+                                                              pixels,
+                                                              reader->bytesPerRow * reader->height,
+                                                              TIPXPNGReleasePixels);
+    TIPXDeferRelease(provider);
+    if (!provider) {
+        free(pixels);
+        return NULL;
+    }
+
+    // libpng outputs straight alpha
+    const CGBitmapInfo bitmapInfo = (CGBitmapInfo)((reader->hasAlpha) ? kCGImageAlphaLast : kCGImageAlphaNoneSkipLast);
+    return CGImageCreate(reader->width,
+                         reader->height,
+                         8 /* bitsPerComponent */,
+                         32 /* bitsPerPixel */,
+                         reader->bytesPerRow,
+                         reader->colorSpace,
+                         bitmapInfo,
+                         provider,
+                         NULL /* decode */,
+                         true /* shouldInterpolate */,
+                         kCGRenderingIntentDefault);
+}
+
+static CGImageRef __nullable TIPXPNGReaderCreateImage(TIPXPNGReader *reader)
+{
+    if (!reader->didReadEnd || !reader->canvas) {
+        return NULL;
+    }
+
+    Byte *pixels = reader->canvas;
+    reader->canvas = NULL;
+    return TIPXPNGCreateImageWithPixels(pixels, reader);
+}
+
+static CGImageRef __nullable TIPXPNGReaderCreatePreviewImage(const TIPXPNGReader *reader)
+{
+    if (!reader->canvas || !reader->colorSpace) {
+        return NULL;
+    }
+
+    // the canvas holds every row, libpng outputs straight alpha
+    const CGBitmapInfo bitmapInfo = (CGBitmapInfo)((reader->hasAlpha) ? kCGImageAlphaLast : kCGImageAlphaNoneSkipLast);
+    return TIPCreateAdam7PreviewImage(reader->canvas,
+                                      reader->width,
+                                      reader->height,
+                                      reader->bytesPerRow,
+                                      NO /* evenRowsOnly */,
+                                      reader->completedPassCount,
+                                      reader->colorSpace,
+                                      bitmapInfo);
+}
+
+static TIPImageContainer * __nullable TIPXPNGDecodeImage(NSData *data)
+{
+    TIPXPNGReader reader;
+    if (!TIPXPNGReaderInit(&reader)) {
+        return nil;
+    }
+    TIPXPNGReaderRead(&reader, data.bytes, data.length);
+    CGImageRef imageRef = TIPXPNGReaderCreateImage(&reader);
+    TIPXPNGReaderDestroy(&reader);
+    TIPXDeferRelease(imageRef);
+    if (!imageRef) {
+        return nil;
+    }
+
+    return [[TIPImageContainer alloc] initWithImage:[UIImage imageWithCGImage:imageRef]];
+}
+
+static void TIPXPNGWrite(png_structp png, png_bytep bytes, png_size_t length)
+{
+    TIPXPNGWriteBuffer *buffer = png_get_io_ptr(png);
+    if (buffer->length + length > buffer->capacity) {
+        const size_t capacity = MAX(buffer->capacity * 2, buffer->length + length);
+        Byte *newBytes = realloc(buffer->bytes, capacity);
+        if (!newBytes) {
+            png_error(png, "out of memory");
+        }
+        buffer->bytes = newBytes;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static void TIPXPNGFlush(png_structp png)
+{
+    // writing to memory, nothing to flush
+}
+
+static BOOL TIPXPNGCompress(const Byte *pixels,
+                            size_t width,
+                            size_t height,
+                            size_t bytesPerRow,
+                            int colorType,
+                            BOOL hasFiller,
+                            int compressionLevel,
+                            BOOL interlaced,
+                            Byte * __nullable * __nonnull bufferOut,
+                            size_t *lengthOut)
+{
+    // No Objective-C objects in here, libpng errors longjmp out of the encoding
+    TIPXPNGWriteBuffer buffer = { 0 };
+    png_bytep *rows = malloc(height * sizeof(png_bytep));
+    if (!rows) {
+        return NO;
+    }
+    for (size_t y = 0; y < height; y++) {
+        rows[y] = (png_bytep)(pixels + (y * bytesPerRow));
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, TIPXPNGErrorCallback, TIPXPNGWarningCallback);
+    png_infop info = (png) ? png_create_info_struct(png) : NULL;
+    if (!info) {
+        png_destroy_write_struct(&png, NULL);
+        free(rows);
+        return NO;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        free(rows);
+        free(buffer.bytes);
+        return NO;
+    }
+
+    png_set_write_fn(png, &buffer, TIPXPNGWrite, TIPXPNGFlush);
+    png_set_compression_level(png, compressionLevel);
+    png_set_IHDR(png,
+                 info,
+                 (png_uint_32)width,
+                 (png_uint_32)height,
+                 8 /* bitDepth */,
+                 colorType,
+                 (interlaced) ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_set_sRGB_gAMA_and_cHRM(png, info, PNG_sRGB_INTENT_PERCEPTUAL);
+    png_write_info(png, info);
+    if (hasFiller) {
+        // strip the X of RGBX
+        png_set_filler(png, 0, PNG_FILLER_AFTER);
+    }
+    png_write_image(png, rows); // handles the Adam7 passes
+    png_write_end(png, info);
+    png_destroy_write_struct(&png, &info);
+    free(rows);
+
+    *bufferOut = buffer.bytes;
+    *lengthOut = buffer.length;
+    return YES;
+}
+
+NS_ASSUME_NONNULL_END
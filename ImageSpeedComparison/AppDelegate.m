@@ -23,7 +23,33 @@
 {
     [TIPGlobalConfiguration sharedInstance].logger = self;
     [[TIPImageCodecCatalogue sharedInstance] replaceCodecForImageType:TIPImageTypeWEBP usingBlock:^id<TIPImageCodec> _Nonnull(id<TIPImageCodec>  _Nullable existingCodec) {
-        return [[TIPXWebPCodec alloc] initWithPreferredCodec:nil];//existingCodec];
+        return [[TIPXWebPCodec alloc] initWithPreferredCodec:nil];
+    }];
+    // TIPXJXLCodec needs libjxl, which is not vendored: add both to this target to compare JPEG XL
+    // progressive loading (otherwise ImageIO decodes JPEG XL on iOS 17+, without progressive loading)
+    Class jxlCodecClass = NSClassFromString(@"TIPXJXLCodec");
+    if (jxlCodecClass) {
+        [[TIPImageCodecCatalogue sharedInstance] setCodec:[[jxlCodecClass alloc] init] forImageType:TIPImageTypeJXL];
+    }
+    // The same goes for the libjpeg-turbo, libpng and giflib codecs, which replace ImageIO for their
+    // image types when they (and their libraries) are added to this target
+    NSDictionary<NSString *, NSString *> *portableCodecClassNames = @{
+        TIPImageTypeJPEG : @"TIPXJPEGTurboCodec",
+        TIPImageTypePNG : @"TIPXPNGCodec",
+        TIPImageTypeGIF : @"TIPXGIFCodec",
+    };
+    [portableCodecClassNames enumerateKeysAndObjectsUsingBlock:^(NSString *imageType, NSString *className, BOOL *stop) {
+        Class codecClass = NSClassFromString(className);
+        if (!codecClass) {
+            return;
+        }
+        // keep the replaced ImageIO codec for what the portable codec can't handle (such as CMYK JPEGs)
+        [[TIPImageCodecCatalogue sharedInstance] replaceCodecForImageType:imageType usingBlock:^id<TIPImageCodec>(id<TIPImageCodec> existingCodec) {
+            if ([codecClass instancesRespondToSelector:@selector(initWithPreferredCodec:)]) {
+                return [(id)[codecClass alloc] initWithPreferredCodec:existingCodec];
+            }
+            return [[codecClass alloc] init];
+        }];
     }];
     return YES;
 }
@@ -19,24 +19,33 @@ typedef struct {
     const char *file; // provide a URL to load from the inet instead of simulating the load
     BOOL isProgressive;
     BOOL isAnimated;
+    const char *transcodeFile; // bundled file to transcode to the type when there's no bundled file of the type
 } ImageTypeStruct;
 
 static const ImageTypeStruct sImageTypes[] = {
-    { @"public.jpeg",           "JPEG",         "twitterfied.jpg",          NO,     NO  },
-    { @"public.jpeg",           "PJPEG",        "twitterfied.pjpg",         YES,    NO  },
-    { @"public.jpeg-2000",      "JPEG-2000",    "twitterfied.jp2",          NO,     NO  },
-    { @"public.png",            "PNG",          "twitterfied.png",          NO,     NO  },
-    { @"public.tiff",           "TIFF",         "twitterfied.tiff",         NO,     NO  },
-    { @"com.compuserve.gif",    "GIF",          "fireworks_original.gif",   NO,     YES },
-    { @"org.webmproject.webp",  "WEBP",         "twitterfied.webp",         NO,     NO  },
-    //{ @"org.webmproject.webp",  "Ani-WEBP",     "fireworks_original.webp",  NO,     YES },
-    { @"org.webmproject.webp",  "Ani-WEBP",     "tenor_test.webp",          NO,     YES },
-    // { @"com.compuserve.gif",    "Static GIF",   "https://media3.giphy.com/media/d3F2Dj8zECyDLFpm/v1.Y2lkPWU4MjZjOWZjOGViZWNhZmJmMjk0NDIyZGQzZjM2ZjhkMzhlNGRhZTk5OTYzZjliMQ/200_s.gif",               NO,     NO  },
-    { @"public.heic",           "HEIC",         "twitterfied.heic",         NO,     NO  },
-    // { @"public.heic",           "Ani-HEIC",     "starfield_animation.heic", NO,     YES },
-    { @"public.jpeg",           "Small-PJPEG",  "twitterfied.small.pjpg",   YES,    NO  },
+    { @"public.jpeg",           "JPEG",         "twitterfied.jpg",          NO,     NO,     NULL },
+    { @"public.jpeg",           "PJPEG",        "twitterfied.pjpg",         YES,    NO,     NULL },
+    { @"public.jpeg-2000",      "JPEG-2000",    "twitterfied.jp2",          NO,     NO,     NULL },
+    { @"public.png",            "PNG",          "twitterfied.png",          NO,     NO,     NULL },
+    { @"public.tiff",           "TIFF",         "twitterfied.tiff",         NO,     NO,     NULL },
+    { @"com.compuserve.gif",    "GIF",          "fireworks_original.gif",   NO,     YES,    NULL },
+    { @"org.webmproject.webp",  "WEBP",         "twitterfied.webp",         NO,     NO,     NULL },
+    //{ @"org.webmproject.webp",  "Ani-WEBP",     "fireworks_original.webp",  NO,     YES,    NULL },
+    { @"org.webmproject.webp",  "Ani-WEBP",     "tenor_test.webp",          NO,     YES,    NULL },
+    // { @"com.compuserve.gif",    "Static GIF",   "https://media3.giphy.com/media/d3F2Dj8zECyDLFpm/v1.Y2lkPWU4MjZjOWZjOGViZWNhZmJmMjk0NDIyZGQzZjM2ZjhkMzhlNGRhZTk5OTYzZjliMQ/200_s.gif",               NO,     NO,     NULL },
+    { @"public.heic",           "HEIC",         "twitterfied.heic",         NO,     NO,     NULL },
+    // { @"public.heic",           "Ani-HEIC",     "starfield_animation.heic", NO,     YES,    NULL },
+    { @"public.jpeg",           "Small-PJPEG",  "twitterfied.small.pjpg",   YES,    NO,     NULL },
+    { @"public.jpeg-xl",        "JXL",          "twitterfied.jxl",          NO,     NO,     "twitterfied.png" },
+    { @"public.jpeg-xl",        "PJXL",         "twitterfied.p.jxl",        YES,    NO,     "twitterfied.png" },
 };
 
+// the results of the image types to compare each image type with (at the same speed)
+static const char * const sComparisonImageTypeNames[] = { "JPEG", "PJPEG", "WEBP" };
+
+// quality to transcode with, comparable to the bundled lossy files
+static const float kTranscodeQuality = 0.8f;
+
 static const NSUInteger kBitrateDribble = 4 * 1000;
 static const NSUInteger kBitrate80sModem = 16 * 1000;
 static const NSUInteger kBitrateBad2G = 56 * 1000;
@@ -82,6 +91,7 @@ static const NSUInteger kDefaultBitrateIndex = 5;
     CFAbsoluteTime _firstImageTime;
     CFAbsoluteTime _finalImageTime;
     NSUInteger _size;
+    NSMutableDictionary<NSString *, NSArray<NSNumber *> *> *_results; // "name@bitrate" -> [first scan duration, size]
 
     CGSize _cachedBounds;
     UIViewContentMode _cachedContentMode;
@@ -92,6 +102,8 @@ static const NSUInteger kDefaultBitrateIndex = 5;
     [super viewDidLoad];
 
     _progressView.progress = 0;
+    _resultsLabel.numberOfLines = 0;
+    _results = [[NSMutableDictionary alloc] init];
 
     _imageTypeIndex = 0;
     _speedIndex = kDefaultBitrateIndex;
@@ -139,6 +151,7 @@ static const NSUInteger kDefaultBitrateIndex = 5;
 
     frame = _resultsLabel.frame;
     frame.origin.y = CGRectGetMaxY(_startButton.frame) + 5 ;
+    frame.size.height = [_resultsLabel sizeThatFits:CGSizeMake(frame.size.width, CGFLOAT_MAX)].height;
     _resultsLabel.frame = frame;
 
     [super viewDidLayoutSubviews];
@@ -205,8 +218,30 @@ static const NSUInteger kDefaultBitrateIndex = 5;
             totalSize = [NSByteCountFormatter stringFromByteCount:(long long)_size countStyle:NSByteCountFormatterCountStyleBinary];
         }
 
-        _resultsLabel.text = [NSString stringWithFormat:@"First Scan: %@\nFinal Scan: %@\nFinal Size: %@", firstResult, finalResult, totalSize];
+        NSMutableString *text = [NSMutableString stringWithFormat:@"First Scan: %@\nFinal Scan: %@\nFinal Size: %@", firstResult, finalResult, totalSize];
+        NSArray<NSNumber *> *result = _results[[self resultKeyForImageTypeName:sImageTypes[_imageTypeIndex].name]];
+        if (result && 0 != _finalImageTime) {
+            // time to first preview and bandwidth relative to the comparable image types
+            for (size_t i = 0; i < sizeof(sComparisonImageTypeNames) / sizeof(sComparisonImageTypeNames[0]); i++) {
+                const char *name = sComparisonImageTypeNames[i];
+                NSArray<NSNumber *> *comparisonResult = _results[[self resultKeyForImageTypeName:name]];
+                if (!comparisonResult || 0 == strcmp(name, sImageTypes[_imageTypeIndex].name)) {
+                    continue;
+                }
+                [text appendFormat:@"\nvs %s: First %+.0f%%, Size %+.0f%%",
+                                   name,
+                                   100.0 * (result[0].doubleValue / comparisonResult[0].doubleValue - 1.0),
+                                   100.0 * (result[1].doubleValue / comparisonResult[1].doubleValue - 1.0)];
+            }
+        }
+        _resultsLabel.text = text;
     }
+    [self.view setNeedsLayout];
+}
+
+- (NSString *)resultKeyForImageTypeName:(const char *)name
+{
+    return [NSString stringWithFormat:@"%s@%tu", name, sBitrates[_speedIndex]];
 }
 
 - (void)updateImageTypeButtonTitle
@@ -231,10 +266,39 @@ static const NSUInteger kDefaultBitrateIndex = 5;
         NSData *imageData = [NSData dataWithContentsOfURL:cannedImageURL
                                                   options:NSDataReadingMappedIfSafe
                                                     error:NULL];
+        if (sImageTypes[_imageTypeIndex].transcodeFile) {
+            imageData = [self transcodeImageData:imageData];
+            if (!imageData) {
+                NSLog(@"Cannot transcode to %@, is a codec with an encoder registered for it?", sImageTypes[_imageTypeIndex].type);
+                return;
+            }
+        }
         [_downloadProvider addDownloadStubForRequestURL:imageURL responseData:imageData responseMIMEType:nil shouldSupportResuming:NO suggestedBitrate:sBitrates[_speedIndex]];
     }
 }
 
+- (NSData *)transcodeImageData:(NSData *)imageData
+{
+    if (!imageData) {
+        return nil;
+    }
+
+    TIPImageCodecCatalogue *catalogue = [TIPImageCodecCatalogue sharedInstance];
+    TIPImageContainer *imageContainer = [catalogue decodeImageWithData:imageData
+                                                      targetDimensions:CGSizeZero
+                                                     targetContentMode:UIViewContentModeCenter
+                                                      decoderConfigMap:nil
+                                                             imageType:NULL];
+    if (!imageContainer) {
+        return nil;
+    }
+    return [catalogue encodeImage:imageContainer
+                    withImageType:sImageTypes[_imageTypeIndex].type
+                          quality:kTranscodeQuality
+                          options:(sImageTypes[_imageTypeIndex].isProgressive) ? TIPImageEncodingProgressive : TIPImageEncodingNoOptions
+                            error:NULL];
+}
+
 - (void)unregisterCannedImage
 {
     NSURL *imageURL = self.imageURL;
@@ -420,12 +484,15 @@ static const NSUInteger kDefaultBitrateIndex = 5;
 
 - (NSDictionary *)progressiveLoadingPolicies
 {
-    return @{ TIPImageTypeWEBP : [[TIPFullFrameProgressiveLoadingPolicy alloc] init] };
+    return @{
+             TIPImageTypeWEBP : [[TIPFullFrameProgressiveLoadingPolicy alloc] init],
+             TIPImageTypeJXL : [[TIPFullFrameProgressiveLoadingPolicy alloc] init]
+             };
 }
 
 - (NSURL *)cannedImageFileURL
 {
-    NSString *file = @(sImageTypes[_imageTypeIndex].file);
+    NSString *file = @(sImageTypes[_imageTypeIndex].transcodeFile ?: sImageTypes[_imageTypeIndex].file);
     if ([file hasPrefix:@"http"]) {
         return [NSURL URLWithString:file];
     }
@@ -489,6 +556,7 @@ shouldLoadProgressivelyWithIdentifier:(NSString *)identifier
     }
     _size = [op.metrics metricInfoForSource:finalResult.imageSource].networkImageSizeInBytes;
     _finalImageTime = CFAbsoluteTimeGetCurrent();
+    _results[[self resultKeyForImageTypeName:sImageTypes[_imageTypeIndex].name]] = @[ @(_firstImageTime - _startTime), @(_size) ];
     _imageView.image = finalResult.imageContainer.image;
     [_progressView setProgress:1.f animated:YES];
     _progressView.progressTintColor = [UIColor greenColor];
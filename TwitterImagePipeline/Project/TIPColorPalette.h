@@ -0,0 +1,46 @@
+//
+//  TIPColorPalette.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+//! Max number of colors `TIPCollectColorPalette` can collect
+#define TIPColorPaletteMaxColorCount (256)
+
+/**
+ Collect the distinct colors of a bitmap of 8-bit premultiplied RGBA pixels
+ (`kCGImageAlphaPremultipliedLast`), bailing out as soon as there are more than _maxColorCount_.
+
+ Large bitmaps are split into bands of rows that are counted concurrently, each band into an open
+ addressing hash table small enough to stay in L1, and the bands are merged once they are all
+ counted.  Runs of pixels identical to the previous pixel are skipped without being hashed (several
+ pixels at a time with NEON/SSE2).  Fully transparent pixels all count as the same color (`0`).
+
+ @param pixels the bitmap
+ @param width the width of the bitmap in pixels
+ @param height the height of the bitmap in pixels
+ @param bytesPerRow the bytes per row of the bitmap
+ @param maxColorCount the max number of colors, at most `TIPColorPaletteMaxColorCount`
+ @param supportsTransparency whether pixels that are not fully opaque are permitted
+ @param supportsAnyAlpha whether partially transparent pixels are permitted (requires _supportsTransparency_)
+ @param palette optional buffer of at least _maxColorCount_ entries to populate with the colors (in no particular order)
+ @param colorCountOut optional count of the colors populated in _palette_
+ @return `YES` if the bitmap has at most _maxColorCount_ colors and meets the transparency requirements
+ */
+FOUNDATION_EXTERN BOOL TIPCollectColorPalette(const void *pixels,
+                                              size_t width,
+                                              size_t height,
+                                              size_t bytesPerRow,
+                                              NSUInteger maxColorCount,
+                                              BOOL supportsTransparency,
+                                              BOOL supportsAnyAlpha,
+                                              uint32_t * __nullable palette,
+                                              NSUInteger * __nullable colorCountOut);
+
+NS_ASSUME_NONNULL_END
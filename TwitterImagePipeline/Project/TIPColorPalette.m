@@ -0,0 +1,238 @@
+//
+//  TIPColorPalette.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#include <stdatomic.h>
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#import <arm_neon.h>
+#elif defined(__SSE2__)
+#import <emmintrin.h>
+#endif
+
+#import "TIP_Project.h"
+#import "TIPColorPalette.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Slots of each hash table, twice the max colors keeps probes short and the table at 2KB
+#define kColorSetHashBits (9)
+#define kColorSetSlotCount (1 << kColorSetHashBits)
+TIPStaticAssert(kColorSetSlotCount == TIPColorPaletteMaxColorCount * 2, MISMATCH_COLOR_SET_SLOT_COUNT);
+// Bitmaps with fewer pixels than this are counted on the calling thread
+static const size_t kConcurrentPixelCountMinimum = 512 * 512;
+// Bands have at least this many rows
+static const size_t kBandRowCountMinimum = 64;
+
+typedef struct {
+    uint32_t slots[kColorSetSlotCount]; // 0 == empty slot
+    NSUInteger count;
+    BOOL hasTransparent; // fully transparent is 0 so is tracked outside of the slots
+} TIPColorSet;
+
+union tip_rgba_pixel {
+    uint32_t value;
+    struct {
+        Byte r, g, b, a;
+    } components;
+};
+
+static BOOL _ColorSetInsert(TIPColorSet *set, uint32_t color, NSUInteger maxColorCount);
+static BOOL _ScanRows(const Byte *pixels,
+                      size_t width,
+                      size_t firstRow,
+                      size_t endRow,
+                      size_t bytesPerRow,
+                      NSUInteger maxColorCount,
+                      BOOL supportsTransparency,
+                      BOOL supportsAnyAlpha,
+                      TIPColorSet *set,
+                      volatile atomic_bool *failed);
+
+BOOL TIPCollectColorPalette(const void *pixels,
+                            size_t width,
+                            size_t height,
+                            size_t bytesPerRow,
+                            NSUInteger maxColorCount,
+                            BOOL supportsTransparency,
+                            BOOL supportsAnyAlpha,
+                            uint32_t * __nullable palette,
+                            NSUInteger * __nullable colorCountOut)
+{
+    TIPAssert(maxColorCount <= TIPColorPaletteMaxColorCount);
+    maxColorCount = MIN(maxColorCount, (NSUInteger)TIPColorPaletteMaxColorCount);
+    if (colorCountOut) {
+        *colorCountOut = 0;
+    }
+
+    size_t bandCount = 1;
+    if (width * height >= kConcurrentPixelCountMinimum) {
+        bandCount = MIN([NSProcessInfo processInfo].activeProcessorCount, MAX((size_t)1, height / kBandRowCountMinimum));
+    }
+    const size_t rowsPerBand = (height + bandCount - 1) / bandCount;
+
+    // one more set for the union of the bands
+    TIPColorSet *sets = calloc(bandCount + 1, sizeof(TIPColorSet));
+    tip_defer(^{
+        free(sets);
+    });
+
+    volatile atomic_bool failed = false;
+    volatile atomic_bool *failedPtr = &failed;
+    if (bandCount > 1) {
+        dispatch_apply(bandCount, DISPATCH_APPLY_AUTO, ^(size_t band) {
+            const size_t firstRow = band * rowsPerBand;
+            const size_t endRow = MIN(height, firstRow + rowsPerBand);
+            if (!_ScanRows(pixels, width, firstRow, endRow, bytesPerRow, maxColorCount, supportsTransparency, supportsAnyAlpha, &sets[band], failedPtr)) {
+                atomic_store(failedPtr, true);
+            }
+        });
+    } else if (!_ScanRows(pixels, width, 0, height, bytesPerRow, maxColorCount, supportsTransparency, supportsAnyAlpha, &sets[0], failedPtr)) {
+        atomic_store(failedPtr, true);
+    }
+    if (atomic_load(failedPtr)) {
+        return NO;
+    }
+
+    TIPColorSet *unionSet = &sets[0];
+    if (bandCount > 1) {
+        unionSet = &sets[bandCount];
+        for (size_t band = 0; band < bandCount; band++) {
+            const TIPColorSet *set = &sets[band];
+            if (set->hasTransparent && !_ColorSetInsert(unionSet, 0, maxColorCount)) {
+                return NO;
+            }
+            for (size_t slot = 0; slot < kColorSetSlotCount; slot++) {
+                if (set->slots[slot] && !_ColorSetInsert(unionSet, set->slots[slot], maxColorCount)) {
+                    return NO;
+                }
+            }
+        }
+    }
+
+    if (palette) {
+        NSUInteger count = 0;
+        if (unionSet->hasTransparent) {
+            palette[count++] = 0;
+        }
+        for (size_t slot = 0; slot < kColorSetSlotCount; slot++) {
+            if (unionSet->slots[slot]) {
+                palette[count++] = unionSet->slots[slot];
+            }
+        }
+        TIPAssert(count == unionSet->count);
+    }
+    if (colorCountOut) {
+        *colorCountOut = unionSet->count;
+    }
+    return YES;
+}
+
+static BOOL _ColorSetInsert(TIPColorSet *set, uint32_t color, NSUInteger maxColorCount)
+{
+    if (!color) {
+        if (!set->hasTransparent) {
+            if (set->count >= maxColorCount) {
+                return NO;
+            }
+            set->hasTransparent = YES;
+            set->count++;
+        }
+        return YES;
+    }
+
+    // Fibonacci hashing spreads nearby colors across the table, linear probing keeps probes in cache
+    size_t slot = (size_t)((color * 2654435769u) >> (32 - kColorSetHashBits));
+    while (set->slots[slot]) {
+        if (set->slots[slot] == color) {
+            return YES;
+        }
+        slot = (slot + 1) & (kColorSetSlotCount - 1);
+    }
+
+    if (set->count >= maxColorCount) {
+        // too many colors!  cannot index this image
+        return NO;
+    }
+    set->slots[slot] = color;
+    set->count++;
+    return YES;
+}
+
+static BOOL _ScanRows(const Byte *pixels,
+                      size_t width,
+                      size_t firstRow,
+                      size_t endRow,
+                      size_t bytesPerRow,
+                      NSUInteger maxColorCount,
+                      BOOL supportsTransparency,
+                      BOOL supportsAnyAlpha,
+                      TIPColorSet *set,
+                      volatile atomic_bool *failed)
+{
+    for (size_t row = firstRow; row < endRow; row++) {
+        if (atomic_load_explicit(failed, memory_order_relaxed)) {
+            // another band already failed
+            return NO;
+        }
+
+        const uint32_t *rowPixels = (const uint32_t *)(pixels + (row * bytesPerRow));
+        union tip_rgba_pixel previous = { .value = 0 };
+        BOOL hasPrevious = NO;
+        size_t x = 0;
+        while (x < width) {
+            if (hasPrevious) {
+                // skip a run of the previous pixel without hashing, it was already counted
+#if defined(__ARM_NEON) && defined(__aarch64__)
+                const uint32x4_t previousVector = vdupq_n_u32(previous.value);
+                while (x + 4 <= width && vminvq_u32(vceqq_u32(vld1q_u32(rowPixels + x), previousVector)) == UINT32_MAX) {
+                    x += 4;
+                }
+#elif defined(__SSE2__)
+                const __m128i previousVector = _mm_set1_epi32((int)previous.value);
+                while (x + 4 <= width && _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(rowPixels + x)), previousVector)) == 0xFFFF) {
+                    x += 4;
+                }
+#endif
+                while (x < width && rowPixels[x] == previous.value) {
+                    x++;
+                }
+                if (x >= width) {
+                    break;
+                }
+            }
+
+            union tip_rgba_pixel pixel = { .value = rowPixels[x] };
+            previous = pixel;
+            hasPrevious = YES;
+            x++;
+
+            if (pixel.components.a != 0xFF) {
+                // has transparency
+                if (!supportsTransparency) {
+                    return NO;
+                }
+
+                if (pixel.components.a == 0x00) {
+                    // coerse fully transparent pixels to all match
+                    // NOTE: not all transcoders will coerse fully transparent pixels to the same value!
+                    pixel.value = 0;
+                } else if (!supportsAnyAlpha) {
+                    // partial alpha (a != 0x00 and a != 0xff)
+                    return NO;
+                }
+            }
+
+            if (!_ColorSetInsert(set, pixel.value, maxColorCount)) {
+                return NO;
+            }
+        }
+    }
+
+    return YES;
+}
+
+NS_ASSUME_NONNULL_END
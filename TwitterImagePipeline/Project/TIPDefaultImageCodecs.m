@@ -9,6 +9,7 @@
 #import <CoreImage/CoreImage.h>
 #import <ImageIO/ImageIO.h>
 #import <MobileCoreServices/MobileCoreServices.h>
+#import <zlib.h>
 
 #import "NSData+TIPAdditions.h"
 #import "TIP_Project.h"
@@ -23,6 +24,41 @@ NS_ASSUME_NONNULL_BEGIN
 #define kJPEG_MARKER_SPECIAL_BYTE   (0xFF)
 #define kJPEG_MARKER_START_FRAME    (0xDA)
 
+#define kPNG_SIGNATURE_LENGTH       (8)
+#define kPNG_CHUNK_HEADER_LENGTH    (8)
+#define kPNG_CHUNK_CRC_LENGTH       (4)
+#define kPNG_CHUNK_TYPE_PLTE        (0x504C5445)
+#define kPNG_CHUNK_TYPE_TRNS        (0x74524E53)
+#define kPNG_CHUNK_TYPE_IDAT        (0x49444154)
+#define kPNG_CHUNK_TYPE_IEND        (0x49454E44)
+
+// The 7th (last) Adam7 pass fills in the odd rows and is left to ImageIO
+#define kPNG_ADAM7_PREVIEW_PASS_COUNT   (6)
+
+typedef struct _TIPPNGInfo {
+    uint32_t width;
+    uint32_t height;
+    uint8_t bitDepth;
+    uint8_t colorType;
+    uint8_t interlaceMethod;
+    BOOL hasTransparency;
+    uint16_t transparentSamples[3];
+    uint8_t palette[256][4]; // RGBA
+} TIPPNGInfo;
+
+// channel count per color type (0 for invalid color types)
+static const uint8_t kTIPPNGChannelCounts[7] = { 1, 0, 3, 1, 2, 0, 4 };
+// x offset, y offset, x step, y step of each Adam7 pass
+static const uint8_t kTIPPNGAdam7Passes[7][4] = { {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2} };
+
+static BOOL TIPPNGReadInfo(const uint8_t *bytes, NSUInteger length, TIPPNGInfo *info);
+static void TIPPNGReadPalette(const uint8_t *bytes, uint32_t length, TIPPNGInfo *info);
+static void TIPPNGReadTransparency(const uint8_t *bytes, uint32_t length, TIPPNGInfo *info);
+static size_t TIPPNGBitsPerPixel(const TIPPNGInfo *info);
+static size_t TIPPNGAdam7PassByteCount(const TIPPNGInfo *info, NSUInteger pass, size_t * __nullable rowCountOut, size_t * __nullable columnCountOut);
+static BOOL TIPPNGUnfilterRows(uint8_t *rows, size_t rowCount, size_t rowByteCount, size_t filterByteCount);
+static void TIPPNGConvertRow(const TIPPNGInfo *info, const uint8_t *row, size_t pixelCount, uint8_t *pixels, size_t pixelStride);
+
 @interface TIPCGImageSourceDecoderCacheItem : NSObject
 {
 @public
@@ -80,9 +116,15 @@ NS_ASSUME_NONNULL_BEGIN
 @interface TIPJPEGCGImageSourceDecoderContext : TIPCGImageSourceDecoderContext
 @end
 
+@interface TIPPNGCGImageSourceDecoderContext : TIPCGImageSourceDecoderContext
+@end
+
 @interface TIPAnimatedCGImageSourceDecoder : TIPBasicCGImageSourceDecoder
 @end
 
+@interface TIPPNGCGImageSourceDecoder : TIPAnimatedCGImageSourceDecoder
+@end
+
 @interface TIPBasicCGImageSourceDecoder ()
 @property (nonatomic, readonly, copy) NSString *UTType;
 - (instancetype)initWithUTType:(NSString *)UTType;
@@ -107,8 +149,15 @@ NS_ASSUME_NONNULL_BEGIN
         encoder = [[TIPBasicCGImageSourceEncoder alloc] initWithUTType:(NSString *)kUTTypeJPEG];
         TIPAssert(TIPImageTypeCanReadWithImageIO(imageType));
         TIPAssert(TIPImageTypeCanWriteWithImageIO(imageType));
-    } else if ([imageType isEqualToString:TIPImageTypeGIF] || [imageType isEqualToString:TIPImageTypePNG]) {
-        // GIF & APNG can be animated
+    } else if ([imageType isEqualToString:TIPImageTypePNG]) {
+        // PNG has a special decoder (APNG can be animated, Adam7 interlaced PNG is progressive)
+        decoder = [[TIPPNGCGImageSourceDecoder alloc] init];
+        encoder = [[TIPBasicCGImageSourceEncoder alloc] initWithUTType:(NSString *)kUTTypePNG];
+        animated = YES;
+        TIPAssert(TIPImageTypeCanReadWithImageIO(imageType));
+        TIPAssert(TIPImageTypeCanWriteWithImageIO(imageType));
+    } else if ([imageType isEqualToString:TIPImageTypeGIF]) {
+        // GIF can be animated
         NSString *UTType = TIPImageTypeToUTType(imageType);
         decoder = [[TIPAnimatedCGImageSourceDecoder alloc] initWithUTType:UTType];
         encoder = [[TIPBasicCGImageSourceEncoder alloc] initWithUTType:UTType];
@@ -184,6 +233,8 @@ NS_ASSUME_NONNULL_BEGIN
                 // it's a crapshoot when the encoder/decoder are present or not
             } else if ([imageType isEqualToString:TIPImageTypeJPEG2000]) {
                 // Apple deprecated JPEG 2000 support so we'll defer to the system on if the codecs are present or not
+            } else if ([imageType isEqualToString:TIPImageTypeJXL]) {
+                // ImageIO decodes JPEG XL on iOS 17+, we'll defer to the system on if the codecs are present or not
             }
         }
     }
@@ -337,6 +388,30 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+@implementation TIPPNGCGImageSourceDecoder
+
+- (instancetype)init
+{
+    return [self initWithUTType:(NSString *)kUTTypePNG];
+}
+
+- (id<TIPImageDecoderContext>)tip_initiateDecoding:(nullable id __unused)config
+                                expectedDataLength:(NSUInteger)expectedDataLength
+                                            buffer:(nullable NSMutableData *)buffer
+{
+    return [[TIPPNGCGImageSourceDecoderContext alloc] initWithUTType:self.UTType
+                                                  expectedDataLength:expectedDataLength
+                                                              buffer:buffer
+                                                 potentiallyAnimated:YES];
+}
+
+- (BOOL)tip_supportsProgressiveDecoding
+{
+    return YES;
+}
+
+@end
+
 @implementation TIPBasicCGImageSourceEncoder
 
 - (instancetype)initWithUTType:(NSString *)UTType
@@ -1047,4 +1122,496 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+@implementation TIPPNGCGImageSourceDecoderContext
+{
+    TIPPNGInfo _info;
+    z_stream _zStream;
+    NSUInteger _chunkOffset;
+    uint32_t _chunkDataConsumedCount;
+    NSUInteger _passIndex;
+    NSUInteger _previewPassCount;
+    NSMutableData *_passData;
+    size_t _passDataFilledCount;
+    NSMutableData *_canvas; // premultiplied RGBA of the even rows
+
+    TIPImageContainer *_previewImageContainer;
+    NSUInteger _previewImageContainerPassCount;
+    CGSize _previewImageContainerDimensions;
+
+    struct {
+        BOOL didInitializeZStream:1;
+        BOOL didFinishReadingPasses:1;
+        BOOL didComplete:1;
+    } _pngFlags;
+}
+
+- (void)dealloc
+{
+    if (_pngFlags.didInitializeZStream) {
+        inflateEnd(&_zStream);
+    }
+}
+
+- (BOOL)readContextualHeaders
+{
+    // Only static Adam7 interlaced PNGs are progressive,
+    // the passes are tracked by inflating the IDAT chunks as they arrive
+
+    if (self.tip_isAnimated || !TIPPNGReadInfo(_data.bytes, _data.length, &_info) || _info.interlaceMethod != 1) {
+        return YES;
+    }
+
+    const uint64_t canvasByteCount = (uint64_t)_info.width * (uint64_t)((_info.height + 1) / 2) * 4;
+    if (canvasByteCount > (uint64_t)NSIntegerMax) {
+        return YES;
+    }
+
+    if (inflateInit(&_zStream) != Z_OK) {
+        return YES;
+    }
+
+    _pngFlags.didInitializeZStream = 1;
+    _chunkOffset = kPNG_SIGNATURE_LENGTH;
+    _passIndex = 0;
+    [self _tip_preparePass];
+    _progressive = YES;
+    return YES;
+}
+
+- (BOOL)readMore:(BOOL)complete
+{
+    if (!_progressive) {
+        return [super readMore:complete];
+    }
+
+    const NSUInteger oldFrameCount = _frameCount;
+
+    if (!_pngFlags.didFinishReadingPasses) {
+        [self _tip_readChunks];
+    }
+
+    _lastByteReadIndex = _data.length - 1;
+    _lastSafeByteIndex = _lastByteReadIndex;
+    if (oldFrameCount != _frameCount) {
+        _lastFrameEndIndex = _lastByteReadIndex;
+    }
+
+    if (complete) {
+        [self _tip_finishReadingPasses];
+        _pngFlags.didComplete = 1;
+        _canvas = nil;
+        _previewImageContainer = nil;
+        _frameCount++;
+    }
+
+    return oldFrameCount != _frameCount;
+}
+
+- (nullable TIPImageContainer *)renderImage:(TIPImageDecoderRenderMode)mode
+                           targetDimensions:(CGSize)targetDimensions
+                          targetContentMode:(UIViewContentMode)targetContentMode
+{
+    if (_progressive && !_pngFlags.didComplete && mode != TIPImageDecoderRenderModeCompleteImage) {
+        return [self _tip_renderPreviewWithTargetDimensions:targetDimensions
+                                          targetContentMode:targetContentMode];
+    }
+
+    return [super renderImage:mode
+             targetDimensions:targetDimensions
+            targetContentMode:targetContentMode];
+}
+
+#pragma mark Private
+
+- (nullable TIPImageContainer *)_tip_renderPreviewWithTargetDimensions:(CGSize)targetDimensions
+                                                     targetContentMode:(UIViewContentMode)targetContentMode TIP_OBJC_DIRECT
+{
+    if (!_previewPassCount) {
+        return nil;
+    }
+
+    const CGSize dimensions = CGSizeMake(_info.width, _info.height);
+    const CGSize scaledDimensions = TIPDimensionsScaledToTargetSizing(dimensions,
+                                                                      targetDimensions,
+                                                                      targetContentMode);
+    if (_previewImageContainer && _previewImageContainerPassCount == _previewPassCount && CGSizeEqualToSize(_previewImageContainerDimensions, scaledDimensions)) {
+        return _previewImageContainer;
+    }
+
+    // the canvas only holds the even rows, premultiplied
+    const BOOL hasAlpha = _info.hasTransparency || 4 == _info.colorType || 6 == _info.colorType;
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    TIPDeferRelease(colorSpace);
+    CGImageRef previewImageRef = TIPCreateAdam7PreviewImage(_canvas.bytes,
+                                                            _info.width,
+                                                            _info.height,
+                                                            (size_t)_info.width * 4,
+                                                            YES /* evenRowsOnly */,
+                                                            _previewPassCount,
+                                                            colorSpace,
+                                                            (CGBitmapInfo)((hasAlpha) ? kCGImageAlphaPremultipliedLast : kCGImageAlphaNoneSkipLast));
+    TIPDeferRelease(previewImageRef);
+    if (!previewImageRef) {
+        return nil;
+    }
+
+    // The preview has 1 pixel per block of pixels that the passes have filled in so far,
+    // scale it up to the dimensions of the image
+    UIImage *image = [UIImage imageWithCGImage:previewImageRef];
+    image = [image tip_scaledImageWithTargetDimensions:scaledDimensions
+                                           contentMode:UIViewContentModeScaleToFill];
+    _previewImageContainer = [[TIPImageContainer alloc] initWithImage:image];
+    _previewImageContainerPassCount = _previewPassCount;
+    _previewImageContainerDimensions = scaledDimensions;
+    return _previewImageContainer;
+}
+
+- (void)_tip_readChunks TIP_OBJC_DIRECT
+{
+    const uint8_t *bytes = _data.bytes;
+    const NSUInteger length = _data.length;
+
+    while (!_pngFlags.didFinishReadingPasses && _chunkOffset + kPNG_CHUNK_HEADER_LENGTH <= length) {
+        const uint8_t *header = bytes + _chunkOffset;
+        const uint32_t chunkLength = ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) | ((uint32_t)header[2] << 8) | (uint32_t)header[3];
+        const uint32_t chunkType = ((uint32_t)header[4] << 24) | ((uint32_t)header[5] << 16) | ((uint32_t)header[6] << 8) | (uint32_t)header[7];
+        const NSUInteger chunkDataOffset = _chunkOffset + kPNG_CHUNK_HEADER_LENGTH;
+        const NSUInteger availableLength = length - chunkDataOffset;
+
+        if (chunkLength > INT32_MAX || kPNG_CHUNK_TYPE_IEND == chunkType) {
+            // corrupt or out of image data
+            [self _tip_finishReadingPasses];
+            break;
+        }
+
+        if (kPNG_CHUNK_TYPE_IDAT == chunkType) {
+            // inflate the image data as it arrives (no need to wait for the whole chunk)
+            const uint32_t newlyAvailableLength = (uint32_t)MIN((NSUInteger)chunkLength, availableLength) - _chunkDataConsumedCount;
+            [self _tip_inflate:bytes + chunkDataOffset + _chunkDataConsumedCount length:newlyAvailableLength];
+            _chunkDataConsumedCount += newlyAvailableLength;
+            if (_chunkDataConsumedCount < chunkLength) {
+                break;
+            }
+        } else if (kPNG_CHUNK_TYPE_PLTE == chunkType || kPNG_CHUNK_TYPE_TRNS == chunkType) {
+            if (availableLength < chunkLength) {
+                break;
+            }
+            if (kPNG_CHUNK_TYPE_PLTE == chunkType) {
+                TIPPNGReadPalette(bytes + chunkDataOffset, chunkLength, &_info);
+            } else {
+                TIPPNGReadTransparency(bytes + chunkDataOffset, chunkLength, &_info);
+            }
+        }
+
+        _chunkOffset = chunkDataOffset + chunkLength + kPNG_CHUNK_CRC_LENGTH;
+        _chunkDataConsumedCount = 0;
+    }
+}
+
+- (void)_tip_inflate:(const uint8_t *)bytes
+              length:(uint32_t)length TIP_OBJC_DIRECT
+{
+    _zStream.next_in = (Bytef *)bytes;
+    _zStream.avail_in = length;
+
+    while (!_pngFlags.didFinishReadingPasses) {
+        const size_t passByteCount = _passData.length;
+        if (_passDataFilledCount == passByteCount) {
+            [self _tip_completePass];
+            continue;
+        }
+        if (!_zStream.avail_in) {
+            break;
+        }
+
+        _zStream.next_out = (Bytef *)_passData.mutableBytes + _passDataFilledCount;
+        _zStream.avail_out = (uInt)MIN(passByteCount - _passDataFilledCount, (size_t)UINT32_MAX);
+        const int status = inflate(&_zStream, Z_NO_FLUSH);
+        _passDataFilledCount = (size_t)((const uint8_t *)_zStream.next_out - (const uint8_t *)_passData.bytes);
+
+        if (Z_STREAM_END == status) {
+            if (_passDataFilledCount < passByteCount) {
+                // the image data ended before the pass did
+                [self _tip_finishReadingPasses];
+            }
+        } else if (status != Z_OK) {
+            [self _tip_finishReadingPasses];
+        }
+    }
+}
+
+- (void)_tip_preparePass TIP_OBJC_DIRECT
+{
+    const size_t passByteCount = TIPPNGAdam7PassByteCount(&_info, _passIndex, NULL, NULL);
+    if (!_passData) {
+        _passData = [NSMutableData dataWithLength:passByteCount];
+    } else {
+        _passData.length = passByteCount;
+    }
+    _passDataFilledCount = 0;
+}
+
+- (void)_tip_completePass TIP_OBJC_DIRECT
+{
+    size_t rowCount, columnCount;
+    const size_t passByteCount = TIPPNGAdam7PassByteCount(&_info, _passIndex, &rowCount, &columnCount);
+    if (passByteCount > 0) {
+        const size_t bitsPerPixel = TIPPNGBitsPerPixel(&_info);
+        const size_t rowByteCount = (columnCount * bitsPerPixel + 7) / 8;
+        uint8_t *rows = _passData.mutableBytes;
+        if (!TIPPNGUnfilterRows(rows, rowCount, rowByteCount, MAX((size_t)1, bitsPerPixel / 8))) {
+            [self _tip_finishReadingPasses];
+            return;
+        }
+
+        // Adam7 passes 1 through 6 only have pixels on even rows, which is all the canvas holds.
+        // The canvas is allocated once there is a pass to show, PNGs that complete before their
+        // first pass (or are never rendered progressively) don't pay for it.
+        if (!_canvas) {
+            _canvas = [NSMutableData dataWithLength:(NSUInteger)((size_t)_info.width * (size_t)((_info.height + 1) / 2) * 4)];
+            if (!_canvas) {
+                [self _tip_finishReadingPasses];
+                return;
+            }
+        }
+        const uint8_t *origin = kTIPPNGAdam7Passes[_passIndex];
+        const size_t canvasBytesPerRow = (size_t)_info.width * 4;
+        uint8_t *canvas = _canvas.mutableBytes;
+        for (size_t row = 0; row < rowCount; row++) {
+            const size_t y = origin[1] + (row * origin[3]);
+            TIPPNGConvertRow(&_info,
+                             rows + (row * (rowByteCount + 1)) + 1,
+                             columnCount,
+                             canvas + ((y / 2) * canvasBytesPerRow) + ((size_t)origin[0] * 4),
+                             (size_t)origin[2] * 4);
+        }
+
+        _previewPassCount = _passIndex + 1;
+        _frameCount++;
+    }
+
+    _passIndex++;
+    if (_passIndex == kPNG_ADAM7_PREVIEW_PASS_COUNT) {
+        [self _tip_finishReadingPasses];
+    } else {
+        [self _tip_preparePass];
+    }
+}
+
+- (void)_tip_finishReadingPasses TIP_OBJC_DIRECT
+{
+    if (_pngFlags.didInitializeZStream) {
+        inflateEnd(&_zStream);
+        _pngFlags.didInitializeZStream = 0;
+    }
+    _pngFlags.didFinishReadingPasses = 1;
+    _passData = nil;
+}
+
+@end
+
+#pragma mark - PNG Functions
+
+static BOOL TIPPNGReadInfo(const uint8_t *bytes, NSUInteger length, TIPPNGInfo *info)
+{
+    static const uint8_t sSignature[kPNG_SIGNATURE_LENGTH] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    static const uint8_t sHeaderChunkPrefix[kPNG_CHUNK_HEADER_LENGTH] = { 0, 0, 0, 13, 'I', 'H', 'D', 'R' };
+    if (length < kPNG_SIGNATURE_LENGTH + kPNG_CHUNK_HEADER_LENGTH + 13) {
+        return NO;
+    }
+    if (0 != memcmp(bytes, sSignature, sizeof(sSignature)) || 0 != memcmp(bytes + kPNG_SIGNATURE_LENGTH, sHeaderChunkPrefix, sizeof(sHeaderChunkPrefix))) {
+        return NO;
+    }
+
+    const uint8_t *header = bytes + kPNG_SIGNATURE_LENGTH + kPNG_CHUNK_HEADER_LENGTH;
+    memset(info, 0, sizeof(*info));
+    info->width = ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) | ((uint32_t)header[2] << 8) | (uint32_t)header[3];
+    info->height = ((uint32_t)header[4] << 24) | ((uint32_t)header[5] << 16) | ((uint32_t)header[6] << 8) | (uint32_t)header[7];
+    info->bitDepth = header[8];
+    info->colorType = header[9];
+    info->interlaceMethod = header[12];
+    for (size_t i = 0; i < 256; i++) {
+        info->palette[i][3] = 0xFF;
+    }
+
+    if (!info->width || !info->height || header[10] != 0 /* compression */ || header[11] != 0 /* filter */) {
+        return NO;
+    }
+
+    const uint8_t bitDepth = info->bitDepth;
+    switch (info->colorType) {
+        case 0: // gray
+            return 1 == bitDepth || 2 == bitDepth || 4 == bitDepth || 8 == bitDepth || 16 == bitDepth;
+        case 3: // palette
+            return 1 == bitDepth || 2 == bitDepth || 4 == bitDepth || 8 == bitDepth;
+        case 2: // RGB
+        case 4: // gray + alpha
+        case 6: // RGBA
+            return 8 == bitDepth || 16 == bitDepth;
+        default:
+            return NO;
+    }
+}
+
+static void TIPPNGReadPalette(const uint8_t *bytes, uint32_t length, TIPPNGInfo *info)
+{
+    const size_t count = MIN((size_t)(length / 3), (size_t)256);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(info->palette[i], bytes + (i * 3), 3);
+    }
+}
+
+static void TIPPNGReadTransparency(const uint8_t *bytes, uint32_t length, TIPPNGInfo *info)
+{
+    switch (info->colorType) {
+        case 0:
+            if (length >= 2) {
+                info->transparentSamples[0] = (uint16_t)((bytes[0] << 8) | bytes[1]);
+                info->hasTransparency = YES;
+            }
+            break;
+        case 2:
+            if (length >= 6) {
+                for (size_t i = 0; i < 3; i++) {
+                    info->transparentSamples[i] = (uint16_t)((bytes[i * 2] << 8) | bytes[(i * 2) + 1]);
+                }
+                info->hasTransparency = YES;
+            }
+            break;
+        case 3:
+            for (size_t i = 0; i < MIN((size_t)length, (size_t)256); i++) {
+                info->palette[i][3] = bytes[i];
+            }
+            info->hasTransparency = YES;
+            break;
+        default:
+            break;
+    }
+}
+
+static size_t TIPPNGBitsPerPixel(const TIPPNGInfo *info)
+{
+    return (size_t)kTIPPNGChannelCounts[info->colorType] * info->bitDepth;
+}
+
+static size_t TIPPNGAdam7PassByteCount(const TIPPNGInfo *info, NSUInteger pass, size_t * __nullable rowCountOut, size_t * __nullable columnCountOut)
+{
+    const uint8_t *passInfo = kTIPPNGAdam7Passes[pass];
+    const size_t columnCount = (info->width > passInfo[0]) ? ((info->width - passInfo[0] + passInfo[2] - 1) / passInfo[2]) : 0;
+    const size_t rowCount = (info->height > passInfo[1]) ? ((info->height - passInfo[1] + passInfo[3] - 1) / passInfo[3]) : 0;
+    if (rowCountOut) {
+        *rowCountOut = rowCount;
+    }
+    if (columnCountOut) {
+        *columnCountOut = columnCount;
+    }
+    if (!rowCount || !columnCount) {
+        return 0;
+    }
+
+    // each row leads with its filter type
+    return rowCount * (1 + ((columnCount * TIPPNGBitsPerPixel(info) + 7) / 8));
+}
+
+static BOOL TIPPNGUnfilterRows(uint8_t *rows, size_t rowCount, size_t rowByteCount, size_t filterByteCount)
+{
+    const uint8_t *priorRow = NULL;
+    for (size_t y = 0; y < rowCount; y++) {
+        uint8_t *row = rows + (y * (rowByteCount + 1)) + 1;
+        switch (row[-1]) {
+            case 0: // None
+                break;
+            case 1: // Sub
+                for (size_t i = filterByteCount; i < rowByteCount; i++) {
+                    row[i] += row[i - filterByteCount];
+                }
+                break;
+            case 2: // Up
+                if (priorRow) {
+                    for (size_t i = 0; i < rowByteCount; i++) {
+                        row[i] += priorRow[i];
+                    }
+                }
+                break;
+            case 3: // Average
+                for (size_t i = 0; i < rowByteCount; i++) {
+                    const unsigned int a = (i >= filterByteCount) ? row[i - filterByteCount] : 0;
+                    const unsigned int b = (priorRow) ? priorRow[i] : 0;
+                    row[i] += (uint8_t)((a + b) >> 1);
+                }
+                break;
+            case 4: // Paeth
+                for (size_t i = 0; i < rowByteCount; i++) {
+                    const int a = (i >= filterByteCount) ? row[i - filterByteCount] : 0;
+                    const int b = (priorRow) ? priorRow[i] : 0;
+                    const int c = (priorRow && i >= filterByteCount) ? priorRow[i - filterByteCount] : 0;
+                    const int pa = abs(b - c);
+                    const int pb = abs(a - c);
+                    const int pc = abs(a + b - (2 * c));
+                    row[i] += (uint8_t)((pa <= pb && pa <= pc) ? a : ((pb <= pc) ? b : c));
+                }
+                break;
+            default:
+                return NO;
+        }
+        priorRow = row;
+    }
+    return YES;
+}
+
+static void TIPPNGConvertRow(const TIPPNGInfo *info, const uint8_t *row, size_t pixelCount, uint8_t *pixels, size_t pixelStride)
+{
+    const size_t channelCount = kTIPPNGChannelCounts[info->colorType];
+    const uint8_t bitDepth = info->bitDepth;
+    const unsigned int maxSample = (1u << bitDepth) - 1;
+
+    for (size_t x = 0; x < pixelCount; x++, pixels += pixelStride) {
+        uint16_t samples[4];
+        for (size_t c = 0; c < channelCount; c++) {
+            const size_t index = (x * channelCount) + c;
+            if (16 == bitDepth) {
+                samples[c] = (uint16_t)((row[index * 2] << 8) | row[(index * 2) + 1]);
+            } else if (8 == bitDepth) {
+                samples[c] = row[index];
+            } else {
+                const size_t bitOffset = index * bitDepth;
+                samples[c] = (uint16_t)((row[bitOffset / 8] >> (8 - bitDepth - (bitOffset % 8))) & maxSample);
+            }
+        }
+
+        uint8_t rgba[4];
+        if (3 == info->colorType) {
+            memcpy(rgba, info->palette[samples[0]], 4);
+        } else {
+            uint8_t values[4];
+            for (size_t c = 0; c < channelCount; c++) {
+                values[c] = (16 == bitDepth) ? (uint8_t)(samples[c] >> 8) : (uint8_t)((samples[c] * 255u) / maxSample);
+            }
+            switch (info->colorType) {
+                case 0:
+                    rgba[0] = rgba[1] = rgba[2] = values[0];
+                    rgba[3] = (info->hasTransparency && samples[0] == info->transparentSamples[0]) ? 0 : 0xFF;
+                    break;
+                case 2:
+                    memcpy(rgba, values, 3);
+                    rgba[3] = (info->hasTransparency && 0 == memcmp(samples, info->transparentSamples, sizeof(info->transparentSamples))) ? 0 : 0xFF;
+                    break;
+                case 4:
+                    rgba[0] = rgba[1] = rgba[2] = values[0];
+                    rgba[3] = values[1];
+                    break;
+                default:
+                    memcpy(rgba, values, 4);
+                    break;
+            }
+        }
+
+        // premultiply
+        for (size_t c = 0; c < 3; c++) {
+            pixels[c] = (uint8_t)(((unsigned int)rgba[c] * rgba[3] + 127) / 255);
+        }
+        pixels[3] = rgba[3];
+    }
+}
+
 NS_ASSUME_NONNULL_END
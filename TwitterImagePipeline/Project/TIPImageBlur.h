@@ -0,0 +1,45 @@
+//
+//  TIPImageBlur.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Blur a bitmap of 8-bit, 4 channel pixels (such as premultiplied BGRA) in place with 3 successive
+ box filters of _boxSize_, which approximates a gaussian blur, and optionally transform the colors of
+ the blurred pixels with _colorMatrix_.
+
+ Each box filter is separable and slides a running sum along the row (or column), so its cost does
+ not depend on _boxSize_.  The horizontal passes run on bands of rows and the vertical passes run on
+ tiles (with a halo of the rows the passes reach into) that are small enough to stay in cache, both
+ concurrently for large bitmaps.  Pixels are filtered 4 channels at a time with `simd_float4` and only
+ rounded back to 8 bits between the horizontal and the vertical passes.  The color matrix is applied
+ as the vertical passes store their pixels, rather than as a separate pass over the bitmap.
+ Edges are extended.
+
+ @param pixels the pixels to blur
+ @param width the width in pixels
+ @param height the height in pixels
+ @param bytesPerRow the bytes per row
+ @param boxSize the size of the box filters, must be odd, `1` to not blur
+ @param alphaChannelIndex the index (`0` to `3`) of the premultiplied alpha channel (colors are
+ clamped to it after the color matrix is applied), `-1` if there is none
+ @param colorMatrix optional 4x4 matrix in the layout of `vImageMatrixMultiply_ARGB8888` (row _i_ has
+ the contribution of the _i_th channel to each output channel), without a divisor
+ @return `NO` if the arguments are invalid or memory could not be allocated
+ */
+FOUNDATION_EXTERN BOOL TIPBoxBlurPixels(void *pixels,
+                                        size_t width,
+                                        size_t height,
+                                        size_t bytesPerRow,
+                                        size_t boxSize,
+                                        NSInteger alphaChannelIndex,
+                                        const float * __nullable colorMatrix);
+
+NS_ASSUME_NONNULL_END
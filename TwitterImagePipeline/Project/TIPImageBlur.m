@@ -0,0 +1,331 @@
+//
+//  TIPImageBlur.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#include <stdatomic.h>
+#import <simd/simd.h>
+
+#import "TIP_Project.h"
+#import "TIPImageBlur.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Box filters that approximate a gaussian
+#define kBoxPassCount (3)
+// Bitmaps with fewer pixels than this are blurred on the calling thread
+static const size_t kConcurrentPixelCountMinimum = 256 * 256;
+// Bands of the horizontal passes have at least this many rows
+static const size_t kBandRowCountMinimum = 16;
+// Tiles of the vertical passes, a tile's columns are filtered together (with its halo, ~64KB of floats)
+static const size_t kTileWidth = 32;
+static const size_t kTileHeight = 128;
+
+static void _Apply(size_t count, BOOL concurrent, void (^block)(size_t index));
+static void _BoxFilter(const simd_float4 *input,
+                       simd_float4 *output,
+                       size_t laneCount,
+                       size_t sampleCount,
+                       size_t firstSample,
+                       size_t endSample,
+                       size_t bufferOffset,
+                       size_t radius,
+                       simd_float4 *sums);
+static void _LoadPixels(const Byte *pixels, simd_float4 *values, size_t count);
+static void _StorePixels(const simd_float4 *values,
+                         Byte *pixels,
+                         size_t count,
+                         const simd_float4x4 * __nullable matrix,
+                         NSInteger alphaChannelIndex);
+static BOOL _BlurRows(const Byte *source,
+                      Byte *destination,
+                      size_t width,
+                      size_t bytesPerRow,
+                      size_t firstRow,
+                      size_t endRow,
+                      size_t radius);
+static BOOL _BlurTile(const Byte *source,
+                      Byte *destination,
+                      size_t height,
+                      size_t bytesPerRow,
+                      size_t firstColumn,
+                      size_t endColumn,
+                      size_t firstRow,
+                      size_t endRow,
+                      size_t radius,
+                      const simd_float4x4 * __nullable matrix,
+                      NSInteger alphaChannelIndex);
+
+BOOL TIPBoxBlurPixels(void *pixels,
+                      size_t width,
+                      size_t height,
+                      size_t bytesPerRow,
+                      size_t boxSize,
+                      NSInteger alphaChannelIndex,
+                      const float * __nullable colorMatrix)
+{
+    if (!width || !height || bytesPerRow < width * 4 || alphaChannelIndex > 3 || 0 == (boxSize % 2)) {
+        return NO;
+    }
+
+    const size_t radius = boxSize / 2;
+    if (!radius && !colorMatrix) {
+        return YES;
+    }
+
+    simd_float4x4 matrix = matrix_identity_float4x4;
+    if (colorMatrix) {
+        for (size_t i = 0; i < 4; i++) {
+            // the rows of the vImage layout are the contributions of each input channel, which are
+            // the columns of a matrix that multiplies a column vector
+            matrix.columns[i] = simd_make_float4(colorMatrix[i * 4 + 0], colorMatrix[i * 4 + 1], colorMatrix[i * 4 + 2], colorMatrix[i * 4 + 3]);
+        }
+    }
+    const simd_float4x4 *matrixPtr = (colorMatrix) ? &matrix : NULL;
+
+    const BOOL concurrent = (width * height) >= kConcurrentPixelCountMinimum;
+    volatile atomic_bool failed = false;
+    volatile atomic_bool *failedPtr = &failed;
+
+    // horizontal passes into an intermediate bitmap, so the vertical passes of a tile can read the
+    // halo rows of their neighbors without racing with them
+    Byte *source = pixels;
+    Byte *intermediate = NULL;
+    tip_defer(^{
+        free(intermediate);
+    });
+    if (radius) {
+        intermediate = malloc(bytesPerRow * height);
+        if (!intermediate) {
+            return NO;
+        }
+        Byte *intermediatePixels = intermediate;
+
+        const size_t bandCount = (concurrent) ? MIN([NSProcessInfo processInfo].activeProcessorCount, MAX((size_t)1, height / kBandRowCountMinimum)) : 1;
+        const size_t rowsPerBand = (height + bandCount - 1) / bandCount;
+        _Apply(bandCount, concurrent, ^(size_t band) {
+            const size_t firstRow = band * rowsPerBand;
+            const size_t endRow = MIN(height, firstRow + rowsPerBand);
+            if (firstRow < endRow && !_BlurRows(pixels, intermediatePixels, width, bytesPerRow, firstRow, endRow, radius)) {
+                atomic_store(failedPtr, true);
+            }
+        });
+        if (atomic_load(failedPtr)) {
+            return NO;
+        }
+        source = intermediate;
+    }
+
+    // vertical passes (and the color matrix) back into the bitmap
+    const size_t columnTileCount = (width + kTileWidth - 1) / kTileWidth;
+    const size_t rowTileCount = (height + kTileHeight - 1) / kTileHeight;
+    _Apply(columnTileCount * rowTileCount, concurrent, ^(size_t tile) {
+        const size_t firstColumn = (tile % columnTileCount) * kTileWidth;
+        const size_t firstRow = (tile / columnTileCount) * kTileHeight;
+        if (!_BlurTile(source,
+                       pixels,
+                       height,
+                       bytesPerRow,
+                       firstColumn,
+                       MIN(width, firstColumn + kTileWidth),
+                       firstRow,
+                       MIN(height, firstRow + kTileHeight),
+                       radius,
+                       matrixPtr,
+                       alphaChannelIndex)) {
+            atomic_store(failedPtr, true);
+        }
+    });
+
+    return !atomic_load(failedPtr);
+}
+
+static void _Apply(size_t count, BOOL concurrent, void (^block)(size_t index))
+{
+    if (concurrent && count > 1) {
+        dispatch_apply(count, DISPATCH_APPLY_AUTO, block);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            block(i);
+        }
+    }
+}
+
+// Box filters the samples from _firstSample_ to _endSample_ of _laneCount_ lanes at once.
+// Sample `i` of the lanes is the row of _laneCount_ values at `(i - bufferOffset) * laneCount` in
+// both buffers, reads are clamped to the _sampleCount_ samples to extend the edges.
+static void _BoxFilter(const simd_float4 *input,
+                       simd_float4 *output,
+                       size_t laneCount,
+                       size_t sampleCount,
+                       size_t firstSample,
+                       size_t endSample,
+                       size_t bufferOffset,
+                       size_t radius,
+                       simd_float4 *sums)
+{
+    const ptrdiff_t lastSample = (ptrdiff_t)sampleCount - 1;
+    const float scale = 1.0f / (float)((radius * 2) + 1);
+#define SAMPLE(i) (input + ((size_t)MIN(lastSample, MAX((ptrdiff_t)0, (ptrdiff_t)(i))) - bufferOffset) * laneCount)
+
+    for (size_t lane = 0; lane < laneCount; lane++) {
+        sums[lane] = 0.0f;
+    }
+    for (ptrdiff_t k = -(ptrdiff_t)radius; k <= (ptrdiff_t)radius; k++) {
+        const simd_float4 *values = SAMPLE((ptrdiff_t)firstSample + k);
+        for (size_t lane = 0; lane < laneCount; lane++) {
+            sums[lane] += values[lane];
+        }
+    }
+
+    for (size_t i = firstSample; i < endSample; i++) {
+        if (i > firstSample) {
+            // slide the window: add the sample entering it and remove the one leaving it
+            const simd_float4 *entering = SAMPLE((ptrdiff_t)(i + radius));
+            const simd_float4 *leaving = SAMPLE((ptrdiff_t)i - (ptrdiff_t)radius - 1);
+            for (size_t lane = 0; lane < laneCount; lane++) {
+                sums[lane] += entering[lane] - leaving[lane];
+            }
+        }
+        simd_float4 *values = output + ((i - bufferOffset) * laneCount);
+        for (size_t lane = 0; lane < laneCount; lane++) {
+            values[lane] = sums[lane] * scale;
+        }
+    }
+
+#undef SAMPLE
+}
+
+static void _LoadPixels(const Byte *pixels, simd_float4 *values, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        simd_uchar4 pixel;
+        memcpy(&pixel, pixels + (i * 4), sizeof(pixel));
+        values[i] = simd_float(pixel);
+    }
+}
+
+static void _StorePixels(const simd_float4 *values,
+                         Byte *pixels,
+                         size_t count,
+                         const simd_float4x4 * __nullable matrix,
+                         NSInteger alphaChannelIndex)
+{
+    const simd_float4 minValue = 0.0f;
+    const simd_float4 maxValue = 255.0f;
+    for (size_t i = 0; i < count; i++) {
+        simd_float4 value = values[i];
+        if (matrix) {
+            value = simd_mul(*matrix, value);
+        }
+        value = simd_clamp(value, minValue, maxValue);
+        if (alphaChannelIndex >= 0) {
+            // premultiplied colors can't exceed their alpha
+            const simd_float4 alpha = value[alphaChannelIndex];
+            value = simd_min(value, alpha);
+        }
+        const simd_uchar4 pixel = simd_uchar(value + 0.5f);
+        memcpy(pixels + (i * 4), &pixel, sizeof(pixel));
+    }
+}
+
+static BOOL _BlurRows(const Byte *source,
+                      Byte *destination,
+                      size_t width,
+                      size_t bytesPerRow,
+                      size_t firstRow,
+                      size_t endRow,
+                      size_t radius)
+{
+    simd_float4 *line = malloc(width * sizeof(simd_float4));
+    simd_float4 *scratch = malloc(width * sizeof(simd_float4));
+    tip_defer(^{
+        free(line);
+        free(scratch);
+    });
+    if (!line || !scratch) {
+        return NO;
+    }
+
+    for (size_t row = firstRow; row < endRow; row++) {
+        _LoadPixels(source + (row * bytesPerRow), line, width);
+        simd_float4 *input = line;
+        simd_float4 *output = scratch;
+        for (size_t pass = 0; pass < kBoxPassCount; pass++) {
+            simd_float4 sum;
+            _BoxFilter(input, output, 1 /*laneCount*/, width, 0, width, 0, radius, &sum);
+            simd_float4 *swap = input;
+            input = output;
+            output = swap;
+        }
+        _StorePixels(input, destination + (row * bytesPerRow), width, NULL, -1);
+    }
+
+    return YES;
+}
+
+static BOOL _BlurTile(const Byte *source,
+                      Byte *destination,
+                      size_t height,
+                      size_t bytesPerRow,
+                      size_t firstColumn,
+                      size_t endColumn,
+                      size_t firstRow,
+                      size_t endRow,
+                      size_t radius,
+                      const simd_float4x4 * __nullable matrix,
+                      NSInteger alphaChannelIndex)
+{
+    // each pass reads _radius_ rows past the rows it outputs, so the tile loads a halo of the rows
+    // all of its passes reach into and each pass outputs a little less of it
+    const size_t laneCount = endColumn - firstColumn;
+    const size_t halo = radius * kBoxPassCount;
+    const size_t firstBufferRow = (firstRow > halo) ? firstRow - halo : 0;
+    const size_t endBufferRow = MIN(height, endRow + halo);
+    const size_t bufferCount = (endBufferRow - firstBufferRow) * laneCount;
+
+    simd_float4 *buffer = malloc(bufferCount * sizeof(simd_float4));
+    simd_float4 *scratch = (radius) ? malloc(bufferCount * sizeof(simd_float4)) : NULL;
+    simd_float4 *sums = (radius) ? malloc(laneCount * sizeof(simd_float4)) : NULL;
+    tip_defer(^{
+        free(buffer);
+        free(scratch);
+        free(sums);
+    });
+    if (!buffer || (radius && (!scratch || !sums))) {
+        return NO;
+    }
+
+    for (size_t row = firstBufferRow; row < endBufferRow; row++) {
+        _LoadPixels(source + (row * bytesPerRow) + (firstColumn * 4), buffer + ((row - firstBufferRow) * laneCount), laneCount);
+    }
+
+    simd_float4 *input = buffer;
+    simd_float4 *output = scratch;
+    if (radius) {
+        for (size_t pass = 1; pass <= kBoxPassCount; pass++) {
+            const size_t reach = radius * (kBoxPassCount - pass);
+            const size_t firstPassRow = (firstRow > reach) ? firstRow - reach : 0;
+            const size_t endPassRow = MIN(height, endRow + reach);
+            _BoxFilter(input, output, laneCount, height, firstPassRow, endPassRow, firstBufferRow, radius, sums);
+            simd_float4 *swap = input;
+            input = output;
+            output = swap;
+        }
+    }
+
+    for (size_t row = firstRow; row < endRow; row++) {
+        _StorePixels(input + ((row - firstBufferRow) * laneCount),
+                     destination + (row * bytesPerRow) + (firstColumn * 4),
+                     laneCount,
+                     matrix,
+                     alphaChannelIndex);
+    }
+
+    return YES;
+}
+
+NS_ASSUME_NONNULL_END
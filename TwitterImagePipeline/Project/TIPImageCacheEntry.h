@@ -39,7 +39,7 @@ NS_ASSUME_NONNULL_BEGIN
 @property (tip_nonatomic_direct) BOOL treatAsPlaceholder;
 @property (tip_nonatomic_direct) NSTimeInterval TTL;
 @property (tip_nonatomic_direct, nullable) NSURL *URL;
-@property (tip_nonatomic_direct, nullable) NSDate *lastAccess;
+@property (tip_nonatomic_direct) CFAbsoluteTime lastAccess; // 0 == never accessed
 @property (tip_nonatomic_direct, getter=isAnimated) BOOL animated;
 
 @property (tip_nonatomic_direct) CGSize dimensions; // pixel size, not point size
@@ -50,6 +50,15 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, copy, nullable) NSString *imageType;
 
+// Validators of the response the image was downloaded from, for revalidating the image once it expires
+@property (nonatomic, copy, nullable) NSString *lastModified;
+@property (nonatomic, copy, nullable) NSString *ETag;
+// How long the disk cache keeps the image past its TTL so it can be revalidated (never persisted)
+@property (tip_nonatomic_direct) NSTimeInterval staleRetentionTTL;
+
+- (BOOL)hasValidators TIP_OBJC_DIRECT;
+- (BOOL)isStaleAsOf:(CFAbsoluteTime)time TIP_OBJC_DIRECT; // past its TTL
+
 @end
 
 @interface TIPPartialImageEntryContext : TIPImageCacheEntryContext
@@ -91,7 +100,14 @@ NS_ASSUME_NONNULL_BEGIN
 #pragma mark - Private
 
 @interface TIPImageCacheEntry (Access)
-- (nullable NSDate *)mostRecentAccess TIP_OBJC_DIRECT;
+- (CFAbsoluteTime)mostRecentAccess TIP_OBJC_DIRECT; // 0 == never accessed
+@end
+
+@interface TIPImageCacheEntry (Expiry)
+// Used by TIPImageCacheExpiryIndex
+@property (nonatomic) NSUInteger expiryIndexPosition; // 1-based, 0 == not indexed
+@property (nonatomic) CFAbsoluteTime expiryTime; // as of the last time the entry was indexed, 0 == unknown
+- (CFAbsoluteTime)computeExpiryTime TIP_OBJC_DIRECT; // DBL_MAX if the entry never expires
 @end
 
 @interface TIPImageCacheEntry (Store)
@@ -106,12 +122,19 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+// Location of a record in a TIPImageDiskCacheSlabStore
+typedef struct TIPImageDiskCacheSlabLocation {
+    UInt32 slabIdentifier; // 0 == not in a slab
+    UInt64 offset;
+} TIPImageDiskCacheSlabLocation;
+
 @interface TIPImageDiskCacheEntry (DiskCache)
 
-// Used by Disk Cache
+// Used by Disk Cache (safeIdentifier is the fixed length hashed key used as the file name)
 @property (nonatomic, readonly, nullable, copy) NSString *safeIdentifier;
 @property (nonatomic) NSUInteger completeFileSize;
 @property (nonatomic) NSUInteger partialFileSize;
+@property (nonatomic) TIPImageDiskCacheSlabLocation slabLocation; // of the complete image, when it is stored in a slab
 
 @end
 
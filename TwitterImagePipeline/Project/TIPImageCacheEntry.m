@@ -22,6 +22,8 @@ NS_ASSUME_NONNULL_BEGIN
 @interface TIPImageCacheEntry ()
 @property (nonatomic, nullable) NSData *completeImageData;
 @property (nonatomic, nullable, copy) NSString *completeImageFilePath;
+@property (nonatomic) NSUInteger expiryIndexPosition;
+@property (nonatomic) CFAbsoluteTime expiryTime;
 - (instancetype)initWithCacheEntry:(TIPImageCacheEntry *)cacheEntry;
 @end
 
@@ -33,6 +35,7 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, readonly, copy, nullable) NSString *safeIdentifier;
 @property (nonatomic) NSUInteger completeFileSize;
 @property (nonatomic) NSUInteger partialFileSize;
+@property (nonatomic) TIPImageDiskCacheSlabLocation slabLocation;
 @end
 
 #pragma mark - Implementations
@@ -69,10 +72,27 @@ NS_ASSUME_NONNULL_BEGIN
         if ([context respondsToSelector:@selector(imageType)]) {
             _imageType = [(TIPCompleteImageEntryContext *)context imageType];
         }
+        if ([context isKindOfClass:[TIPCompleteImageEntryContext class]]) {
+            TIPCompleteImageEntryContext *completeContext = (TIPCompleteImageEntryContext *)context;
+            _lastModified = [completeContext.lastModified copy];
+            _ETag = [completeContext.ETag copy];
+            _staleRetentionTTL = completeContext.staleRetentionTTL;
+        }
     }
     return self;
 }
 
+- (BOOL)hasValidators
+{
+    return _lastModified.length > 0 || _ETag.length > 0;
+}
+
+- (BOOL)isStaleAsOf:(CFAbsoluteTime)time
+{
+    const CFAbsoluteTime lastAccess = self.lastAccess;
+    return lastAccess != 0 && time > lastAccess + self.TTL;
+}
+
 @end
 
 @implementation TIPPartialImageEntryContext
@@ -143,18 +163,26 @@ NS_ASSUME_NONNULL_BEGIN
 
 @implementation TIPImageCacheEntry (Access)
 
-- (nullable NSDate *)mostRecentAccess
+- (CFAbsoluteTime)mostRecentAccess
 {
-    NSDate *completeDate = _completeImageContext.lastAccess;
-    NSDate *partialDate = _partialImageContext.lastAccess;
+    return MAX(_completeImageContext.lastAccess, _partialImageContext.lastAccess);
+}
 
-    if (!completeDate) {
-        return partialDate;
-    } else if (!partialDate) {
-        return completeDate;
-    }
+@end
 
-    return [completeDate laterDate:partialDate];
+NS_INLINE CFAbsoluteTime _ExpiryTimeForContext(TIPImageCacheEntryContext * __nullable context,
+                                               NSTimeInterval staleRetentionTTL)
+{
+    const CFAbsoluteTime lastAccess = context.lastAccess;
+    return (lastAccess != 0) ? lastAccess + context.TTL + staleRetentionTTL : DBL_MAX;
+}
+
+@implementation TIPImageCacheEntry (Expiry)
+
+- (CFAbsoluteTime)computeExpiryTime
+{
+    return MIN(_ExpiryTimeForContext(_completeImageContext, _completeImageContext.staleRetentionTTL),
+               _ExpiryTimeForContext(_partialImageContext, 0));
 }
 
 @end
@@ -219,7 +247,7 @@ NS_ASSUME_NONNULL_BEGIN
 - (nullable NSString *)safeIdentifier
 {
     if (!_safeIdentifier) {
-        _safeIdentifier = TIPSafeFromRaw(self.identifier);
+        _safeIdentifier = TIPHashedKeyFromRaw(self.identifier);
     }
     return _safeIdentifier;
 }
@@ -235,6 +263,7 @@ NS_ASSUME_NONNULL_BEGIN
         if ([cacheEntry isKindOfClass:[TIPImageDiskCacheEntry class]]) {
             _completeFileSize = [(TIPImageDiskCacheEntry *)cacheEntry completeFileSize];
             _partialFileSize = [(TIPImageDiskCacheEntry *)cacheEntry partialFileSize];
+            _slabLocation = [(TIPImageDiskCacheEntry *)cacheEntry slabLocation];
         }
     }
     return self;
@@ -0,0 +1,49 @@
+//
+//  TIPImageCacheExpiryIndex.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+
+@class TIPImageCacheEntry;
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void(^TIPImageCacheExpiryHandler)(NSArray<TIPImageCacheEntry *> *expiredEntries);
+
+/**
+ Index of cache entries ordered by when they expire (the earliest `lastAccess + TTL` of the entry's
+ contexts), backed by a min-heap.
+
+ Rather than waiting for an expired entry to be hit (or for the next launch) to drop it, the index
+ sweeps expired entries out proactively and provides them in batches to the `expiryHandler`.
+ Sweeps are coalesced to a coarse granularity so that entries expiring close together are handled
+ together.  Entries are removed from the index before being provided to the handler, it is up to the
+ handler to drop the expired contexts and `updateEntry:` any entry that is kept.
+
+ Not thread safe, must only be used from the provided queue (the queue of the owning cache), which
+ is also the queue the `expiryHandler` is called on.
+ */
+TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
+@interface TIPImageCacheExpiryIndex : NSObject
+
+@property (nonatomic, readonly) NSUInteger numberOfEntries;
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+                expiryHandler:(TIPImageCacheExpiryHandler)expiryHandler NS_DESIGNATED_INITIALIZER;
+
+/** Add the _entry_ or reposition it (call whenever the entry's contexts or their `lastAccess` change) */
+- (void)updateEntry:(TIPImageCacheEntry *)entry;
+/** Remove the _entry_, no-op if it is not in the index */
+- (void)removeEntry:(TIPImageCacheEntry *)entry;
+- (void)removeAllEntries;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,210 @@
+//
+//  TIPImageCacheExpiryIndex.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+#import "TIPImageCacheEntry.h"
+#import "TIPImageCacheExpiryIndex.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Sweeps are rounded up to this granularity so that entries expiring close together are swept together
+static const CFTimeInterval kExpirySweepGranularity = 5.0;
+// Max entries provided to the handler per sweep, the remainder is swept after yielding the queue
+static const NSUInteger kExpirySweepBatchSize = 64;
+
+@implementation TIPImageCacheExpiryIndex
+{
+    dispatch_queue_t _queue;
+    TIPImageCacheExpiryHandler _expiryHandler;
+    NSMutableArray<TIPImageCacheEntry *> *_heap;
+    CFAbsoluteTime _scheduledSweepTime; // 0 == no sweep scheduled
+    NSUInteger _sweepGeneration;
+}
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+                expiryHandler:(TIPImageCacheExpiryHandler)expiryHandler
+{
+    if (self = [super init]) {
+        _queue = queue;
+        _expiryHandler = [expiryHandler copy];
+        _heap = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (NSUInteger)numberOfEntries
+{
+    return _heap.count;
+}
+
+- (void)updateEntry:(TIPImageCacheEntry *)entry
+{
+    const CFAbsoluteTime expiryTime = [entry computeExpiryTime];
+    entry.expiryTime = expiryTime;
+
+    NSUInteger position = [self _positionOfEntry:entry];
+    if (expiryTime == DBL_MAX) {
+        // never expires, nothing to index
+        if (position != NSNotFound) {
+            [self _removeEntryAtPosition:position];
+        }
+        return;
+    }
+
+    if (position == NSNotFound) {
+        position = _heap.count;
+        [_heap addObject:entry];
+        entry.expiryIndexPosition = position + 1;
+        [self _siftUpFromPosition:position];
+    } else {
+        [self _siftDownFromPosition:[self _siftUpFromPosition:position]];
+    }
+
+    [self _scheduleSweepIfNeeded];
+}
+
+- (void)removeEntry:(TIPImageCacheEntry *)entry
+{
+    const NSUInteger position = [self _positionOfEntry:entry];
+    if (position != NSNotFound) {
+        [self _removeEntryAtPosition:position];
+    }
+}
+
+- (void)removeAllEntries
+{
+    for (TIPImageCacheEntry *entry in _heap) {
+        entry.expiryIndexPosition = 0;
+    }
+    [_heap removeAllObjects];
+    _scheduledSweepTime = 0;
+    _sweepGeneration++; // invalidate any scheduled sweep
+}
+
+#pragma mark Private
+
+- (NSUInteger)_positionOfEntry:(TIPImageCacheEntry *)entry
+{
+    // positions are stored 1-based so that 0 means "not indexed"
+    const NSUInteger position = entry.expiryIndexPosition;
+    if (!position || position > _heap.count || _heap[position - 1] != entry) {
+        return NSNotFound;
+    }
+    return position - 1;
+}
+
+- (void)_removeEntryAtPosition:(NSUInteger)position
+{
+    TIPImageCacheEntry *entry = _heap[position];
+    const NSUInteger lastPosition = _heap.count - 1;
+    if (position != lastPosition) {
+        [self _swapPosition:position withPosition:lastPosition];
+    }
+    [_heap removeLastObject];
+    entry.expiryIndexPosition = 0;
+    if (position < _heap.count) {
+        [self _siftDownFromPosition:[self _siftUpFromPosition:position]];
+    }
+}
+
+- (void)_swapPosition:(NSUInteger)position1 withPosition:(NSUInteger)position2
+{
+    [_heap exchangeObjectAtIndex:position1 withObjectAtIndex:position2];
+    _heap[position1].expiryIndexPosition = position1 + 1;
+    _heap[position2].expiryIndexPosition = position2 + 1;
+}
+
+- (NSUInteger)_siftUpFromPosition:(NSUInteger)position
+{
+    while (position > 0) {
+        const NSUInteger parent = (position - 1) / 2;
+        if (_heap[parent].expiryTime <= _heap[position].expiryTime) {
+            break;
+        }
+        [self _swapPosition:position withPosition:parent];
+        position = parent;
+    }
+    return position;
+}
+
+- (NSUInteger)_siftDownFromPosition:(NSUInteger)position
+{
+    const NSUInteger count = _heap.count;
+    while (YES) {
+        const NSUInteger left = (position * 2) + 1;
+        const NSUInteger right = left + 1;
+        NSUInteger smallest = position;
+        if (left < count && _heap[left].expiryTime < _heap[smallest].expiryTime) {
+            smallest = left;
+        }
+        if (right < count && _heap[right].expiryTime < _heap[smallest].expiryTime) {
+            smallest = right;
+        }
+        if (smallest == position) {
+            break;
+        }
+        [self _swapPosition:position withPosition:smallest];
+        position = smallest;
+    }
+    return position;
+}
+
+- (void)_scheduleSweepIfNeeded
+{
+    TIPImageCacheEntry *soonest = _heap.firstObject;
+    if (!soonest) {
+        return;
+    }
+
+    const CFAbsoluteTime sweepTime = ceil(soonest.expiryTime / kExpirySweepGranularity) * kExpirySweepGranularity;
+    if (_scheduledSweepTime != 0 && _scheduledSweepTime <= sweepTime) {
+        // an early enough sweep is already scheduled
+        return;
+    }
+
+    _scheduledSweepTime = sweepTime;
+    const NSUInteger generation = ++_sweepGeneration;
+    const CFTimeInterval delay = MAX(0.0, sweepTime - CFAbsoluteTimeGetCurrent());
+
+    // wall time so the sweep is not pushed out by the device sleeping
+    __weak typeof(self) weakSelf = self;
+    dispatch_after(dispatch_walltime(NULL, (int64_t)(delay * NSEC_PER_SEC)), _queue, ^{
+        @autoreleasepool {
+            [weakSelf _sweepWithGeneration:generation];
+        }
+    });
+}
+
+- (void)_sweepWithGeneration:(NSUInteger)generation
+{
+    if (generation != _sweepGeneration) {
+        // superseded
+        return;
+    }
+    _scheduledSweepTime = 0;
+
+    const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    NSMutableArray<TIPImageCacheEntry *> *expiredEntries = nil;
+    while (_heap.count > 0 && _heap[0].expiryTime < now && expiredEntries.count < kExpirySweepBatchSize) {
+        if (!expiredEntries) {
+            expiredEntries = [[NSMutableArray alloc] init];
+        }
+        [expiredEntries addObject:_heap[0]];
+        [self _removeEntryAtPosition:0];
+    }
+
+    if (expiredEntries) {
+        _expiryHandler(expiredEntries);
+    }
+
+    [self _scheduleSweepIfNeeded];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
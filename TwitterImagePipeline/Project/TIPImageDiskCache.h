@@ -38,6 +38,8 @@ typedef NS_OPTIONS(NSInteger, TIPImageDiskCacheFetchOptions) {
  forciblyReplaceExisting:(BOOL)force TIP_OBJC_DIRECT;
 - (void)touchImageWithIdentifier:(NSString *)imageIdentifier
                 orSaveImageEntry:(nullable TIPImageDiskCacheEntry *)entry TIP_OBJC_DIRECT;
+// the origin confirmed the complete image is unchanged (a 304), restart its TTL
+- (void)revalidateImageWithIdentifier:(NSString *)imageIdentifier TIP_OBJC_DIRECT;
 - (void)prune TIP_OBJC_DIRECT;
 - (TIPImageDiskCacheTemporaryFile *)openTemporaryFileForImageIdentifier:(NSString *)imageIdentifier TIP_OBJC_DIRECT;
 - (nullable NSString *)copyImageEntryFileForIdentifier:(NSString *)identifier
@@ -57,9 +59,10 @@ typedef NS_OPTIONS(NSInteger, TIPImageDiskCacheFetchOptions) {
 TIP_OBJC_DIRECT_MEMBERS
 @interface TIPImageDiskCache (PrivateExposed)
 - (TIPLRUCache *)diskCache_syncAccessManifest;
-- (nullable NSString *)diskCache_imageEntryFilePathForIdentifier:(NSString *)identifier
-                                        hitShouldMoveEntryToHead:(BOOL)hitToHead
-                                                         context:(out TIPImageCacheEntryContext * __nullable * __nullable)context;
+// the complete image's encoded bytes, whether it is stored in its own file or in a slab
+- (nullable NSData *)diskCache_imageEntryDataForIdentifier:(NSString *)identifier
+                                  hitShouldMoveEntryToHead:(BOOL)hitToHead
+                                                   context:(out TIPImageCacheEntryContext * __nullable * __nullable)context;
 - (void)diskCache_updateImageEntry:(TIPImageCacheEntry *)entry
            forciblyReplaceExisting:(BOOL)force;
 - (nullable TIPImageDiskCacheEntry *)diskCache_imageEntryForIdentifier:(NSString *)identifier
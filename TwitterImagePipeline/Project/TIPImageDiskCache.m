@@ -13,15 +13,28 @@
 #import "TIPFileUtils.h"
 #import "TIPGlobalConfiguration+Project.h"
 #import "TIPImageCacheEntry.h"
+#import "TIPImageCacheExpiryIndex.h"
+#import "TIPImageCodecCatalogue.h"
 #import "TIPImageDiskCache.h"
+#import "TIPImageDiskCacheEntryFile.h"
+#import "TIPImageDiskCacheReclaimer.h"
+#import "TIPImageDiskCacheSlabStore.h"
 #import "TIPImageDiskCacheTemporaryFile.h"
 #import "TIPImagePipelineInspectionResult+Project.h"
 #import "TIPPartialImage.h"
 #import "TIPTiming.h"
+#import "UIImage+TIPAdditions.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
 static NSString * const kPartialImageExtension = @"tmp";
+static NSString * const kTrashPathExtension = @"trash";
+static NSString * const kSlabsDirectoryName = @"slabs"; // within the cache path, never a hashed key
+
+// Delay before compacting slabs so that a burst of frees (like a prune) is compacted in one pass
+static const NSTimeInterval kSlabCompactionDelay = 2.0;
+// Max records relocated per compaction slice, the remainder is relocated after yielding the queue
+static const NSUInteger kSlabCompactionBatchSize = 32;
 
 static NSString * const kXAttributeContextTTLKey = @"TTL";
 static NSString * const kXAttributeContextUpdateTLLOnAccessKey = @"uTTL";
@@ -29,10 +42,12 @@ static NSString * const kXAttributeContextTreatAsPlaceholderKey = @"pl";
 static NSString * const kXAttributeContextURLKey = @"URL";
 static NSString * const kXAttributeContextLastAccessKey = @"LAD";
 static NSString * const kXAttributeContextLastModifiedKey = @"LMD";
+static NSString * const kXAttributeContextETagKey = @"ETag";
 static NSString * const kXAttributeContextExpectedSizeKey = @"clen";
 static NSString * const kXAttributeContextDimensionXKey = @"dX";
 static NSString * const kXAttributeContextDimensionYKey = @"dY";
 static NSString * const kXAttributeContextAnimated = @"ANI";
+static NSString * const kXAttributeEntryIdentifierKey = @"id"; // the raw identifier, since file names are hashed keys
 
 static NSDictionary<NSString *, Class> *_XAttributesKeysToKindsMap(void);
 static NSDictionary<NSString *, Class> *_XAttributesKeysToKindsMap()
@@ -46,11 +61,13 @@ static NSDictionary<NSString *, Class> *_XAttributesKeysToKindsMap()
                  kXAttributeContextTreatAsPlaceholderKey : [NSNumber class], // BOOL
                  kXAttributeContextURLKey : [NSURL class],
                  kXAttributeContextLastAccessKey : [NSDate class],
-                 kXAttributeContextLastModifiedKey : [NSString class], // Only used for partial entries
+                 kXAttributeContextLastModifiedKey : [NSString class],
+                 kXAttributeContextETagKey : [NSString class], // Only used for complete entries
                  kXAttributeContextExpectedSizeKey : [NSNumber class], // Only used for partial entries
                  kXAttributeContextDimensionXKey : [NSNumber class],
                  kXAttributeContextDimensionYKey : [NSNumber class],
                  kXAttributeContextAnimated : [NSNumber class], // BOOL
+                 kXAttributeEntryIdentifierKey : [NSString class],
                  };
     });
     return sMap;
@@ -63,13 +80,18 @@ static NSDictionary<NSString *, Class> *_XAttributesKeysToKindsMapForCompleteEnt
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
         NSMutableDictionary *attributes = [_XAttributesKeysToKindsMap() mutableCopy];
-        [attributes removeObjectsForKeys:@[kXAttributeContextLastModifiedKey, kXAttributeContextExpectedSizeKey]];
+        // legacy files never had validators for complete entries
+        [attributes removeObjectsForKeys:@[kXAttributeContextLastModifiedKey, kXAttributeContextETagKey, kXAttributeContextExpectedSizeKey]];
         sMap = [attributes copy];
     });
     return sMap;
 }
 
-static NSDictionary * __nullable _XAttributesFromContext(TIPImageCacheEntryContext * __nullable context);
+static NSDictionary * __nullable _XAttributesFromContext(NSString *identifier,
+                                                        TIPImageCacheEntryContext * __nullable context);
+static NSData * __nullable _SlabMetadataFromXAttributes(NSDictionary * __nullable xattrs);
+static NSDictionary * __nullable _XAttributesFromSlabMetadata(NSData *metadata,
+                                                             CFAbsoluteTime lastAccess);
 static TIPImageCacheEntryContext * __nullable _ContextFromXAttributes(NSDictionary *xattrs,
                                                                       BOOL notYetComplete);
 static NSOperation *
@@ -91,12 +113,57 @@ static BOOL _UpdateImageConditionCheck(const BOOL force,
                                        NSURL * __nullable oldURL,
                                        NSURL * __nullable newURL);
 static void _SortEntries(NSMutableArray<TIPImageDiskCacheEntry *> *entries);
+static NSString * __nullable _MigrateLegacyEntryFile(NSString *entryPath,
+                                                     NSString *legacySafeIdentifier,
+                                                     BOOL isTmp);
+static TIPImageCacheEntryContext * __nullable _ReadEntryFileContext(NSString *filePath,
+                                                                    BOOL partial,
+                                                                    NSString * __nullable * __nullable identifierOut);
+static BOOL _UpdateEntryFile(NSString *filePath,
+                             NSString *identifier,
+                             TIPImageCacheEntryContext *context,
+                             BOOL identifierChanged);
+
+NS_INLINE BOOL _TouchContext(TIPImageCacheEntryContext *context)
+{
+    if (context.updateExpiryOnAccess || !context.lastAccess) {
+        context.lastAccess = CFAbsoluteTimeGetCurrent();
+        return YES;
+    }
+    return NO;
+}
+
+NS_INLINE NSTimeInterval _StaleRetentionTTL(TIPImageCacheEntryContext * __nullable context)
+{
+    // complete images with validators outlive their TTL by another TTL so they can be revalidated
+    if (![context isKindOfClass:[TIPCompleteImageEntryContext class]] || ![(TIPCompleteImageEntryContext *)context hasValidators]) {
+        return 0;
+    }
+    if (TIPImageRevalidationModeOff == [TIPGlobalConfiguration sharedInstance].imageRevalidationMode) {
+        return 0;
+    }
+    return context.TTL;
+}
+
+NS_INLINE BOOL _ContextHasExpired(TIPImageCacheEntryContext *context, CFAbsoluteTime now)
+{
+    const CFAbsoluteTime lastAccess = context.lastAccess;
+    return lastAccess != 0 && (now - lastAccess) > (context.TTL + _StaleRetentionTTL(context));
+}
 
 NS_INLINE NSString *_CreateTempFilePath()
 {
     return [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
 }
 
+NS_INLINE NSString *_TrashPathForCachePath(NSString *cachePath)
+{
+    // Shared by all disk caches that are siblings in the same directory.
+    // Lives outside that directory so it can never be mistaken for a cache,
+    // but on the same volume so that trashing is always a cheap rename.
+    return [[cachePath stringByDeletingLastPathComponent] stringByAppendingPathExtension:kTrashPathExtension];
+}
+
 static NSOperationQueue *_ImageDiskCacheManifestCacheQueue(void); // serial
 static NSOperationQueue *_ImageDiskCacheManifestIOQueue(void); // concurrent
 static dispatch_queue_t _ImageDiskCacheManifestAccessQueue(void); // serial
@@ -131,6 +198,10 @@ TIP_OBJC_DIRECT_MEMBERS
                      safeIdentifier:(NSString *)safeIdentifier;
 - (BOOL)_diskCache_touchImage:(NSString *)safeIdentifier
                        forced:(BOOL)forced;
+- (BOOL)_diskCache_expireEntry:(TIPImageDiskCacheEntry *)entry
+                        atTime:(CFAbsoluteTime)now;
+- (void)_diskCache_expireEntries:(NSArray<TIPImageCacheEntry *> *)entries;
+- (void)_diskCache_indexEntry:(TIPImageDiskCacheEntry *)entry;
 - (void)_diskCache_touchEntry:(nullable TIPImageDiskCacheEntry *)entry
                        forced:(BOOL)forced
                       partial:(BOOL)partial;
@@ -151,6 +222,14 @@ TIP_OBJC_DIRECT_MEMBERS
                                 decoderConfigMap:(nullable NSDictionary<NSString *, id> *)decoderConfigMap;
 - (void)_diskCache_populateEntryWithTemporaryFile:(TIPImageDiskCacheEntry *)entry;
 - (void)_diskCache_inspect:(TIPInspectableCacheCallback)callback;
+- (BOOL)_diskCache_appendSlabRecordWithData:(NSData *)data
+                                 identifier:(NSString *)identifier
+                                    context:(TIPImageCacheEntryContext *)context
+                                   location:(out TIPImageDiskCacheSlabLocation *)locationOut;
+- (void)_diskCache_removeCompleteImageOfEntry:(TIPImageDiskCacheEntry *)entry
+                                     filePath:(nullable NSString *)filePath;
+- (void)_diskCache_scheduleSlabCompactionIfNeeded;
+- (void)_diskCache_compactSlabs;
 
 @end
 
@@ -170,13 +249,21 @@ TIP_OBJC_DIRECT_MEMBERS
 @implementation TIPImageDiskCache
 {
     TIPGlobalConfiguration *_globalConfig;
+    TIPImageDiskCacheReclaimer *_reclaimer;
+    NSString *_trashPath;
     dispatch_queue_t _manifestQueue;
+    TIPImageCacheExpiryIndex *_expiryIndex; // only accessed from queueForDiskCaches
+    // The slab records are loaded while the manifest is populated, off of the disk cache queue and
+    // while holding _manifestMutex.  Once populated, only accessed from queueForDiskCaches (which
+    // waits on _manifestMutex for anything beyond reading entry files while the manifest loads).
+    TIPImageDiskCacheSlabStore *_slabStore;
 
     UInt64 _earlyRemovedBytesSize;
     TIPLRUCache *_manifest;
     pthread_mutex_t _manifestMutex;
     struct {
         BOOL manifestIsLoading:1;
+        BOOL slabCompactionScheduled:1;
     } _diskCache_flags;
 }
 
@@ -233,8 +320,16 @@ TIP_OBJC_DIRECT_MEMBERS
     if (self = [super init]) {
         TIPAssert(cachePath != nil);
         _cachePath = [cachePath copy];
+        _trashPath = [_TrashPathForCachePath(_cachePath) copy];
         _globalConfig = [TIPGlobalConfiguration sharedInstance];
+        _reclaimer = [TIPImageDiskCacheReclaimer sharedInstance];
+        _slabStore = [[TIPImageDiskCacheSlabStore alloc] initWithPath:[_cachePath stringByAppendingPathComponent:kSlabsDirectoryName]];
         _manifestQueue = _ImageDiskCacheManifestAccessQueue();
+        __weak typeof(self) weakSelf = self;
+        _expiryIndex = [[TIPImageCacheExpiryIndex alloc] initWithQueue:_globalConfig.queueForDiskCaches
+                                                         expiryHandler:^(NSArray<TIPImageCacheEntry *> *expiredEntries) {
+            [weakSelf _diskCache_expireEntries:expiredEntries];
+        }];
         _diskCache_flags.manifestIsLoading = YES;
         pthread_mutex_init(&_manifestMutex, NULL);
         pthread_mutex_lock(&_manifestMutex);
@@ -243,6 +338,9 @@ TIP_OBJC_DIRECT_MEMBERS
         tip_dispatch_async_autoreleasing(_manifestQueue, ^{
             [self _manifest_populateManifestWithCachePath:cachePath];
         });
+
+        // resume reclaiming anything left in the trash from a previous launch
+        [_reclaimer reclaimTrashPath:_trashPath];
     }
     return self;
 }
@@ -334,7 +432,7 @@ TIP_OBJC_DIRECT_MEMBERS
     tip_dispatch_async_autoreleasing(_globalConfig.queueForDiskCaches, ^{
         [self _diskCache_updateImageEntry:entry
                   forciblyReplaceExisting:force
-                           safeIdentifier:TIPSafeFromRaw(entry.identifier)];
+                           safeIdentifier:TIPHashedKeyFromRaw(entry.identifier)];
     });
 }
 
@@ -346,7 +444,7 @@ TIP_OBJC_DIRECT_MEMBERS
 
     tip_dispatch_async_autoreleasing(_globalConfig.queueForDiskCaches, ^{
         TIPLRUCache *manifest = [self diskCache_syncAccessManifest];
-        TIPImageDiskCacheEntry *entry = (TIPImageDiskCacheEntry *)[manifest entryWithIdentifier:TIPSafeFromRaw(identifier)];
+        TIPImageDiskCacheEntry *entry = (TIPImageDiskCacheEntry *)[manifest entryWithIdentifier:TIPHashedKeyFromRaw(identifier)];
         [manifest removeEntry:entry];
     });
 }
@@ -385,7 +483,7 @@ TIP_OBJC_DIRECT_MEMBERS
     }
 
     tip_dispatch_async_autoreleasing(_globalConfig.queueForDiskCaches, ^{
-        NSString *safeIdentifier = TIPSafeFromRaw(imageIdentifier);
+        NSString *safeIdentifier = TIPHashedKeyFromRaw(imageIdentifier);
         if (![self _diskCache_touchImage:safeIdentifier forced:NO] && entry) {
             [self _diskCache_updateImageEntry:entry
                       forciblyReplaceExisting:NO
@@ -394,6 +492,27 @@ TIP_OBJC_DIRECT_MEMBERS
     });
 }
 
+- (void)revalidateImageWithIdentifier:(NSString *)imageIdentifier
+{
+    TIPAssert(imageIdentifier != nil);
+    if (!imageIdentifier) {
+        return;
+    }
+
+    tip_dispatch_async_autoreleasing(_globalConfig.queueForDiskCaches, ^{
+        NSString *safeIdentifier = TIPHashedKeyFromRaw(imageIdentifier);
+        TIPImageDiskCacheEntry *entry = (TIPImageDiskCacheEntry *)[[self diskCache_syncAccessManifest] entryWithIdentifier:safeIdentifier];
+        if (!entry.completeImageContext || ![entry.identifier isEqualToString:imageIdentifier]) {
+            return;
+        }
+
+        // restart the TTL regardless of updateExpiryOnAccess
+        entry.completeImageContext.lastAccess = CFAbsoluteTimeGetCurrent();
+        [self _diskCache_touchEntry:entry forced:YES partial:NO];
+        [self _diskCache_indexEntry:entry];
+    });
+}
+
 - (TIPImageDiskCacheTemporaryFile *)openTemporaryFileForImageIdentifier:(NSString *)imageIdentifier
 {
     TIPAssert(imageIdentifier != nil);
@@ -401,7 +520,7 @@ TIP_OBJC_DIRECT_MEMBERS
         return nil;
     }
 
-    NSString *finalPath = [self filePathForSafeIdentifier:TIPSafeFromRaw(imageIdentifier)];
+    NSString *finalPath = [self filePathForSafeIdentifier:TIPHashedKeyFromRaw(imageIdentifier)];
     TIPImageDiskCacheTemporaryFile *tempFile;
     tempFile = [[TIPImageDiskCacheTemporaryFile alloc] initWithIdentifier:imageIdentifier
                                                             temporaryPath:_CreateTempFilePath()
@@ -453,12 +572,21 @@ TIP_OBJC_DIRECT_MEMBERS
     const NSUInteger size = entry.completeFileSize + entry.partialFileSize;
     _globalConfig.internalTotalCountForAllDiskCaches -= 1;
     [self _diskCache_updateByteCountsAdded:0 removed:size];
+    [_expiryIndex removeEntry:entry];
 
-    NSFileManager *fm = [NSFileManager defaultManager];
+    // Move the files out of the way (cheap) and let the reclaimer delete them in a batch later.
+    // The files must not stay in place since the identifier can be reused right away.
     NSString *filePath = [self filePathForSafeIdentifier:entry.safeIdentifier];
     NSString *partialFilePath = [filePath stringByAppendingPathExtension:kPartialImageExtension];
-    [fm removeItemAtPath:filePath error:NULL];
-    [fm removeItemAtPath:partialFilePath error:NULL];
+    if (entry.slabLocation.slabIdentifier) {
+        // freeing the slab record is a single write, nothing to trash
+        [self _diskCache_removeCompleteImageOfEntry:entry filePath:nil];
+    } else if (![_reclaimer trashItemAtPath:filePath toTrashPath:_trashPath]) {
+        [[NSFileManager defaultManager] removeItemAtPath:filePath error:NULL];
+    }
+    if (![_reclaimer trashItemAtPath:partialFilePath toTrashPath:_trashPath]) {
+        [[NSFileManager defaultManager] removeItemAtPath:partialFilePath error:NULL];
+    }
 
     TIPLogDebug(@"%@ Evicted '%@', complete:'%@', partial:'%@'", NSStringFromClass([self class]), entry.safeIdentifier, entry.completeImageContext.URL, entry.partialImageContext.URL);
 }
@@ -509,18 +637,18 @@ TIP_OBJC_DIRECT_MEMBERS
 {
     NSString *temporaryFilePath = nil;
     NSError *fileCopyError = nil;
-    NSString *filePath = [self diskCache_imageEntryFilePathForIdentifier:unsafeIdentifier
-                                                hitShouldMoveEntryToHead:YES
-                                                                 context:NULL];
+    // the copy is just the image, without the entry file's metadata
+    NSData *data = [self diskCache_imageEntryDataForIdentifier:unsafeIdentifier
+                                      hitShouldMoveEntryToHead:YES
+                                                       context:NULL];
 
-    if (filePath) {
-        NSFileManager *fm = [NSFileManager defaultManager];
+    if (data) {
         temporaryFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
-        [fm createDirectoryAtPath:temporaryFilePath.stringByDeletingLastPathComponent
-      withIntermediateDirectories:YES
-                       attributes:NULL
-                            error:NULL];
-        if (![fm copyItemAtPath:filePath toPath:temporaryFilePath error:&fileCopyError]) {
+        [[NSFileManager defaultManager] createDirectoryAtPath:temporaryFilePath.stringByDeletingLastPathComponent
+                                  withIntermediateDirectories:YES
+                                                   attributes:NULL
+                                                        error:NULL];
+        if (![data writeToFile:temporaryFilePath options:NSDataWritingAtomic error:&fileCopyError]) {
             temporaryFilePath = nil;
         }
     }
@@ -569,22 +697,20 @@ TIP_OBJC_DIRECT_MEMBERS
 {
     TIPImageDiskCacheEntry *entry = nil;
     NSFileManager *fm = [NSFileManager defaultManager];
-    NSString *safeIdentifer = TIPSafeFromRaw(unsafeIdentifier);
+    NSString *safeIdentifer = TIPHashedKeyFromRaw(unsafeIdentifier);
     NSString *filePath = [self filePathForSafeIdentifier:safeIdentifer];
     if ([fm fileExistsAtPath:filePath]) {
         const NSUInteger size = TIPFileSizeAtPath(filePath, NULL);
         if (size) {
-            NSDictionary *xattributes = TIPGetXAttributesForFile(filePath, _XAttributesKeysToKindsMap());
-            TIPImageCacheEntryContext *context = _ContextFromXAttributes(xattributes, NO);
-            if ([context isKindOfClass:[TIPCompleteImageEntryContext class]]) {
+            NSString *rawIdentifier = nil;
+            TIPImageCacheEntryContext *context = _ReadEntryFileContext(filePath, NO, &rawIdentifier);
+            if ([context isKindOfClass:[TIPCompleteImageEntryContext class]] && [rawIdentifier isEqualToString:unsafeIdentifier]) {
                 entry = [[TIPImageDiskCacheEntry alloc] init];
                 entry.identifier = unsafeIdentifier;
                 entry.completeImageContext = (id)context;
                 entry.completeFileSize = size;
                 if (TIP_BITMASK_HAS_SUBSET_FLAGS(options, TIPImageDiskCacheFetchOptionCompleteImage)) {
-                    NSData *data = [NSData dataWithContentsOfURL:[NSURL fileURLWithPath:filePath]
-                                                         options:(context.isAnimated) ? NSDataReadingMappedIfSafe : 0
-                                                           error:NULL];
+                    NSData *data = TIPImageDiskCacheEntryFileReadPayload(filePath, context.isAnimated);
                     TIPImageContainer *image = [TIPImageContainer imageContainerWithData:data
                                                                         targetDimensions:targetDimensions
                                                                        targetContentMode:targetContentMode
@@ -610,45 +736,26 @@ TIP_OBJC_DIRECT_MEMBERS
                                                          decoderConfigMap:(nullable NSDictionary<NSString *, id> *)decoderConfigMap
 {
     TIPLRUCache *manifest = [self diskCache_syncAccessManifest];
-    NSString *safeIdentifer = TIPSafeFromRaw(unsafeIdentifier);
+    NSString *safeIdentifer = TIPHashedKeyFromRaw(unsafeIdentifier);
     TIPImageDiskCacheEntry *entry = (TIPImageDiskCacheEntry *)[manifest entryWithIdentifier:safeIdentifer];
     if (entry) {
         // Validate TTL
-        NSDate *now = [NSDate date];
-        NSDate *lastAccess = nil;
-        const NSUInteger oldCost = entry.completeFileSize + entry.partialFileSize;
-
-        lastAccess = entry.partialImageContext.lastAccess;
-        if (lastAccess && [now timeIntervalSinceDate:lastAccess] > entry.partialImageContext.TTL) {
-            entry.partialImageContext = nil;
-            entry.partialImage = nil;
-            entry.partialFileSize = 0;
-        }
-        lastAccess = entry.completeImageContext.lastAccess;
-        if (lastAccess && [now timeIntervalSinceDate:lastAccess] > entry.completeImageContext.TTL) {
-            entry.completeImageContext = nil;
-            entry.completeImage = nil;
-            entry.completeFileSize = 0;
+        // (only possible to be expired if the expiry index has yet to sweep it)
+        const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        if (now > entry.expiryTime) {
+            if (![self _diskCache_expireEntry:entry atTime:now]) {
+                entry = nil;
+            }
         }
 
-        // Resolve changes to entry
-        const NSUInteger newCost = entry.completeFileSize + entry.partialFileSize;
-        if (!newCost) {
-            [manifest removeEntry:entry];
+        if (entry && ![entry.identifier isEqualToString:unsafeIdentifier]) {
+            // hashed key collision, treat as a miss
+            TIPLogWarning(@"%@ key collision between '%@' and '%@'", NSStringFromClass([self class]), entry.identifier, unsafeIdentifier);
             entry = nil;
-        } else {
-            [self _diskCache_updateByteCountsAdded:newCost removed:oldCost];
-            TIPAssert(newCost <= oldCost); // removing the cache image and/or partial image only ever removes bytes
         }
 
         if (entry) {
             // Update entry
-            if (![entry.identifier isEqualToString:unsafeIdentifier]) {
-                // Entries read from disk can have hashed identifiers.
-                // If the safe identifiers match but the unsafe ones don't,
-                // we can safely update the existing entry's identifier.
-                entry.identifier = unsafeIdentifier;
-            }
             [self _diskCache_touchImage:safeIdentifer forced:NO];
 
             // Mutate and return a copy
@@ -681,13 +788,19 @@ TIP_OBJC_DIRECT_MEMBERS
                                  decoderConfigMap:(nullable NSDictionary<NSString *, id> *)decoderConfigMap
 {
     if (entry.completeImageContext) {
-        NSString *filePath = [self filePathForSafeIdentifier:entry.safeIdentifier];
-        TIPAssertMessage(filePath != nil, @"entry.identifier = %@", entry.identifier);
-        if (filePath) {
-            const BOOL memoryMap = entry.completeImageContext.isAnimated;
-            NSData *data = [NSData dataWithContentsOfURL:[NSURL fileURLWithPath:filePath]
-                                                 options:(memoryMap) ? NSDataReadingMappedIfSafe : 0
-                                                   error:NULL];
+        NSData *data = nil;
+        if (entry.slabLocation.slabIdentifier) {
+            data = [_slabStore dataForRecordAtLocation:entry.slabLocation
+                                            dataLength:entry.completeFileSize];
+        } else {
+            NSString *filePath = [self filePathForSafeIdentifier:entry.safeIdentifier];
+            TIPAssertMessage(filePath != nil, @"entry.identifier = %@", entry.identifier);
+            if (filePath) {
+                const BOOL memoryMap = entry.completeImageContext.isAnimated;
+                data = TIPImageDiskCacheEntryFileReadPayload(filePath, memoryMap);
+            }
+        }
+        if (data) {
             entry.completeImage = [TIPImageContainer imageContainerWithData:data
                                                            targetDimensions:targetDimensions
                                                           targetContentMode:targetContentMode
@@ -706,7 +819,7 @@ TIP_OBJC_DIRECT_MEMBERS
         filePath = [filePath stringByAppendingPathExtension:kPartialImageExtension];
         TIPAssertMessage(filePath != nil, @"entry.identifier = %@", entry.identifier);
         if (filePath) {
-            NSData *data = [NSData dataWithContentsOfFile:filePath];
+            NSData *data = TIPImageDiskCacheEntryFileReadPayload(filePath, NO);
             if (data.length > 0) {
                 TIPPartialImage *partialImage;
                 partialImage = [[TIPPartialImage alloc] initWithExpectedContentLength:entry.partialImageContext.expectedContentLength];
@@ -727,10 +840,15 @@ TIP_OBJC_DIRECT_MEMBERS
         TIPAssertMessage(tempPath != nil, @"entry.identifier = %@", entry.identifier);
         TIPAssertMessage(partialPath != nil, @"entry.identifier = %@", entry.identifier);
         if (tempPath && partialPath && [[NSFileManager defaultManager] copyItemAtPath:partialPath toPath:tempPath error:NULL]) {
-            entry.tempFile = [[TIPImageDiskCacheTemporaryFile alloc] initWithIdentifier:entry.identifier
-                                                                          temporaryPath:tempPath
-                                                                              finalPath:finalPath
-                                                                              diskCache:self];
+            // downloading appends to the payload, the metadata is written again when finalized
+            if (TIPImageDiskCacheEntryFilePrepareForAppending(tempPath)) {
+                entry.tempFile = [[TIPImageDiskCacheTemporaryFile alloc] initWithIdentifier:entry.identifier
+                                                                              temporaryPath:tempPath
+                                                                                  finalPath:finalPath
+                                                                                  diskCache:self];
+            } else {
+                [[NSFileManager defaultManager] removeItemAtPath:tempPath error:NULL];
+            }
         }
     }
 }
@@ -755,19 +873,18 @@ TIP_OBJC_DIRECT_MEMBERS
     // Get the "existing" entry
     TIPLRUCache *manifest = [self diskCache_syncAccessManifest];
     TIPImageDiskCacheEntry *existingEntry = (TIPImageDiskCacheEntry *)[manifest entryWithIdentifier:safeIdentifier];
+    if (existingEntry && ![existingEntry.identifier isEqualToString:entry.identifier]) {
+        // hashed key collision, the newer entry takes over the key
+        TIPLogWarning(@"%@ key collision between '%@' and '%@'", NSStringFromClass([self class]), existingEntry.identifier, entry.identifier);
+        [manifest removeEntry:existingEntry];
+        existingEntry = nil;
+    }
     const BOOL hasPreviousEntry = (existingEntry != nil);
     if (!existingEntry) {
         if (forciblyReplaceExisting || entry.completeImageContext || entry.partialImageContext) {
             existingEntry = [[TIPImageDiskCacheEntry alloc] init];
             existingEntry.identifier = entry.identifier;
         }
-    } else { // existingEntry
-        if (![existingEntry.identifier isEqualToString:entry.identifier]) {
-            // Entries read from disk can have hashed identifiers.
-            // If the safe identifiers match but the unsafe ones don't,
-            // we can safely update the existing entry's identifier.
-            existingEntry.identifier = entry.identifier;
-        }
     }
 
     // Set up variables
@@ -813,44 +930,64 @@ TIP_OBJC_DIRECT_MEMBERS
     conditionMetToUpdate = _UpdateImageConditionCheck(forciblyReplaceExisting,
                                                       oldWasPlaceholder,
                                                       newIsPlaceholder,
-                                                      NO /*extra*/,
+                                                      [existingEntry.completeImageContext isStaleAsOf:CFAbsoluteTimeGetCurrent()] /*extra*/,
                                                       newDimensions,
                                                       oldDimensions,
                                                       existingEntry.completeImageContext.URL,
                                                       entry.completeImageContext.URL);
 
     if (conditionMetToUpdate) {
+        [self _diskCache_removeCompleteImageOfEntry:existingEntry filePath:filePath];
         existingEntry.completeImageContext = nil;
         existingEntry.completeFileSize = 0;
-        if (filePath) {
-            [fm removeItemAtPath:filePath error:NULL];
-        }
         if (entry.completeImage || entry.completeImageData || entry.completeImageFilePath) {
             BOOL success = NO;
             NSError *error = nil;
-            if (filePath) {
-                if (entry.completeImage) {
-                    success = [entry.completeImage saveToFilePath:filePath
-                                                             type:entry.completeImageContext.imageType
-                                                   codecCatalogue:nil
-                                                          options:TIPImageEncodingNoOptions
-                                                          quality:kTIPAppleQualityValueRepresentingJFIFQuality85
-                                                           atomic:YES
-                                                            error:&error];
-                } else if (entry.completeImageData) {
-                    success = [entry.completeImageData writeToFile:filePath
-                                                           options:NSDataWritingAtomic
-                                                             error:&error];
-                } else {
-                    success = [fm copyItemAtPath:entry.completeImageFilePath
-                                          toPath:filePath
-                                           error:&error];
+            TIPCompleteImageEntryContext *context = [entry.completeImageContext copy];
+            _TouchContext(context); // written along with the image, no need to touch after
+
+            // The metadata is written inline with the image, so get the encoded bytes first
+            NSData *data = nil;
+            if (entry.completeImage) {
+                NSString *imageType = context.imageType;
+                if (!imageType) {
+                    const TIPRecommendedImageTypeOptions recoOptions = TIPRecommendedImageTypeOptionsFromEncodingOptions(TIPImageEncodingNoOptions, kTIPAppleQualityValueRepresentingJFIFQuality85);
+                    imageType = [entry.completeImage.image tip_recommendedImageType:recoOptions];
                 }
+                data = [[TIPImageCodecCatalogue sharedInstance] encodeImage:entry.completeImage
+                                                              withImageType:imageType
+                                                                    quality:kTIPAppleQualityValueRepresentingJFIFQuality85
+                                                                    options:TIPImageEncodingNoOptions
+                                                                      error:&error];
+            } else if (entry.completeImageData) {
+                data = entry.completeImageData;
+            } else {
+                data = [NSData dataWithContentsOfFile:entry.completeImageFilePath
+                                              options:NSDataReadingMappedIfSafe
+                                                error:&error];
             }
 
+            // Small images go to a slab instead of their own file
+            TIPImageDiskCacheSlabLocation slabLocation = { 0, 0 };
+            if (data.length > 0 && data.length <= TIPImageDiskCacheSlabRecordMaxDataLength) {
+                success = [self _diskCache_appendSlabRecordWithData:data
+                                                         identifier:entry.identifier
+                                                            context:context
+                                                           location:&slabLocation];
+            }
+
+            NSUInteger fileSize = 0;
             if (success) {
-                existingEntry.completeImageContext = [entry.completeImageContext copy];
-                existingEntry.completeFileSize = (NSUInteger)TIPFileSizeAtPath(filePath, NULL);
+                // stored in a slab
+            } else if (filePath && data.length > 0) {
+                fileSize = (NSUInteger)TIPImageDiskCacheEntryFileWrite(filePath, data, entry.identifier, context, &error);
+                success = fileSize > 0;
+            }
+
+            if (success) {
+                existingEntry.completeImageContext = context;
+                existingEntry.completeFileSize = (slabLocation.slabIdentifier) ? data.length : fileSize;
+                existingEntry.slabLocation = slabLocation;
 
                 // Clear partial on new entry since we set the complete image
                 entry.partialImage = nil;
@@ -909,9 +1046,13 @@ TIP_OBJC_DIRECT_MEMBERS
 
             if (entry.partialImage && !newIsPlaceholder) {
                 NSError *error = nil;
-                if ([entry.partialImage.data writeToFile:partialFilePath options:NSDataWritingAtomic error:&error]) {
-                    existingEntry.partialImageContext = [entry.partialImageContext copy];
-                    existingEntry.partialFileSize = entry.partialImage.byteCount;
+                TIPPartialImageEntryContext *context = [entry.partialImageContext copy];
+                _TouchContext(context); // written along with the image, no need to touch after
+                // account for the whole file, as with complete entry files and when the manifest is loaded
+                const NSUInteger fileSize = (NSUInteger)TIPImageDiskCacheEntryFileWrite(partialFilePath, entry.partialImage.data, entry.identifier, context, &error);
+                if (fileSize) {
+                    existingEntry.partialImageContext = context;
+                    existingEntry.partialFileSize = fileSize;
                 } else {
                     TIPLogError(@"Failed to write partial image! %@", @{ @"data.length" : @(entry.partialImage.data.length), @"filePath" : partialFilePath, @"error" : (error) ?: @"???" });
                 }
@@ -959,7 +1100,7 @@ TIP_OBJC_DIRECT_MEMBERS
                                    };
         [_globalConfig postProblem:TIPProblemImageTooLargeToStoreInDiskCache userInfo:userInfo];
 
-        [fm removeItemAtPath:filePath error:NULL];
+        [self _diskCache_removeCompleteImageOfEntry:existingEntry filePath:filePath];
         existingEntry.completeImage = nil;
         existingEntry.completeImageContext = nil;
         existingEntry.completeFileSize = 0;
@@ -973,7 +1114,7 @@ TIP_OBJC_DIRECT_MEMBERS
         }
     } else {
 
-        // Update xattrs and LRU
+        // Update LRU (the metadata was written with the images)
         const NSUInteger newCost = existingEntry.partialFileSize + existingEntry.completeFileSize;
         [self _diskCache_updateByteCountsAdded:newCost removed:oldCost];
         if (!hasPreviousEntry && existingEntry) {
@@ -981,16 +1122,7 @@ TIP_OBJC_DIRECT_MEMBERS
         }
 
         [manifest addEntry:existingEntry];
-        if (didChangePartial) {
-            [self _diskCache_touchEntry:existingEntry
-                                 forced:forciblyReplaceExisting
-                                partial:YES];
-        }
-        if (didChangeComplete) {
-            [self _diskCache_touchEntry:existingEntry
-                                 forced:forciblyReplaceExisting
-                                partial:NO];
-        }
+        [self _diskCache_indexEntry:existingEntry];
 
         if (gTwitterImagePipelineAssertEnabled) {
             if (existingEntry.partialImageContext && 0 == existingEntry.partialFileSize) {
@@ -1015,6 +1147,57 @@ TIP_OBJC_DIRECT_MEMBERS
     [_globalConfig pruneAllCachesOfType:self.cacheType withPriorityCache:self];
 }
 
+- (BOOL)_diskCache_expireEntry:(TIPImageDiskCacheEntry *)entry
+                        atTime:(CFAbsoluteTime)now
+{
+    const NSUInteger oldCost = entry.completeFileSize + entry.partialFileSize;
+
+    TIPPartialImageEntryContext *partialContext = entry.partialImageContext;
+    if (partialContext && _ContextHasExpired(partialContext, now)) {
+        entry.partialImageContext = nil;
+        entry.partialImage = nil;
+        entry.partialFileSize = 0;
+    }
+    TIPCompleteImageEntryContext *completeContext = entry.completeImageContext;
+    if (completeContext && _ContextHasExpired(completeContext, now)) {
+        if (entry.slabLocation.slabIdentifier) {
+            [self _diskCache_removeCompleteImageOfEntry:entry filePath:nil];
+        }
+        entry.completeImageContext = nil;
+        entry.completeImage = nil;
+        entry.completeFileSize = 0;
+    }
+
+    // Resolve changes to entry
+    const NSUInteger newCost = entry.completeFileSize + entry.partialFileSize;
+    TIPAssert(newCost <= oldCost); // removing the cache image and/or partial image only ever removes bytes
+    [self _diskCache_updateByteCountsAdded:newCost removed:oldCost];
+    if (!newCost) {
+        [[self diskCache_syncAccessManifest] removeEntry:entry];
+        return NO;
+    }
+
+    [self _diskCache_indexEntry:entry];
+    return YES;
+}
+
+- (void)_diskCache_expireEntries:(NSArray<TIPImageCacheEntry *> *)entries
+{
+    TIPStartMethodScopedBackgroundTask(ExpireEntries);
+    const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    for (TIPImageDiskCacheEntry *entry in entries) {
+        [self _diskCache_expireEntry:entry atTime:now];
+    }
+    TIPLogDebug(@"%@ expired %tu entries", NSStringFromClass([self class]), entries.count);
+}
+
+- (void)_diskCache_indexEntry:(TIPImageDiskCacheEntry *)entry
+{
+    TIPCompleteImageEntryContext *completeContext = entry.completeImageContext;
+    completeContext.staleRetentionTTL = _StaleRetentionTTL(completeContext);
+    [_expiryIndex updateEntry:entry];
+}
+
 - (BOOL)_diskCache_touchImage:(NSString *)safeIdentifier
                        forced:(BOOL)forced
 {
@@ -1024,9 +1207,12 @@ TIP_OBJC_DIRECT_MEMBERS
         [self _diskCache_touchEntry:entry
                              forced:forced
                             partial:YES];
-        [self _diskCache_touchEntry:entry
-                             forced:forced
-                            partial:NO];
+        // a stale complete image is only kept to be revalidated, accessing it does not make it fresh
+        if (![entry.completeImageContext isStaleAsOf:CFAbsoluteTimeGetCurrent()]) {
+            [self _diskCache_touchEntry:entry
+                                 forced:forced
+                                partial:NO];
+        }
     }
     return entry != nil;
 }
@@ -1040,13 +1226,19 @@ TIP_OBJC_DIRECT_MEMBERS
         return;
     }
 
-    if (context.updateExpiryOnAccess || !context.lastAccess) {
-        context.lastAccess = [NSDate date];
+    if (_TouchContext(context)) {
+        [self _diskCache_indexEntry:entry];
     } else if (!forced) {
         return;
     }
 
-    NSDictionary *xattrs = _XAttributesFromContext(context);
+    if (!partial && entry.slabLocation.slabIdentifier) {
+        // the rest of the record's metadata does not change
+        [_slabStore setLastAccess:context.lastAccess
+              forRecordAtLocation:entry.slabLocation];
+        return;
+    }
+
     NSString *filePath = [self filePathForSafeIdentifier:entry.safeIdentifier];
     if (partial) {
         filePath = [filePath stringByAppendingPathExtension:kPartialImageExtension];
@@ -1057,32 +1249,45 @@ TIP_OBJC_DIRECT_MEMBERS
         return;
     }
 
-    const NSUInteger numberOfSetXAttributes = TIPSetXAttributesForFile(xattrs, filePath);
-    if (numberOfSetXAttributes != xattrs.count) {
+    if (!_UpdateEntryFile(filePath, entry.identifier, context, NO /*identifierChanged*/)) {
         NSDictionary *info = @{
                                @"filePath" : filePath,
                                @"id" : entry.identifier,
                                @"safeId" : entry.safeIdentifier,
-                               @"xattrs" : xattrs
                                };
-        TIPLogError(@"Error writing xattrs! (wrote %tu of %tu)\n%@", numberOfSetXAttributes, xattrs.count, info);
+        TIPLogError(@"Error writing entry file metadata!\n%@", info);
     }
-
-#if DEBUG
-    NSDictionary *xattrsRoundTrip = TIPGetXAttributesForFile(filePath, _XAttributesKeysToKindsMap());
-    TIPAssertMessage([xattrs isEqualToDictionary:xattrsRoundTrip], @"xattrs differ!\nSet: %@\nGet: %@", xattrs, xattrsRoundTrip);
-#endif
 }
 
 - (void)_diskCache_clearAllImages
 {
     TIPStartMethodScopedBackgroundTask(ClearAllImages);
-    TIPLRUCache *manifest = [self diskCache_syncAccessManifest];
-    const SInt16 totalCount = (SInt16)manifest.numberOfEntries;
-    [manifest clearAllEntries];
+    TIPLRUCache *oldManifest = [self diskCache_syncAccessManifest];
+    const SInt16 totalCount = (SInt16)oldManifest.numberOfEntries;
+
+    // Swap in a fresh manifest and tear down the old one in the background
+    // (it can have thousands of entries to unlink)
+    TIPLRUCache *newManifest = [[TIPLRUCache alloc] initWithEntries:nil delegate:self];
+    dispatch_sync(_manifestQueue, ^{
+        self->_manifest = newManifest;
+    });
+    oldManifest.delegate = nil;
+    [_expiryIndex removeAllEntries];
+    tip_dispatch_async_autoreleasing(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        [oldManifest clearAllEntries];
+    });
+
     [self _diskCache_updateByteCountsAdded:0 removed:(UInt64)self.atomicTotalSize];
     _globalConfig.internalTotalCountForAllDiskCaches -= totalCount;
-    [[NSFileManager defaultManager] removeItemAtPath:_cachePath error:NULL];
+
+    // The slabs are within the cache directory
+    [_slabStore resetSlabs];
+
+    // Atomically move the whole cache directory to the trash instead of deleting each file
+    // on the disk cache queue.  The directory will be recreated with the next write.
+    if (![_reclaimer trashItemAtPath:_cachePath toTrashPath:_trashPath]) {
+        [[NSFileManager defaultManager] removeItemAtPath:_cachePath error:NULL];
+    }
     TIPLogInformation(@"Cleared all images in %@", self);
 }
 
@@ -1107,7 +1312,7 @@ TIP_OBJC_DIRECT_MEMBERS
 
     NSString * const partialPath = [finalPath stringByAppendingPathExtension:kPartialImageExtension];
     NSString * const safeIdentifier = [finalPath lastPathComponent];
-    TIPAssert([safeIdentifier isEqualToString:TIPSafeFromRaw(tempFile.imageIdentifier)]);
+    TIPAssert([safeIdentifier isEqualToString:TIPHashedKeyFromRaw(tempFile.imageIdentifier)]);
 
     [self _diskCache_ensureCacheDirectoryExists];
 
@@ -1125,8 +1330,10 @@ TIP_OBJC_DIRECT_MEMBERS
         return;
     }
 
+    // the temporary file starts with the reserved entry file header
     NSUInteger const size = (NSUInteger)TIPFileSizeAtPath(tempFile.temporaryPath, NULL);
-    if (!size) {
+    NSUInteger const payloadLength = (size > TIPImageDiskCacheEntryFileHeaderLength) ? size - TIPImageDiskCacheEntryFileHeaderLength : 0;
+    if (!payloadLength) {
         [self clearTemporaryFilePath:tempFile.temporaryPath];
         return;
     }
@@ -1134,6 +1341,12 @@ TIP_OBJC_DIRECT_MEMBERS
     NSFileManager * const fm = [NSFileManager defaultManager];
     TIPLRUCache * const manifest = [self diskCache_syncAccessManifest];
     TIPImageDiskCacheEntry *entry = (TIPImageDiskCacheEntry *)[manifest entryWithIdentifier:safeIdentifier];
+    if (entry && ![entry.identifier isEqualToString:tempFile.imageIdentifier]) {
+        // hashed key collision, the newer entry takes over the key
+        TIPLogWarning(@"%@ key collision between '%@' and '%@'", NSStringFromClass([self class]), entry.identifier, tempFile.imageIdentifier);
+        [manifest removeEntry:entry];
+        entry = nil;
+    }
     TIPImageCacheEntryContext * const oldPartialContext = entry.partialImageContext;
     TIPImageCacheEntryContext * const oldCompleteContext = entry.completeImageContext;
     CGSize const newDimensions = context.dimensions;
@@ -1159,13 +1372,14 @@ TIP_OBJC_DIRECT_MEMBERS
 
             if (oldCompleteContext) {
                 const BOOL oldSizeTooSmall = (oldCompleteDimensions.width * oldCompleteDimensions.height) < (newDimensions.width * newDimensions.height);
-                if (oldSizeTooSmall || oldCompleteContext.treatAsPlaceholder) {
-                    // if the old complete image is smaller, remove it
+                const BOOL oldIsStale = [(TIPCompleteImageEntryContext *)oldCompleteContext isStaleAsOf:CFAbsoluteTimeGetCurrent()];
+                if (oldSizeTooSmall || oldIsStale || oldCompleteContext.treatAsPlaceholder) {
+                    // if the old complete image is smaller (or was only kept to be revalidated), remove it
                     [self _diskCache_updateByteCountsAdded:0
                                                    removed:entry.completeFileSize];
                     entry.completeFileSize = 0;
                     entry.completeImageContext = nil;
-                    [fm removeItemAtPath:finalPath error:NULL];
+                    [self _diskCache_removeCompleteImageOfEntry:entry filePath:finalPath];
                 } else {
                     // otherwise, clear ourself
                     [self clearTemporaryFilePath:tempFile.temporaryPath];
@@ -1196,12 +1410,40 @@ TIP_OBJC_DIRECT_MEMBERS
         }
     }
 
-    // 2) Move our new bytes into the disk cache
+    // 2) Move our new bytes into the disk cache (small complete images go to a slab)
 
+    context = [context copy];
+    _TouchContext(context); // written along with the image, no need to touch after
     NSError *error;
-    if ([fm moveItemAtPath:tempFile.temporaryPath toPath:(isPartial) ? partialPath : finalPath error:&error]) {
-        context = [context copy];
+    BOOL stored = NO;
+    NSUInteger storedSize = 0;
+    TIPImageDiskCacheSlabLocation slabLocation = { 0, 0 };
+    if (!isPartial && payloadLength <= TIPImageDiskCacheSlabRecordMaxDataLength) {
+        NSData *data = [NSData dataWithContentsOfFile:tempPath];
+        if (data.length == size) {
+            stored = [self _diskCache_appendSlabRecordWithData:[data subdataWithRange:NSMakeRange(TIPImageDiskCacheEntryFileHeaderLength, payloadLength)]
+                                                    identifier:tempFile.imageIdentifier
+                                                       context:context
+                                                      location:&slabLocation];
+        }
+        if (stored) {
+            storedSize = payloadLength;
+            [self clearTemporaryFilePath:tempPath];
+        }
+    }
+    if (!stored) {
+        // write the metadata into the file, then it is just a move
+        storedSize = (NSUInteger)TIPImageDiskCacheEntryFileFinalize(tempPath, tempFile.imageIdentifier, context);
+        if (storedSize) {
+            stored = [fm moveItemAtPath:tempPath toPath:(isPartial) ? partialPath : finalPath error:&error];
+        } else {
+            error = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                        code:EIO
+                                    userInfo:@{ @"temporaryPath" : tempPath }];
+        }
+    }
 
+    if (stored) {
         const BOOL newEntry = !entry;
         if (!entry) {
             entry = [[TIPImageDiskCacheEntry alloc] init];
@@ -1209,14 +1451,15 @@ TIP_OBJC_DIRECT_MEMBERS
         }
 
         if (isPartial) {
-            entry.partialFileSize = size;
+            entry.partialFileSize = storedSize;
             entry.partialImageContext = (id)context;
         } else {
-            entry.completeFileSize = size;
+            entry.completeFileSize = storedSize;
             entry.completeImageContext = (id)context;
+            entry.slabLocation = slabLocation;
         }
 
-        [self _diskCache_updateByteCountsAdded:size removed:0];
+        [self _diskCache_updateByteCountsAdded:storedSize removed:0];
         if (newEntry) {
             _globalConfig.internalTotalCountForAllDiskCaches += 1;
         }
@@ -1239,9 +1482,7 @@ TIP_OBJC_DIRECT_MEMBERS
         }
 
         [manifest addEntry:entry];
-        [self _diskCache_touchEntry:entry
-                             forced:YES
-                            partial:isPartial];
+        [self _diskCache_indexEntry:entry];
         [_globalConfig pruneAllCachesOfType:self.cacheType withPriorityCache:self];
     } else {
         TIPLogWarning(@"%@", error);
@@ -1280,7 +1521,7 @@ TIP_OBJC_DIRECT_MEMBERS
                                        newIdentifier:(NSString *)newIdentifier
                                                error:(out NSError * __nullable * __nullable)errorOut
 {
-    NSString *oldSafeID = TIPSafeFromRaw(oldIdentifier);
+    NSString *oldSafeID = TIPHashedKeyFromRaw(oldIdentifier);
     TIPLRUCache *manifest = [self diskCache_syncAccessManifest];
     TIPImageDiskCacheEntry *oldEntry = (TIPImageDiskCacheEntry *)[manifest entryWithIdentifier:oldSafeID
                                                                                      canMutate:NO];
@@ -1293,28 +1534,46 @@ TIP_OBJC_DIRECT_MEMBERS
         return NO;
     }
 
-    NSString *newSafeID = TIPSafeFromRaw(newIdentifier);
+    NSString *newSafeID = TIPHashedKeyFromRaw(newIdentifier);
     TIPCompleteImageEntryContext *completeContext = oldEntry.completeImageContext;
-    NSString *oldCompleteFilePath = (completeContext) ? [self filePathForSafeIdentifier:oldSafeID] : nil;
+    const BOOL isInSlab = oldEntry.slabLocation.slabIdentifier != 0;
+    NSString *oldCompleteFilePath = (completeContext && !isInSlab) ? [self filePathForSafeIdentifier:oldSafeID] : nil;
     TIPPartialImageEntryContext *partialContext = oldEntry.partialImageContext;
     NSString *oldPartialFilePath = (partialContext) ? [[self filePathForSafeIdentifier:oldSafeID] stringByAppendingPathExtension:kPartialImageExtension] : nil;
 
     NSError *error = nil;
     BOOL fail = NO;
-    if (oldCompleteFilePath) {
-        NSString *newCompleteFilePath = [self filePathForSafeIdentifier:newSafeID];
+    TIPImageDiskCacheSlabLocation newSlabLocation = { 0, 0 };
+    NSString *newCompleteFilePath = nil;
+    NSString *newPartialFilePath = nil;
+    if (completeContext && isInSlab) {
+        // the record's metadata has the identifier, so append a new record
+        NSData *data = [_slabStore dataForRecordAtLocation:oldEntry.slabLocation
+                                                dataLength:oldEntry.completeFileSize];
+        fail = !data || ![self _diskCache_appendSlabRecordWithData:data
+                                                        identifier:newIdentifier
+                                                           context:completeContext
+                                                          location:&newSlabLocation];
+        if (fail) {
+            error = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                        code:EIO
+                                    userInfo:nil];
+        }
+    } else if (oldCompleteFilePath) {
+        newCompleteFilePath = [self filePathForSafeIdentifier:newSafeID];
         fail = ![[NSFileManager defaultManager] moveItemAtPath:oldCompleteFilePath
                                                         toPath:newCompleteFilePath
                                                          error:&error];
     }
 
     if (!fail && oldPartialFilePath) {
-        NSString *newPartialFilePath = [[self filePathForSafeIdentifier:newSafeID] stringByAppendingPathExtension:kPartialImageExtension];
+        newPartialFilePath = [[self filePathForSafeIdentifier:newSafeID] stringByAppendingPathExtension:kPartialImageExtension];
         fail = ![[NSFileManager defaultManager] moveItemAtPath:oldPartialFilePath
                                                         toPath:newPartialFilePath
                                                          error:&error];
         if (fail) {
-            if (oldCompleteFilePath) {
+            newPartialFilePath = nil;
+            if (oldCompleteFilePath || newSlabLocation.slabIdentifier) {
                 // complete images take precedence over partial
                 fail = NO;
                 error = nil;
@@ -1326,8 +1585,17 @@ TIP_OBJC_DIRECT_MEMBERS
     if (!fail) {
         TIPImageDiskCacheEntry *newEntry = [oldEntry copy];
         newEntry.identifier = newIdentifier;
-        [manifest removeEntry:oldEntry];
+        newEntry.slabLocation = newSlabLocation;
+        [manifest removeEntry:oldEntry]; // frees the old slab record
         [manifest addEntry:newEntry];
+        [self _diskCache_indexEntry:newEntry];
+        // the moved files still carry the old identifier
+        if (newPartialFilePath) {
+            _UpdateEntryFile(newPartialFilePath, newIdentifier, newEntry.partialImageContext, YES /*identifierChanged*/);
+        }
+        if (newCompleteFilePath) {
+            _UpdateEntryFile(newCompleteFilePath, newIdentifier, newEntry.completeImageContext, YES /*identifierChanged*/);
+        }
         [self _diskCache_updateByteCountsAdded:newEntry.completeFileSize + newEntry.partialFileSize
                                        removed:0];
         _globalConfig.internalTotalCountForAllDiskCaches += 1;
@@ -1340,6 +1608,111 @@ TIP_OBJC_DIRECT_MEMBERS
     return !fail;
 }
 
+- (BOOL)_diskCache_appendSlabRecordWithData:(NSData *)data
+                                 identifier:(NSString *)identifier
+                                    context:(TIPImageCacheEntryContext *)context
+                                   location:(out TIPImageDiskCacheSlabLocation *)locationOut
+{
+    NSData *metadata = _SlabMetadataFromXAttributes(_XAttributesFromContext(identifier, context));
+    if (!metadata) {
+        return NO;
+    }
+
+    return [_slabStore appendRecordWithData:data
+                                   metadata:metadata
+                                 lastAccess:context.lastAccess
+                                   location:locationOut];
+}
+
+- (void)_diskCache_removeCompleteImageOfEntry:(TIPImageDiskCacheEntry *)entry
+                                     filePath:(nullable NSString *)filePath
+{
+    if (entry.slabLocation.slabIdentifier) {
+        [_slabStore freeRecordAtLocation:entry.slabLocation];
+        entry.slabLocation = (TIPImageDiskCacheSlabLocation){ 0, 0 };
+        [self _diskCache_scheduleSlabCompactionIfNeeded];
+    } else if (filePath) {
+        [[NSFileManager defaultManager] removeItemAtPath:filePath error:NULL];
+    }
+}
+
+- (void)_diskCache_scheduleSlabCompactionIfNeeded
+{
+    if (_diskCache_flags.slabCompactionScheduled || ![_slabStore slabIdentifierNeedingCompaction]) {
+        return;
+    }
+
+    _diskCache_flags.slabCompactionScheduled = YES;
+    __weak typeof(self) weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kSlabCompactionDelay * NSEC_PER_SEC)), _globalConfig.queueForDiskCaches, ^{
+        @autoreleasepool {
+            [weakSelf _diskCache_compactSlabs];
+        }
+    });
+}
+
+- (void)_diskCache_compactSlabs
+{
+    _diskCache_flags.slabCompactionScheduled = NO;
+    const UInt32 slabIdentifier = [_slabStore slabIdentifierNeedingCompaction];
+    if (!slabIdentifier) {
+        return;
+    }
+
+    TIPStartMethodScopedBackgroundTask(CompactSlabs);
+    TIPLRUCache *manifest = [self diskCache_syncAccessManifest];
+    NSMutableArray<TIPImageDiskCacheEntry *> *unreadableEntries = nil;
+    NSUInteger relocatedCount = 0;
+    BOOL didRelocateAll = YES;
+    for (TIPImageDiskCacheEntry *entry in manifest) {
+        if (entry.slabLocation.slabIdentifier != slabIdentifier) {
+            continue;
+        }
+        if (relocatedCount >= kSlabCompactionBatchSize) {
+            didRelocateAll = NO;
+            break;
+        }
+
+        NSData *data = [_slabStore dataForRecordAtLocation:entry.slabLocation
+                                                dataLength:entry.completeFileSize];
+        TIPImageDiskCacheSlabLocation newLocation = { 0, 0 };
+        if (!data) {
+            if (!unreadableEntries) {
+                unreadableEntries = [[NSMutableArray alloc] init];
+            }
+            [unreadableEntries addObject:entry];
+        } else if ([self _diskCache_appendSlabRecordWithData:data
+                                                  identifier:entry.identifier
+                                                     context:entry.completeImageContext
+                                                    location:&newLocation]) {
+            entry.slabLocation = newLocation;
+        } else {
+            // cannot write right now, compaction will be attempted again with the next free
+            return;
+        }
+        relocatedCount++;
+    }
+
+    for (TIPImageDiskCacheEntry *entry in unreadableEntries) {
+        entry.slabLocation = (TIPImageDiskCacheSlabLocation){ 0, 0 };
+        [manifest removeEntry:entry];
+    }
+
+    if (didRelocateAll) {
+        [_slabStore removeSlab:slabIdentifier];
+        TIPLogDebug(@"%@ compacted slab %u, %llu of %llu slab bytes are freed", NSStringFromClass([self class]), slabIdentifier, _slabStore.freedSlabBytes, _slabStore.totalSlabBytes);
+    }
+
+    if (!didRelocateAll || [_slabStore slabIdentifierNeedingCompaction]) {
+        // continue after yielding the queue
+        _diskCache_flags.slabCompactionScheduled = YES;
+        __weak typeof(self) weakSelf = self;
+        tip_dispatch_async_autoreleasing(_globalConfig.queueForDiskCaches, ^{
+            [weakSelf _diskCache_compactSlabs];
+        });
+    }
+}
+
 @end
 
 @implementation TIPImageDiskCache (PrivateExposed)
@@ -1361,44 +1734,44 @@ TIP_OBJC_DIRECT_MEMBERS
     @autoreleasepool {
         [self _diskCache_updateImageEntry:entry
                   forciblyReplaceExisting:force
-                           safeIdentifier:TIPSafeFromRaw(entry.identifier)];
+                           safeIdentifier:TIPHashedKeyFromRaw(entry.identifier)];
     }
 }
 
-- (nullable NSString *)diskCache_imageEntryFilePathForIdentifier:(NSString *)identifier
-                                        hitShouldMoveEntryToHead:(BOOL)hitToHead
-                                                         context:(out TIPImageCacheEntryContext * __autoreleasing __nullable * __nullable)contextOut
+- (nullable NSData *)diskCache_imageEntryDataForIdentifier:(NSString *)identifier
+                                  hitShouldMoveEntryToHead:(BOOL)hitToHead
+                                                   context:(out TIPImageCacheEntryContext * __autoreleasing __nullable * __nullable)contextOut
 {
+    NSData *data = nil;
     TIPCompleteImageEntryContext *context = nil;
-    NSFileManager *fm = [NSFileManager defaultManager];
-    NSString *safeIdentifer = TIPSafeFromRaw(identifier);
+    NSString *safeIdentifer = TIPHashedKeyFromRaw(identifier);
     NSString *filePath = [self filePathForSafeIdentifier:safeIdentifer];
 
     if (_diskCache_flags.manifestIsLoading) {
-        if ([fm fileExistsAtPath:filePath]) {
-            const NSUInteger size = TIPFileSizeAtPath(filePath, NULL);
-            if (size) {
-                NSDictionary *xattributes = TIPGetXAttributesForFile(filePath, _XAttributesKeysToKindsMapForCompleteEntry());
-                context = (id)_ContextFromXAttributes(xattributes, NO);
-                if (![context isKindOfClass:[TIPCompleteImageEntryContext class]]) {
-                    context = nil;
-                }
-            }
+        // only the files can be read until the manifest (with the slab records) is loaded
+        NSString *rawIdentifier = nil;
+        context = (id)_ReadEntryFileContext(filePath, NO, &rawIdentifier);
+        if ([context isKindOfClass:[TIPCompleteImageEntryContext class]] && [rawIdentifier isEqualToString:identifier]) {
+            data = TIPImageDiskCacheEntryFileReadPayload(filePath, YES /*memoryMap*/);
         }
     } else {
-        TIPImageCacheEntry *entry = (TIPImageCacheEntry *)[_manifest entryWithIdentifier:safeIdentifer
-                                                                               canMutate:hitToHead];
-        context = [entry.completeImageContext copy];
-    }
-
-    if (!context) {
-        filePath = nil;
+        TIPImageDiskCacheEntry *entry = (TIPImageDiskCacheEntry *)[_manifest entryWithIdentifier:safeIdentifer
+                                                                                       canMutate:hitToHead];
+        if (entry.completeImageContext && [entry.identifier isEqualToString:identifier]) {
+            if (entry.slabLocation.slabIdentifier) {
+                data = [_slabStore dataForRecordAtLocation:entry.slabLocation
+                                                dataLength:entry.completeFileSize];
+            } else {
+                data = TIPImageDiskCacheEntryFileReadPayload(filePath, YES /*memoryMap*/);
+            }
+            context = entry.completeImageContext;
+        }
     }
 
     if (contextOut) {
-        *contextOut = context;
+        *contextOut = (data) ? [context copy] : nil;
     }
-    return filePath;
+    return data;
 }
 
 - (nullable TIPImageDiskCacheEntry *)diskCache_imageEntryForIdentifier:(NSString *)identifier
@@ -1466,6 +1839,35 @@ TIP_OBJC_DIRECT_MEMBERS
         NSMutableArray<TIPImageDiskCacheEntry *> *entries = [[NSMutableArray alloc] init];
         NSMutableArray<NSString *> *falseEntryPaths = [[NSMutableArray alloc] init];
         NSMutableDictionary<NSString *, TIPImageDiskCacheEntry *> *manifest = [[NSMutableDictionary alloc] initWithCapacity:entryURLs.count];
+
+        // Load the slab records first (the files are loaded concurrently below)
+        [self->_slabStore loadRecordsUsingBlock:^BOOL(TIPImageDiskCacheSlabLocation location,
+                                                      NSUInteger dataLength,
+                                                      CFAbsoluteTime lastAccess,
+                                                      NSData *metadata) {
+            NSDictionary *xattrs = _XAttributesFromSlabMetadata(metadata, lastAccess);
+            NSString *rawIdentifier = xattrs[kXAttributeEntryIdentifierKey];
+            TIPImageCacheEntryContext *context = (rawIdentifier) ? _ContextFromXAttributes(xattrs, NO) : nil;
+            if (!context || _ContextHasExpired(context, now.timeIntervalSinceReferenceDate)) {
+                return NO;
+            }
+
+            NSString *safeIdentifier = TIPHashedKeyFromRaw(rawIdentifier);
+            if (manifest[safeIdentifier]) {
+                // duplicate record (from being interrupted), keep the first
+                return NO;
+            }
+
+            TIPImageDiskCacheEntry *entry = [[TIPImageDiskCacheEntry alloc] init];
+            entry.identifier = rawIdentifier;
+            entry.completeImageContext = (id)context;
+            entry.completeFileSize = dataLength;
+            entry.slabLocation = location;
+            manifest[safeIdentifier] = entry;
+            [entries addObject:entry];
+            totalSize += dataLength;
+            return YES;
+        }];
         NSOperationQueue *manifestCacheQueue = _ImageDiskCacheManifestCacheQueue();
         NSOperationQueue *manifestIOQueue = _ImageDiskCacheManifestIOQueue();
         dispatch_queue_t manifestAccessQueue = self->_manifestQueue;
@@ -1498,6 +1900,10 @@ TIP_OBJC_DIRECT_MEMBERS
         [finalCacheOperation addDependency:finalIOOperation];
 
         for (NSURL *entryURL in entryURLs) {
+            if ([entryURL.lastPathComponent isEqualToString:kSlabsDirectoryName]) {
+                continue;
+            }
+
             // putting the construction of the operation to load a manifest entry
             // in a function to avoid risking capturing self which can lead to a
             // retain cycle.
@@ -1534,20 +1940,26 @@ TIP_OBJC_DIRECT_MEMBERS
             self->_globalConfig.internalTotalCountForAllDiskCaches += count;
             [self _diskCache_updateByteCountsAdded:totalSize
                                            removed:removeSize];
+
+            // index the current manifest (it may have already been cleared and replaced)
+            for (TIPImageDiskCacheEntry *entry in [self diskCache_syncAccessManifest]) {
+                [self _diskCache_indexEntry:entry];
+            }
         }
     });
 }
 
 @end
 
-static NSDictionary * __nullable _XAttributesFromContext(TIPImageCacheEntryContext * __nullable context)
+static NSDictionary * __nullable _XAttributesFromContext(NSString *identifier,
+                                                        TIPImageCacheEntryContext * __nullable context)
 {
-    if (!context || !context.URL) {
+    if (!identifier || !context || !context.URL) {
         return nil;
     }
 
     if (!context.lastAccess) {
-        context.lastAccess = [NSDate date];
+        context.lastAccess = CFAbsoluteTimeGetCurrent();
     }
 
     NSMutableDictionary *d = [[NSMutableDictionary alloc] initWithCapacity:_XAttributesKeysToKindsMap().count];
@@ -1555,8 +1967,9 @@ static NSDictionary * __nullable _XAttributesFromContext(TIPImageCacheEntryConte
     TIPAssert(context.TTL > 0.0);
 
     // Alwasy set ALL values
+    d[kXAttributeEntryIdentifierKey] = identifier;
     d[kXAttributeContextURLKey] = context.URL;
-    d[kXAttributeContextLastAccessKey] = context.lastAccess;
+    d[kXAttributeContextLastAccessKey] = [NSDate dateWithTimeIntervalSinceReferenceDate:context.lastAccess];
     d[kXAttributeContextTTLKey] =  @(context.TTL);
     d[kXAttributeContextUpdateTLLOnAccessKey] = @(context.updateExpiryOnAccess);
     d[kXAttributeContextDimensionXKey] = @(context.dimensions.width);
@@ -1568,7 +1981,9 @@ static NSDictionary * __nullable _XAttributesFromContext(TIPImageCacheEntryConte
         d[kXAttributeContextLastModifiedKey] = partialContext.lastModified ?: @"!";
         d[kXAttributeContextExpectedSizeKey] = @(partialContext.expectedContentLength);
     } else {
-        d[kXAttributeContextLastModifiedKey] = @"!";
+        TIPCompleteImageEntryContext *completeContext = (id)context;
+        d[kXAttributeContextLastModifiedKey] = completeContext.lastModified ?: @"!";
+        d[kXAttributeContextETagKey] = completeContext.ETag ?: @"";
         d[kXAttributeContextExpectedSizeKey] = @0;
     }
 
@@ -1579,12 +1994,61 @@ static NSDictionary * __nullable _XAttributesFromContext(TIPImageCacheEntryConte
     return d;
 }
 
+static NSData * __nullable _SlabMetadataFromXAttributes(NSDictionary * __nullable xattrs)
+{
+    if (!xattrs) {
+        return nil;
+    }
+
+    // URLs are not property list objects
+    NSMutableDictionary *plist = [xattrs mutableCopy];
+    plist[kXAttributeContextURLKey] = [(NSURL *)xattrs[kXAttributeContextURLKey] absoluteString];
+    return [NSPropertyListSerialization dataWithPropertyList:plist
+                                                      format:NSPropertyListBinaryFormat_v1_0
+                                                     options:0
+                                                       error:NULL];
+}
+
+static NSDictionary * __nullable _XAttributesFromSlabMetadata(NSData *metadata,
+                                                             CFAbsoluteTime lastAccess)
+{
+    NSDictionary *plist = [NSPropertyListSerialization propertyListWithData:metadata
+                                                                    options:NSPropertyListImmutable
+                                                                     format:NULL
+                                                                      error:NULL];
+    if (![plist isKindOfClass:[NSDictionary class]]) {
+        return nil;
+    }
+
+    // Same rules as reading xattrs: only keep the known keys with the expected kinds
+    NSDictionary<NSString *, Class> *keysToKinds = _XAttributesKeysToKindsMap();
+    NSMutableDictionary *xattrs = [[NSMutableDictionary alloc] initWithCapacity:keysToKinds.count];
+    [keysToKinds enumerateKeysAndObjectsUsingBlock:^(NSString *key, Class kind, BOOL *stop) {
+        id value = plist[key];
+        if (kind == [NSURL class] && [value isKindOfClass:[NSString class]]) {
+            value = [NSURL URLWithString:value];
+        }
+        if ([value isKindOfClass:kind]) {
+            xattrs[key] = value;
+        }
+    }];
+
+    // the record header has the most recent access
+    xattrs[kXAttributeContextLastAccessKey] = [NSDate dateWithTimeIntervalSinceReferenceDate:lastAccess];
+    return xattrs;
+}
+
 static TIPImageCacheEntryContext * __nullable _ContextFromXAttributes(NSDictionary *xattrs, BOOL notYetComplete)
 {
     id val;
     TIPImageCacheEntryContext *context = nil;
     if (!notYetComplete) {
         context = [[TIPCompleteImageEntryContext alloc] init];
+        TIPCompleteImageEntryContext *completeContext = (id)context;
+        val = xattrs[kXAttributeContextLastModifiedKey];
+        completeContext.lastModified = [(NSString *)val length] < 4 ? nil : val;
+        val = xattrs[kXAttributeContextETagKey];
+        completeContext.ETag = [(NSString *)val length] ? val : nil;
     } else {
         context = [[TIPPartialImageEntryContext alloc] init];
         TIPPartialImageEntryContext *partialContext = (id)context;
@@ -1604,7 +2068,7 @@ static TIPImageCacheEntryContext * __nullable _ContextFromXAttributes(NSDictiona
     if (!val) {
         return nil;
     }
-    context.lastAccess = val;
+    context.lastAccess = [(NSDate *)val timeIntervalSinceReferenceDate];
 
     val = xattrs[kXAttributeContextTTLKey];
     if (!val) {
@@ -1654,17 +2118,29 @@ _ImageDiskCacheManifestLoadOperation(NSMutableDictionary<NSString *, TIPImageDis
         NSString *rawIdentifier = nil;
         NSError *error = nil;
         const BOOL isTmp = [[path pathExtension] isEqualToString:kPartialImageExtension];
-        NSString * const safeIdentifier = isTmp ? [path stringByDeletingPathExtension] : path;
+        NSString *safeIdentifier = isTmp ? [path stringByDeletingPathExtension] : path;
         NSString *entryPath = [entryURL path];
 
         const NSUInteger size = [[entryURL resourceValuesForKeys:@[NSURLFileSizeKey] error:&error][NSURLFileSizeKey] unsignedIntegerValue];
         if (!size) {
             TIPLogError(@"Could not get filesize of '%@': %@", entryURL, error);
         } else {
-            rawIdentifier = TIPRawFromSafe(safeIdentifier);
-
-            NSDictionary *xattrMap = isTmp ? _XAttributesKeysToKindsMap() : _XAttributesKeysToKindsMapForCompleteEntry();
-            context = (rawIdentifier) ? _ContextFromXAttributes(TIPGetXAttributesForFile(entryPath, xattrMap), isTmp) : nil;
+            context = _ReadEntryFileContext(entryPath, isTmp, &rawIdentifier);
+            if (!rawIdentifier) {
+                // file from before keys were hashed, move it to its hashed key
+                NSString *migratedPath = _MigrateLegacyEntryFile(entryPath, safeIdentifier, isTmp);
+                if (migratedPath) {
+                    entryPath = migratedPath;
+                    context = _ReadEntryFileContext(entryPath, isTmp, &rawIdentifier);
+                }
+            }
+            if (rawIdentifier) {
+                safeIdentifier = TIPHashedKeyFromRaw(rawIdentifier);
+                if (![safeIdentifier isEqualToString:[[entryPath lastPathComponent] stringByDeletingPathExtension]]) {
+                    // the file does not belong at this key
+                    context = nil;
+                }
+            }
             if (isTmp && ![context isKindOfClass:[TIPPartialImageEntryContext class]]) {
                 context = nil;
             } else if (!isTmp && [context isKindOfClass:[TIPPartialImageEntryContext class]]) {
@@ -1673,7 +2149,7 @@ _ImageDiskCacheManifestLoadOperation(NSMutableDictionary<NSString *, TIPImageDis
         }
 
         NSBlockOperation *cacheOp = [NSBlockOperation blockOperationWithBlock:^{
-            if (!context || ([timestamp timeIntervalSinceDate:context.lastAccess] > context.TTL)) {
+            if (!context || _ContextHasExpired(context, timestamp.timeIntervalSinceReferenceDate)) {
                 [falseEntryPaths addObject:entryPath];
                 return;
             }
@@ -1682,6 +2158,11 @@ _ImageDiskCacheManifestLoadOperation(NSMutableDictionary<NSString *, TIPImageDis
             TIPImageDiskCacheEntry *entry = nil;
 
             entry = manifest[safeIdentifier];
+            if (entry && !isTmp && entry.completeImageContext) {
+                // the complete image was already loaded from a slab
+                [falseEntryPaths addObject:entryPath];
+                return;
+            }
             if (!entry) {
                 entry = [[TIPImageDiskCacheEntry alloc] init];
                 entry.identifier = rawIdentifier;
@@ -1815,24 +2296,73 @@ static dispatch_queue_t _ImageDiskCacheManifestAccessQueue()
 static void _SortEntries(NSMutableArray<TIPImageDiskCacheEntry *> *entries)
 {
     [entries sortUsingComparator:^NSComparisonResult(TIPImageDiskCacheEntry *entry1, TIPImageDiskCacheEntry *entry2) {
-        NSDate *lastAccess1 = entry1.mostRecentAccess;
-        NSDate *lastAccess2 = entry2.mostRecentAccess;
+        const CFAbsoluteTime lastAccess1 = entry1.mostRecentAccess;
+        const CFAbsoluteTime lastAccess2 = entry2.mostRecentAccess;
 
-        // Simple check if both are nil (or identical)
+        // Most recent first (a missing access of 0 sorts to the end)
         if (lastAccess1 == lastAccess2) {
             return NSOrderedSame;
         }
+        return (lastAccess1 > lastAccess2) ? NSOrderedAscending : NSOrderedDescending;
+    }];
+}
 
-        // Put the missing access at the end
-        if (!lastAccess1) {
-            return NSOrderedDescending;
-        } else if (!lastAccess2) {
-            return NSOrderedAscending;
-        }
+static NSString * __nullable _MigrateLegacyEntryFile(NSString *entryPath,
+                                                     NSString *legacySafeIdentifier,
+                                                     BOOL isTmp)
+{
+    // Legacy file names were the URL encoded identifier.
+    // Names that were too long had been hashed and cannot be recovered.
+    NSString *rawIdentifier = TIPRawFromSafe(legacySafeIdentifier);
+    if (!rawIdentifier || ![TIPSafeFromRaw(rawIdentifier) isEqualToString:legacySafeIdentifier]) {
+        return nil;
+    }
 
-        // Full compare
-        return [lastAccess2 compare:lastAccess1];
-    }];
+    NSString *migratedPath = [[entryPath stringByDeletingLastPathComponent] stringByAppendingPathComponent:TIPHashedKeyFromRaw(rawIdentifier)];
+    if (isTmp) {
+        migratedPath = [migratedPath stringByAppendingPathExtension:kPartialImageExtension];
+    }
+    if (0 != rename(entryPath.fileSystemRepresentation, migratedPath.fileSystemRepresentation)) {
+        return nil;
+    }
+    if (1 != TIPSetXAttributesForFile(@{ kXAttributeEntryIdentifierKey : rawIdentifier }, migratedPath)) {
+        return nil;
+    }
+    return migratedPath;
+}
+
+static TIPImageCacheEntryContext * __nullable _ReadEntryFileContext(NSString *filePath,
+                                                                    BOOL partial,
+                                                                    NSString * __nullable * __nullable identifierOut)
+{
+    TIPImageCacheEntryContext *context = TIPImageDiskCacheEntryFileReadContext(filePath, identifierOut);
+    if (context) {
+        return context;
+    }
+
+    // legacy file, the metadata is in its xattrs
+    NSDictionary *xattrMap = (partial) ? _XAttributesKeysToKindsMap() : _XAttributesKeysToKindsMapForCompleteEntry();
+    NSDictionary *xattrs = TIPGetXAttributesForFile(filePath, xattrMap);
+    NSString *identifier = xattrs[kXAttributeEntryIdentifierKey];
+    context = (identifier) ? _ContextFromXAttributes(xattrs, partial) : nil;
+    if (identifierOut) {
+        *identifierOut = (context) ? identifier : nil;
+    }
+    return context;
+}
+
+static BOOL _UpdateEntryFile(NSString *filePath,
+                             NSString *identifier,
+                             TIPImageCacheEntryContext *context,
+                             BOOL identifierChanged)
+{
+    if (TIPImageDiskCacheEntryFileUpdate(filePath, (identifierChanged) ? identifier : nil, context)) {
+        return YES;
+    }
+
+    // legacy file, migrate it to an entry file now that it is being written to
+    NSData *payload = TIPImageDiskCacheEntryFileReadPayload(filePath, NO);
+    return payload.length > 0 && TIPImageDiskCacheEntryFileWrite(filePath, payload, identifier, context, NULL) > 0;
 }
 
 NS_ASSUME_NONNULL_END
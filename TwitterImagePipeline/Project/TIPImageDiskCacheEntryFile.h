@@ -0,0 +1,70 @@
+//
+//  TIPImageDiskCacheEntryFile.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+#import "TIPImageCacheEntry.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*
+ Disk cache entry files carry their metadata inline instead of in xattrs.
+
+ An entry file is a fixed size binary header, then the payload (the image bytes), then the
+ variable length metadata (identifier, URL, Last-Modified and ETag).  The header has everything that
+ changes (such as the last access) and the lengths needed to find the rest, so touching an entry
+ is a single `pwrite` and reading its metadata is two `pread`s.
+ Putting the variable length metadata after the payload means a file that is downloaded into can
+ reserve the header up front and keep appending, with the header written when it is finalized.
+
+ Files without a valid header are legacy files (with xattrs) and are entirely payload.
+ */
+
+//! Bytes at the start of every entry file for its header, reserve them before appending a payload
+FOUNDATION_EXTERN const NSUInteger TIPImageDiskCacheEntryFileHeaderLength;
+
+/**
+ Atomically write the entry file for _payload_ to _filePath_ (with a single write).
+ The file is written beside _filePath_ and then renamed over it, so it never crosses volumes.
+ Returns the length of the written file (header and metadata included, like every entry file's
+ accounted size), `0` on failure.
+ */
+FOUNDATION_EXTERN UInt64 TIPImageDiskCacheEntryFileWrite(NSString *filePath,
+                                                         NSData *payload,
+                                                         NSString *identifier,
+                                                         TIPImageCacheEntryContext *context,
+                                                         NSError * __nullable * __nullable outError);
+
+/**
+ Finalize the file at _filePath_ that had its payload appended after reserving the header.
+ Returns the length of the finalized file, `0` on failure.
+ */
+FOUNDATION_EXTERN UInt64 TIPImageDiskCacheEntryFileFinalize(NSString *filePath,
+                                                            NSString *identifier,
+                                                            TIPImageCacheEntryContext *context);
+
+/**
+ Rewrite the header of the entry file at _filePath_ from _context_.
+ Provide the _identifier_ when it changed to also rewrite the variable length metadata.
+ Returns `NO` if the file is not a valid entry file (such as a legacy file).
+ */
+FOUNDATION_EXTERN BOOL TIPImageDiskCacheEntryFileUpdate(NSString *filePath,
+                                                        NSString * __nullable identifier,
+                                                        TIPImageCacheEntryContext *context);
+
+//! Read the metadata of the entry file at _filePath_, `nil` if it is not a valid entry file
+FOUNDATION_EXTERN TIPImageCacheEntryContext * __nullable TIPImageDiskCacheEntryFileReadContext(NSString *filePath,
+                                                                                               NSString * __nullable * __nullable identifierOut);
+
+//! Read the payload of the entry file (or legacy file) at _filePath_
+FOUNDATION_EXTERN NSData * __nullable TIPImageDiskCacheEntryFileReadPayload(NSString *filePath,
+                                                                            BOOL memoryMap);
+
+//! Strip the trailing metadata of the entry file (or legacy file) at _filePath_ so that its payload can be appended to
+FOUNDATION_EXTERN BOOL TIPImageDiskCacheEntryFilePrepareForAppending(NSString *filePath);
+
+NS_ASSUME_NONNULL_END
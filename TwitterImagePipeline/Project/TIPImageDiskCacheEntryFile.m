@@ -0,0 +1,404 @@
+//
+//  TIPImageDiskCacheEntryFile.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#import "TIP_Project.h"
+#import "TIPImageDiskCacheEntryFile.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+static const UInt32 kEntryFileMagic = 0x45504954; // "TIPE"
+static const UInt16 kEntryFileVersion = 1;
+
+static const UInt16 kEntryFileFlagPartial = (1 << 0);
+static const UInt16 kEntryFileFlagAnimated = (1 << 1);
+static const UInt16 kEntryFileFlagUpdateExpiryOnAccess = (1 << 2);
+static const UInt16 kEntryFileFlagTreatAsPlaceholder = (1 << 3);
+
+typedef struct TIPImageDiskCacheEntryFileHeader {
+    UInt32 magic;
+    UInt16 version;
+    UInt16 flags;
+    CFTimeInterval TTL;
+    CFAbsoluteTime lastAccess;
+    double width;
+    double height;
+    UInt64 payloadLength;
+    UInt64 expectedContentLength; // partial entries only
+    // the variable length metadata follows the payload in this order
+    UInt32 identifierLength;
+    UInt32 URLLength;
+    UInt32 lastModifiedLength;
+    UInt32 ETagLength; // complete entries only (was reserved, so older files have none)
+} TIPImageDiskCacheEntryFileHeader;
+
+_Static_assert(sizeof(TIPImageDiskCacheEntryFileHeader) == 72, "entry file header must stay 72 bytes");
+
+const NSUInteger TIPImageDiskCacheEntryFileHeaderLength = sizeof(TIPImageDiskCacheEntryFileHeader);
+
+static BOOL _PopulateHeader(TIPImageDiskCacheEntryFileHeader *header,
+                            UInt64 payloadLength,
+                            TIPImageCacheEntryContext *context);
+static NSData * __nullable _PopulateMetadata(TIPImageDiskCacheEntryFileHeader *header,
+                                             NSString *identifier,
+                                             TIPImageCacheEntryContext *context);
+static BOOL _ReadHeader(int fd,
+                        TIPImageDiskCacheEntryFileHeader *header,
+                        UInt64 fileLength);
+static TIPImageCacheEntryContext * __nullable _ContextFromHeader(const TIPImageDiskCacheEntryFileHeader *header,
+                                                                 NSString * __nullable URLString,
+                                                                 NSString * __nullable lastModified,
+                                                                 NSString * __nullable ETag);
+
+NS_INLINE NSString * __nullable _StringFromBytes(const char *bytes, UInt32 length)
+{
+    return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+}
+
+NS_INLINE UInt64 _MetadataLength(const TIPImageDiskCacheEntryFileHeader *header)
+{
+    return (UInt64)header->identifierLength + header->URLLength + header->lastModifiedLength + header->ETagLength;
+}
+
+UInt64 TIPImageDiskCacheEntryFileWrite(NSString *filePath,
+                                       NSData *payload,
+                                       NSString *identifier,
+                                       TIPImageCacheEntryContext *context,
+                                       NSError * __nullable * __nullable outError)
+{
+    TIPImageDiskCacheEntryFileHeader header;
+    NSData *metadata = nil;
+    if (payload.length && _PopulateHeader(&header, payload.length, context)) {
+        metadata = _PopulateMetadata(&header, identifier, context);
+    }
+
+    int errorCode = (metadata) ? 0 : EINVAL;
+    const ssize_t length = (ssize_t)(sizeof(header) + payload.length + metadata.length);
+    // write beside the destination (not in the temporary directory) so that the rename is atomic,
+    // the temporary directory can be on another volume which would fail the rename with EXDEV.
+    // the extension is not that of a partial entry, so a file left behind by a crash is discarded
+    // as a false entry when the manifest is next loaded.
+    NSString *tempPath = [filePath stringByAppendingFormat:@".%@.writing", [NSUUID UUID].UUIDString];
+    if (!errorCode) {
+        const int fd = open(tempPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            errorCode = errno;
+        } else {
+            // one write for the whole file
+            struct iovec vectors[3] = {
+                { .iov_base = &header, .iov_len = sizeof(header) },
+                { .iov_base = (void *)payload.bytes, .iov_len = payload.length },
+                { .iov_base = (void *)metadata.bytes, .iov_len = metadata.length },
+            };
+            const ssize_t written = writev(fd, vectors, 3);
+            if (written != length) {
+                errorCode = (written < 0) ? errno : EIO;
+            }
+            close(fd);
+
+            if (!errorCode && 0 != rename(tempPath.fileSystemRepresentation, filePath.fileSystemRepresentation)) {
+                errorCode = errno;
+            }
+            if (errorCode) {
+                unlink(tempPath.fileSystemRepresentation);
+            }
+        }
+    }
+
+    if (errorCode && outError) {
+        *outError = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                        code:errorCode
+                                    userInfo:@{ @"filePath" : filePath }];
+    }
+    return (errorCode) ? 0 : (UInt64)length;
+}
+
+UInt64 TIPImageDiskCacheEntryFileFinalize(NSString *filePath,
+                                          NSString *identifier,
+                                          TIPImageCacheEntryContext *context)
+{
+    const int fd = open(filePath.fileSystemRepresentation, O_RDWR);
+    if (fd < 0) {
+        return 0;
+    }
+
+    UInt64 fileLength = 0;
+    struct stat fileStat;
+    if (0 == fstat(fd, &fileStat) && fileStat.st_size > (off_t)sizeof(TIPImageDiskCacheEntryFileHeader)) {
+        TIPImageDiskCacheEntryFileHeader header;
+        const UInt64 payloadLength = (UInt64)fileStat.st_size - sizeof(header);
+        NSData *metadata = (_PopulateHeader(&header, payloadLength, context)) ? _PopulateMetadata(&header, identifier, context) : nil;
+
+        // the header goes last so the file is only valid once it is complete
+        if (metadata && pwrite(fd, metadata.bytes, metadata.length, fileStat.st_size) == (ssize_t)metadata.length) {
+            if (pwrite(fd, &header, sizeof(header), 0) == sizeof(header)) {
+                fileLength = (UInt64)fileStat.st_size + metadata.length;
+            }
+        }
+    }
+    close(fd);
+    return fileLength;
+}
+
+BOOL TIPImageDiskCacheEntryFileUpdate(NSString *filePath,
+                                      NSString * __nullable identifier,
+                                      TIPImageCacheEntryContext *context)
+{
+    const int fd = open(filePath.fileSystemRepresentation, O_RDWR);
+    if (fd < 0) {
+        return NO;
+    }
+
+    BOOL success = NO;
+    struct stat fileStat;
+    TIPImageDiskCacheEntryFileHeader header;
+    if (0 == fstat(fd, &fileStat) && _ReadHeader(fd, &header, (UInt64)fileStat.st_size) && _PopulateHeader(&header, header.payloadLength, context)) {
+        success = YES;
+        if (identifier) {
+            NSData *metadata = _PopulateMetadata(&header, identifier, context);
+            const off_t metadataOffset = (off_t)(sizeof(header) + header.payloadLength);
+            success = metadata != nil;
+            success = success && pwrite(fd, metadata.bytes, metadata.length, metadataOffset) == (ssize_t)metadata.length;
+            success = success && 0 == ftruncate(fd, metadataOffset + (off_t)metadata.length);
+        }
+        success = success && pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+    }
+    close(fd);
+    return success;
+}
+
+TIPImageCacheEntryContext * __nullable TIPImageDiskCacheEntryFileReadContext(NSString *filePath,
+                                                                             NSString * __nullable * __nullable identifierOut)
+{
+    if (identifierOut) {
+        *identifierOut = nil;
+    }
+
+    const int fd = open(filePath.fileSystemRepresentation, O_RDONLY);
+    if (fd < 0) {
+        return nil;
+    }
+
+    TIPImageCacheEntryContext *context = nil;
+    NSString *identifier = nil;
+    struct stat fileStat;
+    TIPImageDiskCacheEntryFileHeader header;
+    if (0 == fstat(fd, &fileStat) && _ReadHeader(fd, &header, (UInt64)fileStat.st_size)) {
+        const size_t metadataLength = (size_t)_MetadataLength(&header);
+        char *metadata = malloc(metadataLength);
+        const off_t metadataOffset = (off_t)(sizeof(header) + header.payloadLength);
+        if (metadata && pread(fd, metadata, metadataLength, metadataOffset) == (ssize_t)metadataLength) {
+            const char *bytes = metadata;
+            identifier = _StringFromBytes(bytes, header.identifierLength);
+            bytes += header.identifierLength;
+            NSString *URLString = _StringFromBytes(bytes, header.URLLength);
+            bytes += header.URLLength;
+            NSString *lastModified = _StringFromBytes(bytes, header.lastModifiedLength);
+            bytes += header.lastModifiedLength;
+            NSString *ETag = _StringFromBytes(bytes, header.ETagLength);
+            context = (identifier.length) ? _ContextFromHeader(&header, URLString, lastModified, ETag) : nil;
+        }
+        free(metadata);
+    }
+    close(fd);
+
+    if (context && identifierOut) {
+        *identifierOut = identifier;
+    }
+    return context;
+}
+
+NSData * __nullable TIPImageDiskCacheEntryFileReadPayload(NSString *filePath,
+                                                          BOOL memoryMap)
+{
+    NSData *data = [NSData dataWithContentsOfFile:filePath
+                                          options:(memoryMap) ? NSDataReadingMappedIfSafe : 0
+                                            error:NULL];
+    if (data.length < sizeof(TIPImageDiskCacheEntryFileHeader)) {
+        return data;
+    }
+
+    TIPImageDiskCacheEntryFileHeader header;
+    memcpy(&header, data.bytes, sizeof(header));
+    if (header.magic != kEntryFileMagic) {
+        // legacy file, all payload
+        return data;
+    }
+    if (header.version != kEntryFileVersion || !header.payloadLength || (sizeof(header) + header.payloadLength) > data.length) {
+        return nil;
+    }
+
+    // slice out the payload without copying it
+    void *payloadBytes = (void *)((const char *)data.bytes + sizeof(header));
+    return [[NSData alloc] initWithBytesNoCopy:payloadBytes
+                                        length:(NSUInteger)header.payloadLength
+                                   deallocator:^(void *bytes, NSUInteger length) {
+        (void)data;
+    }];
+}
+
+BOOL TIPImageDiskCacheEntryFilePrepareForAppending(NSString *filePath)
+{
+    const int fd = open(filePath.fileSystemRepresentation, O_RDWR);
+    if (fd < 0) {
+        return NO;
+    }
+
+    struct stat fileStat;
+    TIPImageDiskCacheEntryFileHeader header;
+    if (0 == fstat(fd, &fileStat) && _ReadHeader(fd, &header, (UInt64)fileStat.st_size)) {
+        const BOOL success = 0 == ftruncate(fd, (off_t)(sizeof(header) + header.payloadLength));
+        close(fd);
+        return success;
+    }
+    close(fd);
+
+    // legacy file, move its payload behind a reserved header
+    NSData *payload = [NSData dataWithContentsOfFile:filePath];
+    if (!payload.length) {
+        return NO;
+    }
+    NSMutableData *data = [[NSMutableData alloc] initWithLength:sizeof(header)];
+    [data appendData:payload];
+    return [data writeToFile:filePath options:NSDataWritingAtomic error:NULL];
+}
+
+static BOOL _PopulateHeader(TIPImageDiskCacheEntryFileHeader *header,
+                            UInt64 payloadLength,
+                            TIPImageCacheEntryContext *context)
+{
+    if (!context.URL) {
+        return NO;
+    }
+
+    if (!context.lastAccess) {
+        context.lastAccess = CFAbsoluteTimeGetCurrent();
+    }
+
+    TIPAssert(context.TTL > 0.0);
+
+    UInt16 flags = 0;
+    UInt64 expectedContentLength = 0;
+    if ([context isKindOfClass:[TIPPartialImageEntryContext class]]) {
+        flags |= kEntryFileFlagPartial;
+        expectedContentLength = [(TIPPartialImageEntryContext *)context expectedContentLength];
+    }
+    if (context.isAnimated) {
+        flags |= kEntryFileFlagAnimated;
+    }
+    if (context.updateExpiryOnAccess) {
+        flags |= kEntryFileFlagUpdateExpiryOnAccess;
+    }
+    if (context.treatAsPlaceholder) {
+        flags |= kEntryFileFlagTreatAsPlaceholder;
+    }
+
+    header->magic = kEntryFileMagic;
+    header->version = kEntryFileVersion;
+    header->flags = flags;
+    header->TTL = context.TTL;
+    header->lastAccess = context.lastAccess;
+    header->width = context.dimensions.width;
+    header->height = context.dimensions.height;
+    header->payloadLength = payloadLength;
+    header->expectedContentLength = expectedContentLength;
+    return YES;
+}
+
+static NSData * __nullable _PopulateMetadata(TIPImageDiskCacheEntryFileHeader *header,
+                                             NSString *identifier,
+                                             TIPImageCacheEntryContext *context)
+{
+    NSData *identifierData = [identifier dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *URLData = [context.URL.absoluteString dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *lastModifiedData = nil;
+    NSData *ETagData = nil;
+    if ([context isKindOfClass:[TIPPartialImageEntryContext class]]) {
+        lastModifiedData = [[(TIPPartialImageEntryContext *)context lastModified] dataUsingEncoding:NSUTF8StringEncoding];
+    } else if ([context isKindOfClass:[TIPCompleteImageEntryContext class]]) {
+        lastModifiedData = [[(TIPCompleteImageEntryContext *)context lastModified] dataUsingEncoding:NSUTF8StringEncoding];
+        ETagData = [[(TIPCompleteImageEntryContext *)context ETag] dataUsingEncoding:NSUTF8StringEncoding];
+    }
+    if (!identifierData.length || !URLData.length) {
+        return nil;
+    }
+
+    header->identifierLength = (UInt32)identifierData.length;
+    header->URLLength = (UInt32)URLData.length;
+    header->lastModifiedLength = (UInt32)lastModifiedData.length;
+    header->ETagLength = (UInt32)ETagData.length;
+
+    NSMutableData *metadata = [[NSMutableData alloc] initWithCapacity:(NSUInteger)_MetadataLength(header)];
+    [metadata appendData:identifierData];
+    [metadata appendData:URLData];
+    if (lastModifiedData) {
+        [metadata appendData:lastModifiedData];
+    }
+    if (ETagData) {
+        [metadata appendData:ETagData];
+    }
+    return metadata;
+}
+
+static BOOL _ReadHeader(int fd,
+                        TIPImageDiskCacheEntryFileHeader *header,
+                        UInt64 fileLength)
+{
+    if (pread(fd, header, sizeof(*header), 0) != sizeof(*header)) {
+        return NO;
+    }
+    if (header->magic != kEntryFileMagic || header->version != kEntryFileVersion) {
+        return NO;
+    }
+    // also rejects files that were not finalized
+    return (sizeof(*header) + header->payloadLength + _MetadataLength(header)) == fileLength;
+}
+
+static TIPImageCacheEntryContext * __nullable _ContextFromHeader(const TIPImageDiskCacheEntryFileHeader *header,
+                                                                 NSString * __nullable URLString,
+                                                                 NSString * __nullable lastModified,
+                                                                 NSString * __nullable ETag)
+{
+    TIPImageCacheEntryContext *context = nil;
+    if (header->flags & kEntryFileFlagPartial) {
+        TIPPartialImageEntryContext *partialContext = [[TIPPartialImageEntryContext alloc] init];
+        partialContext.lastModified = (lastModified.length < 4) ? nil : lastModified;
+        partialContext.expectedContentLength = (NSUInteger)header->expectedContentLength;
+        context = partialContext;
+    } else {
+        TIPCompleteImageEntryContext *completeContext = [[TIPCompleteImageEntryContext alloc] init];
+        completeContext.lastModified = (lastModified.length < 4) ? nil : lastModified;
+        completeContext.ETag = (ETag.length) ? ETag : nil;
+        context = completeContext;
+    }
+
+    NSURL *URL = (URLString.length) ? [NSURL URLWithString:URLString] : nil;
+    if (!URL || header->lastAccess == 0 || header->TTL <= 0.0) {
+        return nil;
+    }
+    context.URL = URL;
+    context.lastAccess = header->lastAccess;
+    context.TTL = header->TTL;
+
+    const CGSize dimensions = CGSizeMake((CGFloat)header->width, (CGFloat)header->height);
+    if (dimensions.width < 1.0 || dimensions.height < 1.0) {
+        return nil;
+    }
+    context.dimensions = dimensions;
+
+    context.animated = (header->flags & kEntryFileFlagAnimated) != 0;
+    context.updateExpiryOnAccess = (header->flags & kEntryFileFlagUpdateExpiryOnAccess) != 0;
+    context.treatAsPlaceholder = (header->flags & kEntryFileFlagTreatAsPlaceholder) != 0;
+    return context;
+}
+
+NS_ASSUME_NONNULL_END
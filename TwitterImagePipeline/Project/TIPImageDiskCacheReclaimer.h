@@ -0,0 +1,44 @@
+//
+//  TIPImageDiskCacheReclaimer.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Reclaims disk space for the disk caches without blocking the disk cache queue.
+
+ Files and directories are "trashed" by atomically renaming them into a trash directory (a cheap,
+ metadata only operation) and the actual deletion is performed later, in batches, on a low priority
+ background queue.  Since the trash directory persists across launches, any reclamation that was
+ interrupted (such as by the app being terminated) is resumed the next time the trash directory
+ is reclaimed.
+ */
+TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
+@interface TIPImageDiskCacheReclaimer : NSObject
+
++ (instancetype)sharedInstance;
+
+/**
+ Atomically move the item at _path_ into the _trashPath_ directory and schedule it for reclamation.
+ Trashing multiple items in quick succession will be coalesced into a single reclamation pass.
+ @return `YES` if the item was moved (or there was no item to move), `NO` if the move failed and
+ the caller is still responsible for the item.
+ */
+- (BOOL)trashItemAtPath:(NSString *)path
+            toTrashPath:(NSString *)trashPath;
+
+/** Asynchronously reclaim everything in the _trashPath_ directory (e.g. left over from a previous launch) */
+- (void)reclaimTrashPath:(NSString *)trashPath;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
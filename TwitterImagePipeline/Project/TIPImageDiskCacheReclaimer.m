@@ -0,0 +1,132 @@
+//
+//  TIPImageDiskCacheReclaimer.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+#import "TIPFileUtils.h"
+#import "TIPImageDiskCacheReclaimer.h"
+#import "TIPTiming.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Delay before a reclamation pass runs so that a burst of trashed items
+// (like a prune evicting many entries) is reclaimed in one batch
+static const NSTimeInterval kReclaimCoalescingDelay = 2.0;
+
+@implementation TIPImageDiskCacheReclaimer
+{
+    dispatch_queue_t _reclaimQueue;
+    NSMutableSet<NSString *> *_scheduledTrashPaths; // only accessed from _reclaimQueue
+}
+
++ (instancetype)sharedInstance
+{
+    static TIPImageDiskCacheReclaimer *sReclaimer;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sReclaimer = [[TIPImageDiskCacheReclaimer alloc] initInternal];
+    });
+    return sReclaimer;
+}
+
+- (instancetype)initInternal
+{
+    if (self = [super init]) {
+        dispatch_queue_attr_t attr = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_BACKGROUND, 0);
+        _reclaimQueue = dispatch_queue_create("com.twitter.tip.disk.reclaim.queue", attr);
+        _scheduledTrashPaths = [[NSMutableSet alloc] init];
+    }
+    return self;
+}
+
+- (BOOL)trashItemAtPath:(NSString *)path
+            toTrashPath:(NSString *)trashPath
+{
+    TIPAssert(path != nil);
+    TIPAssert(trashPath != nil);
+    if (!path || !trashPath) {
+        return NO;
+    }
+
+    NSString *trashedItemPath = [trashPath stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    if (0 != rename(path.fileSystemRepresentation, trashedItemPath.fileSystemRepresentation)) {
+        if (ENOENT == errno) {
+            // Either there is nothing to trash or the trash directory does not exist yet
+            if (![[NSFileManager defaultManager] fileExistsAtPath:path]) {
+                return YES;
+            }
+
+            [[NSFileManager defaultManager] createDirectoryAtPath:trashPath
+                                      withIntermediateDirectories:YES
+                                                       attributes:nil
+                                                            error:NULL];
+            if (0 != rename(path.fileSystemRepresentation, trashedItemPath.fileSystemRepresentation)) {
+                TIPLogWarning(@"Failed to move '%@' to trash: %i", path, errno);
+                return NO;
+            }
+        } else {
+            TIPLogWarning(@"Failed to move '%@' to trash: %i", path, errno);
+            return NO;
+        }
+    }
+
+    [self _scheduleReclaimOfTrashPath:trashPath];
+    return YES;
+}
+
+- (void)reclaimTrashPath:(NSString *)trashPath
+{
+    TIPAssert(trashPath != nil);
+    if (!trashPath) {
+        return;
+    }
+
+    [self _scheduleReclaimOfTrashPath:trashPath];
+}
+
+#pragma mark Private
+
+- (void)_scheduleReclaimOfTrashPath:(NSString *)trashPath
+{
+    trashPath = [trashPath copy];
+    tip_dispatch_async_autoreleasing(_reclaimQueue, ^{
+        if ([self->_scheduledTrashPaths containsObject:trashPath]) {
+            // already scheduled, this item will be reclaimed in that pass
+            return;
+        }
+
+        [self->_scheduledTrashPaths addObject:trashPath];
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kReclaimCoalescingDelay * NSEC_PER_SEC)), self->_reclaimQueue, ^{
+            @autoreleasepool {
+                // unmark before enumerating so that anything trashed during this pass gets its own pass
+                [self->_scheduledTrashPaths removeObject:trashPath];
+                [self _reclaimTrashPath:trashPath];
+            }
+        });
+    });
+}
+
+- (void)_reclaimTrashPath:(NSString *)trashPath
+{
+    NSArray<NSURL *> *trashedItems = TIPContentsAtPath(trashPath, NULL);
+    if (!trashedItems.count) {
+        return;
+    }
+
+    const uint64_t machStart = mach_absolute_time();
+    NSFileManager *fm = [NSFileManager defaultManager];
+    for (NSURL *trashedItem in trashedItems) {
+        @autoreleasepool {
+            [fm removeItemAtURL:trashedItem error:NULL];
+        }
+    }
+    TIPLogDebug(@"%@ reclaimed %tu trashed items in %.3fs", NSStringFromClass([self class]), trashedItems.count, TIPComputeDuration(machStart, mach_absolute_time()));
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
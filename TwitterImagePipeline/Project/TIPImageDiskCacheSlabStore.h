@@ -0,0 +1,75 @@
+//
+//  TIPImageDiskCacheSlabStore.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+#import "TIPImageCacheEntry.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+//! Images with at most this many bytes are stored in slabs instead of their own files
+FOUNDATION_EXTERN const NSUInteger TIPImageDiskCacheSlabRecordMaxDataLength;
+
+/**
+ Block for loading the records of a slab store.
+ Return `NO` to free the record (such as when it has expired or its _metadata_ is not valid).
+ */
+typedef BOOL(^TIPImageDiskCacheSlabRecordLoadBlock)(TIPImageDiskCacheSlabLocation location,
+                                                    NSUInteger dataLength,
+                                                    CFAbsoluteTime lastAccess,
+                                                    NSData *metadata);
+
+/**
+ Packs small images into large append-only slab files so that each small image does not cost its
+ own file (with its own inode, filesystem blocks and xattrs).
+
+ Each record is a fixed size header followed by the image data and then opaque metadata.
+ The location of a record is kept by the owner (the disk cache keeps it on its manifest entries)
+ which makes reading an image a single `pread`.  The last access time is in the header so that
+ touching a record is a single `pwrite`, as is freeing a record.  Freed space is reclaimed by
+ compacting a slab: its live records are appended to the active slab and the slab is removed.
+
+ Not thread safe, the owner must serialize all access.  The disk cache loads the records while
+ populating its manifest and otherwise only uses the store from its disk cache queue.
+ */
+TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
+@interface TIPImageDiskCacheSlabStore : NSObject
+
+@property (nonatomic, readonly, copy) NSString *path;
+@property (nonatomic, readonly) UInt64 totalSlabBytes; // includes freed bytes
+@property (nonatomic, readonly) UInt64 freedSlabBytes;
+
+- (instancetype)initWithPath:(NSString *)path NS_DESIGNATED_INITIALIZER;
+
+/** Load the records in the slabs at `path`, must be called before any other use of the store */
+- (void)loadRecordsUsingBlock:(TIPImageDiskCacheSlabRecordLoadBlock NS_NOESCAPE)block;
+
+/** Append a record, returns `NO` if the record could not be written */
+- (BOOL)appendRecordWithData:(NSData *)data
+                    metadata:(NSData *)metadata
+                  lastAccess:(CFAbsoluteTime)lastAccess
+                    location:(out TIPImageDiskCacheSlabLocation *)locationOut;
+/** Read the data of the record at _location_ */
+- (nullable NSData *)dataForRecordAtLocation:(TIPImageDiskCacheSlabLocation)location
+                                  dataLength:(NSUInteger)dataLength;
+- (void)setLastAccess:(CFAbsoluteTime)lastAccess
+  forRecordAtLocation:(TIPImageDiskCacheSlabLocation)location;
+- (void)freeRecordAtLocation:(TIPImageDiskCacheSlabLocation)location;
+
+/** The slab that has freed enough of its space to be worth compacting, `0` if there is none */
+- (UInt32)slabIdentifierNeedingCompaction;
+/** Remove the slab once its live records have been relocated */
+- (void)removeSlab:(UInt32)slabIdentifier;
+/** Forget all slabs (closing their files), the owner is responsible for removing the slab files */
+- (void)resetSlabs;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
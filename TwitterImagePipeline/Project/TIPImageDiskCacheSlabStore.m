@@ -0,0 +1,363 @@
+//
+//  TIPImageDiskCacheSlabStore.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#import "TIP_Project.h"
+#import "TIPFileUtils.h"
+#import "TIPImageDiskCacheSlabStore.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+const NSUInteger TIPImageDiskCacheSlabRecordMaxDataLength = 32 * 1024;
+
+static NSString * const kSlabPathExtension = @"slab";
+// Slabs stop taking new records once they reach this length
+static const UInt64 kSlabMaxLength = 4 * 1024 * 1024;
+// A slab is compacted once at least this ratio of it has been freed
+static const double kSlabCompactionFreedRatio = 0.5;
+
+static const UInt32 kSlabRecordMagic = 0x52504954; // "TIPR"
+static const UInt32 kSlabRecordFlagLive = (1 << 0);
+
+typedef struct TIPImageDiskCacheSlabRecordHeader {
+    UInt32 magic;
+    UInt32 flags;
+    UInt32 dataLength;
+    UInt32 metadataLength;
+    CFAbsoluteTime lastAccess;
+    UInt64 reserved;
+} TIPImageDiskCacheSlabRecordHeader;
+
+_Static_assert(sizeof(TIPImageDiskCacheSlabRecordHeader) == 32, "record header must stay 32 bytes");
+
+NS_INLINE UInt64 _RecordLength(const TIPImageDiskCacheSlabRecordHeader *header)
+{
+    return sizeof(TIPImageDiskCacheSlabRecordHeader) + header->dataLength + header->metadataLength;
+}
+
+TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
+@interface TIPImageDiskCacheSlab : NSObject
+@property (nonatomic, readonly) UInt32 identifier;
+@property (nonatomic, readonly) int fileDescriptor;
+@property (nonatomic) UInt64 length;
+@property (nonatomic) UInt64 freedLength;
+- (instancetype)initWithIdentifier:(UInt32)identifier
+                    fileDescriptor:(int)fileDescriptor;
+@end
+
+@implementation TIPImageDiskCacheSlab
+
+- (instancetype)initWithIdentifier:(UInt32)identifier
+                    fileDescriptor:(int)fileDescriptor
+{
+    if (self = [super init]) {
+        _identifier = identifier;
+        _fileDescriptor = fileDescriptor;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    close(_fileDescriptor);
+}
+
+@end
+
+@implementation TIPImageDiskCacheSlabStore
+{
+    NSMutableDictionary<NSNumber *, TIPImageDiskCacheSlab *> *_slabs;
+    TIPImageDiskCacheSlab *_activeSlab;
+    UInt32 _lastSlabIdentifier;
+}
+
+- (instancetype)initWithPath:(NSString *)path
+{
+    if (self = [super init]) {
+        _path = [path copy];
+        _slabs = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (void)loadRecordsUsingBlock:(TIPImageDiskCacheSlabRecordLoadBlock NS_NOESCAPE)block
+{
+    NSArray<NSURL *> *slabURLs = TIPContentsAtPath(_path, NULL);
+    for (NSURL *slabURL in slabURLs) {
+        @autoreleasepool {
+            NSString *slabPath = slabURL.path;
+            NSString *name = slabPath.lastPathComponent;
+            const long long slabIdentifier = [name.stringByDeletingPathExtension longLongValue];
+            if (![name.pathExtension isEqualToString:kSlabPathExtension] || slabIdentifier <= 0 || slabIdentifier > UINT32_MAX) {
+                [[NSFileManager defaultManager] removeItemAtPath:slabPath error:NULL];
+                continue;
+            }
+
+            const int fd = open(slabPath.fileSystemRepresentation, O_RDWR);
+            if (fd < 0) {
+                TIPLogWarning(@"Failed to open slab '%@': %i", slabPath, errno);
+                [[NSFileManager defaultManager] removeItemAtPath:slabPath error:NULL];
+                continue;
+            }
+
+            TIPImageDiskCacheSlab *slab = [[TIPImageDiskCacheSlab alloc] initWithIdentifier:(UInt32)slabIdentifier
+                                                                             fileDescriptor:fd];
+            [self _loadRecordsOfSlab:slab usingBlock:block];
+            _lastSlabIdentifier = MAX(_lastSlabIdentifier, slab.identifier);
+            if (slab.freedLength >= slab.length) {
+                // nothing live
+                unlink(slabPath.fileSystemRepresentation);
+                continue;
+            }
+
+            _slabs[@(slab.identifier)] = slab;
+            _totalSlabBytes += slab.length;
+            _freedSlabBytes += slab.freedLength;
+            if (slab.identifier == _lastSlabIdentifier) {
+                _activeSlab = slab;
+            }
+        }
+    }
+
+    if (_activeSlab && _activeSlab.identifier != _lastSlabIdentifier) {
+        // only append to the newest slab, so that older slabs can be compacted
+        _activeSlab = nil;
+    }
+}
+
+- (BOOL)appendRecordWithData:(NSData *)data
+                    metadata:(NSData *)metadata
+                  lastAccess:(CFAbsoluteTime)lastAccess
+                    location:(out TIPImageDiskCacheSlabLocation *)locationOut
+{
+    TIPAssert(data.length <= TIPImageDiskCacheSlabRecordMaxDataLength);
+    if (!data.length || data.length > TIPImageDiskCacheSlabRecordMaxDataLength || metadata.length > UINT16_MAX) {
+        return NO;
+    }
+
+    TIPImageDiskCacheSlabRecordHeader header = {
+        .magic = kSlabRecordMagic,
+        .flags = kSlabRecordFlagLive,
+        .dataLength = (UInt32)data.length,
+        .metadataLength = (UInt32)metadata.length,
+        .lastAccess = lastAccess,
+        .reserved = 0,
+    };
+    const UInt64 recordLength = _RecordLength(&header);
+
+    TIPImageDiskCacheSlab *slab = _activeSlab;
+    if (!slab || (slab.length + recordLength) > kSlabMaxLength) {
+        slab = [self _createSlab];
+        if (!slab) {
+            return NO;
+        }
+    }
+
+    // one write for the whole record
+    NSMutableData *record = [[NSMutableData alloc] initWithCapacity:(NSUInteger)recordLength];
+    [record appendBytes:&header length:sizeof(header)];
+    [record appendData:data];
+    [record appendData:metadata];
+    const ssize_t written = pwrite(slab.fileDescriptor, record.bytes, record.length, (off_t)slab.length);
+    if (written != (ssize_t)recordLength) {
+        TIPLogWarning(@"Failed to append to slab %u: %i", slab.identifier, errno);
+        ftruncate(slab.fileDescriptor, (off_t)slab.length);
+        return NO;
+    }
+
+    locationOut->slabIdentifier = slab.identifier;
+    locationOut->offset = slab.length;
+    slab.length += recordLength;
+    _totalSlabBytes += recordLength;
+    return YES;
+}
+
+- (nullable NSData *)dataForRecordAtLocation:(TIPImageDiskCacheSlabLocation)location
+                                  dataLength:(NSUInteger)dataLength
+{
+    TIPImageDiskCacheSlab *slab = _slabs[@(location.slabIdentifier)];
+    const UInt64 dataOffset = location.offset + sizeof(TIPImageDiskCacheSlabRecordHeader);
+    if (!slab || !dataLength || (dataOffset + dataLength) > slab.length) {
+        return nil;
+    }
+
+    void *bytes = malloc(dataLength);
+    if (!bytes) {
+        return nil;
+    }
+    if (pread(slab.fileDescriptor, bytes, dataLength, (off_t)dataOffset) != (ssize_t)dataLength) {
+        free(bytes);
+        return nil;
+    }
+    return [[NSData alloc] initWithBytesNoCopy:bytes length:dataLength freeWhenDone:YES];
+}
+
+- (void)setLastAccess:(CFAbsoluteTime)lastAccess
+  forRecordAtLocation:(TIPImageDiskCacheSlabLocation)location
+{
+    TIPImageDiskCacheSlab *slab = _slabs[@(location.slabIdentifier)];
+    if (!slab || location.offset >= slab.length) {
+        return;
+    }
+
+    const off_t offset = (off_t)(location.offset + offsetof(TIPImageDiskCacheSlabRecordHeader, lastAccess));
+    pwrite(slab.fileDescriptor, &lastAccess, sizeof(lastAccess), offset);
+}
+
+- (void)freeRecordAtLocation:(TIPImageDiskCacheSlabLocation)location
+{
+    TIPImageDiskCacheSlab *slab = _slabs[@(location.slabIdentifier)];
+    if (!slab || location.offset >= slab.length) {
+        return;
+    }
+
+    TIPImageDiskCacheSlabRecordHeader header;
+    if (pread(slab.fileDescriptor, &header, sizeof(header), (off_t)location.offset) != sizeof(header)) {
+        return;
+    }
+    if (header.magic != kSlabRecordMagic || !(header.flags & kSlabRecordFlagLive)) {
+        return;
+    }
+
+    header.flags &= ~kSlabRecordFlagLive;
+    const off_t offset = (off_t)(location.offset + offsetof(TIPImageDiskCacheSlabRecordHeader, flags));
+    pwrite(slab.fileDescriptor, &header.flags, sizeof(header.flags), offset);
+
+    const UInt64 recordLength = _RecordLength(&header);
+    slab.freedLength += recordLength;
+    _freedSlabBytes += recordLength;
+}
+
+- (UInt32)slabIdentifierNeedingCompaction
+{
+    TIPImageDiskCacheSlab *mostFreedSlab = nil;
+    double mostFreedRatio = kSlabCompactionFreedRatio;
+    for (TIPImageDiskCacheSlab *slab in _slabs.objectEnumerator) {
+        if (slab == _activeSlab || !slab.length) {
+            continue;
+        }
+        const double freedRatio = (double)slab.freedLength / (double)slab.length;
+        if (freedRatio >= mostFreedRatio) {
+            mostFreedRatio = freedRatio;
+            mostFreedSlab = slab;
+        }
+    }
+    return mostFreedSlab.identifier;
+}
+
+- (void)removeSlab:(UInt32)slabIdentifier
+{
+    TIPImageDiskCacheSlab *slab = _slabs[@(slabIdentifier)];
+    if (!slab) {
+        return;
+    }
+
+    [_slabs removeObjectForKey:@(slabIdentifier)];
+    if (slab == _activeSlab) {
+        _activeSlab = nil;
+    }
+    _totalSlabBytes -= slab.length;
+    _freedSlabBytes -= slab.freedLength;
+    unlink([self _pathForSlab:slabIdentifier].fileSystemRepresentation);
+}
+
+- (void)resetSlabs
+{
+    [_slabs removeAllObjects];
+    _activeSlab = nil;
+    _totalSlabBytes = 0;
+    _freedSlabBytes = 0;
+}
+
+#pragma mark Private
+
+- (NSString *)_pathForSlab:(UInt32)slabIdentifier
+{
+    NSString *name = [NSString stringWithFormat:@"%u.%@", slabIdentifier, kSlabPathExtension];
+    return [_path stringByAppendingPathComponent:name];
+}
+
+- (nullable TIPImageDiskCacheSlab *)_createSlab
+{
+    [[NSFileManager defaultManager] createDirectoryAtPath:_path
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:NULL];
+
+    const UInt32 slabIdentifier = ++_lastSlabIdentifier;
+    NSString *slabPath = [self _pathForSlab:slabIdentifier];
+    const int fd = open(slabPath.fileSystemRepresentation, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        TIPLogWarning(@"Failed to create slab '%@': %i", slabPath, errno);
+        return nil;
+    }
+
+    TIPImageDiskCacheSlab *slab = [[TIPImageDiskCacheSlab alloc] initWithIdentifier:slabIdentifier
+                                                                     fileDescriptor:fd];
+    _slabs[@(slabIdentifier)] = slab;
+    _activeSlab = slab;
+    return slab;
+}
+
+- (void)_loadRecordsOfSlab:(TIPImageDiskCacheSlab *)slab
+                usingBlock:(TIPImageDiskCacheSlabRecordLoadBlock NS_NOESCAPE)block
+{
+    const int fd = slab.fileDescriptor;
+    struct stat fileStat;
+    if (0 != fstat(fd, &fileStat) || fileStat.st_size <= 0) {
+        return;
+    }
+
+    const UInt64 fileLength = (UInt64)fileStat.st_size;
+    UInt64 offset = 0;
+    UInt64 freedLength = 0;
+    TIPImageDiskCacheSlabRecordHeader header;
+    while ((offset + sizeof(header)) <= fileLength) {
+        if (pread(fd, &header, sizeof(header), (off_t)offset) != sizeof(header) || header.magic != kSlabRecordMagic) {
+            break;
+        }
+        const UInt64 recordLength = _RecordLength(&header);
+        if ((offset + recordLength) > fileLength) {
+            // torn append
+            break;
+        }
+
+        BOOL keep = NO;
+        if (header.flags & kSlabRecordFlagLive) {
+            NSMutableData *metadata = [[NSMutableData alloc] initWithLength:header.metadataLength];
+            const off_t metadataOffset = (off_t)(offset + sizeof(header) + header.dataLength);
+            if (pread(fd, metadata.mutableBytes, metadata.length, metadataOffset) == (ssize_t)metadata.length) {
+                const TIPImageDiskCacheSlabLocation location = { .slabIdentifier = slab.identifier, .offset = offset };
+                keep = block(location, header.dataLength, header.lastAccess, metadata);
+            }
+            if (!keep) {
+                header.flags &= ~kSlabRecordFlagLive;
+                pwrite(fd, &header.flags, sizeof(header.flags), (off_t)(offset + offsetof(TIPImageDiskCacheSlabRecordHeader, flags)));
+            }
+        }
+        if (!keep) {
+            freedLength += recordLength;
+        }
+        offset += recordLength;
+    }
+
+    if (offset < fileLength) {
+        // drop whatever could not be read so the next append lands on a record boundary
+        ftruncate(fd, (off_t)offset);
+    }
+    slab.length = offset;
+    slab.freedLength = freedLength;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
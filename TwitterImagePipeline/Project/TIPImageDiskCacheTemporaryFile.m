@@ -7,7 +7,9 @@
 //
 
 #import "TIP_Project.h"
+#import "TIPFileUtils.h"
 #import "TIPImageDiskCache.h"
+#import "TIPImageDiskCacheEntryFile.h"
 #import "TIPImageDiskCacheTemporaryFile.h"
 
 NS_ASSUME_NONNULL_BEGIN
@@ -54,6 +56,11 @@ NS_ASSUME_NONNULL_BEGIN
         _diskCache = diskCache;
 
         _openFile = fopen(tempPath.UTF8String, "a");
+        if (_openFile && 0 == TIPFileSizeAtPath(tempPath, NULL)) {
+            // new file, reserve the entry file header (written when finalized)
+            NSData *reservedHeader = [[NSMutableData alloc] initWithLength:TIPImageDiskCacheEntryFileHeaderLength];
+            fwrite(reservedHeader.bytes, 1, reservedHeader.length, _openFile);
+        }
     }
     return self;
 }
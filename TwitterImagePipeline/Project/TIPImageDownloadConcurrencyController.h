@@ -0,0 +1,58 @@
+//
+//  TIPImageDownloadConcurrencyController.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Adapts the number of downloads that can run concurrently to the link being used.
+
+ Samples of the aggregate goodput (bytes received per second across all running downloads) and of
+ each download's time to first byte are gathered in windows.  At the end of each window:
+
+ - Congestion (the time to first byte growing, or inflated well past the best recently seen, while
+ goodput is not improving) multiplicatively decreases the limit, since the extra concurrency is only
+ adding contention
+ - Otherwise, when every slot was in use and goodput is holding up, the limit is additively increased
+ - Otherwise the limit is held
+
+ The limit always stays within the minimum and maximum limits.
+ Not thread safe, must only be used from the queue of the owning downloader.
+ */
+TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
+@interface TIPImageDownloadConcurrencyController : NSObject
+
+@property (nonatomic, readonly) NSUInteger limit;
+@property (nonatomic, readonly) NSUInteger minimumLimit;
+@property (nonatomic, readonly) NSUInteger maximumLimit;
+@property (nonatomic, readonly) double goodput; // bytes per second, of the last window
+@property (nonatomic, readonly) NSTimeInterval timeToFirstByte; // median, of the last window with samples
+
+- (instancetype)initWithMinimumLimit:(NSUInteger)minimumLimit
+                        maximumLimit:(NSUInteger)maximumLimit NS_DESIGNATED_INITIALIZER;
+
+/** Update the bounds, clamping the current limit to them */
+- (void)updateMinimumLimit:(NSUInteger)minimumLimit
+             maximumLimit:(NSUInteger)maximumLimit;
+
+/** Record the time to first byte of a download */
+- (void)recordTimeToFirstByte:(NSTimeInterval)timeToFirstByte;
+/** Record bytes received by a download, with the number of downloads running at _time_ */
+- (void)recordBytes:(NSUInteger)byteCount
+       runningCount:(NSUInteger)runningCount
+               time:(CFAbsoluteTime)time;
+/** End the current window if it is over, returns `YES` if the limit changed */
+- (BOOL)evaluateWindowAtTime:(CFAbsoluteTime)time;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,136 @@
+//
+//  TIPImageDownloadConcurrencyController.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIPGlobalConfiguration.h"
+#import "TIPImageDownloadConcurrencyController.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Windows are at least this long
+static const NSTimeInterval kWindowMinimumDuration = 1.0;
+// Windows are also at least this many times the time to first byte, so they span whole requests
+static const double kWindowTimeToFirstByteMultiple = 4.0;
+// The time to first byte is congested past this many times the best recently seen
+static const double kCongestionTimeToFirstByteRatio = 2.0;
+// The time to first byte grew when it is this many times that of the previous window
+static const double kTimeToFirstByteGrowthRatio = 1.1;
+// The best time to first byte drifts up by this much each window so that old conditions are forgotten
+static const double kBaselineTimeToFirstByteDrift = 1.05;
+// Goodput improved when it is this many times that of the previous window
+static const double kGoodputImprovementRatio = 1.05;
+// Goodput is holding up when it is at least this many times that of the previous window
+static const double kGoodputToleranceRatio = 0.9;
+// The limit is multiplied by this on congestion
+static const double kDecreaseFactor = 0.5;
+// Times to first byte kept per window for the median
+#define kTimeToFirstByteSampleCapacity (32)
+
+static int _CompareTimeIntervals(const void *a, const void *b);
+
+@implementation TIPImageDownloadConcurrencyController
+{
+    CFAbsoluteTime _windowStartTime;
+    UInt64 _windowByteCount;
+    NSUInteger _windowMaxRunningCount;
+    NSTimeInterval _windowSamples[kTimeToFirstByteSampleCapacity];
+    NSUInteger _windowSampleCount;
+    double _previousGoodput;
+    NSTimeInterval _baselineTimeToFirstByte;
+}
+
+- (instancetype)initWithMinimumLimit:(NSUInteger)minimumLimit
+                        maximumLimit:(NSUInteger)maximumLimit
+{
+    if (self = [super init]) {
+        // start where a static limit would be and adapt from there
+        _limit = (NSUInteger)TIPMaxConcurrentImagePipelineDownloadCountDefault;
+        [self updateMinimumLimit:minimumLimit maximumLimit:maximumLimit];
+    }
+    return self;
+}
+
+- (void)updateMinimumLimit:(NSUInteger)minimumLimit
+             maximumLimit:(NSUInteger)maximumLimit
+{
+    _minimumLimit = MAX((NSUInteger)1, minimumLimit);
+    _maximumLimit = MAX(_minimumLimit, maximumLimit);
+    _limit = MIN(_maximumLimit, MAX(_minimumLimit, _limit));
+}
+
+- (void)recordTimeToFirstByte:(NSTimeInterval)timeToFirstByte
+{
+    _windowSamples[_windowSampleCount % kTimeToFirstByteSampleCapacity] = timeToFirstByte;
+    _windowSampleCount++;
+}
+
+- (void)recordBytes:(NSUInteger)byteCount
+       runningCount:(NSUInteger)runningCount
+               time:(CFAbsoluteTime)time
+{
+    if (!_windowStartTime) {
+        _windowStartTime = time;
+    }
+    _windowByteCount += byteCount;
+    _windowMaxRunningCount = MAX(_windowMaxRunningCount, runningCount);
+}
+
+- (BOOL)evaluateWindowAtTime:(CFAbsoluteTime)time
+{
+    if (!_windowStartTime) {
+        return NO;
+    }
+
+    const NSTimeInterval duration = time - _windowStartTime;
+    if (duration < MAX(kWindowMinimumDuration, kWindowTimeToFirstByteMultiple * _timeToFirstByte)) {
+        return NO;
+    }
+
+    const double goodput = (double)_windowByteCount / duration;
+    BOOL congested = NO;
+    if (_windowSampleCount > 0) {
+        const NSUInteger sampleCount = MIN(_windowSampleCount, (NSUInteger)kTimeToFirstByteSampleCapacity);
+        qsort(_windowSamples, sampleCount, sizeof(NSTimeInterval), _CompareTimeIntervals);
+        const NSTimeInterval previousTimeToFirstByte = _timeToFirstByte;
+        _timeToFirstByte = _windowSamples[sampleCount / 2];
+        _baselineTimeToFirstByte = (_baselineTimeToFirstByte > 0) ? MIN(_baselineTimeToFirstByte * kBaselineTimeToFirstByteDrift, _timeToFirstByte) : _timeToFirstByte;
+
+        // requests are getting slower without more getting through
+        const BOOL timeToFirstByteGrew = (previousTimeToFirstByte > 0) && (_timeToFirstByte > previousTimeToFirstByte * kTimeToFirstByteGrowthRatio);
+        const BOOL timeToFirstByteInflated = _timeToFirstByte > _baselineTimeToFirstByte * kCongestionTimeToFirstByteRatio;
+        congested = (timeToFirstByteGrew || timeToFirstByteInflated) && (goodput < _previousGoodput * kGoodputImprovementRatio);
+    }
+
+    const NSUInteger oldLimit = _limit;
+    if (congested) {
+        _limit = MAX(_minimumLimit, (NSUInteger)((double)_limit * kDecreaseFactor));
+    } else if (_windowMaxRunningCount >= _limit && goodput >= _previousGoodput * kGoodputToleranceRatio) {
+        _limit = MIN(_maximumLimit, _limit + 1);
+    }
+
+    _goodput = goodput;
+    _previousGoodput = goodput;
+
+    // the next window starts with the next bytes, idle time is not measured
+    _windowStartTime = 0;
+    _windowByteCount = 0;
+    _windowMaxRunningCount = 0;
+    _windowSampleCount = 0;
+
+    return _limit != oldLimit;
+}
+
+@end
+
+static int _CompareTimeIntervals(const void *a, const void *b)
+{
+    const NSTimeInterval timeA = *(const NSTimeInterval *)a;
+    const NSTimeInterval timeB = *(const NSTimeInterval *)b;
+    return (timeA > timeB) - (timeA < timeB);
+}
+
+NS_ASSUME_NONNULL_END
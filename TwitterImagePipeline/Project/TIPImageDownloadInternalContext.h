@@ -32,6 +32,16 @@ TIP_OBJC_FINAL
     NSError * __nullable _progressStateError;
     NSHTTPURLResponse * __nullable _response;
     NSUInteger _contentLength;
+    CFAbsoluteTime _startTime; // most recent start or resume from pausing
+
+    // scheduling state
+    BOOL _paused;
+
+    // decode backpressure state
+    NSUInteger _appendDeliveryCount; // deliveries of appended bytes the delegates have yet to handle
+    NSUInteger _coalescedByteCount; // bytes appended since the last delivery
+    TIPImageDecoderAppendResult _coalescedAppendResult;
+    BOOL _decodeBacklogged; // paused until the delegates catch up
 
     // internal progress state flags
     struct {
@@ -41,6 +51,7 @@ TIP_OBJC_FINAL
         BOOL didReceiveResponse:1;
         BOOL responseStatusCodeIsFailure:1;
         BOOL didReceiveData:1;
+        BOOL didDeliverAppendedBytes:1;
         BOOL didComplete:1;
     } _flags;
 
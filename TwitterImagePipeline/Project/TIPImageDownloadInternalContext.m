@@ -41,6 +41,9 @@ NS_ASSUME_NONNULL_BEGIN
     _hydratedRequest = nil;
     _authorization = nil;
 
+    _coalescedByteCount = 0;
+    _coalescedAppendResult = TIPImageDecoderAppendResultDidProgress;
+
     memset(&_flags, 0, sizeof(_flags));
 }
 
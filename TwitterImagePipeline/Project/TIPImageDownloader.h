@@ -40,6 +40,9 @@ TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
             forContext:(id<TIPImageDownloadContext>)context;
 - (void)updatePriorityOfContext:(id<TIPImageDownloadContext>)context;
 
+// Number of running downloads currently paused for higher priority downloads
+- (NSUInteger)pausedDownloadCount;
+
 @end
 
 @protocol TIPImageDownloadContext <NSObject>
@@ -73,6 +76,10 @@ TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
 - (nullable TIPPartialImage *)imageDownloadPartialImageForResuming;
 - (nullable TIPImageDiskCacheTemporaryFile *)imageDownloadTemporaryFileForResuming;
 
+// Revalidation info (validators of the stale cached image, sent as a conditional request when not resuming)
+- (nullable NSString *)imageDownloadRevalidationETag;
+- (nullable NSString *)imageDownloadRevalidationLastModified;
+
 @end
 
 @protocol TIPImageDownloadDelegate <NSObject>
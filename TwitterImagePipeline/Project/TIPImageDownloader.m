@@ -10,6 +10,7 @@
 #import "TIP_Project.h"
 #import "TIPError.h"
 #import "TIPGlobalConfiguration+Project.h"
+#import "TIPImageDownloadConcurrencyController.h"
 #import "TIPImageDownloader.h"
 #import "TIPImageDownloadInternalContext.h"
 #import "TIPImageFetchDownload.h"
@@ -130,6 +131,11 @@ static void _ImageDownloadSetProgressStateFailureAndCancel(TIPImageDownloadInter
     [download cancelWithDescription:[NSString stringWithFormat:@"TIP: %@ %@", download, cancelDescription]];
 }
 
+NS_INLINE BOOL _StringsAreEqual(NSString * __nullable string1, NSString * __nullable string2)
+{
+    return string1 == string2 || [string1 isEqualToString:string2];
+}
+
 static BOOL _CanCoalesceDelegate(NSObject<TIPImageDownloadDelegate> *delegate,
                                  TIPImageDownloadInternalContext *context);
 static BOOL _CanCoalesceDelegate(NSObject<TIPImageDownloadDelegate> *delegate,
@@ -161,6 +167,15 @@ static BOOL _CanCoalesceDelegate(NSObject<TIPImageDownloadDelegate> *delegate,
         return NO;
     }
 
+    // a conditional request can only serve requests for the same cached image
+    if (!_StringsAreEqual(otherRequest.imageDownloadRevalidationETag, request.imageDownloadRevalidationETag)) {
+        return NO;
+    }
+
+    if (!_StringsAreEqual(otherRequest.imageDownloadRevalidationLastModified, request.imageDownloadRevalidationLastModified)) {
+        return NO;
+    }
+
     return YES;
 }
 
@@ -171,6 +186,13 @@ TIP_OBJC_DIRECT_MEMBERS
 @interface TIPImageDownloader (Background)
 
 - (void)_background_dequeuePendingDownloads;
+- (void)_background_rebalanceRunningDownloads;
+- (NSUInteger)_background_concurrentDownloadLimit;
+- (void)_background_recordDownloadedBytes:(NSUInteger)byteCount
+                              fromContext:(TIPImageDownloadInternalContext *)context;
+- (void)_background_deliverAppendedBytesOfDownload:(id<TIPImageFetchDownload>)download;
+- (void)_background_didDeliverAppendedBytesOfDownload:(id<TIPImageFetchDownload>)download;
+- (void)_background_updateDecodeBacklogOfDownload:(id<TIPImageFetchDownload>)download;
 - (id<TIPImageFetchDownload>)_background_getOrCreateDownload:(NSObject<TIPImageDownloadDelegate> *)delegate;
 - (void)_background_clearDownload:(id<TIPImageFetchDownload>)download;
 - (void)_background_updatePriorityOfDownload:(id<TIPImageFetchDownload>)download;
@@ -185,6 +207,9 @@ TIP_OBJC_DIRECT_MEMBERS
     NSMutableDictionary<NSURL *, NSMutableArray<id<TIPImageFetchDownload>> *> *_constructedDownloads;
     NSMutableArray<id<TIPImageFetchDownload>> *_pendingDownloads;
     NSUInteger _runningDownloadsCount;
+    NSUInteger _pausedDownloadsCount;
+    BOOL _pausingLowPriorityDownloads;
+    TIPImageDownloadConcurrencyController *_concurrencyController;
 }
 
 + (instancetype)sharedInstance
@@ -241,6 +266,15 @@ TIP_OBJC_DIRECT_MEMBERS
     });
 }
 
+- (NSUInteger)pausedDownloadCount
+{
+    __block NSUInteger count = 0;
+    dispatch_sync(_downloaderQueue, ^{
+        count = self->_pausedDownloadsCount;
+    });
+    return count;
+}
+
 #pragma mark Delegate
 
 - (void)imageFetchDownloadDidStart:(id<TIPImageFetchDownload>)download
@@ -259,6 +293,7 @@ TIP_OBJC_DIRECT_MEMBERS
             return;
         }
         context->_flags.didStart = YES;
+        context->_startTime = CFAbsoluteTimeGetCurrent();
 
 #if TIP_LOG_DOWNLOAD_PROGRESS
         TIPLogDebug(@"(%@)[%p] - starting", context.originalRequest.URL, download);
@@ -351,6 +386,8 @@ TIP_OBJC_DIRECT_MEMBERS
             return;
         }
 
+        [self _background_recordDownloadedBytes:byteCount fromContext:context];
+
         if (context->_flags.responseStatusCodeIsFailure) {
             // data is for a failure, don't capture
             return;
@@ -377,14 +414,14 @@ TIP_OBJC_DIRECT_MEMBERS
         [context->_temporaryFile appendData:data];
 
         if (context.delegateCount > 0) {
-            TIPPartialImage *partialImage = context->_partialImage;
-            [context executePerDelegateSuspendingQueue:_downloaderQueue
-                                                 block:^(id<TIPImageDownloadDelegate> delegate) {
-                                                     [delegate imageDownload:(id)download
-                                                              didAppendBytes:byteCount
-                                                              toPartialImage:partialImage
-                                                                      result:result];
-                                                 }];
+            context->_coalescedByteCount += byteCount;
+            context->_coalescedAppendResult = MAX(context->_coalescedAppendResult, result);
+            if (!context->_appendDeliveryCount) {
+                [self _background_deliverAppendedBytesOfDownload:download];
+            } else {
+                // delegates are still handling earlier bytes, backpressure the network if they fall too far behind
+                [self _background_updateDecodeBacklogOfDownload:download];
+            }
         } else {
             // Running as a "detached" download, time to clean it up
             [self _background_clearDownload:download];
@@ -694,6 +731,10 @@ TIP_OBJC_DIRECT_MEMBERS
                 TIPImageCacheEntryContext *imageContext = nil;
                 if (complete) {
                     imageContext = [[TIPCompleteImageEntryContext alloc] init];
+                    TIPCompleteImageEntryContext *completeContext = (id)imageContext;
+                    NSDictionary *headers = context->_response.allHeaderFields;
+                    completeContext.lastModified = [headers tip_objectForCaseInsensitiveKey:@"Last-Modified"];
+                    completeContext.ETag = [headers tip_objectForCaseInsensitiveKey:@"ETag"];
                 } else {
                     imageContext = [[TIPPartialImageEntryContext alloc] init];
                     TIPPartialImageEntryContext *partialContext = (id)imageContext;
@@ -838,16 +879,224 @@ TIP_OBJC_DIRECT_MEMBERS
 {
     TIPAssertDownloaderQueue();
 
-    // Cast signed max value to unsigned making negative values (infinite) be HUGE (and effectively infinite)
-    const NSUInteger count = (NSUInteger)[TIPGlobalConfiguration sharedInstance].maxConcurrentImagePipelineDownloadCount;
-    while (_runningDownloadsCount < count && _pendingDownloads.count > 0) {
-        id<TIPImageFetchDownload> download = _pendingDownloads.firstObject;
-        [_pendingDownloads removeObjectAtIndex:0];
+    const NSUInteger count = [self _background_concurrentDownloadLimit];
+    // paused downloads give up their slots
+    while ((_runningDownloadsCount - _pausedDownloadsCount) < count && _pendingDownloads.count > 0) {
+        NSUInteger index = 0;
+        if (_pausingLowPriorityDownloads) {
+            // higher priority downloads go first and low priority ones would only be paused
+            NSOperationQueuePriority highestPriority = NSOperationQueuePriorityVeryLow;
+            for (NSUInteger i = 0; i < _pendingDownloads.count; i++) {
+                TIPImageDownloadInternalContext *context = (TIPImageDownloadInternalContext *)_pendingDownloads[i].context;
+                const NSOperationQueuePriority priority = [context downloadPriority];
+                if (priority > highestPriority) {
+                    highestPriority = priority;
+                    index = i;
+                }
+            }
+            if (highestPriority <= NSOperationQueuePriorityLow) {
+                break;
+            }
+        }
+
+        id<TIPImageFetchDownload> download = _pendingDownloads[index];
+        [_pendingDownloads removeObjectAtIndex:index];
         _runningDownloadsCount++;
         [download start];
     }
 }
 
+- (void)_background_rebalanceRunningDownloads
+{
+    TIPAssertDownloaderQueue();
+
+    // low priority downloads are paused while any download with a higher priority is running or pending
+    BOOL pauseLowPriority = NO;
+    if ([TIPGlobalConfiguration sharedInstance].isLowPriorityDownloadPausingEnabled) {
+        for (NSArray<id<TIPImageFetchDownload>> *downloads in _constructedDownloads.allValues) {
+            for (id<TIPImageFetchDownload> download in downloads) {
+                TIPImageDownloadInternalContext *context = (TIPImageDownloadInternalContext *)download.context;
+                if ([context downloadPriority] > NSOperationQueuePriorityLow) {
+                    pauseLowPriority = YES;
+                    break;
+                }
+            }
+            if (pauseLowPriority) {
+                break;
+            }
+        }
+    }
+
+    if (pauseLowPriority || _pausedDownloadsCount > 0) {
+        for (NSArray<id<TIPImageFetchDownload>> *downloads in _constructedDownloads.allValues) {
+            for (id<TIPImageFetchDownload> download in downloads) {
+                if (![download respondsToSelector:@selector(setPaused:)]) {
+                    continue;
+                }
+                TIPImageDownloadInternalContext *context = (TIPImageDownloadInternalContext *)download.context;
+                if (!context || [_pendingDownloads indexOfObjectIdenticalTo:download] != NSNotFound) {
+                    continue;
+                }
+
+                const BOOL pause = pauseLowPriority && [context downloadPriority] <= NSOperationQueuePriorityLow;
+                if (pause != context->_paused) {
+                    context->_paused = pause;
+                    if (pause) {
+                        _pausedDownloadsCount++;
+                    } else {
+                        TIPAssert(_pausedDownloadsCount > 0);
+                        _pausedDownloadsCount--;
+                        if (!context->_flags.didReceiveData) {
+                            // time to first byte is measured from the restart, not across the pause
+                            context->_startTime = CFAbsoluteTimeGetCurrent();
+                        }
+                    }
+                    download.paused = pause || context->_decodeBacklogged;
+                }
+            }
+        }
+    }
+
+    _pausingLowPriorityDownloads = pauseLowPriority;
+    [self _background_dequeuePendingDownloads];
+}
+
+- (NSUInteger)_background_concurrentDownloadLimit
+{
+    TIPAssertDownloaderQueue();
+
+    TIPGlobalConfiguration *config = [TIPGlobalConfiguration sharedInstance];
+    // Cast signed max value to unsigned making negative values (infinite) be HUGE (and effectively infinite)
+    const NSUInteger maxCount = (NSUInteger)config.maxConcurrentImagePipelineDownloadCount;
+    const NSInteger minCount = config.adaptiveDownloadConcurrencyMinimumCount;
+    if (minCount <= 0) {
+        _concurrencyController = nil;
+        return maxCount;
+    }
+
+    if (!_concurrencyController) {
+        _concurrencyController = [[TIPImageDownloadConcurrencyController alloc] initWithMinimumLimit:(NSUInteger)minCount
+                                                                                        maximumLimit:maxCount];
+    } else {
+        [_concurrencyController updateMinimumLimit:(NSUInteger)minCount
+                                      maximumLimit:maxCount];
+    }
+    return _concurrencyController.limit;
+}
+
+- (void)_background_recordDownloadedBytes:(NSUInteger)byteCount
+                              fromContext:(TIPImageDownloadInternalContext *)context
+{
+    TIPAssertDownloaderQueue();
+
+    TIPImageDownloadConcurrencyController *controller = _concurrencyController;
+    if (!controller) {
+        return;
+    }
+
+    const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    if (!context->_flags.didReceiveData && !context->_paused) {
+        // a paused download's first bytes say nothing about the link
+        [controller recordTimeToFirstByte:now - context->_startTime];
+    }
+    [controller recordBytes:byteCount
+               runningCount:_runningDownloadsCount - _pausedDownloadsCount
+                       time:now];
+    if (![controller evaluateWindowAtTime:now]) {
+        return;
+    }
+
+    const NSUInteger limit = controller.limit;
+    const double goodput = controller.goodput;
+    const NSTimeInterval timeToFirstByte = controller.timeToFirstByte;
+    TIPLogDebug(@"Download concurrency limit changed to %tu (goodput: %.0f B/s, time to first byte: %.3fs)", limit, goodput, timeToFirstByte);
+    NSDictionary *userInfo = @{ TIPImageDownloadConcurrencyLimitNotificationKey : @(limit),
+                                TIPImageDownloadConcurrencyGoodputNotificationKey : @(goodput),
+                                TIPImageDownloadConcurrencyTimeToFirstByteNotificationKey : @(timeToFirstByte) };
+    [[NSNotificationCenter defaultCenter] postNotificationName:TIPImageDownloadConcurrencyLimitDidChangeNotification
+                                                        object:nil
+                                                      userInfo:userInfo];
+
+    // pick up any slots that opened up
+    [self _background_dequeuePendingDownloads];
+}
+
+- (void)_background_deliverAppendedBytesOfDownload:(id<TIPImageFetchDownload>)download
+{
+    TIPAssertDownloaderQueue();
+
+    TIPImageDownloadInternalContext *context = (TIPImageDownloadInternalContext *)download.context;
+    TIPAssert(!context->_appendDeliveryCount);
+
+    // Everything appended so far goes out as one delivery, so a delegate that is slow to decode
+    // renders the latest scan once instead of rendering each of the scans it fell behind on.
+    // After the first delivery (which delegates compare with the partial image to detect resumed
+    // downloads) the downloader queue is not suspended for it, so other downloads keep flowing.
+    const NSUInteger byteCount = context->_coalescedByteCount;
+    const TIPImageDecoderAppendResult result = context->_coalescedAppendResult;
+    TIPPartialImage *partialImage = context->_partialImage;
+    context->_coalescedByteCount = 0;
+    context->_coalescedAppendResult = TIPImageDecoderAppendResultDidProgress;
+    context->_appendDeliveryCount = context.delegateCount;
+
+    dispatch_queue_t downloaderQueue = _downloaderQueue;
+    dispatch_queue_t suspendingQueue = (context->_flags.didDeliverAppendedBytes) ? NULL : downloaderQueue;
+    context->_flags.didDeliverAppendedBytes = YES;
+    [context executePerDelegateSuspendingQueue:suspendingQueue
+                                         block:^(id<TIPImageDownloadDelegate> delegate) {
+                                             [delegate imageDownload:(id)download
+                                                      didAppendBytes:byteCount
+                                                      toPartialImage:partialImage
+                                                              result:result];
+                                             tip_dispatch_async_autoreleasing(downloaderQueue, ^{
+                                                 [self _background_didDeliverAppendedBytesOfDownload:download];
+                                             });
+                                         }];
+}
+
+- (void)_background_didDeliverAppendedBytesOfDownload:(id<TIPImageFetchDownload>)download
+{
+    TIPAssertDownloaderQueue();
+
+    TIPImageDownloadInternalContext *context = (TIPImageDownloadInternalContext *)download.context;
+    if (!context) {
+        return;
+    }
+
+    TIPAssert(context->_appendDeliveryCount > 0);
+    context->_appendDeliveryCount--;
+    if (context->_appendDeliveryCount > 0) {
+        return;
+    }
+
+    // completion delivers the whole image, bytes coalesced before it don't need to go out
+    if (context->_coalescedByteCount > 0 && !context->_flags.didComplete && context.delegateCount > 0) {
+        [self _background_deliverAppendedBytesOfDownload:download];
+    }
+    [self _background_updateDecodeBacklogOfDownload:download];
+}
+
+- (void)_background_updateDecodeBacklogOfDownload:(id<TIPImageFetchDownload>)download
+{
+    TIPAssertDownloaderQueue();
+
+    TIPImageDownloadInternalContext *context = (TIPImageDownloadInternalContext *)download.context;
+    if (![download respondsToSelector:@selector(setPaused:)]) {
+        return;
+    }
+
+    const NSUInteger maxBytes = [TIPGlobalConfiguration sharedInstance].downloadDecodeBacklogMaxBytes;
+    const BOOL backlogged = maxBytes > 0 && context->_appendDeliveryCount > 0 && context->_coalescedByteCount >= maxBytes;
+    if (backlogged == context->_decodeBacklogged) {
+        return;
+    }
+
+    // the slot is kept while backlogged, the delegates catching up will resume the download shortly
+    TIPLogDebug(@"(%@)[%p] - %@ reads, %tu bytes ahead of decoding", context.originalRequest.URL, download, (backlogged) ? @"pausing" : @"resuming", context->_coalescedByteCount);
+    context->_decodeBacklogged = backlogged;
+    download.paused = backlogged || context->_paused;
+}
+
 - (void)_background_updatePriorityOfDownload:(id<TIPImageFetchDownload>)download
 {
     TIPAssertDownloaderQueue();
@@ -857,6 +1106,8 @@ TIP_OBJC_DIRECT_MEMBERS
         NSOperationQueuePriority priority = [context downloadPriority];
         download.priority = priority;
     }
+
+    [self _background_rebalanceRunningDownloads];
 }
 
 - (void)_background_removeDelegate:(NSObject<TIPImageDownloadDelegate> *)delegate
@@ -870,6 +1121,7 @@ TIP_OBJC_DIRECT_MEMBERS
     if (context.delegateCount > 1) {
         // Just remove the delegate
         [context removeDelegate:delegate];
+        [self _background_updatePriorityOfDownload:download];
         return;
     }
 
@@ -910,7 +1162,12 @@ TIP_OBJC_DIRECT_MEMBERS
             if (index == NSNotFound) {
                 TIPAssert(_runningDownloadsCount > 0);
                 _runningDownloadsCount--;
-                [self _background_dequeuePendingDownloads];
+                if (context && context->_paused) {
+                    TIPAssert(_pausedDownloadsCount > 0);
+                    _pausedDownloadsCount--;
+                    context->_paused = NO;
+                }
+                [self _background_rebalanceRunningDownloads];
             } else {
                 [_pendingDownloads removeObjectAtIndex:index];
             }
@@ -991,6 +1248,17 @@ TIP_OBJC_DIRECT_MEMBERS
 
         NSMutableURLRequest *URLRequest = [NSMutableURLRequest requestWithURL:URL];
         URLRequest.allHTTPHeaderFields = request.imageDownloadHeaders;
+        if (!context->_partialImage) {
+            // revalidating a stale cached image
+            NSString *ETag = request.imageDownloadRevalidationETag;
+            NSString *lastModified = request.imageDownloadRevalidationLastModified;
+            if (ETag.length > 0) {
+                [URLRequest setValue:ETag forHTTPHeaderField:@"If-None-Match"];
+            }
+            if (lastModified.length > 0) {
+                [URLRequest setValue:lastModified forHTTPHeaderField:@"If-Modified-Since"];
+            }
+        }
 
         context.originalRequest = URLRequest;
         context.downloadQueue = _downloaderQueue;
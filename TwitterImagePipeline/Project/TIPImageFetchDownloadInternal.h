@@ -13,6 +13,9 @@ NS_ASSUME_NONNULL_BEGIN
 @interface TIPImageFetchDownloadInternal : NSObject <TIPImageFetchDownload>
 - (NSURLSession *)URLSession;
 - (instancetype)initWithContext:(id<TIPImageFetchDownloadContext>)context;
++ (NSURLSession *)defaultURLSession;
++ (void)preconnectToURLs:(NSArray<NSURL *> *)URLs
+                 session:(NSURLSession *)session;
 @end
 
 @interface TIPImageFetchDownloadProviderInternal : NSObject <TIPImageFetchDownloadProvider>
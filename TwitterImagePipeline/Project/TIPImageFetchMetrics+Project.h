@@ -28,6 +28,7 @@ TIP_OBJC_DIRECT_MEMBERS
                 imageType:(nullable NSString *)imageType
          imageSizeInBytes:(NSUInteger)sizeInBytes
           imageDimensions:(CGSize)dimensions;
+- (void)networkRequestWasHedged:(BOOL)hedgedRequestWon;
 
 - (void)previewWasHit:(NSTimeInterval)renderLatency;
 - (void)progressiveFrameWasHit:(NSTimeInterval)renderLatency;
@@ -50,6 +51,7 @@ TIP_OBJC_DIRECT_MEMBERS
                 imageType:(nullable NSString *)imageType
          imageSizeInBytes:(NSUInteger)sizeInBytes
           imageDimensions:(CGSize)dimensions;
+- (void)networkRequestWasHedged:(BOOL)hedgedRequestWon;
 - (void)flipLoadSourceFromNetworkToNetworkResumed;
 
 @end
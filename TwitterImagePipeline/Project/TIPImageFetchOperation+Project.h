@@ -32,6 +32,7 @@ NS_ASSUME_NONNULL_BEGIN
                    sourceImageDimensions:(CGSize)sourceDims;
 
 - (void)willEnqueue;
+- (void)prepareForBackgroundRevalidation; // before enqueuing, skips the memory caches and always revalidates
 - (BOOL)supportsLoadingFromSource:(TIPImageLoadSource)source;
 - (BOOL)supportsLoadingFromRenderedCache;
 
@@ -0,0 +1,79 @@
+//
+//  TIPImageHotSet.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import <UIKit/UIView.h>
+
+#import "TIP_Project.h"
+
+@class TIPImageDiskCache;
+@class TIPImageMemoryCache;
+@class TIPImageRenderedCache;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** An image that was hot (recently rendered) along with the sizing it was rendered at */
+TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
+@interface TIPImageHotSetItem : NSObject
+
+@property (nonatomic, readonly, copy) NSString *identifier;
+@property (nonatomic, readonly, nullable) NSURL *URL; // the image was fetched from
+@property (nonatomic, readonly) CGSize targetDimensions;
+@property (nonatomic, readonly) UIViewContentMode targetContentMode;
+
+- (instancetype)initWithIdentifier:(NSString *)identifier
+                               URL:(nullable NSURL *)URL
+                  targetDimensions:(CGSize)targetDimensions
+                 targetContentMode:(UIViewContentMode)targetContentMode NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+/**
+ Persists the hot set of a pipeline's caches so that it can be prewarmed on the next launch.
+
+ Reading, writing and prewarming all happen on a shared low priority serial queue.
+ Prewarming loads one image at a time from the disk cache into the memory cache, deferring whenever
+ there are active fetch operations so that real fetches are never competing with the prewarm.
+ The memory cache only holds encoded bytes, so no decoding happens unless the rendered cache is
+ being prewarmed too, and then only at each item's target sizing.  Prewarming gives up once the
+ launch window has elapsed since, by then, the app has fetched what it needs on its own.
+ */
+TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
+@interface TIPImageHotSet : NSObject
+
+@property (nonatomic, readonly, copy) NSString *path;
+
+- (instancetype)initWithPath:(NSString *)path NS_DESIGNATED_INITIALIZER;
+
+/** Write the _items_ to `path`, an empty _items_ leaves any existing snapshot in place */
+- (void)persistItems:(NSArray<TIPImageHotSetItem *> *)items
+       synchronously:(BOOL)synchronously;
+
+/** Asynchronously read the snapshot at `path` and prewarm the caches with it */
+- (void)prewarmMemoryCache:(TIPImageMemoryCache *)memoryCache
+             renderedCache:(nullable TIPImageRenderedCache *)renderedCache
+             fromDiskCache:(TIPImageDiskCache *)diskCache
+                  maxCount:(NSUInteger)maxCount;
+
+/** Asynchronously remove the snapshot at `path` */
+- (void)removeSnapshot;
+
+/** Asynchronously remove every snapshot, that is the whole _directoryPath_ they are persisted to */
++ (void)removeAllSnapshotsAtDirectoryPath:(NSString *)directoryPath;
+
+/** Asynchronously read the snapshot at `path` and preconnect to the hosts its images were fetched from */
+- (void)preconnectWithMaxCount:(NSUInteger)maxCount;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
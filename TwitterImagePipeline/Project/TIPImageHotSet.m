@@ -0,0 +1,339 @@
+//
+//  TIPImageHotSet.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import "TIP_Project.h"
+#import "TIPGlobalConfiguration+Project.h"
+#import "TIPImageCacheEntry.h"
+#import "TIPImageContainer.h"
+#import "TIPImageDiskCache.h"
+#import "TIPImageHotSet.h"
+#import "TIPImageMemoryCache.h"
+#import "TIPImageRenderedCache.h"
+#import "TIPTiming.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+static NSString * const kHotSetItemIdentifierKey = @"id";
+static NSString * const kHotSetItemURLKey = @"url";
+static NSString * const kHotSetItemWidthKey = @"w";
+static NSString * const kHotSetItemHeightKey = @"h";
+static NSString * const kHotSetItemContentModeKey = @"mode";
+
+// How long to wait before checking again when prewarming is deferring to active fetches
+static const NSTimeInterval kPrewarmDeferralDelay = 0.1;
+// Prewarming is abandoned once this much time has passed since it started
+static const NSTimeInterval kPrewarmWindow = 15.0;
+
+static dispatch_queue_t _HotSetQueue(void);
+static dispatch_queue_t _HotSetQueue()
+{
+    static dispatch_queue_t sQueue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        dispatch_queue_attr_t attr = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_BACKGROUND, 0);
+        sQueue = dispatch_queue_create("com.twitter.tip.hotset.queue", attr);
+    });
+    return sQueue;
+}
+
+static BOOL _AreFetchesActive(void);
+static BOOL _AreFetchesActive()
+{
+    NSArray<TIPImageFetchOperation *> *fetchOps = nil;
+    [[TIPGlobalConfiguration sharedInstance] getAllFetchOperations:&fetchOps
+                                                allStoreOperations:NULL];
+    return fetchOps.count > 0;
+}
+
+@implementation TIPImageHotSetItem
+
+- (instancetype)initWithIdentifier:(NSString *)identifier
+                               URL:(nullable NSURL *)URL
+                  targetDimensions:(CGSize)targetDimensions
+                 targetContentMode:(UIViewContentMode)targetContentMode
+{
+    if (self = [super init]) {
+        _identifier = [identifier copy];
+        _URL = URL;
+        _targetDimensions = targetDimensions;
+        _targetContentMode = targetContentMode;
+    }
+    return self;
+}
+
+@end
+
+@implementation TIPImageHotSet
+
+- (instancetype)initWithPath:(NSString *)path
+{
+    if (self = [super init]) {
+        _path = [path copy];
+    }
+    return self;
+}
+
+- (void)persistItems:(NSArray<TIPImageHotSetItem *> *)items
+       synchronously:(BOOL)synchronously
+{
+    if (!items.count) {
+        return;
+    }
+
+    NSMutableArray<NSDictionary<NSString *, id> *> *plist = [[NSMutableArray alloc] initWithCapacity:items.count];
+    for (TIPImageHotSetItem *item in items) {
+        NSMutableDictionary<NSString *, id> *itemDictionary = [[NSMutableDictionary alloc] initWithCapacity:5];
+        itemDictionary[kHotSetItemIdentifierKey] = item.identifier;
+        itemDictionary[kHotSetItemURLKey] = item.URL.absoluteString;
+        itemDictionary[kHotSetItemWidthKey] = @(item.targetDimensions.width);
+        itemDictionary[kHotSetItemHeightKey] = @(item.targetDimensions.height);
+        itemDictionary[kHotSetItemContentModeKey] = @(item.targetContentMode);
+        [plist addObject:itemDictionary];
+    }
+
+    dispatch_block_t block = ^{
+        [self _hotSet_writePlist:plist];
+    };
+    if (synchronously) {
+        tip_dispatch_sync_autoreleasing(_HotSetQueue(), block);
+    } else {
+        dispatch_block_t endBackgroundTaskBlock = TIPStartBackgroundTask(@"[TIPImageHotSet persist]");
+        tip_dispatch_async_autoreleasing(_HotSetQueue(), ^{
+            block();
+            if (endBackgroundTaskBlock) {
+                endBackgroundTaskBlock();
+            }
+        });
+    }
+}
+
+- (void)prewarmMemoryCache:(TIPImageMemoryCache *)memoryCache
+             renderedCache:(nullable TIPImageRenderedCache *)renderedCache
+             fromDiskCache:(TIPImageDiskCache *)diskCache
+                  maxCount:(NSUInteger)maxCount
+{
+    const uint64_t machStart = mach_absolute_time();
+    tip_dispatch_async_autoreleasing(_HotSetQueue(), ^{
+        NSArray<TIPImageHotSetItem *> *items = [self _hotSet_readItems];
+        if (items.count > maxCount) {
+            items = [items subarrayWithRange:NSMakeRange(0, maxCount)];
+        }
+        if (items.count) {
+            [self _hotSet_prewarmItems:items
+                               atIndex:0
+                           memoryCache:memoryCache
+                         renderedCache:renderedCache
+                             diskCache:diskCache
+                             machStart:machStart];
+        }
+    });
+}
+
+- (void)removeSnapshot
+{
+    tip_dispatch_async_autoreleasing(_HotSetQueue(), ^{
+        [[NSFileManager defaultManager] removeItemAtPath:self->_path error:NULL];
+    });
+}
+
++ (void)removeAllSnapshotsAtDirectoryPath:(NSString *)directoryPath
+{
+    tip_dispatch_async_autoreleasing(_HotSetQueue(), ^{
+        [[NSFileManager defaultManager] removeItemAtPath:directoryPath error:NULL];
+    });
+}
+
+- (void)preconnectWithMaxCount:(NSUInteger)maxCount
+{
+    tip_dispatch_async_autoreleasing(_HotSetQueue(), ^{
+        NSArray<TIPImageHotSetItem *> *items = [self _hotSet_readItems];
+        NSMutableArray<NSURL *> *URLs = [[NSMutableArray alloc] init];
+        for (TIPImageHotSetItem *item in items) {
+            if (URLs.count >= maxCount) {
+                break;
+            }
+            if (item.URL) {
+                [URLs addObject:item.URL];
+            }
+        }
+        if (URLs.count) {
+            [[TIPGlobalConfiguration sharedInstance] preconnectToURLs:URLs];
+        }
+    });
+}
+
+#pragma mark Private
+
+- (void)_hotSet_writePlist:(NSArray<NSDictionary<NSString *, id> *> *)plist
+{
+    NSError *error = nil;
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:plist
+                                                              format:NSPropertyListBinaryFormat_v1_0
+                                                             options:0
+                                                               error:&error];
+    if (data) {
+        [[NSFileManager defaultManager] createDirectoryAtPath:[_path stringByDeletingLastPathComponent]
+                                  withIntermediateDirectories:YES
+                                                   attributes:nil
+                                                        error:NULL];
+        if (![data writeToFile:_path options:NSDataWritingAtomic error:&error]) {
+            data = nil;
+        }
+    }
+    if (!data) {
+        TIPLogWarning(@"Failed to persist hot set to '%@': %@", _path, error);
+    }
+}
+
+- (NSArray<TIPImageHotSetItem *> *)_hotSet_readItems
+{
+    NSData *data = [NSData dataWithContentsOfFile:_path];
+    if (!data) {
+        return @[];
+    }
+
+    id plist = [NSPropertyListSerialization propertyListWithData:data
+                                                         options:NSPropertyListImmutable
+                                                          format:NULL
+                                                           error:NULL];
+    if (![plist isKindOfClass:[NSArray class]]) {
+        TIPLogWarning(@"Discarding malformed hot set at '%@'", _path);
+        [[NSFileManager defaultManager] removeItemAtPath:_path error:NULL];
+        return @[];
+    }
+
+    NSMutableArray<TIPImageHotSetItem *> *items = [[NSMutableArray alloc] initWithCapacity:[(NSArray *)plist count]];
+    for (NSDictionary<NSString *, id> *itemDictionary in (NSArray *)plist) {
+        if (![itemDictionary isKindOfClass:[NSDictionary class]]) {
+            continue;
+        }
+
+        NSString *identifier = itemDictionary[kHotSetItemIdentifierKey];
+        NSNumber *width = itemDictionary[kHotSetItemWidthKey];
+        NSNumber *height = itemDictionary[kHotSetItemHeightKey];
+        NSNumber *contentMode = itemDictionary[kHotSetItemContentModeKey];
+        NSString *URLString = itemDictionary[kHotSetItemURLKey];
+        if (![identifier isKindOfClass:[NSString class]] || ![width isKindOfClass:[NSNumber class]] || ![height isKindOfClass:[NSNumber class]] || ![contentMode isKindOfClass:[NSNumber class]]) {
+            continue;
+        }
+
+        [items addObject:[[TIPImageHotSetItem alloc] initWithIdentifier:identifier
+                                                                    URL:([URLString isKindOfClass:[NSString class]]) ? [NSURL URLWithString:URLString] : nil
+                                                       targetDimensions:CGSizeMake((CGFloat)width.doubleValue, (CGFloat)height.doubleValue)
+                                                      targetContentMode:(UIViewContentMode)contentMode.integerValue]];
+    }
+    return items;
+}
+
+- (void)_hotSet_prewarmItems:(NSArray<TIPImageHotSetItem *> *)items
+                     atIndex:(NSUInteger)index
+                 memoryCache:(TIPImageMemoryCache *)memoryCache
+               renderedCache:(nullable TIPImageRenderedCache *)renderedCache
+                   diskCache:(TIPImageDiskCache *)diskCache
+                   machStart:(uint64_t)machStart
+{
+    if (index >= items.count) {
+        TIPLogDebug(@"%@ prewarmed %tu images in %.3fs", NSStringFromClass([self class]), items.count, TIPComputeDuration(machStart, mach_absolute_time()));
+        return;
+    }
+
+    if (TIPComputeDuration(machStart, mach_absolute_time()) > kPrewarmWindow) {
+        TIPLogDebug(@"%@ abandoned prewarming after %tu of %tu images", NSStringFromClass([self class]), index, items.count);
+        return;
+    }
+
+    dispatch_block_t next = ^{
+        [self _hotSet_prewarmItems:items
+                           atIndex:index + 1
+                       memoryCache:memoryCache
+                     renderedCache:renderedCache
+                         diskCache:diskCache
+                         machStart:machStart];
+    };
+
+    dispatch_block_t deferItem = ^{
+        // defer to the real fetches, check again shortly
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kPrewarmDeferralDelay * NSEC_PER_SEC)), _HotSetQueue(), ^{
+            @autoreleasepool {
+                [self _hotSet_prewarmItems:items
+                                   atIndex:index
+                               memoryCache:memoryCache
+                             renderedCache:renderedCache
+                                 diskCache:diskCache
+                                 machStart:machStart];
+            }
+        });
+    };
+
+    if (_AreFetchesActive()) {
+        deferItem();
+        return;
+    }
+
+    // The disk cache queue is shared with real fetches, so only the manifest lookup happens on it:
+    // files are memory mapped and are paged in by the decode on the hot set queue.
+    // A fetch that started while waiting for the queue wins, the read is skipped.
+    TIPImageHotSetItem *item = items[index];
+    __block NSData *data = nil;
+    __block TIPImageCacheEntryContext *context = nil;
+    __block BOOL didYieldToFetch = NO;
+    tip_dispatch_sync_autoreleasing([TIPGlobalConfiguration sharedInstance].queueForDiskCaches, ^{
+        if (_AreFetchesActive()) {
+            didYieldToFetch = YES;
+            return;
+        }
+        TIPImageCacheEntryContext *dataContext = nil;
+        data = [diskCache diskCache_imageEntryDataForIdentifier:item.identifier
+                                       hitShouldMoveEntryToHead:NO
+                                                        context:&dataContext];
+        context = dataContext;
+    });
+
+    if (didYieldToFetch) {
+        deferItem();
+        return;
+    }
+
+    if (data && [context isKindOfClass:[TIPCompleteImageEntryContext class]]) {
+        // the memory cache only keeps the encoded bytes, no need to decode
+        TIPImageCacheEntry *entry = [[TIPImageCacheEntry alloc] init];
+        entry.identifier = item.identifier;
+        entry.completeImageData = data;
+        entry.completeImageContext = (TIPCompleteImageEntryContext *)context;
+        [memoryCache updateImageEntry:entry forciblyReplaceExisting:NO];
+
+        if (renderedCache && !_AreFetchesActive()) {
+            // decode at the size the image was last rendered at, not at full size
+            // (skipped if a fetch started, the memory cache entry is enough to render it quickly)
+            TIPImageContainer *image = [TIPImageContainer imageContainerWithData:data
+                                                                targetDimensions:item.targetDimensions
+                                                               targetContentMode:item.targetContentMode
+                                                                decoderConfigMap:nil
+                                                                  codecCatalogue:nil];
+            image = [image scaleToTargetDimensions:item.targetDimensions
+                                       contentMode:item.targetContentMode];
+            if (image) {
+                [image decode];
+                TIPImageCacheEntry *renderedEntry = [[TIPImageCacheEntry alloc] init];
+                renderedEntry.identifier = item.identifier;
+                renderedEntry.completeImage = image;
+                renderedEntry.completeImageContext = [entry.completeImageContext copy];
+                [renderedCache storeImageEntry:renderedEntry
+                         transformerIdentifier:nil
+                         sourceImageDimensions:entry.completeImageContext.dimensions];
+            }
+        }
+    }
+
+    // one image at a time, yielding the queue in between
+    tip_dispatch_async_autoreleasing(_HotSetQueue(), next);
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
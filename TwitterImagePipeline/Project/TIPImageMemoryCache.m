@@ -11,6 +11,7 @@
 #import "TIP_Project.h"
 #import "TIPGlobalConfiguration+Project.h"
 #import "TIPImageCacheEntry.h"
+#import "TIPImageCacheExpiryIndex.h"
 #import "TIPImageMemoryCache.h"
 #import "TIPImagePipeline+Project.h"
 #import "TIPImagePipelineInspectionResult+Project.h"
@@ -32,16 +33,30 @@ TIP_OBJC_DIRECT_MEMBERS
            withCompleteImageData:(NSData *)completeImageData
                          context:(TIPCompleteImageEntryContext *)context;
 - (void)_memoryCache_didEvictEntry:(TIPImageMemoryCacheEntry *)entry;
+- (BOOL)_memoryCache_expireEntry:(TIPImageMemoryCacheEntry *)entry
+                          atTime:(CFAbsoluteTime)now;
+- (void)_memoryCache_expireEntries:(NSArray<TIPImageCacheEntry *> *)entries;
 - (void)_memoryCache_inspect:(TIPInspectableCacheCallback)callback;
 - (void)_memoryCache_updateByteCountsAdded:(UInt64)bytesAdded
                                    removed:(UInt64)bytesRemoved;
 
 @end
 
+static BOOL _IsValidEntry(TIPImageCacheEntry *entry);
+static BOOL _IsValidEntry(TIPImageCacheEntry *entry)
+{
+    // only the complete image's data is kept, so the data can stand in for the decoded image
+    if (!entry.completeImage && entry.completeImageData && entry.completeImageContext) {
+        return entry.identifier != nil && !entry.partialImage == !entry.partialImageContext;
+    }
+    return [entry isValid:NO];
+}
+
 @implementation TIPImageMemoryCache
 {
     TIPGlobalConfiguration *_globalConfig;
     TIPLRUCache *_manifest;
+    TIPImageCacheExpiryIndex *_expiryIndex;
 }
 
 @synthesize manifest = _manifest;
@@ -61,6 +76,11 @@ TIP_OBJC_DIRECT_MEMBERS
     if (self = [super init]) {
         _globalConfig = [TIPGlobalConfiguration sharedInstance];
         _manifest = [[TIPLRUCache alloc] initWithEntries:nil delegate:self];
+        __weak typeof(self) weakSelf = self;
+        _expiryIndex = [[TIPImageCacheExpiryIndex alloc] initWithQueue:_globalConfig.queueForMemoryCaches
+                                                         expiryHandler:^(NSArray<TIPImageCacheEntry *> *expiredEntries) {
+            [weakSelf _memoryCache_expireEntries:expiredEntries];
+        }];
         [[NSNotificationCenter defaultCenter] addObserver:self
                                                  selector:@selector(_tip_memoryCache_didReceiveMemoryWarning:)
                                                      name:UIApplicationDidReceiveMemoryWarningNotification
@@ -107,33 +127,12 @@ TIP_OBJC_DIRECT_MEMBERS
         if (entry) {
 
             // Validate TTL
-            NSDate *now = [NSDate date];
-            NSDate *lastAccess = nil;
-            NSUInteger oldCost = entry.memoryCost;
-
-            lastAccess = entry.partialImageContext.lastAccess;
-            if (lastAccess && [now timeIntervalSinceDate:lastAccess] > entry.partialImageContext.TTL) {
-                TIPAssert(entry.partialImageContext.TTL > 0.0);
-                entry.partialImageContext = nil;
-                entry.partialImage = nil;
-            }
-            lastAccess = entry.completeImageContext.lastAccess;
-            if (lastAccess && [now timeIntervalSinceDate:lastAccess] > entry.completeImageContext.TTL) {
-                TIPAssert(entry.completeImageContext.TTL > 0.0);
-                entry.completeImageContext = nil;
-                entry.completeImage = nil;
-                entry.completeImageData = nil;
-            }
-
-            // Resolve changes to entry
-            NSUInteger newCost = entry.memoryCost;
-            if (!newCost) {
-                [self->_manifest removeEntry:entry];
-                entry = nil;
-            } else {
-                [self _memoryCache_updateByteCountsAdded:newCost
-                                                 removed:oldCost];
-                TIPAssert(newCost <= oldCost); // removing the cache image and/or partial image only ever removes bytes
+            // (only possible to be expired if the expiry index has yet to sweep it)
+            const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+            if (now > entry.expiryTime) {
+                if (![self _memoryCache_expireEntry:entry atTime:now]) {
+                    entry = nil;
+                }
             }
 
             // Retrieve the image based on target sizing
@@ -146,13 +145,14 @@ TIP_OBJC_DIRECT_MEMBERS
             }
 
             // Update entry
-            if (entry) {
+            if (entry.shouldAccessMoveLRUEntryToHead) {
                 if (entry.partialImageContext.updateExpiryOnAccess) {
                     entry.partialImageContext.lastAccess = now;
                 }
                 if (entry.completeImageContext.updateExpiryOnAccess) {
                     entry.completeImageContext.lastAccess = now;
                 }
+                [self->_expiryIndex updateEntry:entry];
             }
         }
 
@@ -170,7 +170,7 @@ TIP_OBJC_DIRECT_MEMBERS
     }
 
     tip_dispatch_async_autoreleasing(_globalConfig.queueForMemoryCaches, ^{
-        if (![entry isValid:NO]) {
+        if (!_IsValidEntry(entry)) {
             return;
         }
 
@@ -179,7 +179,7 @@ TIP_OBJC_DIRECT_MEMBERS
         BOOL updatedCompleteImage = NO, updatedPartialImage = NO;
 
         if (currentEntry && !force) {
-            if (entry.completeImage) {
+            if (entry.completeImage || entry.completeImageData) {
                 updatedCompleteImage = [self _memoryCache_updateEntry:currentEntry
                                                 withCompleteImageData:entry.completeImageData
                                                               context:entry.completeImageContext];
@@ -188,6 +188,9 @@ TIP_OBJC_DIRECT_MEMBERS
                                                     withPartialImage:entry.partialImage
                                                              context:entry.partialImageContext];
             }
+            if (updatedCompleteImage || updatedPartialImage) {
+                [self->_expiryIndex updateEntry:currentEntry];
+            }
         } else {
             if (currentEntry) {
                 [self->_manifest removeEntry:currentEntry];
@@ -239,9 +242,10 @@ TIP_OBJC_DIRECT_MEMBERS
                     }
 
                     [self->_manifest addEntry:currentEntry];
-                    NSDate *now = [NSDate date];
+                    const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
                     currentEntry.partialImageContext.lastAccess = now;
                     currentEntry.completeImageContext.lastAccess = now;
+                    [self->_expiryIndex updateEntry:currentEntry];
                 }
             }
         }
@@ -283,6 +287,7 @@ TIP_OBJC_DIRECT_MEMBERS
     tip_dispatch_async_autoreleasing(_globalConfig.queueForMemoryCaches, ^{
         const SInt16 totalCount = (SInt16)self->_manifest.numberOfEntries;
         [self->_manifest clearAllEntries];
+        [self->_expiryIndex removeAllEntries];
         [TIPGlobalConfiguration sharedInstance].internalTotalCountForAllMemoryCaches -= totalCount;
         [self _memoryCache_updateByteCountsAdded:0
                                          removed:(UInt64)self.atomicTotalCost];
@@ -299,6 +304,7 @@ TIP_OBJC_DIRECT_MEMBERS
 {
     [TIPGlobalConfiguration sharedInstance].internalTotalCountForAllMemoryCaches -= 1;
     [self _memoryCache_updateByteCountsAdded:0 removed:entry.memoryCost];
+    [_expiryIndex removeEntry:entry];
     [self _memoryCache_didEvictEntry:entry];
 }
 
@@ -422,6 +428,48 @@ TIP_OBJC_DIRECT_MEMBERS
     return YES;
 }
 
+- (BOOL)_memoryCache_expireEntry:(TIPImageMemoryCacheEntry *)entry
+                          atTime:(CFAbsoluteTime)now
+{
+    const NSUInteger oldCost = entry.memoryCost;
+
+    TIPPartialImageEntryContext *partialContext = entry.partialImageContext;
+    if (partialContext.lastAccess != 0 && (now - partialContext.lastAccess) > partialContext.TTL) {
+        TIPAssert(partialContext.TTL > 0.0);
+        entry.partialImageContext = nil;
+        entry.partialImage = nil;
+    }
+    TIPCompleteImageEntryContext *completeContext = entry.completeImageContext;
+    if (completeContext.lastAccess != 0 && (now - completeContext.lastAccess) > completeContext.TTL) {
+        TIPAssert(completeContext.TTL > 0.0);
+        entry.completeImageContext = nil;
+        entry.completeImage = nil;
+        entry.completeImageData = nil;
+    }
+
+    // Resolve changes to entry
+    const NSUInteger newCost = entry.memoryCost;
+    TIPAssert(newCost <= oldCost); // removing the cache image and/or partial image only ever removes bytes
+    [self _memoryCache_updateByteCountsAdded:newCost
+                                     removed:oldCost];
+    if (!newCost) {
+        [_manifest removeEntry:entry];
+        return NO;
+    }
+
+    [_expiryIndex updateEntry:entry];
+    return YES;
+}
+
+- (void)_memoryCache_expireEntries:(NSArray<TIPImageCacheEntry *> *)entries
+{
+    const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    for (TIPImageMemoryCacheEntry *entry in entries) {
+        [self _memoryCache_expireEntry:entry atTime:now];
+    }
+    TIPLogDebug(@"%@ expired %tu entries", NSStringFromClass([self class]), entries.count);
+}
+
 - (void)_memoryCache_didEvictEntry:(TIPImageMemoryCacheEntry *)entry
 {
     TIPLogDebug(@"%@ Evicted '%@', complete:'%@', partial:'%@'", NSStringFromClass([self class]), entry.identifier, entry.completeImageContext.URL, entry.partialImageContext.URL);
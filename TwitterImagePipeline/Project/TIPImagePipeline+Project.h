@@ -14,6 +14,7 @@
 @class TIPImageMemoryCache;
 @class TIPImageRenderedCache;
 @class TIPImageDownloader;
+@class TIPImageHotSet;
 @class TIPImageStoreOperation;
 
 NS_ASSUME_NONNULL_BEGIN
@@ -27,6 +28,7 @@ FOUNDATION_EXTERN NSString * const TIPImagePipelineDidTearDownImagePipelineNotif
 @property (tip_nonatomic_direct, readonly, nullable) TIPImageMemoryCache *memoryCache;
 @property (tip_nonatomic_direct, readonly, nullable) TIPImageDiskCache *diskCache;
 @property (tip_nonatomic_direct, readonly, nullable) TIPImageDownloader *downloader;
+@property (tip_nonatomic_direct, readonly) TIPImageHotSet *hotSet;
 
 - (TIPImageStoreOperation *)storeOperationWithRequest:(id<TIPImageStoreRequest>)request
                                            completion:(nullable TIPImagePipelineOperationCompletionBlock)completion TIP_OBJC_DIRECT;
@@ -35,6 +37,19 @@ FOUNDATION_EXTERN NSString * const TIPImagePipelineDidTearDownImagePipelineNotif
 
 - (nullable id<TIPImageCache>)cacheOfType:(TIPImageCacheType)type;
 + (NSDictionary<NSString *, TIPImagePipeline *> *)allRegisteredImagePipelines;
++ (void)removeAllHotSetSnapshots; // including those of pipelines that are not registered
+
+// Cache lookup statistics (thread safe)
+- (void)recordLookupOfCacheType:(TIPImageCacheType)type
+                            hit:(BOOL)hit TIP_OBJC_DIRECT;
+- (void)getLookupHitCount:(out NSUInteger * __nullable)hitCountOut
+                missCount:(out NSUInteger * __nullable)missCountOut
+             forCacheType:(TIPImageCacheType)type TIP_OBJC_DIRECT;
+
+// Time to first image, from the pipeline's creation to its first final image (thread safe)
+- (void)recordFirstImageLoadWithSource:(TIPImageLoadSource)source TIP_OBJC_DIRECT; // only the first call counts
+- (BOOL)getTimeToFirstImage:(out NSTimeInterval * __nullable)durationOut
+                 loadSource:(out TIPImageLoadSource * __nullable)loadSourceOut TIP_OBJC_DIRECT;
 
 @end
 
@@ -12,6 +12,7 @@
 #import "TIPInspectableCache.h"
 
 @class TIPImageCacheEntry;
+@class TIPImageHotSetItem;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -28,6 +29,7 @@ NS_ASSUME_NONNULL_BEGIN
   sourceImageDimensions:(CGSize)sourceDims TIP_OBJC_DIRECT;
 - (void)dirtyImageWithIdentifier:(NSString *)identifier TIP_OBJC_DIRECT;
 - (void)weakifyEntries TIP_OBJC_DIRECT;
+- (NSArray<TIPImageHotSetItem *> *)hotSetItemsWithMaxCount:(NSUInteger)maxCount TIP_OBJC_DIRECT; // main thread only, most recent first
 
 @end
 
@@ -11,6 +11,7 @@
 #import "TIP_Project.h"
 #import "TIPGlobalConfiguration+Project.h"
 #import "TIPImageCacheEntry.h"
+#import "TIPImageHotSet.h"
 #import "TIPImagePipeline+Project.h"
 #import "TIPImagePipelineInspectionResult+Project.h"
 #import "TIPImageRenderedCache.h"
@@ -67,6 +68,7 @@ TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
                                         sourceImageDimensions:(out CGSize * __nullable)sourceDimsOut
                                                         dirty:(out BOOL * __nullable)dirtyOut;
 - (NSArray<TIPImageCacheEntry *> *)allEntries;
+- (nullable TIPImageCacheEntry *)mostRecentUntransformedEntry;
 - (void)dirtyAllEntries;
 
 // weakify pattern
@@ -334,6 +336,34 @@ TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
     }
 }
 
+- (NSArray<TIPImageHotSetItem *> *)hotSetItemsWithMaxCount:(NSUInteger)maxCount
+{
+    TIPAssert([NSThread isMainThread]);
+
+    NSMutableArray<TIPImageHotSetItem *> *items = [[NSMutableArray alloc] init];
+    @autoreleasepool {
+
+        STRONGIFY_TEMPORARILY_IF_NEEDED();
+
+        for (TIPImageRenderedEntriesCollection *collection in _manifest) {
+            if (items.count >= maxCount) {
+                break;
+            }
+
+            TIPImageCacheEntry *entry = [collection mostRecentUntransformedEntry];
+            if (entry) {
+                // the rendered image preserves the aspect ratio of its source,
+                // so aspect fill to its dimensions reproduces the same rendering
+                [items addObject:[[TIPImageHotSetItem alloc] initWithIdentifier:collection.identifier
+                                                                            URL:entry.completeImageContext.URL
+                                                               targetDimensions:entry.completeImage.dimensions
+                                                              targetContentMode:UIViewContentModeScaleAspectFill]];
+            }
+        }
+    }
+    return items;
+}
+
 #pragma mark Delegate
 
 - (void)tip_cache:(TIPLRUCache *)manifest didEvictEntry:(TIPImageRenderedEntriesCollection *)entry
@@ -532,6 +562,16 @@ sourceImageDimensions:(CGSize)sourceDims
     return [allEntries copy];
 }
 
+- (nullable TIPImageCacheEntry *)mostRecentUntransformedEntry
+{
+    for (TIPRenderedCacheItem *item in _items) {
+        if (!item.transformerIdentifier && !item.isDirty) {
+            return item.entry;
+        }
+    }
+    return nil;
+}
+
 - (void)dirtyAllEntries
 {
     for (TIPRenderedCacheItem *item in _items) {
@@ -0,0 +1,62 @@
+//
+//  TIPImageResampler.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import <CoreGraphics/CGContext.h>
+
+#import "TIP_Project.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** Filters for `TIPResamplePixels`, from fastest to highest quality */
+typedef NS_ENUM(NSInteger, TIPImageResamplingFilter) {
+    /** averages the source pixels covered by each destination pixel */
+    TIPImageResamplingFilterBox = 0,
+    /** triangle filter, bilinear when upscaling */
+    TIPImageResamplingFilterBilinear,
+    /** windowed sinc with 3 lobes, sharpest but can ring at hard edges */
+    TIPImageResamplingFilterLanczos3,
+};
+
+//! The filter that matches an interpolation quality, `CGInterpolationQualityDefault` is `Bilinear`
+FOUNDATION_EXTERN TIPImageResamplingFilter TIPImageResamplingFilterFromInterpolationQuality(CGInterpolationQuality quality);
+
+/**
+ Resample a bitmap of 8-bit, 4 channel pixels (such as premultiplied RGBA or BGRA) with a separable
+ filter.
+
+ The whole source must be in memory.  The horizontal pass is applied to each source row as the
+ vertical pass needs it and only the window of filtered rows the vertical pass uses is kept, so there
+ is no full size intermediate on top of the source and destination.  Large destinations are split into bands of rows that are
+ resampled concurrently.  Pixels are filtered 4 channels at a time with `simd_float4`.
+ Premultiplied pixels stay correct: filtering is done on the premultiplied values and colors are
+ clamped to their alpha after filtering (ringing of `Lanczos3` could otherwise exceed it).
+
+ @param source the source pixels
+ @param sourceWidth the source width in pixels
+ @param sourceHeight the source height in pixels
+ @param sourceBytesPerRow the source bytes per row
+ @param destination the destination pixels, of at least _destinationBytesPerRow_ x _destinationHeight_ bytes
+ @param destinationWidth the destination width in pixels
+ @param destinationHeight the destination height in pixels
+ @param destinationBytesPerRow the destination bytes per row
+ @param alphaChannelIndex the index (`0` to `3`) of the premultiplied alpha channel, `-1` if there is none
+ @param filter the filter to resample with
+ @return `NO` if the arguments are invalid
+ */
+FOUNDATION_EXTERN BOOL TIPResamplePixels(const void *source,
+                                         size_t sourceWidth,
+                                         size_t sourceHeight,
+                                         size_t sourceBytesPerRow,
+                                         void *destination,
+                                         size_t destinationWidth,
+                                         size_t destinationHeight,
+                                         size_t destinationBytesPerRow,
+                                         NSInteger alphaChannelIndex,
+                                         TIPImageResamplingFilter filter);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,316 @@
+//
+//  TIPImageResampler.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import <simd/simd.h>
+
+#import "TIP_Project.h"
+#import "TIPImageResampler.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Destinations with fewer pixels than this are resampled on the calling thread
+static const size_t kConcurrentPixelCountMinimum = 256 * 256;
+// Bands have at least this many rows
+static const size_t kBandRowCountMinimum = 16;
+
+// The source pixels (and their weights) that a destination pixel is filtered from
+typedef struct {
+    size_t start;
+    size_t count;
+    size_t weightsOffset;
+} TIPResamplingSpan;
+
+typedef struct {
+    TIPResamplingSpan *spans;
+    float *weights;
+    size_t maxCount;
+} TIPResamplingContributions;
+
+static BOOL _ComputeContributions(size_t sourceSize,
+                                  size_t destinationSize,
+                                  TIPImageResamplingFilter filter,
+                                  TIPResamplingContributions *contributions);
+static void _FreeContributions(TIPResamplingContributions *contributions);
+static void _ResampleBand(const Byte *source,
+                          size_t sourceWidth,
+                          size_t sourceBytesPerRow,
+                          Byte *destination,
+                          size_t destinationWidth,
+                          size_t destinationBytesPerRow,
+                          const TIPResamplingContributions *horizontal,
+                          const TIPResamplingContributions *vertical,
+                          size_t firstRow,
+                          size_t endRow,
+                          NSInteger alphaChannelIndex);
+
+TIPImageResamplingFilter TIPImageResamplingFilterFromInterpolationQuality(CGInterpolationQuality quality)
+{
+    switch (quality) {
+        case kCGInterpolationNone:
+        case kCGInterpolationLow:
+            return TIPImageResamplingFilterBox;
+        case kCGInterpolationHigh:
+            return TIPImageResamplingFilterLanczos3;
+        case kCGInterpolationDefault:
+        case kCGInterpolationMedium:
+        default:
+            return TIPImageResamplingFilterBilinear;
+    }
+}
+
+BOOL TIPResamplePixels(const void *source,
+                       size_t sourceWidth,
+                       size_t sourceHeight,
+                       size_t sourceBytesPerRow,
+                       void *destination,
+                       size_t destinationWidth,
+                       size_t destinationHeight,
+                       size_t destinationBytesPerRow,
+                       NSInteger alphaChannelIndex,
+                       TIPImageResamplingFilter filter)
+{
+    if (!sourceWidth || !sourceHeight || !destinationWidth || !destinationHeight) {
+        return NO;
+    }
+    if (sourceBytesPerRow < sourceWidth * 4 || destinationBytesPerRow < destinationWidth * 4) {
+        return NO;
+    }
+    if (alphaChannelIndex > 3) {
+        return NO;
+    }
+
+    TIPResamplingContributions horizontal = { 0 };
+    TIPResamplingContributions vertical = { 0 };
+    TIPResamplingContributions *horizontalPtr = &horizontal;
+    TIPResamplingContributions *verticalPtr = &vertical;
+    tip_defer(^{
+        _FreeContributions(horizontalPtr);
+        _FreeContributions(verticalPtr);
+    });
+    if (!_ComputeContributions(sourceWidth, destinationWidth, filter, horizontalPtr) ||
+        !_ComputeContributions(sourceHeight, destinationHeight, filter, verticalPtr)) {
+        return NO;
+    }
+
+    size_t bandCount = 1;
+    if (destinationWidth * destinationHeight >= kConcurrentPixelCountMinimum) {
+        bandCount = MIN([NSProcessInfo processInfo].activeProcessorCount, MAX((size_t)1, destinationHeight / kBandRowCountMinimum));
+    }
+    const size_t rowsPerBand = (destinationHeight + bandCount - 1) / bandCount;
+
+    dispatch_apply(bandCount, DISPATCH_APPLY_AUTO, ^(size_t band) {
+        const size_t firstRow = band * rowsPerBand;
+        const size_t endRow = MIN(destinationHeight, firstRow + rowsPerBand);
+        if (firstRow < endRow) {
+            _ResampleBand(source,
+                          sourceWidth,
+                          sourceBytesPerRow,
+                          destination,
+                          destinationWidth,
+                          destinationBytesPerRow,
+                          horizontalPtr,
+                          verticalPtr,
+                          firstRow,
+                          endRow,
+                          alphaChannelIndex);
+        }
+    });
+
+    return YES;
+}
+
+static double _FilterSupport(TIPImageResamplingFilter filter)
+{
+    switch (filter) {
+        case TIPImageResamplingFilterBox:
+            return 0.5;
+        case TIPImageResamplingFilterLanczos3:
+            return 3.0;
+        case TIPImageResamplingFilterBilinear:
+        default:
+            return 1.0;
+    }
+}
+
+static double _FilterWeight(TIPImageResamplingFilter filter, double x)
+{
+    x = fabs(x);
+    switch (filter) {
+        case TIPImageResamplingFilterBox:
+            return (x < 0.5) ? 1.0 : 0.0;
+        case TIPImageResamplingFilterLanczos3:
+            if (x < 1e-6) {
+                return 1.0;
+            }
+            if (x >= 3.0) {
+                return 0.0;
+            }
+            return (3.0 * sin(M_PI * x) * sin(M_PI * x / 3.0)) / (M_PI * M_PI * x * x);
+        case TIPImageResamplingFilterBilinear:
+        default:
+            return (x < 1.0) ? 1.0 - x : 0.0;
+    }
+}
+
+static BOOL _ComputeContributions(size_t sourceSize,
+                                  size_t destinationSize,
+                                  TIPImageResamplingFilter filter,
+                                  TIPResamplingContributions *contributions)
+{
+    const double scale = (double)sourceSize / (double)destinationSize;
+    // when downscaling, the filter is stretched to cover every source pixel
+    const double filterScale = MAX(scale, 1.0);
+    const double support = _FilterSupport(filter) * filterScale;
+    const size_t maxCount = (size_t)ceil(support * 2.0) + 3;
+
+    contributions->spans = calloc(destinationSize, sizeof(TIPResamplingSpan));
+    contributions->weights = calloc(destinationSize * maxCount, sizeof(float));
+    if (!contributions->spans || !contributions->weights) {
+        return NO;
+    }
+
+    for (size_t i = 0; i < destinationSize; i++) {
+        const double center = ((double)i + 0.5) * scale;
+        const size_t left = (size_t)MAX(0.0, floor(center - support));
+        const size_t right = (size_t)MIN((double)(sourceSize - 1), ceil(center + support));
+        float *weights = contributions->weights + (i * maxCount);
+
+        // edges are not extended, the taps past them are dropped and the remaining ones renormalized
+        size_t start = left;
+        size_t count = 0;
+        double total = 0.0;
+        for (size_t j = left; j <= right; j++) {
+            const double weight = _FilterWeight(filter, ((double)j + 0.5 - center) / filterScale);
+            if (0.0 == weight && 0 == count) {
+                start = j + 1;
+                continue;
+            }
+            weights[count++] = (float)weight;
+            total += weight;
+        }
+        while (count > 0 && 0.0f == weights[count - 1]) {
+            count--;
+        }
+
+        if (0 == count || 0.0 == total) {
+            // degenerate, use the nearest pixel
+            start = MIN((size_t)center, sourceSize - 1);
+            count = 1;
+            weights[0] = 1.0f;
+            total = 1.0;
+        }
+        for (size_t k = 0; k < count; k++) {
+            weights[k] = (float)(weights[k] / total);
+        }
+
+        contributions->spans[i] = (TIPResamplingSpan){ .start = start, .count = count, .weightsOffset = i * maxCount };
+        contributions->maxCount = MAX(contributions->maxCount, count);
+    }
+
+    return YES;
+}
+
+static void _FreeContributions(TIPResamplingContributions *contributions)
+{
+    free(contributions->spans);
+    free(contributions->weights);
+    contributions->spans = NULL;
+    contributions->weights = NULL;
+}
+
+static void _ResampleBand(const Byte *source,
+                          size_t sourceWidth,
+                          size_t sourceBytesPerRow,
+                          Byte *destination,
+                          size_t destinationWidth,
+                          size_t destinationBytesPerRow,
+                          const TIPResamplingContributions *horizontal,
+                          const TIPResamplingContributions *vertical,
+                          size_t firstRow,
+                          size_t endRow,
+                          NSInteger alphaChannelIndex)
+{
+    // a ring of horizontally filtered rows, large enough for the taps of any destination row
+    const size_t ringSize = vertical->maxCount;
+    simd_float4 *ring = malloc(ringSize * destinationWidth * sizeof(simd_float4));
+    simd_float4 *sourceRow = malloc(sourceWidth * sizeof(simd_float4));
+    simd_float4 *accumulator = malloc(destinationWidth * sizeof(simd_float4));
+    tip_defer(^{
+        free(ring);
+        free(sourceRow);
+        free(accumulator);
+    });
+    if (!ring || !sourceRow || !accumulator) {
+        return;
+    }
+
+    const simd_float4 minValue = 0.0f;
+    const simd_float4 maxValue = 255.0f;
+    size_t nextSourceRow = 0;
+    BOOL hasFilteredRows = NO;
+    for (size_t row = firstRow; row < endRow; row++) {
+        const TIPResamplingSpan verticalSpan = vertical->spans[row];
+
+        // stream in the source rows this destination row needs, spans only move forward so rows
+        // before the start of the span are never needed again
+        if (!hasFilteredRows || nextSourceRow < verticalSpan.start) {
+            nextSourceRow = verticalSpan.start;
+            hasFilteredRows = YES;
+        }
+        for (; nextSourceRow < verticalSpan.start + verticalSpan.count; nextSourceRow++) {
+            const Byte *sourcePixels = source + (nextSourceRow * sourceBytesPerRow);
+            for (size_t x = 0; x < sourceWidth; x++) {
+                simd_uchar4 pixel;
+                memcpy(&pixel, sourcePixels + (x * 4), sizeof(pixel));
+                sourceRow[x] = simd_float(pixel);
+            }
+
+            simd_float4 *filteredRow = ring + ((nextSourceRow % ringSize) * destinationWidth);
+            for (size_t x = 0; x < destinationWidth; x++) {
+                const TIPResamplingSpan span = horizontal->spans[x];
+                const float *weights = horizontal->weights + span.weightsOffset;
+                const simd_float4 *taps = sourceRow + span.start;
+                simd_float4 sum = 0.0f;
+                for (size_t k = 0; k < span.count; k++) {
+                    sum += taps[k] * weights[k];
+                }
+                filteredRow[x] = sum;
+            }
+        }
+
+        // vertical pass, row by row so the inner loop runs over contiguous pixels
+        const float *weights = vertical->weights + verticalSpan.weightsOffset;
+        for (size_t k = 0; k < verticalSpan.count; k++) {
+            const simd_float4 *filteredRow = ring + (((verticalSpan.start + k) % ringSize) * destinationWidth);
+            const float weight = weights[k];
+            if (0 == k) {
+                for (size_t x = 0; x < destinationWidth; x++) {
+                    accumulator[x] = filteredRow[x] * weight;
+                }
+            } else {
+                for (size_t x = 0; x < destinationWidth; x++) {
+                    accumulator[x] += filteredRow[x] * weight;
+                }
+            }
+        }
+
+        Byte *destinationPixels = destination + (row * destinationBytesPerRow);
+        for (size_t x = 0; x < destinationWidth; x++) {
+            simd_float4 value = simd_clamp(accumulator[x], minValue, maxValue);
+            if (alphaChannelIndex >= 0) {
+                // premultiplied colors can't exceed their alpha
+                const simd_float4 alpha = value[alphaChannelIndex];
+                value = simd_min(value, alpha);
+            }
+            const simd_uchar4 pixel = simd_uchar(value + 0.5f);
+            memcpy(destinationPixels + (x * 4), &pixel, sizeof(pixel));
+        }
+    }
+}
+
+NS_ASSUME_NONNULL_END
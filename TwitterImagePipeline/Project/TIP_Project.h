@@ -43,6 +43,7 @@ NS_INLINE BOOL TIPSizeGreaterThanZero(CGSize targetSize)
 FOUNDATION_EXTERN NSString *TIPSafeFromRaw(NSString *raw); // URL encodes raw.  If that encoded string is > the max length of a file name (less 4 characters for supporting a 3 character extension), it will be hashed.
 FOUNDATION_EXTERN NSString *TIPRawFromSafe(NSString *safe); // might not be the same as the input to "SafeFromRaw" since long "raw" strings will be hashed
 FOUNDATION_EXTERN NSString *TIPHash(NSString *string);
+FOUNDATION_EXTERN NSString *TIPHashedKeyFromRaw(NSString *raw); // fixed length (32 hex characters) key from a fast 128-bit hash of raw, not reversible
 
 FOUNDATION_EXTERN CGSize TIPScaleToFillKeepingAspectRatio(CGSize sourceSize, CGSize targetSize, CGFloat scale);
 
@@ -186,6 +186,105 @@ NSString *TIPRawFromSafe(NSString *safe)
     return (NSString * _Nonnull)raw; // TIPAssert() performed 1 line above
 }
 
+NS_INLINE uint64_t _Rotl64(uint64_t x, int8_t r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+NS_INLINE uint64_t _Fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// MurmurHash3 (x64, 128-bit variant)
+static void _MurmurHash3_128(const uint8_t *data, const size_t length, uint64_t out[2]);
+static void _MurmurHash3_128(const uint8_t *data, const size_t length, uint64_t out[2])
+{
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    const size_t blockCount = length / 16;
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+
+    for (size_t i = 0; i < blockCount; i++) {
+        uint64_t k1, k2;
+        memcpy(&k1, data + (i * 16), sizeof(k1));
+        memcpy(&k2, data + (i * 16) + 8, sizeof(k2));
+
+        k1 *= c1; k1 = _Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = _Rotl64(h1, 27); h1 += h2; h1 = (h1 * 5) + 0x52dce729;
+
+        k2 *= c2; k2 = _Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = _Rotl64(h2, 31); h2 += h1; h2 = (h2 * 5) + 0x38495ab5;
+    }
+
+    const uint8_t *tail = data + (blockCount * 16);
+    const size_t tailLength = length & 15;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for (size_t i = tailLength; i > 8; i--) {
+        k2 ^= ((uint64_t)tail[i - 1]) << ((i - 9) * 8);
+    }
+    if (tailLength > 8) {
+        k2 *= c2; k2 = _Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    }
+    for (size_t i = MIN(tailLength, (size_t)8); i > 0; i--) {
+        k1 ^= ((uint64_t)tail[i - 1]) << ((i - 1) * 8);
+    }
+    if (tailLength > 0) {
+        k1 *= c1; k1 = _Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= length;
+    h2 ^= length;
+    h1 += h2;
+    h2 += h1;
+    h1 = _Fmix64(h1);
+    h2 = _Fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    out[0] = h1;
+    out[1] = h2;
+}
+
+NSString *TIPHashedKeyFromRaw(NSString *raw)
+{
+    TIPAssert(raw != nil);
+
+    // hash the UTF-16 code units directly, avoiding any transcoding or heap allocation for typical identifiers
+    const NSUInteger length = raw.length;
+    const size_t byteLength = length * sizeof(unichar);
+    uint64_t hash[2];
+    const unichar *characters = CFStringGetCharactersPtr((__bridge CFStringRef)raw);
+    if (characters) {
+        _MurmurHash3_128((const uint8_t *)characters, byteLength, hash);
+    } else if (length <= 512) {
+        unichar buffer[512];
+        [raw getCharacters:buffer range:NSMakeRange(0, length)];
+        _MurmurHash3_128((const uint8_t *)buffer, byteLength, hash);
+    } else {
+        unichar *buffer = (unichar *)malloc(byteLength);
+        [raw getCharacters:buffer range:NSMakeRange(0, length)];
+        _MurmurHash3_128((const uint8_t *)buffer, byteLength, hash);
+        free(buffer);
+    }
+
+    static const char kHexDigits[] = "0123456789abcdef";
+    char key[32];
+    for (size_t i = 0; i < 16; i++) {
+        const uint8_t byte = (uint8_t)(hash[i / 8] >> ((i % 8) * 8));
+        key[i * 2] = kHexDigits[byte >> 4];
+        key[(i * 2) + 1] = kHexDigits[byte & 0xF];
+    }
+    return [[NSString alloc] initWithBytes:key length:sizeof(key) encoding:NSASCIIStringEncoding];
+}
+
 dispatch_block_t __nullable TIPStartBackgroundTask(NSString * __nullable name)
 {
     __block NSUInteger taskId = UIBackgroundTaskInvalid;
@@ -9,7 +9,10 @@
 #import <CoreGraphics/CGContext.h>
 #import <Foundation/Foundation.h>
 
+#import <TwitterImagePipeline/TIPDefinitions.h>
+
 @class TIPImageFetchOperation;
+@class TIPImagePipeline;
 @class TIPImageStoreOperation;
 
 NS_ASSUME_NONNULL_BEGIN
@@ -25,6 +28,14 @@ FOUNDATION_EXTERN SInt64 const TIPMaxBytesForAllMemoryCachesDefault;
 FOUNDATION_EXTERN SInt64 const TIPMaxBytesForAllDiskCachesDefault;
 //! Default max number of concurrent image downloads.  `4`
 FOUNDATION_EXTERN NSInteger const TIPMaxConcurrentImagePipelineDownloadCountDefault;
+//! Default max number of concurrent byte ranges for a single parallel range download.  `4`
+FOUNDATION_EXTERN NSUInteger const TIPParallelRangeDownloadMaxRangeCountDefault;
+//! Default minimum time a download waits for its response before it can be hedged.  `1.0` seconds
+FOUNDATION_EXTERN NSTimeInterval const TIPHedgedDownloadMinimumDelayDefault;
+//! Default max ratio of downloads that can be hedged.  `0.05` (1 in 20)
+FOUNDATION_EXTERN float const TIPHedgedDownloadBudgetDefault;
+//! Default max bytes a download can receive ahead of its decoding before reads are paused.  `512 KBs`
+FOUNDATION_EXTERN NSUInteger const TIPDownloadDecodeBacklogMaxBytesDefault;
 //! Default maximum size of a cache entry by ratio to the cache max size.  `1:6` - `1/6th` the size
 FOUNDATION_EXTERN NSUInteger const TIPMaxRatioSizeOfCacheEntryDefault;
 
@@ -35,6 +46,42 @@ FOUNDATION_EXTERN SInt16 const TIPMaxCountForAllRenderedCachesDefault;
 //! Default max count for all disk caches to hold. `INT16_MAX >> 4` (2044)
 FOUNDATION_EXTERN SInt16 const TIPMaxCountForAllDiskCachesDefault;
 
+//! Default ratio of a cache type's max that caches are pruned down to once the max is exceeded. `0.9`
+FOUNDATION_EXTERN double const TIPCachePruneLowWatermarkRatioDefault;
+
+/**
+ How an expired complete image in the disk cache that has validators (`ETag` or `Last-Modified`)
+ is handled
+ */
+typedef NS_ENUM(NSInteger, TIPImageRevalidationMode) {
+    /** Expired images are removed and downloaded again */
+    TIPImageRevalidationModeOff = 0,
+    /**
+     Expired images are revalidated with a conditional request.
+     On a `304 Not Modified` the cached image is served (and its TTL restarts) without downloading
+     it again.
+     */
+    TIPImageRevalidationModeRevalidate,
+    /**
+     Expired images are served immediately and revalidated in the background, same as
+     `TIPImageRevalidationModeRevalidate` otherwise.
+     */
+    TIPImageRevalidationModeStaleWhileRevalidate,
+};
+
+/**
+ Notification when the adaptive download concurrency limit changed, `object` => `nil`.
+ Posted from a background queue.
+ See `TIPGlobalConfiguration.adaptiveDownloadConcurrencyMinimumCount`.
+ */
+FOUNDATION_EXTERN NSString * const TIPImageDownloadConcurrencyLimitDidChangeNotification;
+//! Key to the new limit of concurrently running downloads, `NSNumber` wrapping an `NSUInteger`
+FOUNDATION_EXTERN NSString * const TIPImageDownloadConcurrencyLimitNotificationKey;
+//! Key to the aggregate goodput (bytes per second) that led to the change, `NSNumber` wrapping a `double`
+FOUNDATION_EXTERN NSString * const TIPImageDownloadConcurrencyGoodputNotificationKey;
+//! Key to the median time to first byte that led to the change, `NSNumber` wrapping an `NSTimeInterval`
+FOUNDATION_EXTERN NSString * const TIPImageDownloadConcurrencyTimeToFirstByteNotificationKey;
+
 @protocol TIPImagePipelineObserver;
 @protocol TIPImageFetchDownloadProvider;
 @protocol TIPLogger;
@@ -131,6 +178,20 @@ FOUNDATION_EXTERN SInt16 const TIPMaxCountForAllDiskCachesDefault;
  */
 @property (atomic) NSInteger maxRatioSizeOfCacheEntry;
 
+/**
+ The ratio of the max bytes and max count that caches are pruned down to (the low watermark) once
+ the max (the high watermark) has been exceeded.
+ Caches are immediately pruned back to the max when it is exceeded, the remaining pruning down to
+ the low watermark is done incrementally in small time slices so cache reads are not starved.
+ Rendered caches live on the main queue, so their slices are shorter and a frame apart.
+ The gap between the watermarks avoids paying eviction overhead on nearly every store when a
+ cache is under steady inflow.
+
+ Negative is Default, values are clamped to `[0.5, 1.0]` and `1.0` disables the hysteresis.
+ Default is `TIPCachePruneLowWatermarkRatioDefault`.
+ */
+@property (atomic) double cachePruneLowWatermarkRatio;
+
 /** Total bytes across all `TIPImagePipeline` rendered caches */
 @property (atomic, readonly) SInt64 totalBytesForAllRenderedCaches;
 /** Total bytes across all `TIPImagePipeline` memory caches */
@@ -180,6 +241,121 @@ FOUNDATION_EXTERN SInt16 const TIPMaxCountForAllDiskCachesDefault;
  */
 @property (atomic) NSInteger maxConcurrentImagePipelineDownloadCount;
 
+/**
+ Minimum number of concurrent network downloads when adapting the limit to the link.
+ When positive, the limit of running downloads adapts between this and
+ `maxConcurrentImagePipelineDownloadCount` (the ceiling): it additively increases while every slot
+ is in use and the aggregate goodput holds up, and multiplicatively decreases when the time to first
+ byte inflates (congestion) without goodput improving.
+ Changes post `TIPImageDownloadConcurrencyLimitDidChangeNotification`.
+ `0` disables adapting (`maxConcurrentImagePipelineDownloadCount` is the limit).  Default == `0`
+ */
+@property (atomic) NSInteger adaptiveDownloadConcurrencyMinimumCount;
+
+/**
+ Whether running downloads with a low priority are paused while higher priority downloads are active.
+ When enabled, downloads with `NSOperationQueuePriorityLow` or lower (such as prefetches) are paused
+ while any download with a higher priority is running or pending, so that the higher priority
+ downloads get the bandwidth.  Paused downloads do not count against
+ `maxConcurrentImagePipelineDownloadCount` and resume where they left off once no higher priority
+ download remains.  Priority changes (such as `TIPImageFetchOperation.priority`) take effect
+ immediately.
+ Requires the `TIPImageFetchDownload` to support `paused`, which the default downloader does.
+ The default downloader times out after 3 minutes of loading, not counting time spent paused.
+ A download that stays paused for over an hour still fails with `NSURLErrorTimedOut`.
+ Default == `NO`
+ */
+@property (atomic, getter=isLowPriorityDownloadPausingEnabled) BOOL lowPriorityDownloadPausingEnabled;
+
+/**
+ Maximum number of bytes a download can receive ahead of its decoding before its reads are paused.
+ While the delegates of a download (such as a `TIPImageFetchOperation` rendering progressive scans)
+ are still handling earlier bytes, newly received bytes are coalesced into a single update that is
+ delivered once they catch up, so renders that would immediately be superseded by a newer scan are
+ skipped.  Once the coalesced bytes exceed this budget, the download is paused until the decoding
+ catches up so that the network does not keep racing ahead of a slow decoder.
+ `0` disables pausing (bytes are still coalesced).  Default == `TIPDownloadDecodeBacklogMaxBytesDefault`
+ @note Pausing requires the `TIPImageFetchDownload` to support `paused`, which the default downloader does.
+ */
+@property (atomic) NSUInteger downloadDecodeBacklogMaxBytes;
+
+/**
+ Minimum response body size (in bytes) for the internal downloader to split a download into
+ concurrent byte ranges.
+ Once a response with a `Content-Length` of at least this size, `Accept-Ranges: bytes` and a
+ validator (`ETag` or `Last-Modified`) is received, the remainder of the body is fetched as
+ concurrent `Range` requests that are reassembled in order (so the download still looks like a
+ single response to the pipeline) and any range that stalls is re-issued.
+ Helps large images and animated media on high latency connections that are bounded by the
+ throughput of a single connection.
+ `0` disables parallel range downloads.  Default == `0`
+ @note Only applies to the default `imageFetchDownloadProvider`
+ */
+@property (atomic) NSUInteger parallelRangeDownloadMinimumBytes;
+
+/**
+ Maximum number of concurrent byte ranges a single parallel range download can use.
+ Values less than `2` disable parallel range downloads.
+ Default == `TIPParallelRangeDownloadMaxRangeCountDefault`
+ */
+@property (atomic) NSUInteger parallelRangeDownloadMaxRangeCount;
+
+/**
+ Percentile of recent times to first response that a download can go without a response before the
+ internal downloader hedges it.
+ Hedging issues a duplicate request, uses whichever of the two responds first and cancels the other,
+ which cuts the tail latency of a slow connection or CDN edge.
+ Downloads with a priority of `NSOperationQueuePriorityLow` or lower (such as prefetches) are not
+ hedged.
+ `0` disables hedged downloads.  Default == `0`, `0.95` is a good starting point.
+ @note Only applies to the default `imageFetchDownloadProvider`
+ */
+@property (atomic) float hedgedDownloadPercentile;
+
+/**
+ Minimum time a download waits for its response before it can be hedged, this is also the wait used
+ until enough downloads have completed to compute `hedgedDownloadPercentile`.
+ Default == `TIPHedgedDownloadMinimumDelayDefault`
+ */
+@property (atomic) NSTimeInterval hedgedDownloadMinimumDelay;
+
+/**
+ Max ratio of downloads that can be hedged, limiting the extra traffic hedging can cost.
+ Default == `TIPHedgedDownloadBudgetDefault`
+ */
+@property (atomic) float hedgedDownloadBudget;
+
+/**
+ How expired images in the disk cache are handled.
+ When not `TIPImageRevalidationModeOff`, complete images with validators are kept on disk for up to
+ one more TTL past their expiry so they can be revalidated.
+ Default == `TIPImageRevalidationModeOff`
+ */
+@property (atomic) TIPImageRevalidationMode imageRevalidationMode;
+
+/**
+ Preconnect to the hosts of _URLs_, such as the CDN hosts images are about to be fetched from, so
+ that the first fetch from each host does not pay for DNS, TCP and TLS set up.
+ Only the scheme, host and port of each URL matter and duplicates are ignored.
+ Goes through `imageFetchDownloadProvider`, doing nothing if it does not implement
+ `[TIPImageFetchDownloadProvider preconnectToURLs:]`.  The default provider does.
+ See `hotSetPreconnectEnabled` for preconnecting to the hosts of the hot set on launch.
+
+ @warning The default provider connects by sending a real `HEAD` request for `preconnectPath` to
+ each host (the response is ignored).  The host sees it as any other request: it counts as traffic,
+ and CDNs commonly answer `HEAD /` with a `403` or a redirect.  Set `preconnectPath` to a path
+ that is cheap and valid to request on your hosts.
+ Thread safe.
+ */
+- (void)preconnectToURLs:(NSArray<NSURL *> *)URLs;
+
+/**
+ The path requested from each host when preconnecting (see `preconnectToURLs:`), such as a tiny
+ image or a health check that every image host serves.
+ Default == `nil` (requests `/`)
+ */
+@property (atomic, copy, nullable) NSString *preconnectPath;
+
 #pragma mark Observing
 
 /**
@@ -241,12 +417,57 @@ FOUNDATION_EXTERN SInt16 const TIPMaxCountForAllDiskCachesDefault;
  */
 @property (nonatomic, readwrite, getter=isClearMemoryCachesOnApplicationBackgroundEnabled) BOOL clearMemoryCachesOnApplicationBackgroundEnabled;
 
+/**
+ The number of most recently rendered images (per `TIPImagePipeline`) to snapshot, along with the
+ dimensions they were rendered at, when the app is backgrounded or terminated.
+ On the next launch, the snapshotted images are prewarmed from the disk cache into the memory cache
+ as each `TIPImagePipeline` is created.  Prewarming happens one image at a time on a background
+ queue and defers to any active fetch operations so that it never competes with real fetches:
+ it checks for them before each disk cache read (including once on the disk cache queue) and decode.
+
+ `0` disables both snapshotting and prewarming.
+ Default == `0`
+ */
+@property (nonatomic, readwrite) NSUInteger hotSetSnapshotCount;
+
+/**
+ Configure whether prewarming the hot set (see `hotSetSnapshotCount`) also scales and decodes the
+ images into the rendered cache.  This avoids the decode cost of the first render of those images
+ at the cost of more work and memory at launch.
+ Default == `NO`
+ */
+@property (nonatomic, readwrite, getter=isHotSetRenderedCachePrewarmEnabled) BOOL hotSetRenderedCachePrewarmEnabled;
+
+/**
+ Configure whether the hosts the hot set (see `hotSetSnapshotCount`) was fetched from are
+ preconnected to (see `preconnectToURLs:`) as each `TIPImagePipeline` is created.  This learns the
+ hosts to warm up from recent use, so the first fetches of the launch do not pay for connection set up.
+ Default == `NO`
+ */
+@property (nonatomic, readwrite, getter=isHotSetPreconnectEnabled) BOOL hotSetPreconnectEnabled;
+
 /**
  The default `CGInterpolationQuality` when scaling an image if a quality was not provided.
  Default == `CGInterpolationQualityDefault`
  */
 @property (nonatomic, readwrite) CGInterpolationQuality defaultInterpolationQuality;
 
+/**
+ Configure whether static images are downscaled with the internal resampler instead of by drawing
+ into a CoreGraphics context.
+ The resampler runs concurrently (it is not serialized by `TIPExecuteCGContextBlock`) and filters
+ with the interpolation quality of each scale (see `defaultInterpolationQuality` and
+ `[UIImage tip_scaledImageWithTargetDimensions:contentMode:interpolationQuality:decode:]`):
+ `kCGInterpolationNone` and `kCGInterpolationLow` average the covered pixels (box),
+ `kCGInterpolationDefault` and `kCGInterpolationMedium` are bilinear and `kCGInterpolationHigh` is
+ Lanczos3.  Upscales and images the resampler does not support (animations, orientations other
+ than up and pixels that are not 8-bit RGB with 4 channels) are still drawn with CoreGraphics.
+ The resampler reads from a copy of the source's pixels, so a scale briefly needs twice the memory of
+ the decoded source (plus the destination).
+ Default == `NO`
+ */
+@property (nonatomic, readwrite, getter=isImageResamplerEnabled) BOOL imageResamplerEnabled;
+
 /**
  Configure whether the default codecs in TIPImageCodecCatalogue are loaded synchronously by
  the calling thread (which can incur long pauses as it makes XPC calls) or are loaded asynchronously.
@@ -274,6 +495,40 @@ FOUNDATION_EXTERN SInt16 const TIPMaxCountForAllDiskCachesDefault;
 //! The callback providing all the inspection results for every registered `TIPImagePipeline`
 typedef void(^TIPGlobalConfigurationInspectionCallback)(NSDictionary<NSString *, TIPImagePipelineInspectionResult*> *results);
 
+/**
+ Cumulative statistics on the pruning of a type of cache across all `TIPImagePipeline` instances.
+ Useful for tuning `cachePruneLowWatermarkRatio`.
+ */
+typedef struct TIPCachePruneStatistics {
+    /** Number of times the caches exceeded their max (high watermark) and were pruned */
+    NSUInteger pruneCount;
+    /** Number of incremental time slices run to prune down to the low watermark */
+    NSUInteger sliceCount;
+    /** Number of entries evicted by pruning */
+    NSUInteger evictedEntryCount;
+    /** Total duration spent pruning */
+    NSTimeInterval totalDuration;
+    /** Longest duration spent in a single prune or slice */
+    NSTimeInterval maxDuration;
+} TIPCachePruneStatistics;
+
+/**
+ How much of a type of cache a single `TIPImagePipeline` occupies compared to its fair share of the
+ global budget, along with how well that cache is serving lookups.
+ */
+typedef struct TIPImagePipelineCacheUsage {
+    /** Bytes occupied by the pipeline's cache */
+    SInt64 totalBytes;
+    /** The pipeline's share of the global max bytes, weighted by `TIPImagePipeline.cacheShareWeight` */
+    SInt64 fairShareBytes;
+    /** The portion of the fair share that is never pruned, see `TIPImagePipeline.cacheShareReservedRatio` */
+    SInt64 reservedBytes;
+    /** Number of lookups that found a complete image */
+    NSUInteger hitCount;
+    /** Number of lookups that did not find a complete image */
+    NSUInteger missCount;
+} TIPImagePipelineCacheUsage;
+
 /**
  Category for inspecting all `TIPImagePipeline` instances.  See `TIPImagePipeline(Inspect)` also.
  */
@@ -287,6 +542,34 @@ typedef void(^TIPGlobalConfigurationInspectionCallback)(NSDictionary<NSString *,
  */
 - (void)inspect:(TIPGlobalConfigurationInspectionCallback)callback;
 
+/** Pruning statistics for all rendered caches.  Thread safe. */
+@property (atomic, readonly) TIPCachePruneStatistics pruneStatisticsForAllRenderedCaches;
+/** Pruning statistics for all memory caches.  Thread safe. */
+@property (atomic, readonly) TIPCachePruneStatistics pruneStatisticsForAllMemoryCaches;
+/** Pruning statistics for all disk caches.  Thread safe. */
+@property (atomic, readonly) TIPCachePruneStatistics pruneStatisticsForAllDiskCaches;
+
+/**
+ Get the cache usage of the given _imagePipeline_ for each type of cache.
+ Provide `NULL` to skip an output.  Thread safe.
+ */
+- (void)getCacheUsageForImagePipeline:(TIPImagePipeline *)imagePipeline
+                   renderedCacheUsage:(out TIPImagePipelineCacheUsage * __nullable)renderedUsageOut
+                     memoryCacheUsage:(out TIPImagePipelineCacheUsage * __nullable)memoryUsageOut
+                       diskCacheUsage:(out TIPImagePipelineCacheUsage * __nullable)diskUsageOut;
+
+/**
+ Get how long it took from the _imagePipeline_ being created until one of its fetches first loaded a
+ final image, and where that image was loaded from.  This is the launch metric that prewarming the
+ hot set (see `hotSetSnapshotCount`) improves: a prewarmed first screen loads from the memory cache.
+ Provide `NULL` to skip an output.  Thread safe.
+
+ @return `NO` if none of the _imagePipeline_ fetches have loaded a final image yet
+ */
+- (BOOL)getTimeToFirstImageForImagePipeline:(TIPImagePipeline *)imagePipeline
+                                   duration:(out NSTimeInterval * __nullable)durationOut
+                                 loadSource:(out TIPImageLoadSource * __nullable)loadSourceOut;
+
 /**
  Get all the running TIP operations.  Provide `NULL` to skip an output.
  */
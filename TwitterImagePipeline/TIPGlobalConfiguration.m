@@ -22,9 +22,15 @@
 #import "TIPImagePipeline+Project.h"
 #import "TIPImageRenderedCache.h"
 #import "TIPImageStoreAndMoveOperations.h"
+#import "TIPTiming.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+NSString * const TIPImageDownloadConcurrencyLimitDidChangeNotification = @"TIPImageDownloadConcurrencyLimitDidChangeNotification";
+NSString * const TIPImageDownloadConcurrencyLimitNotificationKey = @"limit";
+NSString * const TIPImageDownloadConcurrencyGoodputNotificationKey = @"goodput";
+NSString * const TIPImageDownloadConcurrencyTimeToFirstByteNotificationKey = @"timeToFirstByte";
+
 SInt64 const TIPMaxBytesForAllRenderedCachesDefault = -1;
 SInt64 const TIPMaxBytesForAllMemoryCachesDefault = -1;
 SInt64 const TIPMaxBytesForAllDiskCachesDefault = -1;
@@ -32,7 +38,19 @@ SInt16 const TIPMaxCountForAllMemoryCachesDefault = INT16_MAX >> 7;
 SInt16 const TIPMaxCountForAllRenderedCachesDefault = INT16_MAX >> 7;
 SInt16 const TIPMaxCountForAllDiskCachesDefault = INT16_MAX >> 4;
 NSInteger const TIPMaxConcurrentImagePipelineDownloadCountDefault = 4;
+NSUInteger const TIPParallelRangeDownloadMaxRangeCountDefault = 4;
+NSTimeInterval const TIPHedgedDownloadMinimumDelayDefault = 1.0;
+float const TIPHedgedDownloadBudgetDefault = 0.05f;
+NSUInteger const TIPDownloadDecodeBacklogMaxBytesDefault = 512 * 1024;
 NSUInteger const TIPMaxRatioSizeOfCacheEntryDefault = 6;
+double const TIPCachePruneLowWatermarkRatioDefault = 0.9;
+
+// Max time a single incremental prune slice can take before yielding the cache queue
+static const NSTimeInterval kPruneSliceTimeBudget = 0.004;
+// Rendered caches prune on the main queue, so their slices are shorter and a frame apart
+static const NSTimeInterval kPruneSliceMainQueueTimeBudget = 0.002;
+static const NSTimeInterval kPruneSliceMainQueueYieldDelay = 1.0 / 60.0;
+#define PRUNE_CACHE_TYPE_COUNT (3) // Rendered, Memory, Disk
 
 // Cap the default max memory bytes at 160MB (to be split equally betweet Rendered and Memory caches) -- a reasonable limit for devices with lots of RAM since iOS still enforces memory warnings even if the device has much more RAM available
 #define DEFAULT_MAX_RENDERED_BYTES_CAP      (160ull * 1024ull * 1024ull)
@@ -56,6 +74,257 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
     return (SInt64)DEFAULT_MAX_DISK_BYTES;
 }
 
+NS_INLINE BOOL _IsOverMax(SInt64 totalBytes, SInt16 totalCount, SInt64 maxBytes, SInt16 maxCount)
+{
+    // max count of 0 == unlimited
+    return totalBytes > maxBytes || (maxCount > 0 && totalCount > maxCount);
+}
+
+NS_INLINE NSTimeInterval _PruneSliceTimeBudget(TIPImageCacheType type)
+{
+    return (TIPImageCacheTypeRendered == type) ? kPruneSliceMainQueueTimeBudget : kPruneSliceTimeBudget;
+}
+
+NS_INLINE double _CacheShareWeight(TIPImagePipeline *pipeline)
+{
+    const double weight = pipeline.cacheShareWeight;
+    return (weight > 0.0) ? weight : 1.0;
+}
+
+static double _TotalCacheShareWeight(NSArray<TIPImagePipeline *> *pipelines, TIPImageCacheType type);
+static double _TotalCacheShareWeight(NSArray<TIPImagePipeline *> *pipelines, TIPImageCacheType type)
+{
+    double totalWeight = 0.0;
+    for (TIPImagePipeline *pipeline in pipelines) {
+        if ([pipeline cacheOfType:type]) {
+            totalWeight += _CacheShareWeight(pipeline);
+        }
+    }
+    return totalWeight;
+}
+
+static TIPLRUCache *_ManifestForCache(id<TIPImageCache> cache, TIPImageCacheType type);
+static TIPLRUCache *_ManifestForCache(id<TIPImageCache> cache, TIPImageCacheType type)
+{
+    return (TIPImageCacheTypeDisk == type) ? [(TIPImageDiskCache *)cache diskCache_syncAccessManifest] : cache.manifest;
+}
+
+NS_INLINE double _CacheShareReservedRatio(TIPImagePipeline *pipeline)
+{
+    return MIN(1.0, MAX(0.0, pipeline.cacheShareReservedRatio));
+}
+
+/**
+ A cache being pruned, with its usage tracked incrementally over the course of a prune so that each
+ eviction only updates the cache that was evicted from.
+ The pipelines (and so their caches) are retained by the caller for the duration of the prune.
+ */
+typedef struct _TIPPrunePartition {
+    __unsafe_unretained id<TIPImageCache> cache;
+    __unsafe_unretained TIPLRUCache *manifest;
+    double share; // the pipeline's weighted fraction of the global max, 0 for an unregistered pipeline
+    double reservedRatio; // the fraction of the fair share that is never evicted
+    double ratio; // usage over the fair share, > 1.0 is over the fair share
+    BOOL evictable; // has entries beyond its reservation
+} _TIPPrunePartition;
+
+typedef struct _TIPPrunePartitions {
+    _TIPPrunePartition *partitions;
+    NSUInteger count;
+    NSUInteger *heap; // evictable partitions other than the priority one, max-heap by ratio
+    NSUInteger heapCount;
+    NSUInteger priorityIndex; // NSNotFound == no priority cache
+    double globalMax;
+    BOOL overBytes;
+} _TIPPrunePartitions;
+
+static void _PrunePartitionsUpdate(_TIPPrunePartitions *pp, NSUInteger index);
+static void _PrunePartitionsUpdate(_TIPPrunePartitions *pp, NSUInteger index)
+{
+    _TIPPrunePartition *partition = &pp->partitions[index];
+    const NSUInteger entryCount = partition->manifest.numberOfEntries;
+    const double usage = (pp->overBytes) ? (double)partition->cache.totalCost : (double)entryCount;
+    const double fairShare = MAX(1.0, pp->globalMax * partition->share);
+    // an unregistered pipeline has no share, its cache is only evicted from as a last resort
+    partition->ratio = (partition->share > 0.0) ? usage / fairShare : 0.0;
+    partition->evictable = entryCount > 0 && usage > fairShare * partition->reservedRatio;
+}
+
+static void _PrunePartitionsSiftDown(_TIPPrunePartitions *pp, NSUInteger heapIndex);
+static void _PrunePartitionsSiftDown(_TIPPrunePartitions *pp, NSUInteger heapIndex)
+{
+    NSUInteger *heap = pp->heap;
+    while (YES) {
+        const NSUInteger left = (heapIndex * 2) + 1;
+        const NSUInteger right = left + 1;
+        NSUInteger largest = heapIndex;
+        if (left < pp->heapCount && pp->partitions[heap[left]].ratio > pp->partitions[heap[largest]].ratio) {
+            largest = left;
+        }
+        if (right < pp->heapCount && pp->partitions[heap[right]].ratio > pp->partitions[heap[largest]].ratio) {
+            largest = right;
+        }
+        if (largest == heapIndex) {
+            return;
+        }
+        const NSUInteger swap = heap[heapIndex];
+        heap[heapIndex] = heap[largest];
+        heap[largest] = swap;
+        heapIndex = largest;
+    }
+}
+
+/**
+ Populate the partitions from the _pipelines_ caches of the given _type_.
+ Must be called from the queue of the given cache _type_.
+ */
+static void _PrunePartitionsLoad(_TIPPrunePartitions *pp,
+                                 NSArray<TIPImagePipeline *> *pipelines,
+                                 TIPImageCacheType type,
+                                 id<TIPImageCache> __nullable priorityCache);
+static void _PrunePartitionsLoad(_TIPPrunePartitions *pp,
+                                 NSArray<TIPImagePipeline *> *pipelines,
+                                 TIPImageCacheType type,
+                                 id<TIPImageCache> __nullable priorityCache)
+{
+    pp->partitions = (_TIPPrunePartition *)calloc(pipelines.count + 1, sizeof(_TIPPrunePartition));
+    pp->heap = (NSUInteger *)calloc(pipelines.count + 1, sizeof(NSUInteger));
+    pp->count = 0;
+    pp->heapCount = 0;
+    pp->priorityIndex = NSNotFound;
+
+    const double totalWeight = _TotalCacheShareWeight(pipelines, type);
+    for (TIPImagePipeline *pipeline in pipelines) {
+        id<TIPImageCache> cache = [pipeline cacheOfType:type];
+        if (!cache) {
+            continue;
+        }
+
+        _TIPPrunePartition *partition = &pp->partitions[pp->count];
+        partition->cache = cache;
+        partition->manifest = _ManifestForCache(cache, type);
+        partition->share = _CacheShareWeight(pipeline) / MAX(totalWeight, 1.0);
+        partition->reservedRatio = _CacheShareReservedRatio(pipeline);
+        if (cache == priorityCache) {
+            pp->priorityIndex = pp->count;
+        }
+        pp->count++;
+    }
+
+    if (NSNotFound == pp->priorityIndex && priorityCache) {
+        // priority cache of an unregistered pipeline
+        _TIPPrunePartition *partition = &pp->partitions[pp->count];
+        partition->cache = priorityCache;
+        partition->manifest = _ManifestForCache(priorityCache, type);
+        pp->priorityIndex = pp->count;
+        pp->count++;
+    }
+}
+
+/**
+ Measure every partition against _globalMax_ (bytes when _overBytes_, otherwise entry count)
+ and order them for eviction.
+ */
+static void _PrunePartitionsMeasure(_TIPPrunePartitions *pp,
+                                    double globalMax,
+                                    BOOL overBytes);
+static void _PrunePartitionsMeasure(_TIPPrunePartitions *pp,
+                                    double globalMax,
+                                    BOOL overBytes)
+{
+    pp->globalMax = globalMax;
+    pp->overBytes = overBytes;
+    pp->heapCount = 0;
+    for (NSUInteger i = 0; i < pp->count; i++) {
+        _PrunePartitionsUpdate(pp, i);
+        if (i != pp->priorityIndex && pp->partitions[i].evictable) {
+            pp->heap[pp->heapCount++] = i;
+        }
+    }
+    for (NSUInteger i = pp->heapCount / 2; i > 0; i--) {
+        _PrunePartitionsSiftDown(pp, i - 1);
+    }
+}
+
+/**
+ Select the partition to evict from: the evictable partition that is the most over its pipeline's
+ weighted share of the global max.
+ Pipelines only use more than their share by borrowing what other pipelines are not using, so
+ this reclaims from the borrowers first and leaves pipelines within their share untouched.
+ The priority cache (the cache being added to) is evicted from last, unless it is the cache most
+ over its share, so that a busy pipeline cannot crowd out the others.
+ A partition within its reservation (see `TIPImagePipeline.cacheShareReservedRatio`) is never selected.
+ Returns `NSNotFound` when there is nothing left that can be evicted.
+ */
+static NSUInteger _PrunePartitionsSelectVictim(const _TIPPrunePartitions *pp);
+static NSUInteger _PrunePartitionsSelectVictim(const _TIPPrunePartitions *pp)
+{
+    const NSUInteger victimIndex = (pp->heapCount > 0) ? pp->heap[0] : NSNotFound;
+    if (NSNotFound != pp->priorityIndex && pp->partitions[pp->priorityIndex].evictable) {
+        const double priorityRatio = pp->partitions[pp->priorityIndex].ratio;
+        if (NSNotFound == victimIndex || (priorityRatio > 1.0 && priorityRatio > pp->partitions[victimIndex].ratio)) {
+            return pp->priorityIndex;
+        }
+    }
+    return victimIndex;
+}
+
+/** Update the _victimIndex_ partition after evicting from it, which can only lower its ratio */
+static void _PrunePartitionsDidEvict(_TIPPrunePartitions *pp, NSUInteger victimIndex);
+static void _PrunePartitionsDidEvict(_TIPPrunePartitions *pp, NSUInteger victimIndex)
+{
+    _PrunePartitionsUpdate(pp, victimIndex);
+    if (victimIndex == pp->priorityIndex) {
+        return;
+    }
+
+    TIPAssert(pp->heapCount > 0 && pp->heap[0] == victimIndex);
+    if (!pp->partitions[victimIndex].evictable) {
+        pp->heap[0] = pp->heap[--pp->heapCount];
+    }
+    _PrunePartitionsSiftDown(pp, 0);
+}
+
+static void _PrunePartitionsFree(_TIPPrunePartitions *pp);
+static void _PrunePartitionsFree(_TIPPrunePartitions *pp)
+{
+    free(pp->partitions);
+    free(pp->heap);
+    pp->partitions = NULL;
+    pp->heap = NULL;
+}
+
+static NSArray<NSURL *> *_PreconnectOrigins(NSArray<NSURL *> *URLs, NSString * __nullable path);
+static NSArray<NSURL *> *_PreconnectOrigins(NSArray<NSURL *> *URLs, NSString * __nullable path)
+{
+    if (!path.length) {
+        path = @"/";
+    } else if (![path hasPrefix:@"/"]) {
+        path = [@"/" stringByAppendingString:path];
+    }
+
+    NSMutableArray<NSURL *> *origins = [[NSMutableArray alloc] initWithCapacity:URLs.count];
+    NSMutableSet<NSString *> *originStrings = [[NSMutableSet alloc] initWithCapacity:URLs.count];
+    for (NSURL *URL in URLs) {
+        NSString *scheme = URL.scheme.lowercaseString;
+        if (!URL.host.length || (![scheme isEqualToString:@"https"] && ![scheme isEqualToString:@"http"])) {
+            continue;
+        }
+
+        NSURLComponents *components = [[NSURLComponents alloc] init];
+        components.scheme = scheme;
+        components.host = URL.host.lowercaseString;
+        components.port = URL.port;
+        components.path = path;
+        NSURL *origin = components.URL;
+        if (origin && ![originStrings containsObject:origin.absoluteString]) {
+            [originStrings addObject:origin.absoluteString];
+            [origins addObject:origin];
+        }
+    }
+    return origins;
+}
+
 @implementation TIPGlobalConfiguration
 {
     NSOperationQueue *_sharedImagePipelineQueue;
@@ -63,6 +332,14 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
     dispatch_queue_t _queueForMemoryCaches;
     dispatch_queue_t _queueForDiskCaches;
     NSHashTable<id<TIPImagePipelineObserver>> *_globalObservers;
+
+    // only accessed from the respective cache type's queue
+    BOOL _pruneSliceScheduled[PRUNE_CACHE_TYPE_COUNT];
+
+    // protected by _pruneMutex
+    pthread_mutex_t _pruneMutex;
+    double _cachePruneLowWatermarkRatio;
+    TIPCachePruneStatistics _pruneStatistics[PRUNE_CACHE_TYPE_COUNT];
 }
 
 @synthesize imageFetchDownloadProvider = _imageFetchDownloadProvider;
@@ -115,8 +392,23 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
         _internalMaxCountForAllRenderedCaches = TIPMaxCountForAllRenderedCachesDefault;
 
         _maxConcurrentImagePipelineDownloadCount = TIPMaxConcurrentImagePipelineDownloadCountDefault;
+        _adaptiveDownloadConcurrencyMinimumCount = 0;
+        _lowPriorityDownloadPausingEnabled = NO;
+        _downloadDecodeBacklogMaxBytes = TIPDownloadDecodeBacklogMaxBytesDefault;
+        _parallelRangeDownloadMinimumBytes = 0;
+        _parallelRangeDownloadMaxRangeCount = TIPParallelRangeDownloadMaxRangeCountDefault;
+        _hedgedDownloadPercentile = 0;
+        _hedgedDownloadMinimumDelay = TIPHedgedDownloadMinimumDelayDefault;
+        _hedgedDownloadBudget = TIPHedgedDownloadBudgetDefault;
+        _imageRevalidationMode = TIPImageRevalidationModeOff;
         _maxRatioSizeOfCacheEntry = TIPMaxRatioSizeOfCacheEntryDefault;
+        _cachePruneLowWatermarkRatio = TIPCachePruneLowWatermarkRatioDefault;
+        pthread_mutex_init(&_pruneMutex, NULL);
         _clearMemoryCachesOnApplicationBackgroundEnabled = NO;
+        _hotSetSnapshotCount = 0;
+        _hotSetRenderedCachePrewarmEnabled = NO;
+        _hotSetPreconnectEnabled = NO;
+        _imageResamplerEnabled = NO;
         _serializeCGContextAccess = YES;
 
         _queueForDiskCaches = dispatch_queue_create("tip.global.disk.cache.queue", DISPATCH_QUEUE_SERIAL);
@@ -314,6 +606,22 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
     return totalCount;
 }
 
+- (void)setCachePruneLowWatermarkRatio:(double)ratio
+{
+    ratio = (ratio < 0.0) ? TIPCachePruneLowWatermarkRatioDefault : MIN(1.0, MAX(0.5, ratio));
+    pthread_mutex_lock(&_pruneMutex);
+    _cachePruneLowWatermarkRatio = ratio;
+    pthread_mutex_unlock(&_pruneMutex);
+}
+
+- (double)cachePruneLowWatermarkRatio
+{
+    pthread_mutex_lock(&_pruneMutex);
+    const double ratio = _cachePruneLowWatermarkRatio;
+    pthread_mutex_unlock(&_pruneMutex);
+    return ratio;
+}
+
 #pragma mark Instance Methods
 
 - (void)clearAllDiskCaches
@@ -321,6 +629,7 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
     [[TIPImagePipeline allRegisteredImagePipelines] enumerateKeysAndObjectsUsingBlock:^(NSString * _Nonnull key, TIPImagePipeline * _Nonnull pipeline, BOOL * _Nonnull stop) {
         [pipeline clearDiskCache];
     }];
+    [TIPImagePipeline removeAllHotSetSnapshots];
 }
 
 - (void)clearAllMemoryCaches
@@ -513,10 +822,25 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
 {
     const SInt64 globalMaxBytes = [self internalMaxBytesForAllCachesOfType:type];
     const SInt16 globalMaxCount = [self internalMaxCountForAllCachesOfType:type];
-    [self pruneAllCachesOfType:type
-             withPriorityCache:priorityCache
-              toGlobalMaxBytes:globalMaxBytes
-              toGlobalMaxCount:globalMaxCount];
+    if (!_IsOverMax([self internalTotalBytesForAllCachesOfType:type], [self internalTotalCountForAllCachesOfType:type], globalMaxBytes, globalMaxCount)) {
+        // under the high watermark, nothing to do
+        return;
+    }
+
+    // Over the high watermark: get back under it now (the max is a hard limit, even for the
+    // rendered caches on the main queue), then incrementally prune down to the low watermark.
+    const uint64_t machStart = mach_absolute_time();
+    const NSUInteger evictedCount = [self _pruneAllCachesOfType:type
+                                              withPriorityCache:priorityCache
+                                               toGlobalMaxBytes:globalMaxBytes
+                                               toGlobalMaxCount:globalMaxCount
+                                                     timeBudget:0
+                                                       didYield:NULL];
+    [self _recordPruneOfType:type
+                     isSlice:NO
+                evictedCount:evictedCount
+                    duration:TIPComputeDuration(machStart, 0)];
+    [self _schedulePruneSliceForCachesOfType:type];
 }
 
 - (void)pruneAllCachesOfType:(TIPImageCacheType)type
@@ -524,6 +848,111 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
             toGlobalMaxBytes:(SInt64)globalMaxBytes
             toGlobalMaxCount:(SInt16)globalMaxCount
 {
+    (void)[self _pruneAllCachesOfType:type
+                    withPriorityCache:priorityCache
+                     toGlobalMaxBytes:globalMaxBytes
+                     toGlobalMaxCount:globalMaxCount
+                           timeBudget:0
+                             didYield:NULL];
+}
+
+#pragma mark Private Prune Methods
+
+- (void)_schedulePruneSliceForCachesOfType:(TIPImageCacheType)type TIP_OBJC_DIRECT
+{
+    if (_pruneSliceScheduled[type]) {
+        return;
+    }
+
+    _pruneSliceScheduled[type] = YES;
+    if (TIPImageCacheTypeRendered == type) {
+        // let the main run loop get a frame in between slices
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kPruneSliceMainQueueYieldDelay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            @autoreleasepool {
+                self->_pruneSliceScheduled[type] = NO;
+                [self _runPruneSliceForCachesOfType:type];
+            }
+        });
+    } else {
+        tip_dispatch_async_autoreleasing([self queueForCachesOfType:type], ^{
+            self->_pruneSliceScheduled[type] = NO;
+            [self _runPruneSliceForCachesOfType:type];
+        });
+    }
+}
+
+- (void)_runPruneSliceForCachesOfType:(TIPImageCacheType)type TIP_OBJC_DIRECT
+{
+    const double ratio = self.cachePruneLowWatermarkRatio;
+    const SInt64 globalMaxBytes = [self internalMaxBytesForAllCachesOfType:type];
+    const SInt16 globalMaxCount = [self internalMaxCountForAllCachesOfType:type];
+    const SInt64 lowWatermarkBytes = (SInt64)((double)globalMaxBytes * ratio);
+    const SInt16 lowWatermarkCount = (globalMaxCount > 0) ? (SInt16)MAX(1.0, (double)globalMaxCount * ratio) : 0;
+    if (!_IsOverMax([self internalTotalBytesForAllCachesOfType:type], [self internalTotalCountForAllCachesOfType:type], lowWatermarkBytes, lowWatermarkCount)) {
+        return;
+    }
+
+    BOOL didYield = NO;
+    const uint64_t machStart = mach_absolute_time();
+    const NSUInteger evictedCount = [self _pruneAllCachesOfType:type
+                                              withPriorityCache:nil
+                                               toGlobalMaxBytes:lowWatermarkBytes
+                                               toGlobalMaxCount:lowWatermarkCount
+                                                     timeBudget:_PruneSliceTimeBudget(type)
+                                                       didYield:&didYield];
+    [self _recordPruneOfType:type
+                     isSlice:YES
+                evictedCount:evictedCount
+                    duration:TIPComputeDuration(machStart, 0)];
+    if (didYield) {
+        // requeue so that cache reads waiting on the queue can interleave with pruning
+        [self _schedulePruneSliceForCachesOfType:type];
+    }
+}
+
+- (void)_recordPruneOfType:(TIPImageCacheType)type
+                   isSlice:(BOOL)isSlice
+              evictedCount:(NSUInteger)evictedCount
+                  duration:(NSTimeInterval)duration TIP_OBJC_DIRECT
+{
+    pthread_mutex_lock(&_pruneMutex);
+    TIPCachePruneStatistics *stats = &_pruneStatistics[type];
+    if (isSlice) {
+        stats->sliceCount++;
+    } else {
+        stats->pruneCount++;
+    }
+    stats->evictedEntryCount += evictedCount;
+    stats->totalDuration += duration;
+    stats->maxDuration = MAX(stats->maxDuration, duration);
+    pthread_mutex_unlock(&_pruneMutex);
+}
+
+- (TIPCachePruneStatistics)pruneStatisticsForCachesOfType:(TIPImageCacheType)type TIP_OBJC_DIRECT
+{
+    pthread_mutex_lock(&_pruneMutex);
+    const TIPCachePruneStatistics stats = _pruneStatistics[type];
+    pthread_mutex_unlock(&_pruneMutex);
+    return stats;
+}
+
+/**
+ Evict entries (oldest first, from the pipeline most over its weighted share, priority cache last
+ unless it is the most over its share) until the caches of the given type are within the given max
+ bytes and max count.
+ A `timeBudget` of `0` is unbounded, otherwise pruning yields (populating `didYieldOut` with `YES`)
+ once the budget has elapsed.
+ Returns the number of evicted entries.
+ */
+- (NSUInteger)_pruneAllCachesOfType:(TIPImageCacheType)type
+                  withPriorityCache:(nullable id<TIPImageCache>)priorityCache
+                   toGlobalMaxBytes:(SInt64)globalMaxBytes
+                   toGlobalMaxCount:(SInt16)globalMaxCount
+                         timeBudget:(NSTimeInterval)timeBudget
+                           didYield:(nullable out BOOL *)didYieldOut TIP_OBJC_DIRECT
+{
+    NSUInteger evictedCount = 0;
+    BOOL didYield = NO;
     @autoreleasepool {
         switch (type) {
             case TIPImageCacheTypeRendered:
@@ -532,7 +961,7 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
                 break;
             default:
                 TIPAssertNever();
-                return;
+                return 0;
         }
 
         TIPAssert(globalMaxBytes >= 0);
@@ -548,55 +977,46 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
             globalMaxCount = INT16_MAX;
         }
 
+        const uint64_t machStart = (timeBudget > 0) ? mach_absolute_time() : 0;
         NSArray<TIPImagePipeline *> *allPipelines = nil;
-        NSInteger knownTotalEntries = -1;
-        NSInteger knownPriorityEntries = 0;
-        if (priorityCache) {
-            TIPLRUCache *manifest = (TIPImageCacheTypeDisk == type) ? [(TIPImageDiskCache *)priorityCache diskCache_syncAccessManifest] : priorityCache.manifest;
-            knownPriorityEntries = (NSInteger)manifest.numberOfEntries;
-        }
+        _TIPPrunePartitions partitions = { 0 };
 
-        // Remove entries from the non-priority caches to alleviate memory pressure
-        while (([self internalTotalBytesForAllCachesOfType:type] > globalMaxBytes || [self internalTotalCountForAllCachesOfType:type] > globalMaxCount) && knownTotalEntries != knownPriorityEntries) {
+        // Evict the oldest entry of whichever cache is the most over its pipeline's share, one at a time
+        while ([self internalTotalBytesForAllCachesOfType:type] > globalMaxBytes || [self internalTotalCountForAllCachesOfType:type] > globalMaxCount) {
 
+            if (machStart && TIPComputeDuration(machStart, 0) >= timeBudget) {
+                didYield = YES;
+                break;
+            }
+
+            const BOOL overBytes = [self internalTotalBytesForAllCachesOfType:type] > globalMaxBytes;
             if (!allPipelines) {
                 // lazy load
                 allPipelines = [[TIPImagePipeline allRegisteredImagePipelines] allValues];
+                _PrunePartitionsLoad(&partitions, allPipelines, type, priorityCache);
+                _PrunePartitionsMeasure(&partitions,
+                                        (overBytes) ? (double)globalMaxBytes : (double)globalMaxCount,
+                                        overBytes);
+            } else if (overBytes != partitions.overBytes) {
+                // switched between pruning bytes and pruning count
+                _PrunePartitionsMeasure(&partitions,
+                                        (overBytes) ? (double)globalMaxBytes : (double)globalMaxCount,
+                                        overBytes);
             }
 
-            // Only load knownTotalEntries once
-            const BOOL getKnownTotalEntries = knownTotalEntries < 0;
-            if (getKnownTotalEntries) {
-                knownTotalEntries = 0;
-            }
-
-            // Ditch the oldest entry for all non-priority caches
-            for (TIPImagePipeline *pipeline in allPipelines) {
-                id<TIPImageCache> cache = [pipeline cacheOfType:type];
-                if (cache) {
-                    TIPLRUCache *manifest = (TIPImageCacheTypeDisk == type) ? [(TIPImageDiskCache *)cache diskCache_syncAccessManifest] : cache.manifest;
-                    if (getKnownTotalEntries) {
-                        knownTotalEntries += manifest.numberOfEntries;
-                    }
-
-                    if (cache != priorityCache) {
-                        if ([manifest removeTailEntry]) {
-                            knownTotalEntries--;
-                        }
-                    }
-                }
+            const NSUInteger victimIndex = _PrunePartitionsSelectVictim(&partitions);
+            if (NSNotFound == victimIndex || ![partitions.partitions[victimIndex].manifest removeTailEntry]) {
+                // nothing left to evict
+                break;
             }
-
+            _PrunePartitionsDidEvict(&partitions, victimIndex);
+            evictedCount++;
         }
 
-        // If we still have too much data being consumed, start removing entries from the priority cache
-        while (([self internalTotalBytesForAllCachesOfType:type] > globalMaxBytes || [self internalTotalCountForAllCachesOfType:type] > globalMaxCount) && knownPriorityEntries > 0) {
-            [priorityCache.manifest removeTailEntry];
-            knownPriorityEntries--;
-        }
+        _PrunePartitionsFree(&partitions);
 
 #if DEBUG
-        if ([self internalTotalBytesForAllCachesOfType:type] > globalMaxBytes || [self internalTotalCountForAllCachesOfType:type] > globalMaxCount) {
+        if (!didYield && ([self internalTotalBytesForAllCachesOfType:type] > globalMaxBytes || [self internalTotalCountForAllCachesOfType:type] > globalMaxCount)) {
             NSString *typeStr = nil;
             switch (type) {
                 case TIPImageCacheTypeRendered:
@@ -613,6 +1033,11 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
         }
 #endif
     }
+
+    if (didYieldOut) {
+        *didYieldOut = didYield;
+    }
+    return evictedCount;
 }
 
 #pragma mark Runtime Methods
@@ -640,6 +1065,19 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
 
 #pragma mark Download Methods
 
+- (void)preconnectToURLs:(NSArray<NSURL *> *)URLs
+{
+    id<TIPImageFetchDownloadProvider> imageFetchDownloadProvider = self.imageFetchDownloadProvider;
+    if (![imageFetchDownloadProvider respondsToSelector:@selector(preconnectToURLs:)]) {
+        return;
+    }
+
+    NSArray<NSURL *> *origins = _PreconnectOrigins(URLs, self.preconnectPath);
+    if (origins.count > 0) {
+        [imageFetchDownloadProvider preconnectToURLs:origins];
+    }
+}
+
 - (id<TIPImageFetchDownload>)createImageFetchDownloadWithContext:(id<TIPImageFetchDownloadContext>)context
 {
     id<TIPImageFetchDownloadProvider> imageFetchDownloadProvider = self.imageFetchDownloadProvider;
@@ -723,6 +1161,60 @@ NS_INLINE SInt64 _MaxBytesForAllDiskCachesDefaultValue()
     _Inspect(pipelines, results, callback);
 }
 
+- (void)getCacheUsageForImagePipeline:(TIPImagePipeline *)imagePipeline
+                   renderedCacheUsage:(out TIPImagePipelineCacheUsage * __nullable)renderedUsageOut
+                     memoryCacheUsage:(out TIPImagePipelineCacheUsage * __nullable)memoryUsageOut
+                       diskCacheUsage:(out TIPImagePipelineCacheUsage * __nullable)diskUsageOut
+{
+    NSArray<TIPImagePipeline *> *allPipelines = [[TIPImagePipeline allRegisteredImagePipelines] allValues];
+    const TIPImageCacheType types[PRUNE_CACHE_TYPE_COUNT] = { TIPImageCacheTypeRendered, TIPImageCacheTypeMemory, TIPImageCacheTypeDisk };
+    TIPImagePipelineCacheUsage * __nullable const usagesOut[PRUNE_CACHE_TYPE_COUNT] = { renderedUsageOut, memoryUsageOut, diskUsageOut };
+
+    for (size_t i = 0; i < PRUNE_CACHE_TYPE_COUNT; i++) {
+        TIPImagePipelineCacheUsage * __nullable const usageOut = usagesOut[i];
+        if (!usageOut) {
+            continue;
+        }
+
+        const TIPImageCacheType type = types[i];
+        id<TIPImageCache> cache = [imagePipeline cacheOfType:type];
+        const double totalWeight = _TotalCacheShareWeight(allPipelines, type);
+        TIPImagePipelineCacheUsage usage = { 0 };
+        if (cache && totalWeight > 0.0) {
+            usage.totalBytes = (SInt64)cache.totalCost;
+            usage.fairShareBytes = (SInt64)((double)[self internalMaxBytesForAllCachesOfType:type] * _CacheShareWeight(imagePipeline) / totalWeight);
+            usage.reservedBytes = (SInt64)((double)usage.fairShareBytes * _CacheShareReservedRatio(imagePipeline));
+        }
+        [imagePipeline getLookupHitCount:&usage.hitCount
+                               missCount:&usage.missCount
+                            forCacheType:type];
+        *usageOut = usage;
+    }
+}
+
+- (BOOL)getTimeToFirstImageForImagePipeline:(TIPImagePipeline *)imagePipeline
+                                   duration:(out NSTimeInterval * __nullable)durationOut
+                                 loadSource:(out TIPImageLoadSource * __nullable)loadSourceOut
+{
+    return [imagePipeline getTimeToFirstImage:durationOut
+                                   loadSource:loadSourceOut];
+}
+
+- (TIPCachePruneStatistics)pruneStatisticsForAllRenderedCaches
+{
+    return [self pruneStatisticsForCachesOfType:TIPImageCacheTypeRendered];
+}
+
+- (TIPCachePruneStatistics)pruneStatisticsForAllMemoryCaches
+{
+    return [self pruneStatisticsForCachesOfType:TIPImageCacheTypeMemory];
+}
+
+- (TIPCachePruneStatistics)pruneStatisticsForAllDiskCaches
+{
+    return [self pruneStatisticsForCachesOfType:TIPImageCacheTypeDisk];
+}
+
 static void _Inspect(NSMutableDictionary<NSString *, TIPImagePipeline *> *remainingPipelines,
                      NSMutableDictionary<NSString *, TIPImagePipelineInspectionResult *> *gatheredResults,
                      TIPGlobalConfigurationInspectionCallback callback)
@@ -42,6 +42,7 @@ NS_ASSUME_NONNULL_BEGIN
                                                  TIPImageTypeHEIC,
                                                  TIPImageTypeAVCI,
                                                  TIPImageTypeWEBP,
+                                                 TIPImageTypeJXL,
                                                  ];
         for (NSString *imageType in knownImageTypes) {
             id<TIPImageCodec> codec = [TIPBasicCGImageSourceCodec codecWithImageType:imageType];
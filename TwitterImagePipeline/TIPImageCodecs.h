@@ -296,6 +296,24 @@ typedef NS_ENUM(NSInteger, TIPImageDecoderRenderMode)
 - (nullable TIPImageContainer *)tip_decodeImageWithData:(NSData *)imageData
                                                  config:(nullable id)config __attribute__((deprecated("Implement tip_decodeImageWithData:targetDimensions:targetContentMode:config:")));
 
+/**
+ Optional implementation for decoding a region of an image, such as the visible tile of a zoomed in
+ image, without decoding the rest of the image.
+ Implementing this method will offer that feature to __TIP__.
+ Otherwise, `TIPDecodeImageRegionFromData` decodes the entire image (at the scale of the region's target sizing) and crops it.
+ @param region the region to decode, in pixels of the image as displayed (after its orientation is applied)
+ @param imageData the (complete) image data to decode
+ @param targetDimensions the dimension sizing constraints to decode the region into (`CGSizeZero` for full size) -- can be ignored by codec to simplify implementation
+ @param targetContentMode the content mode sizing constraints to decode the region into (any non-scaling mode for full size) -- can be ignored by codec to simplify implementation
+ @param config an optional opaque object to provide extra customization for how the decoding should operate
+ @return the decoded region (wrapped in a `TIPImageContainer`) or `nil` if the region could not be decoded
+ */
+- (nullable TIPImageContainer *)tip_decodeImageRegion:(CGRect)region
+                                             fromData:(NSData *)imageData
+                                     targetDimensions:(CGSize)targetDimensions
+                                    targetContentMode:(UIViewContentMode)targetContentMode
+                                               config:(nullable id)config;
+
 
 @end
 
@@ -314,6 +332,13 @@ FOUNDATION_EXTERN TIPImageContainer * __nullable TIPDecodeImageFromData(id<TIPIm
                                                                         CGSize targetDimensions,
                                                                         UIViewContentMode targetContentMode,
                                                                         NSString * __nullable earlyGuessImageType) __attribute__((overloadable));
+//! Convenience function to decode a region (in pixels of the image as displayed) of an image from data, decodes the entire image at the scale of the region's target sizing and crops it if the decoder does not implement `tip_decodeImageRegion:fromData:targetDimensions:targetContentMode:config:`
+FOUNDATION_EXTERN TIPImageContainer * __nullable TIPDecodeImageRegionFromData(id<TIPImageCodec> codec,
+                                                                              id __nullable config,
+                                                                              NSData *imageData,
+                                                                              CGRect region,
+                                                                              CGSize targetDimensions,
+                                                                              UIViewContentMode targetContentMode);
 //! Convenience function to encode an image to a file
 FOUNDATION_EXTERN BOOL TIPEncodeImageToFile(id<TIPImageCodec> codec,
                                             TIPImageContainer *imageContainer,
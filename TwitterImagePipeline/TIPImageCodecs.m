@@ -9,9 +9,16 @@
 #import "TIP_Project.h"
 #import "TIPError.h"
 #import "TIPImageCodecs.h"
+#import "TIPImageContainer.h"
+#import "TIPImageUtils.h"
+#import "UIImage+TIPAdditions.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+static CGSize _TIPRegionDimensions(CGSize regionSize,
+                                   CGSize targetDimensions,
+                                   UIViewContentMode targetContentMode);
+
 TIPImageContainer * __nullable TIPDecodeImageFromData(id<TIPImageCodec> codec,
                                                       id __nullable config,
                                                       NSData *imageData,
@@ -65,6 +72,86 @@ TIPImageContainer * __nullable TIPDecodeImageFromData(id<TIPImageCodec> codec,
     return container;
 }
 
+TIPImageContainer * __nullable TIPDecodeImageRegionFromData(id<TIPImageCodec> codec,
+                                                            id __nullable config,
+                                                            NSData *imageData,
+                                                            CGRect region,
+                                                            CGSize targetDimensions,
+                                                            UIViewContentMode targetContentMode)
+{
+    region = CGRectIntegral(region);
+    if (CGRectIsEmpty(region)) {
+        return nil;
+    }
+
+    id<TIPImageDecoder> decoder = codec.tip_decoder;
+    if ([decoder respondsToSelector:@selector(tip_decodeImageRegion:fromData:targetDimensions:targetContentMode:config:)]) {
+        return [decoder tip_decodeImageRegion:region
+                                     fromData:imageData
+                             targetDimensions:targetDimensions
+                            targetContentMode:targetContentMode
+                                       config:config];
+    }
+
+    // decode the entire image at the scale of the region (so the decoder can subsample, such as
+    // with an ImageIO thumbnail) and render the region of it
+    const CGSize encodedDimensions = TIPDetectImageDataDimensions(imageData);
+    CGSize decodeDimensions = CGSizeZero;
+    if (encodedDimensions.width > 0 && encodedDimensions.height > 0) {
+        // the detected dimensions are not oriented, use the larger scale of the region clipped to
+        // either orientation and scale the longest side into a square to get that scale either way
+        const CGSize orientedDimensions[] = { encodedDimensions, CGSizeMake(encodedDimensions.height, encodedDimensions.width) };
+        CGFloat decodeScale = 0;
+        for (size_t i = 0; i < sizeof(orientedDimensions) / sizeof(orientedDimensions[0]); i++) {
+            const CGRect clippedRegion = CGRectIntersection(region, CGRectMake(0, 0, orientedDimensions[i].width, orientedDimensions[i].height));
+            if (!CGRectIsEmpty(clippedRegion)) {
+                const CGSize regionDimensions = _TIPRegionDimensions(clippedRegion.size, targetDimensions, targetContentMode);
+                decodeScale = MAX(decodeScale, MAX(regionDimensions.width / clippedRegion.size.width, regionDimensions.height / clippedRegion.size.height));
+            }
+        }
+        if (decodeScale <= 0) {
+            return nil;
+        }
+        if (decodeScale < 1) {
+            const CGFloat longestSide = ceil(MAX(encodedDimensions.width, encodedDimensions.height) * decodeScale);
+            decodeDimensions = CGSizeMake(longestSide, longestSide);
+        }
+    }
+    TIPImageContainer *container = TIPDecodeImageFromData(codec, config, imageData, decodeDimensions, UIViewContentModeScaleAspectFit);
+    UIImage *image = container.image;
+    if (!image || container.isAnimated) {
+        return nil;
+    }
+
+    // the region is in pixels of the full size image, which the decoded image is drawn at
+    const CGSize decodedDimensions = [image tip_dimensions];
+    CGSize dimensions = decodedDimensions;
+    if (decodeDimensions.width > 0) {
+        const BOOL isTransposed = (decodedDimensions.width >= decodedDimensions.height) != (encodedDimensions.width >= encodedDimensions.height);
+        dimensions = (isTransposed) ? CGSizeMake(encodedDimensions.height, encodedDimensions.width) : encodedDimensions;
+    }
+    region = CGRectIntersection(region, CGRectMake(0, 0, dimensions.width, dimensions.height));
+    if (CGRectIsEmpty(region)) {
+        return nil;
+    }
+
+    const CGSize regionDimensions = _TIPRegionDimensions(region.size, targetDimensions, targetContentMode);
+    const CGFloat scaleX = regionDimensions.width / region.size.width;
+    const CGFloat scaleY = regionDimensions.height / region.size.height;
+    const BOOL opaque = ![image tip_hasAlpha:NO];
+    UIImage *regionImage = TIPRenderImage(image, ^(id<TIPRenderImageFormat> format) {
+        format.renderSize = regionDimensions;
+        format.scale = 1;
+        format.opaque = opaque;
+    }, ^(UIImage *sourceImage, CGContextRef ctx) {
+        [sourceImage drawInRect:CGRectMake(-region.origin.x * scaleX,
+                                           -region.origin.y * scaleY,
+                                           dimensions.width * scaleX,
+                                           dimensions.height * scaleY)];
+    });
+    return (regionImage) ? [[TIPImageContainer alloc] initWithImage:regionImage] : nil;
+}
+
 BOOL TIPEncodeImageToFile(id<TIPImageCodec> codec,
                           TIPImageContainer *imageContainer,
                           NSString *filePath,
@@ -112,4 +199,16 @@ BOOL TIPEncodeImageToFile(id<TIPImageCodec> codec,
     return success;
 }
 
+static CGSize _TIPRegionDimensions(CGSize regionSize,
+                                   CGSize targetDimensions,
+                                   UIViewContentMode targetContentMode)
+{
+    CGSize regionDimensions = TIPDimensionsScaledToTargetSizing(regionSize, targetDimensions, targetContentMode);
+    if (regionDimensions.width > regionSize.width || regionDimensions.height > regionSize.height) {
+        // don't scale up, like a decoder doesn't
+        regionDimensions = regionSize;
+    }
+    return CGSizeMake(MAX(1, round(regionDimensions.width)), MAX(1, round(regionDimensions.height)));
+}
+
 NS_ASSUME_NONNULL_END
@@ -97,9 +97,23 @@ FOUNDATION_EXTERN NSString * const TIPImageFetchDownloadConstructorExceptionName
  */
 @property (nonatomic, readonly, nullable) id downloadMetrics;
 
+/** Optional readonly property for whether a duplicate (hedged) request was issued for the download */
+@property (nonatomic, readonly) BOOL didHedgeRequest;
+/** Optional readonly property for whether the hedged request responded first and was the one used */
+@property (nonatomic, readonly) BOOL hedgedRequestWon;
+
 /** Optional readwrite property to support dynamic priority */
 @property (nonatomic) NSOperationQueuePriority priority;
 
+/**
+ Optional readwrite property to support pausing a running download so that higher priority
+ downloads can have the bandwidth.
+ A paused download should not time out and must continue where it left off once unpaused.
+ Can be set before the download starts, in which case the download must not load until unpaused.
+ See `TIPGlobalConfiguration.lowPriorityDownloadPausingEnabled`
+ */
+@property (nonatomic, getter=isPaused) BOOL paused;
+
 @end
 
 /** Block for hydration completion that provides `nil` on success or an `NSError` on failure */
@@ -259,6 +273,17 @@ typedef void(^TIPImageFetchDownloadRequestAuthorizationCompleteBlock)(NSError *
  */
 - (id<TIPImageFetchDownload>)imageFetchDownloadWithContext:(id<TIPImageFetchDownloadContext>)context;
 
+@optional
+
+/**
+ Open connections to the hosts of _URLs_ and keep them warm so that the first download from each
+ host does not pay for DNS, TCP and TLS set up.
+ Called by __TIP__ via `[TIPGlobalConfiguration preconnectToURLs:]` from any thread.
+ @param URLs the origins to connect to, each with only a scheme, host, port and the
+ `TIPGlobalConfiguration.preconnectPath` (and no duplicates)
+ */
+- (void)preconnectToURLs:(NSArray<NSURL *> *)URLs;
+
 @end
 
 /**
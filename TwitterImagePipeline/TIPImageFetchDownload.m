@@ -6,7 +6,9 @@
 //  Copyright © 2020 Twitter. All rights reserved.
 //
 
+#import "NSDictionary+TIPAdditions.h"
 #import "TIP_Project.h"
+#import "TIPGlobalConfiguration.h"
 #import "TIPImageFetchDownloadInternal.h"
 
 @class TIPImageFetchDownloadInternalURLSessionDelegate;
@@ -20,20 +22,102 @@ static NSURLSession *sTIPImageFetchDownloadInternalURLSession = nil;
 static NSOperationQueue *sTIPImageFetchDownloadInternalOperationQueue = nil;
 static TIPImageFetchDownloadInternalURLSessionDelegate *sTIPImageFetchDownloadInternalURLSessionDelegate = nil;
 
+// Parallel range downloads never use ranges smaller than this
+static const UInt64 kParallelRangeMinimumRangeLength = 128 * 1024;
+// A range that has not received any bytes for this long is re-issued
+static const NSTimeInterval kParallelRangeStallTimeout = 8.0;
+// A range is issued at most this many times before the download fails
+static const NSUInteger kParallelRangeMaxAttemptCount = 3;
+// Recent times to first response are kept for the hedged download percentile
+#define kHedgeSampleCapacity (64)
+// The hedged download percentile is only used once there are this many samples
+static const NSUInteger kHedgeMinimumSampleCount = 16;
+// Preconnecting gives up on a host after this long
+static const NSTimeInterval kPreconnectTimeout = 10.0;
+// A download fails once it has been loading for this long, time spent paused is not counted
+static const NSTimeInterval kResourceTimeout = 60 * 3;
+// NSURLSession keeps timing suspended tasks, so its own resource timeout only bounds how long a download can stay paused
+static const NSTimeInterval kSessionResourceTimeout = 60 * 60;
+
+// Hedging state, only accessed from the URL session delegate queue
+static NSTimeInterval sHedgeSamples[kHedgeSampleCapacity];
+static NSUInteger sHedgeSampleCount = 0;
+static NSUInteger sHedgeSampleIndex = 0;
+static NSUInteger sHedgeDownloadCount = 0;
+static NSUInteger sHedgeCount = 0;
+
 static float ConvertNSOperationQueuePriorityToNSURLSessionTaskPriority(NSOperationQueuePriority pri);
+static BOOL _ParseContentRange(NSString * __nullable contentRange,
+                               UInt64 *startOut,
+                               UInt64 *endOut,
+                               UInt64 *totalOut);
+static void _RecordTimeToFirstResponse(NSTimeInterval duration);
+static NSTimeInterval _HedgeDelay(float percentile,
+                                  NSTimeInterval minimumDelay);
+static int _CompareTimeIntervals(const void *a, const void *b);
 
 @interface TIPImageFetchDownloadInternalURLSessionDelegate : NSObject <NSURLSessionDataDelegate>
-- (void)addDownload:(TIPImageFetchDownloadInternal *)download;
-- (void)removeDownloadWithTask:(NSURLSessionDataTask *)task;
+- (void)addDownload:(TIPImageFetchDownloadInternal *)download
+               task:(NSURLSessionDataTask *)task;
+- (void)removeDownloadWithTask:(NSURLSessionTask *)task;
+@end
+
+/**
+ A byte range of a parallel range download.
+ Only accessed from the URL session delegate queue.
+ */
+TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
+@interface TIPImageFetchDownloadInternalRange : NSObject
+@property (nonatomic, readonly) UInt64 offset; // absolute offset in the resource
+@property (nonatomic, readonly) UInt64 length;
+@property (nonatomic) UInt64 receivedLength;
+@property (nonatomic) UInt64 requestedOffset; // absolute offset the current task started at
+@property (nonatomic, nullable) NSURLSessionDataTask *task;
+@property (nonatomic, nullable) NSMutableData *bufferedData; // received, waiting on earlier ranges
+@property (nonatomic) CFAbsoluteTime lastActivityTime;
+@property (nonatomic) NSUInteger attemptCount;
+@property (nonatomic, readonly, getter=isComplete) BOOL complete;
+- (instancetype)initWithOffset:(UInt64)offset length:(UInt64)length;
 @end
 
 @interface TIPImageFetchDownloadInternal ()
 
 @property (nonatomic, nullable) id downloadMetrics;
+@property (nonatomic) BOOL didHedgeRequest;
+@property (nonatomic) BOOL hedgedRequestWon;
 
 @property (nonatomic, nullable, readonly) NSURLSessionDataTask *task;
 @property (nonatomic, readonly) dispatch_queue_t contextQueue;
 
+// URL session delegate queue
+
+- (NSURLSessionResponseDisposition)_task:(NSURLSessionDataTask *)task
+                      didReceiveResponse:(NSHTTPURLResponse *)response TIP_OBJC_DIRECT;
+- (void)_task:(NSURLSessionDataTask *)task
+        didReceiveData:(NSData *)data TIP_OBJC_DIRECT;
+- (void)_task:(NSURLSessionTask *)task
+        didCompleteWithError:(nullable NSError *)error TIP_OBJC_DIRECT;
+
+- (void)_startRangesWithResponse:(NSHTTPURLResponse *)response TIP_OBJC_DIRECT;
+- (BOOL)_issueRange:(TIPImageFetchDownloadInternalRange *)range TIP_OBJC_DIRECT;
+- (nullable TIPImageFetchDownloadInternalRange *)_rangeForTask:(NSURLSessionTask *)task TIP_OBJC_DIRECT;
+- (void)_completeRange:(TIPImageFetchDownloadInternalRange *)range TIP_OBJC_DIRECT;
+- (void)_retryRange:(TIPImageFetchDownloadInternalRange *)range
+              error:(nullable NSError *)error TIP_OBJC_DIRECT;
+- (void)_stopRangeTask:(NSURLSessionDataTask *)task TIP_OBJC_DIRECT;
+- (void)_abandonRangesWithError:(NSError *)error TIP_OBJC_DIRECT;
+- (void)_finishRangesWithError:(nullable NSError *)error TIP_OBJC_DIRECT;
+- (void)_scheduleStallCheck TIP_OBJC_DIRECT;
+- (void)_checkForStalledRanges TIP_OBJC_DIRECT;
+- (void)_scheduleHedgeCheck TIP_OBJC_DIRECT;
+- (void)_hedgeIfNeeded TIP_OBJC_DIRECT;
+- (void)_resolveHedgeWithWinningTask:(NSURLSessionTask *)task TIP_OBJC_DIRECT;
+- (void)_updateTasksPaused:(BOOL)paused TIP_OBJC_DIRECT;
+- (void)_scheduleResourceTimeout TIP_OBJC_DIRECT;
+- (void)_checkResourceTimeoutOfGeneration:(NSUInteger)generation TIP_OBJC_DIRECT;
+- (void)_deliverData:(NSData *)data TIP_OBJC_DIRECT;
+- (void)_deliverCompletionWithError:(nullable NSError *)error TIP_OBJC_DIRECT;
+
 static void _PrepareGlobalState(void);
 
 @end
@@ -45,14 +129,48 @@ static void _PrepareGlobalState(void);
     return [[TIPImageFetchDownloadInternal alloc] initWithContext:context];
 }
 
+- (void)preconnectToURLs:(NSArray<NSURL *> *)URLs
+{
+    [TIPImageFetchDownloadInternal preconnectToURLs:URLs
+                                            session:[TIPImageFetchDownloadInternal defaultURLSession]];
+}
+
 @end
 
 @implementation TIPImageFetchDownloadInternal
 {
     NSOperationQueuePriority _priority;
     NSURLSession *_session;
+    NSURLRequest *_request;
     BOOL _started;
     BOOL _cancelled;
+    BOOL _paused;
+
+    // parallel ranges, only accessed from the URL session delegate queue
+    NSArray<TIPImageFetchDownloadInternalRange *> *_ranges;
+    NSString *_rangeValidator;
+    NSUInteger _deliveringRangeIndex;
+    BOOL _rangesFinished;
+    BOOL _rangesAwaitingOriginalTask;
+
+    // hedging, only accessed from the URL session delegate queue
+    NSURLSessionDataTask *_hedgeTask;
+    CFAbsoluteTime _taskStartTime;
+    CFAbsoluteTime _hedgeStartTime;
+    BOOL _responseReceived;
+    BOOL _hedgeWon;
+    BOOL _taskFailedBeforeResponse;
+    BOOL _completionDelivered;
+
+    // snapshot of _priority, only accessed from the URL session delegate queue
+    NSOperationQueuePriority _taskPriority;
+
+    // pausing, only accessed from the URL session delegate queue
+    BOOL _tasksPaused;
+    BOOL _tasksWerePaused;
+    NSTimeInterval _activeDuration; // loading time up until the latest pause
+    CFAbsoluteTime _activeStartTime; // when loading last started or resumed
+    NSUInteger _resourceTimeoutGeneration;
 }
 
 @synthesize context = _context;
@@ -77,6 +195,18 @@ static void _PrepareGlobalState(void);
             }
         }];
     }
+    NSURLSessionDataTask *hedgeTask = _hedgeTask;
+    if (hedgeTask) {
+        TIPImageFetchDownloadInternalURLSessionDelegate *delegate = (id)_session.delegate;
+        [_session.delegateQueue addOperationWithBlock:^{
+            [delegate removeDownloadWithTask:hedgeTask];
+        }];
+        [hedgeTask cancel];
+    }
+    // no other references to the ranges remain, tear down directly
+    for (TIPImageFetchDownloadInternalRange *range in _ranges) {
+        [range.task cancel];
+    }
 }
 
 - (void)start
@@ -98,11 +228,28 @@ static void _PrepareGlobalState(void);
                         request =  [request mutableCopy];
                         [(NSMutableURLRequest *)request setValue:context.authorization forHTTPHeaderField:@"Authorization"];
                     }
+                    self->_request = request;
                     self->_task = [self->_session dataTaskWithRequest:request];
+                    NSURLSessionDataTask *task = self->_task;
+                    const BOOL paused = self->_paused;
+                    const NSOperationQueuePriority priority = self->_priority;
                     [self->_session.delegateQueue addOperationWithBlock:^{
-                        [(TIPImageFetchDownloadInternalURLSessionDelegate *)self->_session.delegate addDownload:self];
+                        self->_taskPriority = priority;
+                        [(TIPImageFetchDownloadInternalURLSessionDelegate *)self->_session.delegate addDownload:self
+                                                                                                          task:task];
+                        self->_taskStartTime = CFAbsoluteTimeGetCurrent();
+                        self->_tasksPaused = self->_tasksWerePaused = paused;
+                        sHedgeDownloadCount++;
+                        [self _scheduleHedgeCheck];
+                        if (!paused) {
+                            self->_activeStartTime = self->_taskStartTime;
+                            [self _scheduleResourceTimeout];
+                        }
                     }];
-                    [self->_task resume];
+                    if (!paused) {
+                        // a paused download is left suspended until it is resumed
+                        [task resume];
+                    }
                 } else {
                     [context.client imageFetchDownload:self didCompleteWithError:authError];
                 }
@@ -122,6 +269,19 @@ static void _PrepareGlobalState(void);
     _cancelled = YES;
     if (_task) {
         [_task cancel];
+        [_session.delegateQueue addOperationWithBlock:^{
+            NSURLSessionDataTask *hedgeTask = self->_hedgeTask;
+            if (hedgeTask && !self->_hedgeWon) {
+                // the original task delivers the completion
+                [(TIPImageFetchDownloadInternalURLSessionDelegate *)self->_session.delegate removeDownloadWithTask:hedgeTask];
+            }
+            [hedgeTask cancel];
+            if (self->_ranges && !self->_rangesFinished) {
+                [self _finishRangesWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                                 code:NSURLErrorCancelled
+                                                             userInfo:nil]];
+            }
+        }];
     } else if (_context) {
         tip_dispatch_async_autoreleasing(self.contextQueue, ^{
             [self.context.client imageFetchDownload:self
@@ -142,7 +302,17 @@ static void _PrepareGlobalState(void);
 - (void)setPriority:(NSOperationQueuePriority)priority
 {
     _priority = priority;
-    _task.priority = ConvertNSOperationQueuePriorityToNSURLSessionTaskPriority(_priority);
+    const float taskPriority = ConvertNSOperationQueuePriorityToNSURLSessionTaskPriority(_priority);
+    _task.priority = taskPriority;
+    if (_task) {
+        [_session.delegateQueue addOperationWithBlock:^{
+            self->_taskPriority = priority;
+            self->_hedgeTask.priority = taskPriority;
+            for (TIPImageFetchDownloadInternalRange *range in self->_ranges) {
+                range.task.priority = taskPriority;
+            }
+        }];
+    }
 }
 
 - (NSOperationQueuePriority)priority
@@ -150,9 +320,614 @@ static void _PrepareGlobalState(void);
     return _priority;
 }
 
+- (void)setPaused:(BOOL)paused
+{
+    if (_paused == paused) {
+        return;
+    }
+
+    _paused = paused;
+    if (_task) {
+        [_session.delegateQueue addOperationWithBlock:^{
+            [self _updateTasksPaused:paused];
+        }];
+    }
+}
+
+- (BOOL)isPaused
+{
+    return _paused;
+}
+
 - (nullable NSURLRequest *)finalURLRequest
 {
-    return _task.currentRequest;
+    // a winning hedge followed its own redirects, the original task was cancelled
+    return (_hedgeWon ? _hedgeTask : _task).currentRequest;
+}
+
+#pragma mark Session Events
+
+- (NSURLSessionResponseDisposition)_task:(NSURLSessionDataTask *)task
+                      didReceiveResponse:(NSHTTPURLResponse *)response
+{
+    if (!_responseReceived && (task == _task || task == _hedgeTask)) {
+        _responseReceived = YES;
+        if (_hedgeTask) {
+            [self _resolveHedgeWithWinningTask:task];
+        } else if (!_tasksWerePaused) {
+            _RecordTimeToFirstResponse(CFAbsoluteTimeGetCurrent() - _taskStartTime);
+        }
+        tip_dispatch_async_autoreleasing(self.contextQueue, ^{
+            [self.context.client imageFetchDownload:self
+                              didReceiveURLResponse:response];
+        });
+        if (task == _task) {
+            [self _startRangesWithResponse:response];
+        }
+        return NSURLSessionResponseAllow;
+    }
+
+    TIPImageFetchDownloadInternalRange *range = [self _rangeForTask:task];
+    if (!range) {
+        return NSURLSessionResponseCancel;
+    }
+
+    // a re-issued range must be the exact remainder of the same representation
+    UInt64 start, end, total;
+    if (206 /* Partial Content */ != response.statusCode ||
+        !_ParseContentRange([response.allHeaderFields tip_objectForCaseInsensitiveKey:@"Content-Range"], &start, &end, &total) ||
+        start != range.requestedOffset ||
+        end != (range.offset + range.length - 1)) {
+        TIPLogWarning(@"Parallel range download received an unusable range response (%zd), URL: %@", response.statusCode, response.URL);
+        [self _abandonRangesWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                          code:NSURLErrorBadServerResponse
+                                                      userInfo:nil]];
+        return NSURLSessionResponseCancel;
+    }
+
+    range.lastActivityTime = CFAbsoluteTimeGetCurrent();
+    return NSURLSessionResponseAllow;
+}
+
+- (void)_task:(NSURLSessionDataTask *)task
+        didReceiveData:(NSData *)data
+{
+    if (!_ranges) {
+        [self _deliverData:data];
+        return;
+    }
+
+    TIPImageFetchDownloadInternalRange *range = [self _rangeForTask:task];
+    if (!range || range.isComplete) {
+        return;
+    }
+
+    range.lastActivityTime = CFAbsoluteTimeGetCurrent();
+
+    // the original task is not bounded to its range, trim what follows it
+    const UInt64 remainingLength = range.length - range.receivedLength;
+    if ((UInt64)data.length > remainingLength) {
+        data = [data subdataWithRange:NSMakeRange(0, (NSUInteger)remainingLength)];
+    }
+    range.receivedLength += data.length;
+
+    if (range == _ranges[_deliveringRangeIndex]) {
+        [self _deliverData:data];
+    } else if (range.bufferedData) {
+        [range.bufferedData appendData:data];
+    } else {
+        range.bufferedData = [data mutableCopy];
+    }
+
+    if (range.isComplete) {
+        [self _completeRange:range];
+    }
+}
+
+- (void)_task:(NSURLSessionTask *)task
+        didCompleteWithError:(nullable NSError *)error
+{
+    if (_hedgeTask && !_responseReceived && !_cancelled) {
+        // until either responds, the other request can still succeed
+        if (task == _hedgeTask && !_taskFailedBeforeResponse) {
+            _hedgeTask = nil;
+            return;
+        }
+        if (task == _task) {
+            _taskFailedBeforeResponse = YES;
+            return;
+        }
+    }
+
+    if (!_ranges) {
+        [self _deliverCompletionWithError:error];
+        return;
+    }
+
+    if (task == _task && _rangesAwaitingOriginalTask) {
+        // its metrics have been collected by now
+        _rangesAwaitingOriginalTask = NO;
+        [self _deliverCompletionWithError:nil];
+        return;
+    }
+
+    TIPImageFetchDownloadInternalRange *range = [self _rangeForTask:task];
+    if (!range || range.isComplete) {
+        return;
+    }
+
+    range.task = nil;
+    if (error && [error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorCancelled && _cancelled) {
+        [self _finishRangesWithError:error];
+        return;
+    }
+
+    // ended before the whole range was received
+    [self _retryRange:range
+                error:error ?: [NSError errorWithDomain:NSURLErrorDomain
+                                                   code:NSURLErrorNetworkConnectionLost
+                                               userInfo:nil]];
+}
+
+#pragma mark Parallel Ranges
+
+- (void)_startRangesWithResponse:(NSHTTPURLResponse *)response
+{
+    if (_cancelled) {
+        return;
+    }
+
+    TIPGlobalConfiguration *config = [TIPGlobalConfiguration sharedInstance];
+    const UInt64 minimumBytes = config.parallelRangeDownloadMinimumBytes;
+    const UInt64 maxRangeCount = config.parallelRangeDownloadMaxRangeCount;
+    if (!minimumBytes || maxRangeCount < 2) {
+        return;
+    }
+
+    NSDictionary *headers = response.allHeaderFields;
+    NSString *acceptRanges = [headers tip_objectForCaseInsensitiveKey:@"Accept-Ranges"];
+    if ([acceptRanges compare:@"bytes" options:NSCaseInsensitiveSearch] != NSOrderedSame) {
+        return;
+    }
+
+    // byte ranges of an encoded body are not byte ranges of what is delivered
+    NSString *contentEncoding = [headers tip_objectForCaseInsensitiveKey:@"Content-Encoding"];
+    if (contentEncoding && [contentEncoding compare:@"identity" options:NSCaseInsensitiveSearch] != NSOrderedSame) {
+        return;
+    }
+
+    // the ranges must be of the same representation, a weak ETag cannot be used for If-Range
+    NSString *validator = [headers tip_objectForCaseInsensitiveKey:@"ETag"];
+    if (!validator || [validator hasPrefix:@"W/"]) {
+        validator = [headers tip_objectForCaseInsensitiveKey:@"Last-Modified"];
+    }
+    if (!validator) {
+        return;
+    }
+
+    // the body is either everything (200) or the remainder being resumed (206)
+    UInt64 start = 0;
+    UInt64 end = 0;
+    if (200 /* OK */ == response.statusCode) {
+        if (response.expectedContentLength <= 0) {
+            return;
+        }
+        end = (UInt64)response.expectedContentLength - 1;
+    } else if (206 /* Partial Content */ == response.statusCode) {
+        UInt64 total;
+        if (!_ParseContentRange([headers tip_objectForCaseInsensitiveKey:@"Content-Range"], &start, &end, &total) || end != (total - 1)) {
+            return;
+        }
+    } else {
+        return;
+    }
+
+    const UInt64 length = end - start + 1;
+    if (length < minimumBytes) {
+        return;
+    }
+    const UInt64 rangeCount = MIN(maxRangeCount, length / kParallelRangeMinimumRangeLength);
+    if (rangeCount < 2) {
+        return;
+    }
+
+    TIPLogDebug(@"Parallel range download with %llu ranges of %llu bytes, URL: %@", rangeCount, length, response.URL);
+
+    NSMutableArray<TIPImageFetchDownloadInternalRange *> *ranges = [[NSMutableArray alloc] initWithCapacity:(NSUInteger)rangeCount];
+    const UInt64 rangeLength = length / rangeCount;
+    for (UInt64 i = 0; i < rangeCount; i++) {
+        const UInt64 offset = start + (i * rangeLength);
+        const UInt64 thisRangeLength = (i == rangeCount - 1) ? (length - (i * rangeLength)) : rangeLength;
+        [ranges addObject:[[TIPImageFetchDownloadInternalRange alloc] initWithOffset:offset length:thisRangeLength]];
+    }
+
+    // the first range continues on the original task
+    TIPImageFetchDownloadInternalRange *firstRange = ranges.firstObject;
+    firstRange.task = _task;
+    firstRange.requestedOffset = start;
+    firstRange.attemptCount = 1;
+    firstRange.lastActivityTime = CFAbsoluteTimeGetCurrent();
+
+    _ranges = [ranges copy];
+    _rangeValidator = [validator copy];
+    _deliveringRangeIndex = 0;
+
+    for (NSUInteger i = 1; i < ranges.count; i++) {
+        if (![self _issueRange:ranges[i]]) {
+            [self _abandonRangesWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                              code:NSURLErrorBadURL
+                                                          userInfo:nil]];
+            return;
+        }
+    }
+
+    [self _scheduleStallCheck];
+}
+
+- (BOOL)_issueRange:(TIPImageFetchDownloadInternalRange *)range
+{
+    const UInt64 requestedOffset = range.offset + range.receivedLength;
+    NSMutableURLRequest *request = [_request mutableCopy];
+    if (!request) {
+        return NO;
+    }
+    [request setValue:[NSString stringWithFormat:@"bytes=%llu-%llu", requestedOffset, range.offset + range.length - 1]
+   forHTTPHeaderField:@"Range"];
+    [request setValue:_rangeValidator forHTTPHeaderField:@"If-Range"];
+
+    NSURLSessionDataTask *task = [_session dataTaskWithRequest:request];
+    task.priority = ConvertNSOperationQueuePriorityToNSURLSessionTaskPriority(_taskPriority);
+    range.task = task;
+    range.requestedOffset = requestedOffset;
+    range.attemptCount += 1;
+    range.lastActivityTime = CFAbsoluteTimeGetCurrent();
+    [(TIPImageFetchDownloadInternalURLSessionDelegate *)_session.delegate addDownload:self task:task];
+    if (!_tasksPaused) {
+        [task resume];
+    }
+    return YES;
+}
+
+- (nullable TIPImageFetchDownloadInternalRange *)_rangeForTask:(NSURLSessionTask *)task
+{
+    for (TIPImageFetchDownloadInternalRange *range in _ranges) {
+        if (range.task == task) {
+            return range;
+        }
+    }
+    return nil;
+}
+
+- (void)_completeRange:(TIPImageFetchDownloadInternalRange *)range
+{
+    // the original task keeps going past its range, stop it
+    NSURLSessionDataTask *task = range.task;
+    range.task = nil;
+    if (task) {
+        [self _stopRangeTask:task];
+    }
+
+    // deliver the following ranges in order, as far as they have been received
+    while (_deliveringRangeIndex < _ranges.count && _ranges[_deliveringRangeIndex].isComplete) {
+        _deliveringRangeIndex++;
+        if (_deliveringRangeIndex < _ranges.count) {
+            TIPImageFetchDownloadInternalRange *nextRange = _ranges[_deliveringRangeIndex];
+            NSData *bufferedData = nextRange.bufferedData;
+            nextRange.bufferedData = nil;
+            if (bufferedData.length) {
+                [self _deliverData:bufferedData];
+            }
+        }
+    }
+
+    if (_deliveringRangeIndex == _ranges.count) {
+        [self _finishRangesWithError:nil];
+    }
+}
+
+- (void)_retryRange:(TIPImageFetchDownloadInternalRange *)range
+              error:(nullable NSError *)error
+{
+    NSURLSessionDataTask *task = range.task;
+    range.task = nil;
+    if (task) {
+        [self _stopRangeTask:task];
+    }
+
+    if (range.attemptCount >= kParallelRangeMaxAttemptCount || ![self _issueRange:range]) {
+        [self _finishRangesWithError:error];
+        return;
+    }
+
+    TIPLogDebug(@"Parallel range download re-issued range at %llu (attempt %tu), error: %@", range.requestedOffset, range.attemptCount, error);
+}
+
+- (void)_abandonRangesWithError:(NSError *)error
+{
+    if (_rangesFinished) {
+        return;
+    }
+
+    // fall back to the original task when it has not been cut short yet
+    TIPImageFetchDownloadInternalRange *firstRange = _ranges.firstObject;
+    if (firstRange.task == _task && !firstRange.isComplete) {
+        for (NSUInteger i = 1; i < _ranges.count; i++) {
+            NSURLSessionDataTask *task = _ranges[i].task;
+            if (task) {
+                [self _stopRangeTask:task];
+            }
+        }
+        _ranges = nil;
+        _rangeValidator = nil;
+        return;
+    }
+
+    [self _finishRangesWithError:error];
+}
+
+- (void)_finishRangesWithError:(nullable NSError *)error
+{
+    if (_rangesFinished) {
+        return;
+    }
+    _rangesFinished = YES;
+
+    for (TIPImageFetchDownloadInternalRange *range in _ranges) {
+        NSURLSessionDataTask *task = range.task;
+        range.task = nil;
+        range.bufferedData = nil;
+        if (task) {
+            [self _stopRangeTask:task];
+        }
+    }
+
+    if (!error && _task.state != NSURLSessionTaskStateCompleted) {
+        // wait on the original task so that its metrics are there on completion
+        _rangesAwaitingOriginalTask = YES;
+        return;
+    }
+
+    // everything delivered so far is contiguous, so a failure can still be resumed from
+    [self _deliverCompletionWithError:error];
+}
+
+- (void)_stopRangeTask:(NSURLSessionDataTask *)task
+{
+    // the original task stays registered, for its metrics and its completion
+    if (task != _task) {
+        [(TIPImageFetchDownloadInternalURLSessionDelegate *)_session.delegate removeDownloadWithTask:task];
+    }
+    if (task.state == NSURLSessionTaskStateRunning || task.state == NSURLSessionTaskStateSuspended) {
+        [task cancel];
+    }
+}
+
+- (void)_scheduleStallCheck
+{
+    __weak typeof(self) weakSelf = self;
+    NSOperationQueue *delegateQueue = _session.delegateQueue;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kParallelRangeStallTimeout / 2 * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [delegateQueue addOperationWithBlock:^{
+            [weakSelf _checkForStalledRanges];
+        }];
+    });
+}
+
+- (void)_checkForStalledRanges
+{
+    if (!_ranges || _rangesFinished) {
+        return;
+    }
+
+    if (_tasksPaused) {
+        // nothing is expected to arrive while paused
+        [self _scheduleStallCheck];
+        return;
+    }
+
+    const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    for (TIPImageFetchDownloadInternalRange *range in _ranges) {
+        if (!range.isComplete && (now - range.lastActivityTime) > kParallelRangeStallTimeout) {
+            [self _retryRange:range
+                        error:[NSError errorWithDomain:NSURLErrorDomain
+                                                  code:NSURLErrorTimedOut
+                                              userInfo:nil]];
+            if (_rangesFinished) {
+                return;
+            }
+        }
+    }
+
+    [self _scheduleStallCheck];
+}
+
+#pragma mark Hedging
+
+- (void)_scheduleHedgeCheck
+{
+    TIPGlobalConfiguration *config = [TIPGlobalConfiguration sharedInstance];
+    const float percentile = config.hedgedDownloadPercentile;
+    if (percentile <= 0) {
+        return;
+    }
+
+    const NSTimeInterval delay = _HedgeDelay(percentile, config.hedgedDownloadMinimumDelay);
+    __weak typeof(self) weakSelf = self;
+    NSOperationQueue *delegateQueue = _session.delegateQueue;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [delegateQueue addOperationWithBlock:^{
+            [weakSelf _hedgeIfNeeded];
+        }];
+    });
+}
+
+- (void)_hedgeIfNeeded
+{
+    if (_cancelled || _responseReceived || _hedgeTask || _ranges || _task.state != NSURLSessionTaskStateRunning) {
+        return;
+    }
+
+    // prefetches can wait
+    if (_taskPriority <= NSOperationQueuePriorityLow) {
+        return;
+    }
+
+    // always allow one hedge so that the budget does not block hedging until there are many downloads
+    const float budget = [TIPGlobalConfiguration sharedInstance].hedgedDownloadBudget;
+    if ((double)sHedgeCount >= ((double)budget * (double)sHedgeDownloadCount) + 1.0) {
+        return;
+    }
+
+    NSURLSessionDataTask *hedgeTask = [_session dataTaskWithRequest:_request];
+    hedgeTask.priority = ConvertNSOperationQueuePriorityToNSURLSessionTaskPriority(_taskPriority);
+    _hedgeTask = hedgeTask;
+    _hedgeStartTime = CFAbsoluteTimeGetCurrent();
+    sHedgeCount++;
+    [(TIPImageFetchDownloadInternalURLSessionDelegate *)_session.delegate addDownload:self task:hedgeTask];
+    [hedgeTask resume];
+
+    tip_dispatch_async_autoreleasing(self.contextQueue, ^{
+        self.didHedgeRequest = YES;
+    });
+    TIPLogDebug(@"Hedged download after %.3fs without a response, URL: %@", _hedgeStartTime - _taskStartTime, _request.URL);
+}
+
+- (void)_resolveHedgeWithWinningTask:(NSURLSessionTask *)task
+{
+    _hedgeWon = (task == _hedgeTask);
+    if (!_tasksWerePaused) {
+        _RecordTimeToFirstResponse(CFAbsoluteTimeGetCurrent() - ((_hedgeWon) ? _hedgeStartTime : _taskStartTime));
+    }
+
+    // the loser is forgotten so that only the winner delivers its data, metrics and completion
+    NSURLSessionDataTask *losingTask = (_hedgeWon) ? _task : _hedgeTask;
+    [(TIPImageFetchDownloadInternalURLSessionDelegate *)_session.delegate removeDownloadWithTask:losingTask];
+    [losingTask cancel];
+
+    if (_hedgeWon) {
+        TIPLogDebug(@"Hedged download won, URL: %@", _request.URL);
+        tip_dispatch_async_autoreleasing(self.contextQueue, ^{
+            self.hedgedRequestWon = YES;
+        });
+    } else {
+        _hedgeTask = nil;
+    }
+}
+
+#pragma mark Pausing
+
+- (void)_updateTasksPaused:(BOOL)paused
+{
+    if (_tasksPaused == paused || _completionDelivered) {
+        return;
+    }
+    _tasksPaused = paused;
+    const CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    if (paused) {
+        // time spent paused would skew the times to first response
+        _tasksWerePaused = YES;
+        _activeDuration += now - _activeStartTime;
+    } else {
+        _activeStartTime = now;
+        [self _scheduleResourceTimeout];
+    }
+
+    NSMutableArray<NSURLSessionDataTask *> *tasks = [[NSMutableArray alloc] init];
+    if (_task) {
+        [tasks addObject:_task];
+    }
+    if (_hedgeTask) {
+        [tasks addObject:_hedgeTask];
+    }
+    for (TIPImageFetchDownloadInternalRange *range in _ranges) {
+        if (range.task && range.task != _task) {
+            [tasks addObject:range.task];
+        }
+        // the stall timeout restarts
+        range.lastActivityTime = now;
+    }
+
+    for (NSURLSessionDataTask *task in tasks) {
+        if (paused && task.state == NSURLSessionTaskStateRunning) {
+            [task suspend];
+        } else if (!paused && task.state == NSURLSessionTaskStateSuspended) {
+            [task resume];
+        }
+    }
+
+    TIPLogDebug(@"%@ download, URL: %@", (paused) ? @"Paused" : @"Resumed", _request.URL);
+}
+
+- (void)_scheduleResourceTimeout
+{
+    // a newer schedule (on resuming) supersedes any earlier one
+    const NSUInteger generation = ++_resourceTimeoutGeneration;
+    const NSTimeInterval remaining = MAX(kResourceTimeout - _activeDuration, 0.0);
+    __weak typeof(self) weakSelf = self;
+    NSOperationQueue *delegateQueue = _session.delegateQueue;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(remaining * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [delegateQueue addOperationWithBlock:^{
+            [weakSelf _checkResourceTimeoutOfGeneration:generation];
+        }];
+    });
+}
+
+- (void)_checkResourceTimeoutOfGeneration:(NSUInteger)generation
+{
+    if (generation != _resourceTimeoutGeneration || _tasksPaused || _completionDelivered) {
+        // resuming schedules a new check
+        return;
+    }
+
+    if (_rangesAwaitingOriginalTask) {
+        // everything has been received, only the original task's metrics are pending
+        return;
+    }
+
+    const NSTimeInterval activeDuration = _activeDuration + (CFAbsoluteTimeGetCurrent() - _activeStartTime);
+    if (activeDuration < kResourceTimeout) {
+        _activeDuration = activeDuration;
+        _activeStartTime = CFAbsoluteTimeGetCurrent();
+        [self _scheduleResourceTimeout];
+        return;
+    }
+
+    TIPLogWarning(@"Download timed out after %.0fs of loading, URL: %@", activeDuration, _request.URL);
+    NSError *error = [NSError errorWithDomain:NSURLErrorDomain
+                                         code:NSURLErrorTimedOut
+                                     userInfo:nil];
+    [_hedgeTask cancel];
+    if (_ranges) {
+        [self _finishRangesWithError:error];
+        return;
+    }
+
+    // the task's completion is ignored once this completion is delivered
+    [_task cancel];
+    [self _deliverCompletionWithError:error];
+}
+
+#pragma mark Delivery
+
+- (void)_deliverData:(NSData *)data
+{
+    tip_dispatch_async_autoreleasing(self.contextQueue, ^{
+        [self.context.client imageFetchDownload:self
+                                 didReceiveData:data];
+    });
+}
+
+- (void)_deliverCompletionWithError:(nullable NSError *)error
+{
+    if (_completionDelivered) {
+        return;
+    }
+    _completionDelivered = YES;
+
+    tip_dispatch_async_autoreleasing(self.contextQueue, ^{
+        [self.context.client imageFetchDownload:self
+                           didCompleteWithError:error];
+    });
 }
 
 #pragma mark Private
@@ -175,7 +950,7 @@ static void _PrepareGlobalState(void)
         config.HTTPCookieAcceptPolicy = NSHTTPCookieAcceptPolicyNever;
         config.HTTPShouldSetCookies = NO;
         config.URLCache = nil;
-        config.timeoutIntervalForResource = 60 * 3;
+        config.timeoutIntervalForResource = kSessionResourceTimeout;
 
         sTIPImageFetchDownloadInternalURLSession = [NSURLSession sessionWithConfiguration:config
                                                                                  delegate:sTIPImageFetchDownloadInternalURLSessionDelegate
@@ -184,6 +959,11 @@ static void _PrepareGlobalState(void)
 }
 
 - (NSURLSession *)URLSession
+{
+    return [TIPImageFetchDownloadInternal defaultURLSession];
+}
+
++ (NSURLSession *)defaultURLSession
 {
     if (nil == (__bridge void *)sTIPImageFetchDownloadInternalURLSession) {
         _PrepareGlobalState();
@@ -192,6 +972,24 @@ static void _PrepareGlobalState(void)
     return sTIPImageFetchDownloadInternalURLSession;
 }
 
++ (void)preconnectToURLs:(NSArray<NSURL *> *)URLs
+                 session:(NSURLSession *)session
+{
+    // a HEAD request (for the preconnect path of TIPGlobalConfiguration) is the cheapest way to have
+    // the session set up a connection it will then pool, but it is a real request the host sees.
+    // The session delegate ignores tasks it does not know of.
+    for (NSURL *URL in URLs) {
+        NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:URL
+                                                               cachePolicy:NSURLRequestReloadIgnoringLocalCacheData
+                                                           timeoutInterval:kPreconnectTimeout];
+        request.HTTPMethod = @"HEAD";
+        NSURLSessionDataTask *task = [session dataTaskWithRequest:request];
+        task.priority = NSURLSessionTaskPriorityLow;
+        [task resume];
+        TIPLogDebug(@"Preconnecting to %@", URL);
+    }
+}
+
 @end
 
 @implementation TIPImageFetchDownloadInternalURLSessionDelegate
@@ -208,11 +1006,12 @@ static void _PrepareGlobalState(void)
 }
 
 - (void)addDownload:(TIPImageFetchDownloadInternal *)download
+               task:(NSURLSessionDataTask *)task
 {
-    [_downloadContexts setObject:download forKey:@(download.task.taskIdentifier)];
+    [_downloadContexts setObject:download forKey:@(task.taskIdentifier)];
 }
 
-- (void)removeDownloadWithTask:(NSURLSessionDataTask *)task
+- (void)removeDownloadWithTask:(NSURLSessionTask *)task
 {
     [_downloadContexts removeObjectForKey:@(task.taskIdentifier)];
 }
@@ -225,13 +1024,12 @@ didReceiveResponse:(NSURLResponse *)response
  completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
 {
     TIPImageFetchDownloadInternal *download = [_downloadContexts objectForKey:@(dataTask.taskIdentifier)];
+    NSURLSessionResponseDisposition disposition = NSURLSessionResponseAllow;
     if (download) {
-        tip_dispatch_async_autoreleasing(download.contextQueue, ^{
-            [download.context.client imageFetchDownload:download
-                                  didReceiveURLResponse:(NSHTTPURLResponse *)response];
-        });
+        disposition = [download _task:dataTask
+                   didReceiveResponse:(NSHTTPURLResponse *)response];
     }
-    completionHandler(NSURLSessionResponseAllow);
+    completionHandler(disposition);
 }
 
 - (void)URLSession:(NSURLSession *)session
@@ -240,10 +1038,8 @@ didReceiveResponse:(NSURLResponse *)response
 {
     TIPImageFetchDownloadInternal *download = [_downloadContexts objectForKey:@(dataTask.taskIdentifier)];
     if (download) {
-        tip_dispatch_async_autoreleasing(download.contextQueue, ^{
-            [download.context.client imageFetchDownload:download
-                                         didReceiveData:data];
-        });
+        [download _task:dataTask
+         didReceiveData:data];
     }
 }
 
@@ -253,11 +1049,9 @@ didReceiveResponse:(NSURLResponse *)response
 {
     TIPImageFetchDownloadInternal *download = [_downloadContexts objectForKey:@(task.taskIdentifier)];
     if (download) {
-        tip_dispatch_async_autoreleasing(download.contextQueue, ^{
-            [download.context.client imageFetchDownload:download
-                                   didCompleteWithError:error];
-        });
         [_downloadContexts removeObjectForKey:@(task.taskIdentifier)];
+        [download _task:task
+   didCompleteWithError:error];
     }
 }
 
@@ -275,6 +1069,24 @@ didReceiveResponse:(NSURLResponse *)response
 
 @end
 
+@implementation TIPImageFetchDownloadInternalRange
+
+- (instancetype)initWithOffset:(UInt64)offset length:(UInt64)length
+{
+    if (self = [super init]) {
+        _offset = offset;
+        _length = length;
+    }
+    return self;
+}
+
+- (BOOL)isComplete
+{
+    return _receivedLength == _length;
+}
+
+@end
+
 @implementation NSHTTPURLResponse (TIPStubbingSupport)
 
 + (instancetype)tip_responseWithRequestURL:(NSURL *)requestURL
@@ -313,4 +1125,64 @@ static float ConvertNSOperationQueuePriorityToNSURLSessionTaskPriority(NSOperati
     return taskPri;
 }
 
+static BOOL _ParseContentRange(NSString * __nullable contentRange,
+                               UInt64 *startOut,
+                               UInt64 *endOut,
+                               UInt64 *totalOut)
+{
+    // "bytes <start>-<end>/<total>"
+    if (!contentRange) {
+        return NO;
+    }
+
+    NSScanner *scanner = [NSScanner scannerWithString:contentRange];
+    unsigned long long start, end, total;
+    if (![scanner scanString:@"bytes" intoString:NULL] ||
+        ![scanner scanUnsignedLongLong:&start] ||
+        ![scanner scanString:@"-" intoString:NULL] ||
+        ![scanner scanUnsignedLongLong:&end] ||
+        ![scanner scanString:@"/" intoString:NULL] ||
+        ![scanner scanUnsignedLongLong:&total]) {
+        return NO;
+    }
+    if (end < start || end >= total) {
+        return NO;
+    }
+
+    *startOut = start;
+    *endOut = end;
+    *totalOut = total;
+    return YES;
+}
+
+static void _RecordTimeToFirstResponse(NSTimeInterval duration)
+{
+    sHedgeSamples[sHedgeSampleIndex] = duration;
+    sHedgeSampleIndex = (sHedgeSampleIndex + 1) % kHedgeSampleCapacity;
+    if (sHedgeSampleCount < kHedgeSampleCapacity) {
+        sHedgeSampleCount++;
+    }
+}
+
+static NSTimeInterval _HedgeDelay(float percentile,
+                                  NSTimeInterval minimumDelay)
+{
+    if (sHedgeSampleCount < kHedgeMinimumSampleCount) {
+        return minimumDelay;
+    }
+
+    NSTimeInterval samples[kHedgeSampleCapacity];
+    memcpy(samples, sHedgeSamples, sizeof(NSTimeInterval) * sHedgeSampleCount);
+    qsort(samples, sHedgeSampleCount, sizeof(NSTimeInterval), _CompareTimeIntervals);
+    const NSUInteger index = MIN((NSUInteger)(percentile * sHedgeSampleCount), sHedgeSampleCount - 1);
+    return MAX(minimumDelay, samples[index]);
+}
+
+static int _CompareTimeIntervals(const void *a, const void *b)
+{
+    const NSTimeInterval timeA = *(const NSTimeInterval *)a;
+    const NSTimeInterval timeB = *(const NSTimeInterval *)b;
+    return (timeA > timeB) - (timeA < timeB);
+}
+
 NS_ASSUME_NONNULL_END
@@ -106,6 +106,10 @@ typedef NS_ENUM(NSInteger, TIPImageFetchLoadResult){
 @property (nonatomic, readonly) CGSize networkImageDimensions;
 /** The pixels per byte ratio (larger indicates more compressed encoding) */
 @property (nonatomic, readonly) float networkImagePixelsPerByte;
+/** A duplicate (hedged) request was issued because the network download was slow to respond */
+@property (nonatomic, readonly) BOOL networkRequestWasHedged;
+/** The hedged request responded first and was the one used */
+@property (nonatomic, readonly) BOOL networkHedgedRequestWon;
 
 @end
 
@@ -23,6 +23,8 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, copy, readonly, nullable) NSString *networkImageType;
 @property (nonatomic, readonly) CGSize networkImageDimensions;
 @property (nonatomic, readonly) float networkImagePixelsPerByte;
+@property (nonatomic, readonly) BOOL networkRequestWasHedged;
+@property (nonatomic, readonly) BOOL networkHedgedRequestWon;
 @end
 
 @implementation TIPImageFetchMetrics
@@ -192,6 +194,15 @@ NS_ASSUME_NONNULL_BEGIN
                                         imageDimensions:dimensions];
 }
 
+- (void)networkRequestWasHedged:(BOOL)hedgedRequestWon
+{
+    if (_flags.wasCancelled || !_flags.isTrackingCurrentSource) {
+        return;
+    }
+
+    [_infos[_flags.currentSource - 1] networkRequestWasHedged:hedgedRequestWon];
+}
+
 - (void)previewWasHit:(NSTimeInterval)renderLatency
 {
     [self _hit:TIPImageFetchLoadResultHitPreview
@@ -399,6 +410,20 @@ NS_ASSUME_NONNULL_BEGIN
     }
 }
 
+- (void)networkRequestWasHedged:(BOOL)hedgedRequestWon
+{
+    if (_flags.wasCancelled) {
+        return;
+    }
+
+    if (_source != TIPImageLoadSourceNetwork && _source != TIPImageLoadSourceNetworkResumed) {
+        return;
+    }
+
+    _networkRequestWasHedged = YES;
+    _networkHedgedRequestWon = hedgedRequestWon;
+}
+
 - (float)networkImagePixelsPerByte
 {
     if (_networkImageSizeInBytes > 0 && _networkImageDimensions.height > 0 && _networkImageDimensions.width > 0) {
@@ -474,6 +499,7 @@ NS_ASSUME_NONNULL_BEGIN
 
     NSString *pixelsPerByte = @"";
     NSString *imageType = @"";
+    NSString *hedged = @"";
     if (_source == TIPImageLoadSourceNetwork || _source == TIPImageLoadSourceNetworkResumed) {
         if (_networkImageType) {
             imageType = [NSString stringWithFormat:@" %@", _networkImageType];
@@ -482,9 +508,12 @@ NS_ASSUME_NONNULL_BEGIN
         if (pixelsPerByteFloat > FLT_EPSILON) {
             pixelsPerByte = [NSString stringWithFormat:@" pixelsPerByte=%.3f", pixelsPerByteFloat];
         }
+        if (_networkRequestWasHedged) {
+            hedged = (_networkHedgedRequestWon) ? @" hedged=won" : @" hedged=lost";
+        }
     }
 
-    return [NSString stringWithFormat:@"%@ : %@=%.3fs%@%@%@%@", source, result, duration, renderLatency, firstResult, pixelsPerByte, imageType];
+    return [NSString stringWithFormat:@"%@ : %@=%.3fs%@%@%@%@%@", source, result, duration, renderLatency, firstResult, pixelsPerByte, imageType, hedged];
 }
 
 @end
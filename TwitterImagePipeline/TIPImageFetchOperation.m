@@ -70,6 +70,8 @@ static NSQualityOfService ConvertNSOperationQueuePriorityToQualityOfService(NSOp
 @property (atomic, nullable, copy) NSString *imageDownloadLastModified;
 @property (atomic, nullable) TIPPartialImage *imageDownloadPartialImageForResuming;
 @property (atomic, nullable) TIPImageDiskCacheTemporaryFile *imageDownloadTemporaryFileForResuming;
+@property (atomic, nullable, copy) NSString *imageDownloadRevalidationETag;
+@property (atomic, nullable, copy) NSString *imageDownloadRevalidationLastModified;
 @property (nonatomic) NSOperationQueuePriority imageDownloadPriority;
 
 // init
@@ -197,6 +199,8 @@ TIP_OBJC_DIRECT_MEMBERS
 - (void)_background_handleCompletedMemoryEntry:(TIPImageMemoryCacheEntry *)entry;
 - (void)_background_handlePartialMemoryEntry:(TIPImageMemoryCacheEntry *)entry;
 - (void)_background_handleCompletedDiskEntry:(TIPImageDiskCacheEntry *)entry;
+- (BOOL)_background_revalidateStaleDiskEntry:(TIPImageDiskCacheEntry *)entry;
+- (void)_background_startBackgroundRevalidation;
 - (void)_background_handlePartialDiskEntry:(TIPImageDiskCacheEntry *)entry
         tryOtherPipelineDiskCachesIfNeeded:(BOOL)tryOtherPipelineDiskCachesIfNeeded;
 
@@ -287,6 +291,7 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
     // Network
     TIPImageFetchOperationNetworkStepContext *_networkContext;
     NSUInteger _progressiveRenderCount;
+    TIPImageDiskCacheEntry *_staleDiskEntry; // being revalidated
 
     // Priority
     NSOperationQueuePriority _enqueuedPriority;
@@ -312,6 +317,7 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
         BOOL previewImageWasTransformed:1;
         BOOL finalImageWasTransformed:1;
         BOOL shouldSkipRenderedCacheStore:1;
+        BOOL isBackgroundRevalidation:1;
     } _flags;
 }
 
@@ -663,6 +669,7 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
     _metrics = _metricsInternal;
     _metricsInternal = nil;
     _finishTime = mach_absolute_time();
+    [_imagePipeline recordFirstImageLoadWithSource:TIPImageLoadSourceMemoryCache];
 
     TIPAssert(finalResult != nil);
     if (finalResult && [delegate respondsToSelector:@selector(tip_imageFetchOperation:didLoadFinalImage:)]) {
@@ -707,6 +714,14 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
     _enqueueTime = mach_absolute_time();
 }
 
+- (void)prepareForBackgroundRevalidation
+{
+    TIPAssert(!_flags.wasEnqueued);
+    _flags.isBackgroundRevalidation = 1;
+    // the stale image is what the memory caches have, go to the disk cache (for the validators)
+    _loadingSources &= ~(TIPImageFetchLoadingSourceMemoryCache | TIPImageFetchLoadingSourceAdditionalCache);
+}
+
 - (BOOL)supportsLoadingFromRenderedCache
 {
     if (_transformer && !_transfomerIdentifier) {
@@ -873,6 +888,8 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
         error:(nullable NSError *)error
 {
     const BOOL wasResuming = (_networkContext.imageDownloadRequest.imageDownloadPartialImageForResuming != nil);
+    TIPImageDiskCacheEntry *staleEntry = _staleDiskEntry;
+    _staleDiskEntry = nil;
     [self _background_clearNetworkContextVariables];
     _networkContext.imageDownloadContext = nil;
 
@@ -882,6 +899,9 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
                               imageType:imageType
                        imageSizeInBytes:bytes
                         imageDimensions:(image) ? image.dimensions : partialImage.dimensions];
+    if ([download respondsToSelector:@selector(didHedgeRequest)] && download.didHedgeRequest) {
+        [_metricsInternal networkRequestWasHedged:[download respondsToSelector:@selector(hedgedRequestWon)] && download.hedgedRequestWon];
+    }
 
     if (partialImage && !image) {
         [self _background_propagatePartialImage:partialImage
@@ -911,6 +931,21 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
                           networkImageType:imageType
                           networkByteCount:bytes
                                placeholder:placeholder];
+    } else if (staleEntry) {
+        // revalidated (or could not revalidate), serve the cached image
+        if (304 /* Not Modified */ == statusCode) {
+            [_imagePipeline.diskCache revalidateImageWithIdentifier:self.imageIdentifier];
+        } else {
+            TIPLogWarning(@"Could not revalidate stale image (%@), serving it anyway: %@", error, self.imageURL);
+        }
+        [self _background_updateFinalImage:staleEntry.completeImage
+                                 imageData:staleEntry.completeImageData // ok if nil
+                             renderLatency:0
+                                       URL:staleEntry.completeImageContext.URL
+                                loadSource:TIPImageLoadSourceDiskCache
+                          networkImageType:nil
+                          networkByteCount:0
+                               placeholder:staleEntry.completeImageContext.treatAsPlaceholder];
     } else {
         TIPAssert(error != nil);
 
@@ -948,7 +983,7 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
     context.treatAsPlaceholder = placeholder;
     context.TTL = _networkContext.imageDownloadRequest.imageDownloadTTL;
     context.URL = imageURL;
-    context.lastAccess = [NSDate date];
+    context.lastAccess = CFAbsoluteTimeGetCurrent();
     if (context.TTL <= 0.0) {
         context.TTL = TIPTimeToLiveDefault;
     }
@@ -1111,6 +1146,8 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
     _networkContext.imageDownloadRequest.imageDownloadPartialImageForResuming = nil;
     _networkContext.imageDownloadRequest.imageDownloadLastModified = nil;
     _networkContext.imageDownloadRequest.imageDownloadTemporaryFileForResuming = nil;
+    _networkContext.imageDownloadRequest.imageDownloadRevalidationETag = nil;
+    _networkContext.imageDownloadRequest.imageDownloadRevalidationLastModified = nil;
     _progressiveRenderCount = 0;
 }
 
@@ -1224,6 +1261,7 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
                                                                          targetDimensions:_targetDimensions
                                                                         targetContentMode:_targetContentMode
                                                                          decoderConfigMap:_decoderConfigMap];
+    [_imagePipeline recordLookupOfCacheType:TIPImageCacheTypeMemory hit:(entry.completeImage != nil)];
     [self _background_handleCompletedMemoryEntry:entry];
 }
 
@@ -1245,6 +1283,7 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
                                              targetDimensions:_targetDimensions
                                             targetContentMode:_targetContentMode
                                              decoderConfigMap:_decoderConfigMap];
+    [_imagePipeline recordLookupOfCacheType:TIPImageCacheTypeDisk hit:(entry.completeImageContext != nil)];
     [self _background_handleCompletedDiskEntry:entry];
 }
 
@@ -1446,6 +1485,7 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
         return;
     }
 
+    [_imagePipeline recordFirstImageLoadWithSource:source];
     [self _background_executeDelegateWork:^(id<TIPImageFetchDelegate> delegate){
         if ([delegate respondsToSelector:@selector(tip_imageFetchOperation:didLoadFinalImage:)]) {
             [delegate tip_imageFetchOperation:self didLoadFinalImage:finalResult];
@@ -1803,6 +1843,10 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
                 TIPImageContainer *image = entry.completeImage;
                 if (image) {
                     if (isFinal) {
+                        if ([self _background_revalidateStaleDiskEntry:entry]) {
+                            return;
+                        }
+
                         [self _background_updateFinalImage:image
                                                  imageData:entry.completeImageData // ok if nil
                                              renderLatency:0
@@ -1828,6 +1872,43 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
           tryOtherPipelineDiskCachesIfNeeded:YES];
 }
 
+- (BOOL)_background_revalidateStaleDiskEntry:(TIPImageDiskCacheEntry *)entry
+{
+    TIPCompleteImageEntryContext *context = entry.completeImageContext;
+    if (![context isStaleAsOf:CFAbsoluteTimeGetCurrent()] || ![context hasValidators]) {
+        return NO;
+    }
+
+    const TIPImageRevalidationMode mode = [TIPGlobalConfiguration sharedInstance].imageRevalidationMode;
+    if (TIPImageRevalidationModeOff == mode || ![self supportsLoadingFromSource:TIPImageLoadSourceNetwork]) {
+        // serve it stale
+        return NO;
+    }
+
+    if (TIPImageRevalidationModeStaleWhileRevalidate == mode && !_flags.isBackgroundRevalidation) {
+        [self _background_startBackgroundRevalidation];
+        return NO;
+    }
+
+    // jump to the network with a conditional request, the stale image is served on a 304
+    _staleDiskEntry = entry;
+    _networkContext.imageDownloadRequest.imageDownloadRevalidationETag = context.ETag;
+    _networkContext.imageDownloadRequest.imageDownloadRevalidationLastModified = context.lastModified;
+    _flags.shouldJumpToResumingDownload = 1;
+    [self _background_loadFromNextSource];
+    return YES;
+}
+
+- (void)_background_startBackgroundRevalidation
+{
+    TIPImageFetchOperation *op = [_imagePipeline operationWithRequest:_request
+                                                              context:nil
+                                                             delegate:nil];
+    [op prepareForBackgroundRevalidation];
+    op.priority = NSOperationQueuePriorityVeryLow;
+    [_imagePipeline fetchImageWithOperation:op];
+}
+
 - (void)_background_handlePartialDiskEntry:(TIPImageDiskCacheEntry *)entry
         tryOtherPipelineDiskCachesIfNeeded:(BOOL)tryOtherPipelineDiskCachesIfNeeded
 {
@@ -2203,7 +2284,8 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
                 if (imageData && !entry.completeImageData) {
                     entry.completeImageData = imageData;
                 }
-                [_imagePipeline.memoryCache updateImageEntry:entry forciblyReplaceExisting:NO];
+                // a background revalidation replaces the stale image that was served from memory
+                [_imagePipeline.memoryCache updateImageEntry:entry forciblyReplaceExisting:_flags.isBackgroundRevalidation];
                 if (TIPImageLoadSourceNetwork == source || TIPImageLoadSourceNetworkResumed == source) {
                     [_imagePipeline postCompletedEntry:entry manual:NO];
                     // the network will have already transitioned the disk entry to the disk cache
@@ -2287,14 +2369,14 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
     TIPImageDiskCache *nextDiskCache = nextPipeline.diskCache;
     if (nextDiskCache) {
 
-        // pull out the on disk path to the desired entry if available
+        // pull out the encoded bytes of the desired entry if available
         TIPCompleteImageEntryContext *context = nil;
-        NSString *filePath = [nextDiskCache diskCache_imageEntryFilePathForIdentifier:self.imageIdentifier
-                                                             hitShouldMoveEntryToHead:NO
-                                                                              context:&context];
+        NSData *data = [nextDiskCache diskCache_imageEntryDataForIdentifier:self.imageIdentifier
+                                                   hitShouldMoveEntryToHead:NO
+                                                                    context:&context];
 
         // only accept an exact match (URLs are equal)
-        if (filePath && [context.URL isEqual:self.imageURL]) {
+        if (data && [context.URL isEqual:self.imageURL]) {
 
             // pull out our pipeline's disk cache
             TIPImageDiskCache *thisDiskCache = _imagePipeline.diskCache;
@@ -2303,7 +2385,7 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
             const TIPImageFetchOptions options = _networkContext.imageDownloadRequest.imageDownloadOptions;
             context.updateExpiryOnAccess = TIP_BITMASK_EXCLUDES_FLAGS(options, TIPImageFetchDoNotResetExpiryOnAccess);
             context.TTL = _networkContext.imageDownloadRequest.imageDownloadTTL;
-            context.lastAccess = [NSDate date];
+            context.lastAccess = CFAbsoluteTimeGetCurrent();
             if (context.TTL <= 0.0) {
                 context.TTL = TIPTimeToLiveDefault;
             }
@@ -2313,9 +2395,9 @@ TIPStaticAssert(sizeof(TIPImageFetchOperationState_Unaligned_AtomicT) == sizeof(
             TIPImageCacheEntry *entry = [[TIPImageCacheEntry alloc] init];
             entry.identifier = self.imageIdentifier;
             entry.completeImageContext = context;
-            entry.completeImageFilePath = filePath;
+            entry.completeImageData = data;
 
-            // store the entry (via file path) to disk cache
+            // store the entry (via data) to disk cache
             [thisDiskCache diskCache_updateImageEntry:entry
                               forciblyReplaceExisting:!context.treatAsPlaceholder];
 
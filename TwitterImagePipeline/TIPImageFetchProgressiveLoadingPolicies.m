@@ -18,12 +18,14 @@ NSDictionary<NSString *, id<TIPImageFetchProgressiveLoadingPolicy>> *TIPImageFet
 #if __LP64__
         // fast
         sDefaultPolicies = @{
-                             TIPImageTypeJPEG : [[TIPFullFrameProgressiveLoadingPolicy alloc] init]
+                             TIPImageTypeJPEG : [[TIPFullFrameProgressiveLoadingPolicy alloc] init],
+                             TIPImageTypeJXL : [[TIPFullFrameProgressiveLoadingPolicy alloc] init]
                              };
 #else
         // slow
         sDefaultPolicies = @{
-                             TIPImageTypeJPEG : [[TIPFirstAndLastFrameProgressiveLoadingPolicy alloc] init]
+                             TIPImageTypeJPEG : [[TIPFirstAndLastFrameProgressiveLoadingPolicy alloc] init],
+                             TIPImageTypeJXL : [[TIPFirstAndLastFrameProgressiveLoadingPolicy alloc] init]
                              };
 #endif
     });
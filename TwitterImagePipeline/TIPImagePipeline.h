@@ -157,6 +157,27 @@ FOUNDATION_EXTERN NSString * const TIPImagePipelineImageTreatAsPlaceholderNofiti
  */
 @property (atomic, nullable) id<TIPImagePipelineObserver> observer;
 
+/**
+ The weight of this _pipeline_'s share of the global cache budgets (such as
+ `TIPGlobalConfiguration.maxBytesForAllMemoryCaches`) relative to the other pipelines.
+ A _pipeline_ may borrow the unused share of other pipelines, but when the caches are pruned,
+ entries are evicted from whichever _pipeline_ is the most over its weighted share first.
+ So a _pipeline_ that stays within its share is guaranteed to keep its entries when a busier
+ _pipeline_ is filling the caches.
+ Values `<= 0` are treated as the default.  Default == `1.0`
+ */
+@property (atomic) double cacheShareWeight;
+
+/**
+ The portion of this _pipeline_'s weighted share (see `cacheShareWeight`) of the global cache
+ budgets that is reserved for it.  Pruning never evicts from a cache of this _pipeline_ while that
+ cache is within its reservation, no matter how busy the other pipelines are.
+ Since every reservation is a portion of a fair share, all reservations together never exceed the
+ global budgets.
+ Values are clamped to `[0.0, 1.0]`.  Default == `0.0` (nothing reserved)
+ */
+@property (atomic) double cacheShareReservedRatio;
+
 /** The identifier of the _pipeline_.  __See Also:__ `initWithIdentifier:` */
 @property (nonatomic, readonly, copy) NSString *identifier;
 
@@ -6,6 +6,8 @@
 //  Copyright (c) 2015 Twitter, Inc. All rights reserved.
 //
 
+#include <stdatomic.h>
+
 #import "TIP_Project.h"
 #import "TIPError.h"
 #import "TIPFileUtils.h"
@@ -15,11 +17,13 @@
 #import "TIPImageFetchDelegate.h"
 #import "TIPImageFetchOperation+Project.h"
 #import "TIPImageFetchRequest.h"
+#import "TIPImageHotSet.h"
 #import "TIPImageMemoryCache.h"
 #import "TIPImagePipeline+Project.h"
 #import "TIPImagePipelineInspectionResult+Project.h"
 #import "TIPImageRenderedCache.h"
 #import "TIPImageStoreAndMoveOperations.h"
+#import "TIPTiming.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -37,6 +41,8 @@ NSString * const TIPImagePipelineImageTreatAsPlaceholderNofiticationKey = @"trea
 
 static NSString * const kImagePipelineFolderName = @"TIPImagePipeline";
 
+#define CACHE_TYPE_COUNT (3)
+
 #define TIPRegisterAssertMessage(expression, format, ...) \
 do { \
     if (TIPShouldAssertDuringPipelineRegistation()) { \
@@ -69,6 +75,8 @@ static BOOL TIPRegisterImagePipelineWithIdentifier(TIPImagePipeline *pipeline, N
 static void TIPUnregisterImagePipelineWithIdentifier(NSString *identifier);
 static NSString * TIPImagePipelinePath(void) __attribute__((const));
 static NSString * __nullable TIPOpenImagePipelineWithIdentifier(NSString *identifier);
+static NSString *TIPImagePipelineHotSetDirectoryPath(void);
+static NSString *TIPImagePipelineHotSetPath(NSString *identifier);
 static NSDictionary *TIPCopyAllRegisteredImagePipelines(void);
 static void TIPEnqueueOperation(TIPImageFetchOperation *operation);
 static void TIPFireFetchCompletionBlock(TIPImagePipelineFetchCompletionBlock __nullable completion,
@@ -78,6 +86,11 @@ static void TIPFireFetchCompletionBlock(TIPImagePipelineFetchCompletionBlock __n
 @implementation TIPImagePipeline
 {
     NSString *_imagePipelinePath;
+    volatile atomic_uint_fast64_t _lookupHitCounts[CACHE_TYPE_COUNT];
+    volatile atomic_uint_fast64_t _lookupMissCounts[CACHE_TYPE_COUNT];
+    uint64_t _creationMachTime;
+    volatile atomic_int_fast64_t _firstImageLoadSource;
+    volatile atomic_uint_fast64_t _firstImageMachTime;
 }
 
 // the following getters may appear superfluous, and would be, if it weren't for the need to
@@ -146,6 +159,7 @@ static void TIPFireFetchCompletionBlock(TIPImagePipelineFetchCompletionBlock __n
         TIPUnregisterImagePipelineWithIdentifier(_identifier);
         NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
         [nc removeObserver:self name:UIApplicationDidEnterBackgroundNotification object:nil];
+        [nc removeObserver:self name:UIApplicationWillTerminateNotification object:nil];
         [nc postNotificationName:TIPImagePipelineDidTearDownImagePipelineNotification object:nil userInfo:@{ TIPImagePipelineImagePipelineIdentifierNotificationKey : _identifier }];
     }
 }
@@ -160,14 +174,30 @@ static void TIPFireFetchCompletionBlock(TIPImagePipelineFetchCompletionBlock __n
         }
 
         _identifier = identifier;
+        _creationMachTime = mach_absolute_time();
+        _cacheShareWeight = 1.0;
         _imagePipelinePath = [TIPOpenImagePipelineWithIdentifier(identifier) copy];
         _diskCache = [[TIPImageDiskCache alloc] initWithPath:_imagePipelinePath];
         _memoryCache = [[TIPImageMemoryCache alloc] init];
         _renderedCache = [[TIPImageRenderedCache alloc] init];
         _downloader = [TIPImageDownloader sharedInstance];
+        _hotSet = [[TIPImageHotSet alloc] initWithPath:TIPImagePipelineHotSetPath(identifier)];
+
+        TIPGlobalConfiguration *config = [TIPGlobalConfiguration sharedInstance];
+        const NSUInteger hotSetCount = config.hotSetSnapshotCount;
+        if (hotSetCount > 0 && config.isHotSetPreconnectEnabled) {
+            [_hotSet preconnectWithMaxCount:hotSetCount];
+        }
+        if (hotSetCount > 0 && _diskCache) {
+            [_hotSet prewarmMemoryCache:_memoryCache
+                          renderedCache:(config.isHotSetRenderedCachePrewarmEnabled) ? _renderedCache : nil
+                          fromDiskCache:_diskCache
+                               maxCount:hotSetCount];
+        }
 
         NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
         [nc addObserver:self selector:@selector(_tip_applicationDidEnterBackground) name:UIApplicationDidEnterBackgroundNotification object:nil];
+        [nc addObserver:self selector:@selector(_tip_applicationWillTerminate) name:UIApplicationWillTerminateNotification object:nil];
         [nc postNotificationName:TIPImagePipelineDidStandUpImagePipelineNotification object:self userInfo:@{ TIPImagePipelineImagePipelineIdentifierNotificationKey : _identifier }];
     }
 
@@ -243,6 +273,7 @@ static void TIPFireFetchCompletionBlock(TIPImagePipelineFetchCompletionBlock __n
                                        targetContentMode:targetContentMode
                                    sourceImageDimensions:&sourceImageDimensions
                                                    dirty:&isDirty];
+        [self recordLookupOfCacheType:TIPImageCacheTypeRendered hit:(entry.completeImage != nil)];
     }
 
     if (entry.completeImage) {
@@ -343,6 +374,12 @@ static void TIPFireFetchCompletionBlock(TIPImagePipelineFetchCompletionBlock __n
 - (void)clearDiskCache
 {
     [_diskCache clearAllImages:NULL];
+    [_hotSet removeSnapshot];
+}
+
++ (void)removeAllHotSetSnapshots
+{
+    [TIPImageHotSet removeAllSnapshotsAtDirectoryPath:TIPImagePipelineHotSetDirectoryPath()];
 }
 
 #pragma mark Copy Disk Cache File
@@ -406,6 +443,61 @@ static void TIPFireFetchCompletionBlock(TIPImagePipelineFetchCompletionBlock __n
 
 #pragma mark Properties
 
+- (void)recordLookupOfCacheType:(TIPImageCacheType)type
+                            hit:(BOOL)hit
+{
+    TIPAssert(type >= 0 && type < CACHE_TYPE_COUNT);
+    if (type < 0 || type >= CACHE_TYPE_COUNT) {
+        return;
+    }
+
+    atomic_fetch_add((hit) ? &_lookupHitCounts[type] : &_lookupMissCounts[type], 1);
+}
+
+- (void)getLookupHitCount:(out NSUInteger * __nullable)hitCountOut
+                missCount:(out NSUInteger * __nullable)missCountOut
+             forCacheType:(TIPImageCacheType)type
+{
+    const BOOL validType = (type >= 0 && type < CACHE_TYPE_COUNT);
+    TIPAssert(validType);
+    if (hitCountOut) {
+        *hitCountOut = (validType) ? (NSUInteger)atomic_load(&_lookupHitCounts[type]) : 0;
+    }
+    if (missCountOut) {
+        *missCountOut = (validType) ? (NSUInteger)atomic_load(&_lookupMissCounts[type]) : 0;
+    }
+}
+
+- (void)recordFirstImageLoadWithSource:(TIPImageLoadSource)source
+{
+    if (TIPImageLoadSourceUnknown == source || atomic_load(&_firstImageLoadSource) != TIPImageLoadSourceUnknown) {
+        return;
+    }
+
+    // the source is claimed first so that a reader seeing the time will also see the source
+    int_fast64_t unknownSource = TIPImageLoadSourceUnknown;
+    if (atomic_compare_exchange_strong(&_firstImageLoadSource, &unknownSource, source)) {
+        atomic_store(&_firstImageMachTime, mach_absolute_time());
+    }
+}
+
+- (BOOL)getTimeToFirstImage:(out NSTimeInterval * __nullable)durationOut
+                 loadSource:(out TIPImageLoadSource * __nullable)loadSourceOut
+{
+    const uint64_t firstImageMachTime = atomic_load(&_firstImageMachTime);
+    if (!firstImageMachTime) {
+        return NO;
+    }
+
+    if (durationOut) {
+        *durationOut = TIPComputeDuration(_creationMachTime, firstImageMachTime);
+    }
+    if (loadSourceOut) {
+        *loadSourceOut = (TIPImageLoadSource)atomic_load(&_firstImageLoadSource);
+    }
+    return YES;
+}
+
 - (nullable id<TIPImageCache>)cacheOfType:(TIPImageCacheType)type
 {
     switch (type) {
@@ -423,6 +515,9 @@ static void TIPFireFetchCompletionBlock(TIPImagePipelineFetchCompletionBlock __n
 
 - (void)_tip_applicationDidEnterBackground
 {
+    // snapshot before the rendered cache is weakified
+    [self _persistHotSetSynchronously:NO];
+
     if ([TIPGlobalConfiguration sharedInstance].clearMemoryCachesOnApplicationBackgroundEnabled) {
 
         dispatch_block_t endBackgroundTaskBlock = TIPStartBackgroundTask([NSString stringWithFormat:@"[%@ %@]", NSStringFromClass([self class]), NSStringFromSelector(_cmd)]);
@@ -432,6 +527,22 @@ static void TIPFireFetchCompletionBlock(TIPImagePipelineFetchCompletionBlock __n
     }
 }
 
+- (void)_tip_applicationWillTerminate
+{
+    [self _persistHotSetSynchronously:YES];
+}
+
+- (void)_persistHotSetSynchronously:(BOOL)synchronously TIP_OBJC_DIRECT
+{
+    const NSUInteger hotSetCount = [TIPGlobalConfiguration sharedInstance].hotSetSnapshotCount;
+    if (!hotSetCount || !_diskCache) {
+        return;
+    }
+
+    [_hotSet persistItems:[_renderedCache hotSetItemsWithMaxCount:hotSetCount]
+            synchronously:synchronously];
+}
+
 @end
 
 @implementation TIPImagePipeline (Inspect)
@@ -606,6 +717,18 @@ static NSString * __nullable TIPOpenImagePipelineWithIdentifier(NSString *identi
     return path;
 }
 
+static NSString *TIPImagePipelineHotSetDirectoryPath(void)
+{
+    // lives beside (rather than in) the pipeline directories so it is not mistaken for a pipeline
+    return [TIPImagePipelinePath() stringByAppendingPathExtension:@"hotset"];
+}
+
+static NSString *TIPImagePipelineHotSetPath(NSString *identifier)
+{
+    NSString *path = TIPImagePipelineHotSetDirectoryPath();
+    return [path stringByAppendingPathComponent:[identifier stringByAppendingPathExtension:@"plist"]];
+}
+
 static NSDictionary *TIPCopyAllRegisteredImagePipelines()
 {
     TIPEnsureStaticImagePipelineVariables();
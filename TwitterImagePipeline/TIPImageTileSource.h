@@ -0,0 +1,180 @@
+//
+//  TIPImageTileSource.h
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import <CoreGraphics/CoreGraphics.h>
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+@protocol TIPImageCodec;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A decoded tile of a `TIPImageTileSource`.
+ Tiles are laid out in a grid per _level_: level `0` is the full resolution and each level after it
+ halves the resolution, so a tile at level _n_ covers `2^n` times as many image pixels per side.
+ */
+@interface TIPImageTile : NSObject
+
+/** The identifier of the image the tile is from */
+@property (nonatomic, readonly, copy) NSString *identifier;
+/** The level of the tile, `0` is the full resolution */
+@property (nonatomic, readonly) NSUInteger level;
+/** The column of the tile in its level's grid */
+@property (nonatomic, readonly) NSUInteger column;
+/** The row of the tile in its level's grid */
+@property (nonatomic, readonly) NSUInteger row;
+/** The region of the image the tile covers, in pixels of the full resolution image as displayed */
+@property (nonatomic, readonly) CGRect region;
+/** The decoded tile, the _region_ at `1 / 2^level` of the full resolution */
+@property (nonatomic, readonly) UIImage *image;
+
+/** `NS_UNAVAILABLE` */
+- (instancetype)init NS_UNAVAILABLE;
+/** `NS_UNAVAILABLE` */
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+/**
+ An LRU cache of decoded `TIPImageTile` instances keyed by image identifier, level, column and row.
+ The cache is bounded by the bytes of its decoded tiles, so the memory for zooming into an image is
+ bounded by the cache instead of by the size of the image.
+ All methods are thread safe.  The cache is cleared when the app receives a memory warning.
+ */
+@interface TIPImageTileCache : NSObject
+
+/** The max bytes of decoded tiles to keep, least recently used tiles are evicted past it */
+@property (atomic) NSUInteger maxBytes;
+/** The bytes of the decoded tiles in the cache */
+@property (atomic, readonly) NSUInteger totalBytes;
+
+/** The shared cache used by `TIPImageTileSource` by default, with a `maxBytes` of 64MB */
++ (instancetype)sharedInstance;
+
+/** Designated initializer */
+- (instancetype)initWithMaxBytes:(NSUInteger)maxBytes NS_DESIGNATED_INITIALIZER;
+
+/** Get a tile (marking it as recently used) */
+- (nullable TIPImageTile *)tileWithIdentifier:(NSString *)identifier
+                                        level:(NSUInteger)level
+                                       column:(NSUInteger)column
+                                          row:(NSUInteger)row;
+/** Store a tile, replacing any tile with the same identifier, level, column and row */
+- (void)storeTile:(TIPImageTile *)tile;
+/** Remove the tiles of the image with the given _identifier_ */
+- (void)clearTilesWithIdentifier:(NSString *)identifier;
+/** Remove all tiles */
+- (void)clearAllTiles;
+
+/** `NS_UNAVAILABLE` */
+- (instancetype)init NS_UNAVAILABLE;
+/** `NS_UNAVAILABLE` */
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+/** Block called on the main queue with each tile of a viewport as it is loaded */
+typedef void(^TIPImageTileHandlerBlock)(TIPImageTile *tile);
+
+/**
+ Loads tiles of a large image for zooming into it, without decoding the whole image.
+
+ Each tile is decoded from the encoded image with `TIPDecodeImageRegionFromData`, so codecs that
+ implement region decoding (such as `TIPXJPEGTurboCodec`) only decode the pixels of the tile, at the
+ resolution of the tile's level.  Other codecs decode the whole image for each tile.
+ Decoded tiles are stored in the `tileCache`.
+
+ Tiles are fetched for a viewport: the tiles closest to the center of the viewport are decoded first,
+ a few at a time, and fetching a new viewport drops the tiles of the previous viewport that have not
+ started decoding.  To keep the encoded image out of memory too, get the file of a fetched image with
+ `-[TIPImagePipeline copyDiskCacheFileWithIdentifier:completion:]` (moving it in the completion) and
+ map it with `tileSourceWithImageFilePath:identifier:`.
+ */
+@interface TIPImageTileSource : NSObject
+
+/** The identifier of the image, for keying the tiles in the `tileCache` */
+@property (nonatomic, readonly, copy) NSString *identifier;
+/** The dimensions of the full resolution image as displayed (with its orientation applied) */
+@property (nonatomic, readonly) CGSize dimensions;
+/** The width and height in pixels of the (decoded) tiles, the tiles at the edges are smaller */
+@property (nonatomic, readonly) NSUInteger tileDimension;
+/** The number of levels, the last level fits the whole image in one tile */
+@property (nonatomic, readonly) NSUInteger levelCount;
+/** The cache for decoded tiles */
+@property (nonatomic, readonly) TIPImageTileCache *tileCache;
+
+/**
+ Create a tile source for image data, using the codec of `[TIPImageCodecCatalogue sharedInstance]`
+ for the image type of the data and 512 pixel tiles cached in `[TIPImageTileCache sharedInstance]`.
+ @return the tile source or `nil` if the image type or dimensions could not be determined
+ */
++ (nullable instancetype)tileSourceWithImageData:(NSData *)imageData
+                                      identifier:(NSString *)identifier;
+/** Same as `tileSourceWithImageData:identifier:` with the file memory mapped */
++ (nullable instancetype)tileSourceWithImageFilePath:(NSString *)filePath
+                                          identifier:(NSString *)identifier;
+
+/**
+ Designated initializer
+ @param imageData the (complete) encoded image
+ @param identifier the identifier of the image
+ @param codec the codec to decode tiles with
+ @param dimensions the dimensions of the image as displayed
+ @param tileDimension the width and height of tiles, at least `64`
+ @param tileCache the cache for decoded tiles, `nil` for `[TIPImageTileCache sharedInstance]`
+ */
+- (instancetype)initWithImageData:(NSData *)imageData
+                       identifier:(NSString *)identifier
+                            codec:(id<TIPImageCodec>)codec
+                       dimensions:(CGSize)dimensions
+                    tileDimension:(NSUInteger)tileDimension
+                        tileCache:(nullable TIPImageTileCache *)tileCache NS_DESIGNATED_INITIALIZER;
+
+/**
+ The level to display the image with at a zoom scale, the level with the lowest resolution that is
+ still at least the resolution displayed.
+ @param zoomScale the displayed pixels per pixel of the full resolution image
+ */
+- (NSUInteger)levelForZoomScale:(CGFloat)zoomScale;
+
+/** The region of the image (in pixels as displayed) covered by a tile, `CGRectNull` if out of bounds */
+- (CGRect)regionOfTileAtLevel:(NSUInteger)level
+                       column:(NSUInteger)column
+                          row:(NSUInteger)row;
+
+/** The tile from the `tileCache`, `nil` if it isn't cached */
+- (nullable TIPImageTile *)cachedTileAtLevel:(NSUInteger)level
+                                      column:(NSUInteger)column
+                                         row:(NSUInteger)row;
+
+/**
+ Fetch the tiles of a level that intersect a viewport, replacing the previous viewport.
+ Tiles already cached are delivered right away, the others as they are decoded (nearest to the
+ center of the viewport first).  Tiles of the previous viewport that are still wanted keep decoding,
+ the others are dropped unless they already started decoding, in which case they are cached but
+ only delivered if they intersect the current viewport.
+ @param viewport the visible region of the image, in pixels of the full resolution image as displayed
+ @param level the level of the tiles
+ @param tileHandler called on the main queue with each tile
+ */
+- (void)fetchTilesInViewport:(CGRect)viewport
+                       level:(NSUInteger)level
+                 tileHandler:(TIPImageTileHandlerBlock)tileHandler;
+
+/** Stop fetching tiles, tiles that are decoding are still cached but no longer delivered */
+- (void)cancelTileFetches;
+
+/** `NS_UNAVAILABLE` */
+- (instancetype)init NS_UNAVAILABLE;
+/** `NS_UNAVAILABLE` */
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,563 @@
+//
+//  TIPImageTileSource.m
+//  TwitterImagePipeline
+//
+//  Created on 10/18/26.
+//  Copyright © 2020 Twitter. All rights reserved.
+//
+
+#import <ImageIO/ImageIO.h>
+#include <pthread.h>
+
+#import "TIP_Project.h"
+#import "TIPImageCodecCatalogue.h"
+#import "TIPImageCodecs.h"
+#import "TIPImageContainer.h"
+#import "TIPImageTileSource.h"
+#import "TIPImageTypes.h"
+#import "TIPLRUCache.h"
+#import "UIImage+TIPAdditions.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+static const NSUInteger kTileCacheSharedMaxBytes = 64 * 1024 * 1024;
+static const NSUInteger kTileSourceDefaultTileDimension = 512;
+static const NSUInteger kTileSourceMinimumTileDimension = 64;
+static const NSUInteger kTileSourceMaxConcurrentDecodes = 2;
+
+static NSString *_TileKey(NSString *identifier, NSUInteger level, NSUInteger column, NSUInteger row);
+static CGSize _DetectDisplayedDimensions(NSData *imageData, id<TIPImageCodec> codec);
+
+@interface TIPImageTile ()
+@property (nonatomic, readonly) NSUInteger cost;
+- (instancetype)initWithIdentifier:(NSString *)identifier
+                             level:(NSUInteger)level
+                            column:(NSUInteger)column
+                               row:(NSUInteger)row
+                            region:(CGRect)region
+                             image:(UIImage *)image NS_DESIGNATED_INITIALIZER;
+@end
+
+TIP_OBJC_FINAL
+@interface TIPImageTileCacheEntry : NSObject <TIPLRUEntry>
+@property (nonatomic, readonly) TIPImageTile *tile;
+@property (nonatomic, readonly, copy) NSString *key;
+@property (nonatomic, nullable) TIPImageTileCacheEntry *nextLRUEntry;
+@property (nonatomic, nullable, weak) TIPImageTileCacheEntry *previousLRUEntry;
+- (instancetype)initWithTile:(TIPImageTile *)tile key:(NSString *)key TIP_OBJC_DIRECT;
+@end
+
+// A tile waiting to be decoded
+TIP_OBJC_FINAL TIP_OBJC_DIRECT_MEMBERS
+@interface TIPImageTileRequest : NSObject
+@property (nonatomic, readonly) NSUInteger column;
+@property (nonatomic, readonly) NSUInteger row;
+@property (nonatomic, readonly) CGRect region;
+@property (nonatomic, readonly, copy) NSString *key;
+@property (nonatomic, readonly) CGFloat distanceToViewportCenter; // squared
+- (instancetype)initWithColumn:(NSUInteger)column
+                           row:(NSUInteger)row
+                        region:(CGRect)region
+                           key:(NSString *)key
+                viewportCenter:(CGPoint)viewportCenter;
+@end
+
+@implementation TIPImageTileRequest
+
+- (instancetype)initWithColumn:(NSUInteger)column
+                           row:(NSUInteger)row
+                        region:(CGRect)region
+                           key:(NSString *)key
+                viewportCenter:(CGPoint)viewportCenter
+{
+    if (self = [super init]) {
+        _column = column;
+        _row = row;
+        _region = region;
+        _key = [key copy];
+        const CGFloat dx = CGRectGetMidX(region) - viewportCenter.x;
+        const CGFloat dy = CGRectGetMidY(region) - viewportCenter.y;
+        _distanceToViewportCenter = (dx * dx) + (dy * dy);
+    }
+    return self;
+}
+
+@end
+
+@implementation TIPImageTile
+
+- (instancetype)initWithIdentifier:(NSString *)identifier
+                             level:(NSUInteger)level
+                            column:(NSUInteger)column
+                               row:(NSUInteger)row
+                            region:(CGRect)region
+                             image:(UIImage *)image
+{
+    if (self = [super init]) {
+        _identifier = [identifier copy];
+        _level = level;
+        _column = column;
+        _row = row;
+        _region = region;
+        _image = image;
+        _cost = [image tip_estimatedSizeInBytes];
+    }
+    return self;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: %@ level=%tu column=%tu row=%tu>", NSStringFromClass([self class]), self, _identifier, _level, _column, _row];
+}
+
+@end
+
+@implementation TIPImageTileCacheEntry
+
+- (instancetype)initWithTile:(TIPImageTile *)tile key:(NSString *)key
+{
+    if (self = [super init]) {
+        _tile = tile;
+        _key = [key copy];
+    }
+    return self;
+}
+
+- (NSString *)LRUEntryIdentifier
+{
+    return _key;
+}
+
+- (BOOL)shouldAccessMoveLRUEntryToHead
+{
+    return YES;
+}
+
+@end
+
+@interface TIPImageTileCache () <TIPLRUCacheDelegate>
+@end
+
+@implementation TIPImageTileCache
+{
+    pthread_mutex_t _mutex;
+    TIPLRUCache *_manifest;
+    NSUInteger _maxBytes;
+    NSUInteger _totalBytes;
+}
+
++ (instancetype)sharedInstance
+{
+    static TIPImageTileCache *sCache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sCache = [[TIPImageTileCache alloc] initWithMaxBytes:kTileCacheSharedMaxBytes];
+    });
+    return sCache;
+}
+
+- (instancetype)initWithMaxBytes:(NSUInteger)maxBytes
+{
+    if (self = [super init]) {
+        pthread_mutex_init(&_mutex, NULL);
+        _manifest = [[TIPLRUCache alloc] initWithEntries:nil delegate:self];
+        _maxBytes = maxBytes;
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(_tip_tileCache_didReceiveMemoryWarning:)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self
+                                                    name:UIApplicationDidReceiveMemoryWarningNotification
+                                                  object:nil];
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (void)_tip_tileCache_didReceiveMemoryWarning:(NSNotification *)note
+{
+    [self clearAllTiles];
+}
+
+- (NSUInteger)maxBytes
+{
+    pthread_mutex_lock(&_mutex);
+    const NSUInteger maxBytes = _maxBytes;
+    pthread_mutex_unlock(&_mutex);
+    return maxBytes;
+}
+
+- (void)setMaxBytes:(NSUInteger)maxBytes
+{
+    pthread_mutex_lock(&_mutex);
+    _maxBytes = maxBytes;
+    [self _tileCache_pruneToMaxBytes];
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (NSUInteger)totalBytes
+{
+    pthread_mutex_lock(&_mutex);
+    const NSUInteger totalBytes = _totalBytes;
+    pthread_mutex_unlock(&_mutex);
+    return totalBytes;
+}
+
+- (nullable TIPImageTile *)tileWithIdentifier:(NSString *)identifier
+                                        level:(NSUInteger)level
+                                       column:(NSUInteger)column
+                                          row:(NSUInteger)row
+{
+    NSString *key = _TileKey(identifier, level, column, row);
+    pthread_mutex_lock(&_mutex);
+    TIPImageTileCacheEntry *entry = (TIPImageTileCacheEntry *)[_manifest entryWithIdentifier:key];
+    pthread_mutex_unlock(&_mutex);
+    return entry.tile;
+}
+
+- (void)storeTile:(TIPImageTile *)tile
+{
+    NSString *key = _TileKey(tile.identifier, tile.level, tile.column, tile.row);
+    TIPImageTileCacheEntry *entry = [[TIPImageTileCacheEntry alloc] initWithTile:tile key:key];
+    pthread_mutex_lock(&_mutex);
+    // removing the replaced entry goes through the eviction callback, which subtracts its cost
+    [_manifest removeEntry:[_manifest entryWithIdentifier:key canMutate:NO]];
+    if (tile.cost <= _maxBytes) {
+        [_manifest addEntry:entry];
+        _totalBytes += tile.cost;
+        [self _tileCache_pruneToMaxBytes];
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)clearTilesWithIdentifier:(NSString *)identifier
+{
+    pthread_mutex_lock(&_mutex);
+    for (TIPImageTileCacheEntry *entry in [_manifest allEntries]) {
+        if ([entry.tile.identifier isEqualToString:identifier]) {
+            [_manifest removeEntry:entry];
+        }
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)clearAllTiles
+{
+    pthread_mutex_lock(&_mutex);
+    [_manifest clearAllEntries];
+    _totalBytes = 0;
+    pthread_mutex_unlock(&_mutex);
+}
+
+- (void)_tileCache_pruneToMaxBytes
+{
+    // called with the mutex locked
+    while (_totalBytes > _maxBytes && [_manifest removeTailEntry]) {
+        // the eviction callback subtracts the cost
+    }
+}
+
+#pragma mark TIPLRUCacheDelegate
+
+- (void)tip_cache:(TIPLRUCache *)cache didEvictEntry:(TIPImageTileCacheEntry *)entry
+{
+    // called with the mutex locked
+    const NSUInteger cost = entry.tile.cost;
+    _totalBytes = (_totalBytes > cost) ? _totalBytes - cost : 0;
+}
+
+@end
+
+@implementation TIPImageTileSource
+{
+    NSData *_imageData;
+    id<TIPImageCodec> _codec;
+    dispatch_queue_t _queue;
+
+    // state on _queue
+    NSMutableArray<TIPImageTileRequest *> *_pendingRequests;
+    NSMutableSet<NSString *> *_decodingKeys;
+    TIPImageTileHandlerBlock _tileHandler;
+    CGRect _viewport;
+    NSUInteger _viewportLevel;
+}
+
++ (nullable instancetype)tileSourceWithImageData:(NSData *)imageData
+                                      identifier:(NSString *)identifier
+{
+    NSString *imageType = TIPDetectImageTypeViaMagicNumbers(imageData);
+    id<TIPImageCodec> codec = (imageType) ? [[TIPImageCodecCatalogue sharedInstance] codecForImageType:imageType] : nil;
+    if (!codec) {
+        return nil;
+    }
+
+    const CGSize dimensions = _DetectDisplayedDimensions(imageData, codec);
+    if (dimensions.width < 1 || dimensions.height < 1) {
+        return nil;
+    }
+
+    return [[self alloc] initWithImageData:imageData
+                                identifier:identifier
+                                     codec:codec
+                                dimensions:dimensions
+                             tileDimension:kTileSourceDefaultTileDimension
+                                 tileCache:nil];
+}
+
++ (nullable instancetype)tileSourceWithImageFilePath:(NSString *)filePath
+                                          identifier:(NSString *)identifier
+{
+    NSData *imageData = [NSData dataWithContentsOfFile:filePath options:NSDataReadingMappedIfSafe error:NULL];
+    return (imageData) ? [self tileSourceWithImageData:imageData identifier:identifier] : nil;
+}
+
+- (instancetype)initWithImageData:(NSData *)imageData
+                       identifier:(NSString *)identifier
+                            codec:(id<TIPImageCodec>)codec
+                       dimensions:(CGSize)dimensions
+                    tileDimension:(NSUInteger)tileDimension
+                        tileCache:(nullable TIPImageTileCache *)tileCache
+{
+    if (self = [super init]) {
+        _imageData = imageData;
+        _identifier = [identifier copy];
+        _codec = codec;
+        _dimensions = CGSizeMake(MAX(1, round(dimensions.width)), MAX(1, round(dimensions.height)));
+        _tileDimension = MAX(kTileSourceMinimumTileDimension, tileDimension);
+        _tileCache = tileCache ?: [TIPImageTileCache sharedInstance];
+
+        // levels halve the resolution until the whole image fits in a tile
+        NSUInteger levelCount = 1;
+        CGFloat span = _tileDimension;
+        while (span < MAX(_dimensions.width, _dimensions.height)) {
+            span *= 2;
+            levelCount++;
+        }
+        _levelCount = levelCount;
+
+        _queue = dispatch_queue_create("com.twitter.tip.tile.source.queue", DISPATCH_QUEUE_SERIAL);
+        _pendingRequests = [[NSMutableArray alloc] init];
+        _decodingKeys = [[NSMutableSet alloc] init];
+        _viewport = CGRectNull;
+    }
+    return self;
+}
+
+- (NSUInteger)levelForZoomScale:(CGFloat)zoomScale
+{
+    if (zoomScale >= 1 || zoomScale <= 0) {
+        return 0;
+    }
+    const NSUInteger level = (NSUInteger)floor(log2(1. / zoomScale));
+    return MIN(level, _levelCount - 1);
+}
+
+- (CGRect)regionOfTileAtLevel:(NSUInteger)level
+                       column:(NSUInteger)column
+                          row:(NSUInteger)row
+{
+    if (level >= _levelCount) {
+        return CGRectNull;
+    }
+    const CGFloat span = (CGFloat)(_tileDimension << level);
+    const CGRect region = CGRectMake(column * span, row * span, span, span);
+    const CGRect bounds = CGRectMake(0, 0, _dimensions.width, _dimensions.height);
+    return CGRectIntersection(region, bounds);
+}
+
+- (nullable TIPImageTile *)cachedTileAtLevel:(NSUInteger)level
+                                      column:(NSUInteger)column
+                                         row:(NSUInteger)row
+{
+    return [_tileCache tileWithIdentifier:_identifier level:level column:column row:row];
+}
+
+- (void)fetchTilesInViewport:(CGRect)viewport
+                       level:(NSUInteger)level
+                 tileHandler:(TIPImageTileHandlerBlock)tileHandler
+{
+    viewport = CGRectIntersection(viewport, CGRectMake(0, 0, _dimensions.width, _dimensions.height));
+    level = MIN(level, _levelCount - 1);
+    tip_dispatch_async_autoreleasing(_queue, ^{
+        [self _tileSource_updateViewport:viewport level:level tileHandler:tileHandler];
+    });
+}
+
+- (void)cancelTileFetches
+{
+    tip_dispatch_async_autoreleasing(_queue, ^{
+        [self->_pendingRequests removeAllObjects];
+        self->_tileHandler = nil;
+        self->_viewport = CGRectNull;
+    });
+}
+
+#pragma mark Private
+
+- (void)_tileSource_updateViewport:(CGRect)viewport
+                             level:(NSUInteger)level
+                       tileHandler:(TIPImageTileHandlerBlock)tileHandler
+{
+    [_pendingRequests removeAllObjects];
+    _viewport = viewport;
+    _viewportLevel = level;
+    _tileHandler = [tileHandler copy];
+    if (CGRectIsEmpty(viewport)) {
+        return;
+    }
+
+    const CGFloat span = (CGFloat)(_tileDimension << level);
+    const NSUInteger firstColumn = (NSUInteger)floor(CGRectGetMinX(viewport) / span);
+    const NSUInteger lastColumn = (NSUInteger)ceil(CGRectGetMaxX(viewport) / span);
+    const NSUInteger firstRow = (NSUInteger)floor(CGRectGetMinY(viewport) / span);
+    const NSUInteger lastRow = (NSUInteger)ceil(CGRectGetMaxY(viewport) / span);
+    const CGPoint center = CGPointMake(CGRectGetMidX(viewport), CGRectGetMidY(viewport));
+
+    NSMutableArray<TIPImageTile *> *cachedTiles = [[NSMutableArray alloc] init];
+    for (NSUInteger row = firstRow; row < lastRow; row++) {
+        for (NSUInteger column = firstColumn; column < lastColumn; column++) {
+            const CGRect region = [self regionOfTileAtLevel:level column:column row:row];
+            if (CGRectIsEmpty(region)) {
+                continue;
+            }
+            TIPImageTile *tile = [self cachedTileAtLevel:level column:column row:row];
+            if (tile) {
+                [cachedTiles addObject:tile];
+                continue;
+            }
+            NSString *key = _TileKey(_identifier, level, column, row);
+            if ([_decodingKeys containsObject:key]) {
+                // delivered when it finishes decoding
+                continue;
+            }
+            [_pendingRequests addObject:[[TIPImageTileRequest alloc] initWithColumn:column
+                                                                                  row:row
+                                                                               region:region
+                                                                                  key:key
+                                                                       viewportCenter:center]];
+        }
+    }
+    [_pendingRequests sortUsingComparator:^NSComparisonResult(TIPImageTileRequest *request1, TIPImageTileRequest *request2) {
+        if (request1.distanceToViewportCenter < request2.distanceToViewportCenter) {
+            return NSOrderedAscending;
+        }
+        return (request1.distanceToViewportCenter > request2.distanceToViewportCenter) ? NSOrderedDescending : NSOrderedSame;
+    }];
+
+    if (cachedTiles.count > 0) {
+        tip_dispatch_async_autoreleasing(dispatch_get_main_queue(), ^{
+            for (TIPImageTile *tile in cachedTiles) {
+                tileHandler(tile);
+            }
+        });
+    }
+    [self _tileSource_startDecodingIfPossible];
+}
+
+- (void)_tileSource_startDecodingIfPossible
+{
+    while (_decodingKeys.count < kTileSourceMaxConcurrentDecodes && _pendingRequests.count > 0) {
+        TIPImageTileRequest *request = _pendingRequests.firstObject;
+        [_pendingRequests removeObjectAtIndex:0];
+        [_decodingKeys addObject:request.key];
+
+        const NSUInteger level = _viewportLevel;
+        NSString *identifier = _identifier;
+        NSData *imageData = _imageData;
+        id<TIPImageCodec> codec = _codec;
+        tip_dispatch_async_autoreleasing(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            // decode the region at the resolution of the level
+            const CGRect region = request.region;
+            const CGSize tileDimensions = CGSizeMake(ceil(region.size.width / (CGFloat)(1 << level)),
+                                                     ceil(region.size.height / (CGFloat)(1 << level)));
+            TIPImageContainer *container = TIPDecodeImageRegionFromData(codec,
+                                                                        nil /*config*/,
+                                                                        imageData,
+                                                                        region,
+                                                                        tileDimensions,
+                                                                        UIViewContentModeScaleAspectFit);
+            TIPImageTile *tile = nil;
+            if (container.image) {
+                tile = [[TIPImageTile alloc] initWithIdentifier:identifier
+                                                          level:level
+                                                         column:request.column
+                                                            row:request.row
+                                                         region:region
+                                                          image:container.image];
+                [self.tileCache storeTile:tile];
+            }
+            tip_dispatch_async_autoreleasing(self->_queue, ^{
+                [self _tileSource_didDecodeTile:tile request:request level:level];
+            });
+        });
+    }
+}
+
+- (void)_tileSource_didDecodeTile:(nullable TIPImageTile *)tile
+                          request:(TIPImageTileRequest *)request
+                            level:(NSUInteger)level
+{
+    [_decodingKeys removeObject:request.key];
+
+    TIPImageTileHandlerBlock tileHandler = _tileHandler;
+    if (tile && tileHandler && level == _viewportLevel && CGRectIntersectsRect(tile.region, _viewport)) {
+        tip_dispatch_async_autoreleasing(dispatch_get_main_queue(), ^{
+            tileHandler(tile);
+        });
+    } else if (!tile) {
+        TIPLogWarning(@"Failed to decode tile of %@ at level %tu (%@)", _identifier, level, NSStringFromCGRect(request.region));
+    }
+
+    [self _tileSource_startDecodingIfPossible];
+}
+
+@end
+
+#pragma mark Functions
+
+static NSString *_TileKey(NSString *identifier, NSUInteger level, NSUInteger column, NSUInteger row)
+{
+    // the numbers are always last, so identifiers containing the separator can't collide
+    return [NSString stringWithFormat:@"%@|%tu|%tu|%tu", identifier, level, column, row];
+}
+
+static CGSize _DetectDisplayedDimensions(NSData *imageData, id<TIPImageCodec> codec)
+{
+    // ImageIO reads the dimensions and orientation without decoding
+    CGImageSourceRef imageSource = CGImageSourceCreateWithData((__bridge CFDataRef)imageData, (__bridge CFDictionaryRef)@{ (NSString *)kCGImageSourceShouldCache : @NO });
+    TIPDeferRelease(imageSource);
+    if (imageSource) {
+        CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(imageSource, 0, NULL);
+        TIPDeferRelease(properties);
+        if (properties) {
+            NSNumber *width = (__bridge NSNumber *)CFDictionaryGetValue(properties, kCGImagePropertyPixelWidth);
+            NSNumber *height = (__bridge NSNumber *)CFDictionaryGetValue(properties, kCGImagePropertyPixelHeight);
+            NSNumber *orientation = (__bridge NSNumber *)CFDictionaryGetValue(properties, kCGImagePropertyOrientation);
+            if (width && height) {
+                switch ((CGImagePropertyOrientation)orientation.unsignedIntValue) {
+                    case kCGImagePropertyOrientationLeftMirrored:
+                    case kCGImagePropertyOrientationRight:
+                    case kCGImagePropertyOrientationRightMirrored:
+                    case kCGImagePropertyOrientationLeft:
+                        return CGSizeMake(height.doubleValue, width.doubleValue);
+                    default:
+                        return CGSizeMake(width.doubleValue, height.doubleValue);
+                }
+            }
+        }
+    }
+
+    // fall back to the headers of the codec (for image types ImageIO can't read)
+    id<TIPImageDecoder> decoder = codec.tip_decoder;
+    id<TIPImageDecoderContext> context = [decoder tip_initiateDecoding:nil
+                                                    expectedDataLength:imageData.length
+                                                                buffer:nil];
+    [decoder tip_append:context data:imageData];
+    return context.tip_dimensions;
+}
+
+NS_ASSUME_NONNULL_END
@@ -99,6 +99,14 @@ FOUNDATION_EXTERN NSString * const TIPImageTypeAVCI;
  @note the `TIPXWebPCodec` encoder and decoder can be installed for backwards compatibility
  */
 FOUNDATION_EXTERN NSString * const TIPImageTypeWEBP;
+/**
+ JXL (JPEG XL)
+ Only decoding is supported by __TIP__ by default.
+ @note requires iOS 17+
+ @note the `TIPXJXLCodec` encoder and decoder can be installed for backwards compatibility and for
+ progressive loading
+ */
+FOUNDATION_EXTERN NSString * const TIPImageTypeJXL;
 
 #pragma mark Unsupported image types (cannot read nor write)
 
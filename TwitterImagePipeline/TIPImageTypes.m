@@ -23,6 +23,10 @@ static const UInt8 kPNGMagicNumbers[]       = { 0x89, 0x50, 0x4E, 0x47,
 static const UInt8 kWEBPMagicNumbers[]      = { 'R', 'I', 'F', 'F',
                                                 '\0', '\0', '\0', '\0',
                                                 'W', 'E', 'B', 'P' };
+static const UInt8 kJXLCodestreamMagicNumbers[] = { 0xFF, 0x0A };
+static const UInt8 kJXLContainerMagicNumbers[]  = { 0x00, 0x00, 0x00, 0x0C,
+                                                    'J', 'X', 'L', ' ',
+                                                    0x0D, 0x0A, 0x87, 0x0A };
 
 #define BIGGER(x, y) ((x) > (y) ? (x) : (y))
 
@@ -32,7 +36,8 @@ const NSUInteger TIPMagicNumbersForImageTypeMaximumLength =
                    BIGGER(sizeof(kGIFMagicNumbers),
                           BIGGER(sizeof(kJPEGMagicNumbers),
                                  BIGGER(sizeof(kBMP1MagicNumbers),
-                                        sizeof(kWEBPMagicNumbers)))));
+                                        BIGGER(sizeof(kWEBPMagicNumbers),
+                                               sizeof(kJXLContainerMagicNumbers))))));
 
 #define MAGIC_NUMBERS_ARE_EQUAL(bytes, len, magicNumber) \
 ( (len >= sizeof( magicNumber )) && (memcmp(bytes, magicNumber, sizeof( magicNumber )) == 0) )
@@ -66,6 +71,7 @@ NSString * const TIPImageTypeRAW        = @"public.camera-raw-image";
 NSString * const TIPImageTypeHEIC       = @"public.heic";
 NSString * const TIPImageTypeAVCI       = @"public.avci";
 NSString * const TIPImageTypeWEBP       = @"org.webmproject.webp";
+NSString * const TIPImageTypeJXL        = @"public.jpeg-xl";
 
 #pragma mark - Static Functions
 
@@ -111,6 +117,7 @@ NSSet<NSString *> * TIPDetectableImageTypesViaMagicNumbers(void)
                                         TIPImageTypeGIF,
                                         TIPImageTypePNG,
                                         TIPImageTypeWEBP,
+                                        TIPImageTypeJXL,
                                         nil];
     });
     return sTypes;
@@ -153,6 +160,11 @@ NSString * __nullable TIPDetectImageTypeViaMagicNumbers(NSData *dataObj)
         }
     }
 
+    // JPEG XL is either a naked codestream or an ISO BMFF container (starting with the "JXL " box)
+    if (MAGIC_NUMBERS_ARE_EQUAL(bytes, length, kJXLCodestreamMagicNumbers) || MAGIC_NUMBERS_ARE_EQUAL(bytes, length, kJXLContainerMagicNumbers)) {
+        return TIPImageTypeJXL;
+    }
+
     return nil;
 }
 
@@ -169,7 +181,8 @@ BOOL TIPImageTypeSupportsLossyQuality(NSString * __nullable type)
     const BOOL hasLossy =  [type isEqualToString:TIPImageTypeJPEG]
                         || [type isEqualToString:TIPImageTypeJPEG2000]
                         || [type isEqualToString:TIPImageTypeHEIC]
-                        || [type isEqualToString:TIPImageTypeAVCI];
+                        || [type isEqualToString:TIPImageTypeAVCI]
+                        || [type isEqualToString:TIPImageTypeJXL];
 
     // though GIF can be munged many ways to change the quality,
     // we'll keep it simple and not treat GIF as supporting lossy quality
@@ -235,6 +248,8 @@ NSString * __nullable TIPImageTypeFromUTType(NSString * __nullable utType)
         return TIPImageTypeAVCI;
     } else if (UTTypeConformsTo(imageType, CFSTR("org.webmproject.webp"))) {
         return TIPImageTypeWEBP;
+    } else if (UTTypeConformsTo(imageType, CFSTR("public.jpeg-xl"))) {
+        return TIPImageTypeJXL;
     }
 
     return nil;
@@ -295,5 +295,27 @@ FOUNDATION_EXTERN CGSize TIPDetectImageFileDimensions(NSString * __nullable file
  */
 FOUNDATION_EXTERN CGSize TIPDetectImageSourceDimensionsAtIndex(CGImageSourceRef __nullable imageSource, size_t index);
 
+/**
+ Create a preview of a partially decoded Adam7 interlaced image, with 1 pixel per block of pixels
+ that the completed passes have filled in so far (scale it up to the dimensions of the image to display it)
+ @param pixels the 32-bit pixels decoded so far, each at its position in the image
+ @param width the width of the image
+ @param height the height of the image
+ @param bytesPerRow the byte count of each row of _pixels_
+ @param evenRowsOnly whether _pixels_ only holds the even rows of the image (the only rows the first 6 passes fill in)
+ @param passCount the number of completed passes, `1` through `6`
+ @param colorSpace the color space of _pixels_
+ @param bitmapInfo the layout of _pixels_
+ @return the preview image or `NULL` if it could not be created
+ */
+FOUNDATION_EXTERN CGImageRef __nullable TIPCreateAdam7PreviewImage(const uint8_t *pixels,
+                                                                   size_t width,
+                                                                   size_t height,
+                                                                   size_t bytesPerRow,
+                                                                   BOOL evenRowsOnly,
+                                                                   NSUInteger passCount,
+                                                                   CGColorSpaceRef colorSpace,
+                                                                   CGBitmapInfo bitmapInfo) CF_RETURNS_RETAINED;
+
 NS_ASSUME_NONNULL_END
 
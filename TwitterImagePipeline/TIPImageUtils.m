@@ -9,6 +9,11 @@
 #import <CoreGraphics/CoreGraphics.h>
 #import <ImageIO/ImageIO.h>
 #import <UIKit/UIKit.h>
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#import <arm_neon.h>
+#elif defined(__SSE2__)
+#import <emmintrin.h>
+#endif
 
 #import "TIP_Project.h"
 #import "TIPError.h"
@@ -21,6 +26,10 @@ NS_ASSUME_NONNULL_BEGIN
 
 static CGSize TIPSizeAlignToPixelEx(CGSize size, CGFloat scale);
 static CGSize TIPDetectImageDataProviderDimensions(CGDataProviderRef dataProviderRef);
+static BOOL _TIPPixelsHaveNonOpaqueAlpha(const UInt8 *bytes,
+                                         size_t pixelCount,
+                                         size_t bytesPerPixel,
+                                         size_t alphaByteIndex);
 
 #pragma mark - Render Format
 
@@ -281,14 +290,10 @@ BOOL TIPCGImageHasAlpha(CGImageRef imageRef, BOOL inspectPixels)
 
     const UInt8 *byteComponent = CFDataGetBytePtr(data);
     for (size_t iRow = 0; iRow < (size_t)size.height; iRow++) {
-        const UInt8 * const endRowByte = byteComponent + expectedBytesPerRow;
-        while (byteComponent < endRowByte) {
-            if (0xFF != byteComponent[alphaByteIndex]) {
-                return YES;
-            }
-            byteComponent += numberOfComponents + 1;
+        if (_TIPPixelsHaveNonOpaqueAlpha(byteComponent, (size_t)size.width, numberOfComponents + 1, (size_t)alphaByteIndex)) {
+            return YES;
         }
-        byteComponent += byteSluffPerRow;
+        byteComponent += expectedBytesPerRow + byteSluffPerRow;
     }
 
     return NO;
@@ -547,6 +552,59 @@ CGSize TIPDetectImageSourceDimensionsAtIndex(CGImageSourceRef __nullable imageSo
     return CGSizeZero;
 }
 
+CGImageRef __nullable TIPCreateAdam7PreviewImage(const uint8_t *pixels,
+                                                 size_t width,
+                                                 size_t height,
+                                                 size_t bytesPerRow,
+                                                 BOOL evenRowsOnly,
+                                                 NSUInteger passCount,
+                                                 CGColorSpaceRef colorSpace,
+                                                 CGBitmapInfo bitmapInfo)
+{
+    // After each pass the pixels filled in so far are on a grid, take 1 pixel per cell of the grid
+    static const uint8_t sAdam7GridSizes[6][2] = { {8, 8}, {4, 8}, {4, 4}, {2, 4}, {2, 2}, {1, 2} };
+    if (passCount < 1 || passCount > 6 || !width || !height) {
+        return NULL;
+    }
+
+    const size_t gridWidth = sAdam7GridSizes[passCount - 1][0];
+    const size_t gridHeight = sAdam7GridSizes[passCount - 1][1];
+    const size_t previewWidth = (width + gridWidth - 1) / gridWidth;
+    const size_t previewHeight = (height + gridHeight - 1) / gridHeight;
+    const size_t previewBytesPerRow = previewWidth * 4;
+    NSMutableData *previewData = [NSMutableData dataWithLength:previewBytesPerRow * previewHeight];
+    uint8_t *previewPixels = previewData.mutableBytes;
+    if (!previewPixels) {
+        return NULL;
+    }
+
+    for (size_t y = 0; y < previewHeight; y++) {
+        const size_t pixelsRowIndex = (evenRowsOnly) ? ((y * gridHeight) / 2) : (y * gridHeight);
+        const uint8_t *pixelsRow = pixels + (pixelsRowIndex * bytesPerRow);
+        uint8_t *previewRow = previewPixels + (y * previewBytesPerRow);
+        for (size_t x = 0; x < previewWidth; x++) {
+            memcpy(previewRow + (x * 4), pixelsRow + (x * gridWidth * 4), 4);
+        }
+    }
+
+    CGDataProviderRef dataProvider = CGDataProviderCreateWithCFData((__bridge CFDataRef)previewData);
+    TIPDeferRelease(dataProvider);
+    if (!dataProvider) {
+        return NULL;
+    }
+    return CGImageCreate(previewWidth,
+                         previewHeight,
+                         8 /* bitsPerComponent */,
+                         32 /* bitsPerPixel */,
+                         previewBytesPerRow,
+                         colorSpace,
+                         bitmapInfo,
+                         dataProvider,
+                         NULL /* decode */,
+                         true /* shouldInterpolate */,
+                         kCGRenderingIntentDefault);
+}
+
 #pragma mark - Statics
 
 static CGSize TIPSizeAlignToPixelEx(CGSize size, CGFloat scale)
@@ -565,4 +623,60 @@ static CGSize TIPDetectImageDataProviderDimensions(CGDataProviderRef dataProvide
     return TIPDetectImageSourceDimensionsAtIndex(imageSourceRef, 0);
 }
 
+static BOOL _TIPPixelsHaveNonOpaqueAlpha(const UInt8 *bytes,
+                                         size_t pixelCount,
+                                         size_t bytesPerPixel,
+                                         size_t alphaByteIndex)
+{
+    size_t iPixel = 0;
+
+#if (defined(__ARM_NEON) && defined(__aarch64__)) || defined(__SSE2__)
+    // When pixels tile a 16 byte vector, AND 4 vectors together (16 RGBA pixels) so an alpha byte
+    // stays 0xFF only if it is 0xFF in every pixel, then set the other bytes to 0xFF and check for all ones.
+    if (16 % bytesPerPixel == 0) {
+        UInt8 otherBytesMask[16];
+        for (size_t iByte = 0; iByte < 16; iByte++) {
+            otherBytesMask[iByte] = ((iByte % bytesPerPixel) == alphaByteIndex) ? 0x00 : 0xFF;
+        }
+        const size_t pixelsPerBlock = 64 / bytesPerPixel;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+        const uint8x16_t mask = vld1q_u8(otherBytesMask);
+        for (; iPixel + pixelsPerBlock <= pixelCount; iPixel += pixelsPerBlock) {
+            const UInt8 * const block = bytes + (iPixel * bytesPerPixel);
+            uint8x16_t v = vandq_u8(vandq_u8(vld1q_u8(block), vld1q_u8(block + 16)),
+                                    vandq_u8(vld1q_u8(block + 32), vld1q_u8(block + 48)));
+            v = vorrq_u8(v, mask);
+            if (vminvq_u8(v) != 0xFF) {
+                return YES;
+            }
+        }
+#else
+        const __m128i mask = _mm_loadu_si128((const __m128i *)otherBytesMask);
+        const __m128i allOnes = _mm_set1_epi8((char)0xFF);
+        for (; iPixel + pixelsPerBlock <= pixelCount; iPixel += pixelsPerBlock) {
+            const UInt8 * const block = bytes + (iPixel * bytesPerPixel);
+            __m128i v = _mm_and_si128(_mm_and_si128(_mm_loadu_si128((const __m128i *)block),
+                                                    _mm_loadu_si128((const __m128i *)(block + 16))),
+                                      _mm_and_si128(_mm_loadu_si128((const __m128i *)(block + 32)),
+                                                    _mm_loadu_si128((const __m128i *)(block + 48))));
+            v = _mm_or_si128(v, mask);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, allOnes)) != 0xFFFF) {
+                return YES;
+            }
+        }
+#endif
+    }
+#endif
+
+    // remaining pixels (and pixel layouts that don't tile a vector)
+    for (const UInt8 *byteComponent = bytes + (iPixel * bytesPerPixel) + alphaByteIndex; iPixel < pixelCount; iPixel++) {
+        if (0xFF != *byteComponent) {
+            return YES;
+        }
+        byteComponent += bytesPerPixel;
+    }
+
+    return NO;
+}
+
 NS_ASSUME_NONNULL_END
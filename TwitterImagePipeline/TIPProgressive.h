@@ -88,9 +88,12 @@ typedef NS_ENUM(NSInteger, TIPImageFetchProgressUpdateBehavior)
  If a progressive loading policy is not given on a request that is loading an image type that is
  progressive, the default policy will be used.
 
- `TIPImageTypeJPEG`:
+ `TIPImageTypeJPEG` and `TIPImageTypeJXL` (with a progressive decoder, such as `TIPXJXLCodec`):
  - 64-bit: `TIPFullFrameProgressiveLoadingPolicy` w/ `shouldRenderLowQualityFrame` == `YES`
  - 32-bit: `TIPFirstAndLastFrameProgressiveLoadingPolicy` w/ `shouldRenderLowQualityFrame` == `YES`
+
+ `TIPImageTypePNG` has no default policy, so Adam7 interlaced PNGs only load progressively when a
+ policy for `TIPImageTypePNG` is given with `progressiveLoadingPolicies` on the fetch request.
  */
 FOUNDATION_EXTERN NSDictionary<NSString *, id<TIPImageFetchProgressiveLoadingPolicy>> *TIPImageFetchProgressiveLoadingPolicyDefaultPolicies(void);
 
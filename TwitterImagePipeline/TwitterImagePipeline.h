@@ -26,6 +26,7 @@
 #import <TwitterImagePipeline/TIPImagePipeline.h>
 #import <TwitterImagePipeline/TIPImagePipelineInspectionResult.h>
 #import <TwitterImagePipeline/TIPImageStoreRequest.h>
+#import <TwitterImagePipeline/TIPImageTileSource.h>
 #import <TwitterImagePipeline/TIPImageTypes.h>
 #import <TwitterImagePipeline/TIPImageUtils.h>
 #import <TwitterImagePipeline/TIPImageViewFetchHelper.h>
@@ -70,7 +70,7 @@ NS_ASSUME_NONNULL_BEGIN
  Return whether the image has few enough colors to use an indexed palette or not.
  @param options the options to use when checking if the image can be losslessly encoded with an indexed palette.  See `TIPIndexedPaletteEncodingOptions`.
  @return `YES` if the image could use an indexed palette.  `NO` otherwise.
- @warning This method is very expensive.  It iterates through every single pixel of the image and on every pixel evaluates against all the previously "hit" colors.
+ @warning This method is expensive.  It renders the image and hashes every pixel (concurrently for large images), bailing out as soon as there are too many colors.
  */
 - (BOOL)tip_canLosslesslyEncodeUsingIndexedPaletteWithOptions:(TIPIndexedPaletteEncodingOptions)options;
 
@@ -166,7 +166,8 @@ NS_ASSUME_NONNULL_BEGIN
  @param tintColor The tint to apply to the image or `nil` to not tint
  @param saturationDeltaFactor The factor to multiply the saturation levels by, or `1.0` to not change saturation
  @param maskImage The image to mask the output image with, or `nil` to have no mask
- @return an image with each opted in effect applied
+ @return an image with each opted in effect applied, the unmodified image if the effects could not be
+ rendered, or `nil` if the image (or _maskImage_) has no `CGImage`
  */
 - (nullable UIImage *)tip_imageWithBlurWithRadius:(CGFloat)blurRadius
                                         tintColor:(nullable UIColor *)tintColor
@@ -6,13 +6,15 @@
 //  Copyright © 2020 Twitter. All rights reserved.
 //
 
-#import <Accelerate/Accelerate.h>
 #import <CoreGraphics/CoreGraphics.h>
 #import <UIKit/UIKit.h>
 
 #import "TIP_Project.h"
+#import "TIPColorPalette.h"
 #import "TIPError.h"
 #import "TIPGlobalConfiguration+Project.h"
+#import "TIPImageBlur.h"
+#import "TIPImageResampler.h"
 #import "TIPImageUtils.h"
 #import "UIImage+TIPAdditions.h"
 
@@ -27,17 +29,9 @@ static NSDictionary *TIPImageWritingProperties(UIImage *image,
                                                BOOL isGlobalProperties);
 static CGImageRef __nullable TIPCGImageCreateGrayscale(CGImageRef __nullable imageRef);
 
-struct tip_color_pixel {
-    Byte r, g, b, a;
-};
-
-struct tip_color_entry {
-    struct tip_color_entry * __nullable nextEntry;
-    struct tip_color_pixel pixel;
-};
-
 static const size_t kRGBAByteCount = 4;
-TIPStaticAssert(sizeof(struct tip_color_pixel) == kRGBAByteCount, MISSMATCH_PIXEL_SIZE);
+// Blurs are rendered at 1/n resolution, where n is how many times larger than this their radius is
+static const CGFloat kBlurDownscaleRadius = 4.0;
 
 @implementation UIImage (TIPAdditions)
 
@@ -149,55 +143,21 @@ TIPStaticAssert(sizeof(struct tip_color_pixel) == kRGBAByteCount, MISSMATCH_PIXE
 
     /// Prepare the state
 
-    // we are limited to `maxColorCount` colors (default is 256), track the count as we progress
-    size_t numberOfColors = 0;
-
     // we need a pixel buffer to render into for inspecting each pixel, needs to be zero'd out for premultiplication to work
-    struct tip_color_pixel *pixels = calloc(1, CGImageGetWidth(imageRef) * CGImageGetHeight(imageRef) * kRGBAByteCount);
-
-    // we will pre-allocate "max-colors" empty/zero'd-out "color entries" (default is 256)...
-    // this will be where pull from to add more indexed colors to our tracking
-    struct tip_color_entry * entryPool = calloc(1, sizeof(struct tip_color_entry) * maxColorCount);
-
-    /****
-        This comment presumes max of 256 color palette, but other (smaller) color palette limits work just as well
-     ****/
-    // this is the lookup table, it is a very simple hashmap for finding entries faster than
-    // iterating through all past seen entries (will initially be empty/zero'd-out).
-    //      best case: ~16x faster
-    //      worst case: ~1x speed (no worse than brute force)
-    //      average case: ~6x faster (2.5 megapixel image: ~150ms on iPhone 6, ~70ms on iPhone XR)
-    //
-    // how it works:
-    //     As we inspect every pixel, we need to check if the color already exists and if not, track
-    //       the newly seen color.
-    //     Instead of on every pixel iterating through every past seen color, we can bucket colors
-    //       so that we only have to iterate through all seen colors in that bucket.
-    //     For fast hashing, we will take the 4 significant bits of each of the R, G, B and A
-    //       components and combine those into a 16 bit lookup hash.
-    //     This means we can preallocate the lookup table to have 65,535 buckets.
-    //     Doing more buckets would cost us more RAM at minimal speed gain (already 514KB in
-    //       overhead... 512KB for the lookup table and 2KB for the 256 color entries).
-    //     Doing fewer buckets would save on RAM, but see notable speed reduction.
-    struct tip_color_entry ** lookup_entries = calloc(1, UINT16_MAX * sizeof(struct tip_color_entry *));
-
-    // defer `free` calls for easy cleanup (preallocation makes cleanup fast and easy)
+    const size_t width = CGImageGetWidth(imageRef);
+    const size_t height = CGImageGetHeight(imageRef);
+    void *pixels = calloc(1, width * height * kRGBAByteCount);
     tip_defer(^{
         free(pixels);
-        free(lookup_entries);
-        free(entryPool);
     });
 
-    // Track the next available color entry from our pre-allocated pool
-    struct tip_color_entry * nextEntryPtr = entryPool;
-
     // Create our bitmap context
     CGContextRef context = CGBitmapContextCreate(
-        (void *)pixels,
-        CGImageGetWidth(imageRef),
-        CGImageGetHeight(imageRef),
+        pixels,
+        width,
+        height,
         8,
-        CGImageGetWidth(imageRef) * kRGBAByteCount,
+        width * kRGBAByteCount,
         sRGBColorSpace,
         kCGImageAlphaPremultipliedLast
     );
@@ -210,87 +170,25 @@ TIPStaticAssert(sizeof(struct tip_color_pixel) == kRGBAByteCount, MISSMATCH_PIXE
 
     // Draw the image in the bitmap
     CGContextDrawImage(context,
-                       CGRectMake(0.0f, 0.0f, CGImageGetWidth(imageRef), CGImageGetHeight(imageRef)),
+                       CGRectMake(0.0f, 0.0f, width, height),
                        imageRef);
 
-    // Loop over pixels to compute the color table
-    struct tip_color_pixel * pixelPtr = pixels;
-    struct tip_color_pixel * endPixelPtr = pixelPtr + (CGImageGetHeight(imageRef) * CGImageGetWidth(imageRef));
-    for (; pixelPtr < endPixelPtr; pixelPtr++) {
-
-        if (pixelPtr->a == 0xff) {
-            // fully opaque is always OK
-        } else {
-            // has transparency
-
-            if (!supportsTransparency) {
-                return NO;
-            }
-
-            if (pixelPtr->a == 0x00) {
-                // coerse fully transparent pixels to all match
-                // NOTE: not all transcoders will coerse fully transparent pixels to the same value!
-                // The Twitter Media Pipeline PNG8 transcoder _is_ smart enought though (I wrote it),
-                // so we will maintain that this image CAN be transcoded to an indexed color palette
-                // and it is on whomever is doing the transcoding to be responsible for that.
-                pixelPtr->r = pixelPtr->g = pixelPtr->b = 0x00;
-            } else {
-                // partial alpha (a != 0x00 and a != 0xff)
-                if (!supportsAnyAlpha) {
-                    return NO;
-                }
-            }
-        }
-
-        // Compute our lookup index (hash)
-        // NOTE: this can be written in more compact way but reduces legibility and ultimately the
-        // compiler will optimize it down anyway, so we're preserving legibility.
-        uint16_t lookupIdx = pixelPtr->r >> 4;
-        lookupIdx <<= 4;
-        lookupIdx |= (pixelPtr->g >> 4);
-        lookupIdx <<= 4;
-        lookupIdx |= (pixelPtr->b >> 4);
-        lookupIdx <<= 4;
-        lookupIdx |= (pixelPtr->a >> 4);
-
-        // Get the entry from our hashed lookup
-        struct tip_color_entry *pLastEntry = NULL;
-        struct tip_color_entry *pEntry = lookup_entries[lookupIdx];
-        while (pEntry != NULL) {
-            if (pixelPtr->r == pEntry->pixel.r &&
-                pixelPtr->g == pEntry->pixel.g &&
-                pixelPtr->b == pEntry->pixel.b &&
-                pixelPtr->a == pEntry->pixel.a) {
-                // we have a match! break to indicate we have a match and can continue to the next pixel.
-                break;
-            }
-            pLastEntry = pEntry;
-            pEntry = pLastEntry->nextEntry;
-        }
-
-        if (pEntry != NULL) {
-            // had a match
-            continue;
-        }
-
-        // not found
-        if (numberOfColors >= maxColorCount) {
-            // too many colors!  cannot index this image
-            return NO;
-        }
-
-        // We have room for another color.  Add it to our lookup table.
-        pEntry = nextEntryPtr;
-        nextEntryPtr++;
-        pEntry->pixel = *pixelPtr;
-        if (pLastEntry) {
-            // already had an entry, add to the linked list
-            pLastEntry->nextEntry = pEntry;
-        } else {
-            // no entries for this hash yet, start the linked list
-            lookup_entries[lookupIdx] = pEntry;
-        }
-        numberOfColors++;
+    // Count the colors (concurrently for large images), bailing as soon as there are too many.
+    // NOTE: fully transparent pixels are all counted as the same color, not all transcoders will
+    // coerse fully transparent pixels to the same value!
+    // The Twitter Media Pipeline PNG8 transcoder _is_ smart enought though (I wrote it),
+    // so we will maintain that this image CAN be transcoded to an indexed color palette
+    // and it is on whomever is doing the transcoding to be responsible for that.
+    if (!TIPCollectColorPalette(pixels,
+                                width,
+                                height,
+                                width * kRGBAByteCount,
+                                maxColorCount,
+                                supportsTransparency,
+                                supportsAnyAlpha,
+                                NULL /*palette*/,
+                                NULL /*colorCountOut*/)) {
+        return NO;
     }
 
     // we made it here without an early return, means this image has few enough colors to be indexed
@@ -415,6 +313,110 @@ TIPStaticAssert(sizeof(struct tip_color_pixel) == kRGBAByteCount, MISSMATCH_PIXE
 }
 #endif
 
+- (nullable UIImage *)_resampler_scaleToDimensions:(CGSize)scaledDimensions
+                                             scale:(CGFloat)scale
+                              interpolationQuality:(CGInterpolationQuality)interpolationQuality TIP_OBJC_DIRECT
+{
+    // only static, upright images are resampled, UIKit handles the rest
+    if (self.images.count > 1 || self.imageOrientation != UIImageOrientationUp) {
+        return nil;
+    }
+
+    CGImageRef cgImage = self.CGImage;
+    if (!cgImage) {
+        return nil;
+    }
+
+    const size_t sourceWidth = CGImageGetWidth(cgImage);
+    const size_t sourceHeight = CGImageGetHeight(cgImage);
+    const size_t width = (size_t)scaledDimensions.width;
+    const size_t height = (size_t)scaledDimensions.height;
+    if (!width || !height || width > sourceWidth || height > sourceHeight) {
+        // only downscales
+        return nil;
+    }
+
+    const CGBitmapInfo bitmapInfo = CGImageGetBitmapInfo(cgImage);
+    if (CGImageGetBitsPerComponent(cgImage) != 8 || CGImageGetBitsPerPixel(cgImage) != 32 || TIP_BITMASK_INTERSECTS_FLAGS(bitmapInfo, kCGBitmapFloatComponents)) {
+        return nil;
+    }
+    const CGBitmapInfo byteOrder = bitmapInfo & kCGBitmapByteOrderMask;
+    if (byteOrder != kCGBitmapByteOrderDefault && byteOrder != kCGBitmapByteOrder32Big && byteOrder != kCGBitmapByteOrder32Little) {
+        return nil;
+    }
+    CGColorSpaceRef colorSpace = CGImageGetColorSpace(cgImage);
+    if (!colorSpace || CGColorSpaceGetModel(colorSpace) != kCGColorSpaceModelRGB) {
+        return nil;
+    }
+
+    NSInteger alphaChannelIndex = -1;
+    switch ((CGImageAlphaInfo)(bitmapInfo & kCGBitmapAlphaInfoMask)) {
+        case kCGImageAlphaNoneSkipFirst:
+        case kCGImageAlphaNoneSkipLast:
+            break;
+        case kCGImageAlphaPremultipliedFirst:
+        case kCGImageAlphaPremultipliedLast:
+        {
+            const BOOL alphaFirst = (bitmapInfo & kCGBitmapAlphaInfoMask) == kCGImageAlphaPremultipliedFirst;
+            const BOOL littleEndian = byteOrder == kCGBitmapByteOrder32Little;
+            alphaChannelIndex = (alphaFirst != littleEndian) ? 0 : 3;
+            break;
+        }
+        default:
+            // straight alpha cannot be filtered without bleeding the color of transparent pixels
+            return nil;
+    }
+
+    // this is a copy of all the source pixels (decoding them first if the image has not been decoded),
+    // so scaling this way peaks at the source's size twice over plus the destination's
+    const size_t sourceBytesPerRow = CGImageGetBytesPerRow(cgImage);
+    CFDataRef sourceData = CGDataProviderCopyData(CGImageGetDataProvider(cgImage));
+    TIPDeferRelease(sourceData);
+    if (!sourceData || (size_t)CFDataGetLength(sourceData) < (sourceBytesPerRow * (sourceHeight - 1)) + (sourceWidth * kRGBAByteCount)) {
+        return nil;
+    }
+
+    const size_t bytesPerRow = width * kRGBAByteCount;
+    NSMutableData *data = [NSMutableData dataWithLength:bytesPerRow * height];
+    if (!data) {
+        return nil;
+    }
+    if (!TIPResamplePixels(CFDataGetBytePtr(sourceData),
+                           sourceWidth,
+                           sourceHeight,
+                           sourceBytesPerRow,
+                           data.mutableBytes,
+                           width,
+                           height,
+                           bytesPerRow,
+                           alphaChannelIndex,
+                           TIPImageResamplingFilterFromInterpolationQuality(interpolationQuality))) {
+        return nil;
+    }
+
+    CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)data);
+    TIPDeferRelease(provider);
+    CGImageRef scaledCGImage = CGImageCreate(width,
+                                             height,
+                                             8 /* bitsPerComponent */,
+                                             32 /* bitsPerPixel */,
+                                             bytesPerRow,
+                                             colorSpace,
+                                             bitmapInfo,
+                                             provider,
+                                             NULL /* decode */,
+                                             false /* shouldInterpolate */,
+                                             kCGRenderingIntentDefault);
+    TIPDeferRelease(scaledCGImage);
+    if (!scaledCGImage) {
+        return nil;
+    }
+
+    return [UIImage imageWithCGImage:scaledCGImage
+                               scale:((0.0 == scale) ? [UIScreen mainScreen].scale : scale)
+                         orientation:UIImageOrientationUp];
+}
+
 - (UIImage *)_uikit_scaleToDimensions:(CGSize)scaledDimensions
                                 scale:(CGFloat)scale
                  interpolationQuality:(CGInterpolationQuality)interpolationQuality TIP_OBJC_DIRECT
@@ -533,10 +535,20 @@ TIPStaticAssert(sizeof(struct tip_color_pixel) == kRGBAByteCount, MISSMATCH_PIXE
 
         const CGInterpolationQuality interpolationQualityValue = (interpolationQuality) ? (CGInterpolationQuality)interpolationQuality.intValue : [TIPGlobalConfiguration sharedInstance].defaultInterpolationQuality;
 
-        // scale with UIKit at screen scale
-        image = [self _uikit_scaleToDimensions:scaledTargetDimensions
-                                         scale:0.0 /*auto*/
-                          interpolationQuality:interpolationQualityValue];
+        image = nil;
+        if ([TIPGlobalConfiguration sharedInstance].isImageResamplerEnabled) {
+            // resample the pixels directly at screen scale
+            image = [self _resampler_scaleToDimensions:scaledTargetDimensions
+                                                 scale:0.0 /*auto*/
+                                  interpolationQuality:interpolationQualityValue];
+        }
+
+        if (!image) {
+            // scale with UIKit at screen scale
+            image = [self _uikit_scaleToDimensions:scaledTargetDimensions
+                                             scale:0.0 /*auto*/
+                              interpolationQuality:interpolationQualityValue];
+        }
 
         // image = [self _cg_scaleToDimensions:scaledTargetDimensions scale:0.0 /*auto*/ interpolationQuality:interpolationQualityValue];
 
@@ -808,28 +820,35 @@ TIPStaticAssert(sizeof(struct tip_color_pixel) == kRGBAByteCount, MISSMATCH_PIXE
         const BOOL hasBlur = blurRadius > __FLT_EPSILON__;
         const BOOL hasSaturationChange = fabs(saturationDeltaFactor - 1.) > __FLT_EPSILON__;
         if (hasBlur || hasSaturationChange) {
-            UIGraphicsBeginImageContextWithOptions(imageSize, NO, scale);
-
-            CGContextRef effectInContext = UIGraphicsGetCurrentContext();
-            CGContextScaleCTM(effectInContext, 1.0, -1.0);
-            CGContextTranslateCTM(effectInContext, 0, -imageSize.height);
-            CGContextDrawImage(effectInContext, imageRect, image.CGImage);
-
-            vImage_Buffer effectInBuffer;
-            effectInBuffer.data     = CGBitmapContextGetData(effectInContext);
-            effectInBuffer.width    = CGBitmapContextGetWidth(effectInContext);
-            effectInBuffer.height   = CGBitmapContextGetHeight(effectInContext);
-            effectInBuffer.rowBytes = CGBitmapContextGetBytesPerRow(effectInContext);
-
-            UIGraphicsBeginImageContextWithOptions(imageSize, NO, scale);
-
-            CGContextRef effectOutContext = UIGraphicsGetCurrentContext();
-            vImage_Buffer effectOutBuffer;
-            effectOutBuffer.data     = CGBitmapContextGetData(effectOutContext);
-            effectOutBuffer.width    = CGBitmapContextGetWidth(effectOutContext);
-            effectOutBuffer.height   = CGBitmapContextGetHeight(effectOutContext);
-            effectOutBuffer.rowBytes = CGBitmapContextGetBytesPerRow(effectOutContext);
+            // A blur hides detail finer than a fraction of its radius, so a large blur is rendered at
+            // a fraction of the resolution (and stretched when drawn) which makes every pass cheaper
+            const CGFloat downscale = (hasBlur) ? MAX((CGFloat)1.0, floor(blurRadius / kBlurDownscaleRadius)) : 1.0;
+            const size_t effectWidth = (size_t)MAX((CGFloat)1.0, round(imageSize.width * scale / downscale));
+            const size_t effectHeight = (size_t)MAX((CGFloat)1.0, round(imageSize.height * scale / downscale));
+
+            // keep the source's colors (such as Display P3), sRGB when its color space cannot be drawn into as RGB
+            CGColorSpaceRef colorSpace = CGColorSpaceRetain(CGImageGetColorSpace(image.CGImage));
+            if (!colorSpace || !CGColorSpaceSupportsOutput(colorSpace) || CGColorSpaceGetModel(colorSpace) != kCGColorSpaceModelRGB) {
+                CGColorSpaceRelease(colorSpace);
+                colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+            }
+            TIPDeferRelease(colorSpace);
+            // premultiplied BGRA, the channel order of the saturation matrix
+            CGContextRef effectContext = CGBitmapContextCreate(NULL /* void * data */,
+                                                               effectWidth,
+                                                               effectHeight,
+                                                               8 /* bitsPerComponent */,
+                                                               0 /* bytesPerRow (auto) */,
+                                                               colorSpace,
+                                                               kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
+            TIPDeferRelease(effectContext);
+            if (!effectContext) {
+                return;
+            }
+            CGContextSetInterpolationQuality(effectContext, kCGInterpolationMedium);
+            CGContextDrawImage(effectContext, CGRectMake(0, 0, effectWidth, effectHeight), image.CGImage);
 
+            size_t boxSize = 1;
             if (hasBlur) {
                 // A description of how to compute the box kernel width from the Gaussian
                 // radius (aka standard deviation) appears in the SVG spec:
@@ -843,51 +862,38 @@ TIPStaticAssert(sizeof(struct tip_color_pixel) == kRGBAByteCount, MISSMATCH_PIXE
                 //
                 // ... if d is odd, use three box-blurs of size 'd', centered on the output pixel.
                 //
-                const CGFloat inputRadius = blurRadius;
-                uint32_t radius = (uint32_t)floor(inputRadius * 3. * sqrt(2 * M_PI) / 4 + 0.5);
-                if (radius % 2 != 1) {
-                    radius += 1; // force radius to be odd so that the three box-blur methodology works.
-                }
-                vImageBoxConvolve_ARGB8888(&effectInBuffer, &effectOutBuffer, NULL, 0, 0, radius, radius, 0, kvImageEdgeExtend);
-                vImageBoxConvolve_ARGB8888(&effectOutBuffer, &effectInBuffer, NULL, 0, 0, radius, radius, 0, kvImageEdgeExtend);
-                vImageBoxConvolve_ARGB8888(&effectInBuffer, &effectOutBuffer, NULL, 0, 0, radius, radius, 0, kvImageEdgeExtend);
-            }
-
-            const BOOL swapEffectImageBuffer = (hasSaturationChange && hasBlur);
-            if (hasSaturationChange) {
-                const CGFloat s = saturationDeltaFactor;
-                const CGFloat floatingPointSaturationMatrix[] = {
-                    0.0722f + (0.9278f * s),  0.0722f - (0.0722f * s),  0.0722f - (0.0722f * s),  0,
-                    0.7152f - (0.7152f * s),  0.7152f + (0.2848f * s),  0.7152f - (0.7152f * s),  0,
-                    0.2126f - (0.2126f * s),  0.2126f - (0.2126f * s),  0.2126f + (0.7873f * s),  0,
-                                          0,                        0,                        0,  1,
-                };
-                const int32_t divisor = 256;
-                const NSUInteger matrixSize = sizeof(floatingPointSaturationMatrix)/sizeof(floatingPointSaturationMatrix[0]);
-                int16_t saturationMatrix[matrixSize];
-                for (NSUInteger i = 0; i < matrixSize; ++i) {
-#if CGFLOAT_IS_DOUBLE
-                    saturationMatrix[i] = (int16_t)round(floatingPointSaturationMatrix[i] * divisor);
-#else
-                    saturationMatrix[i] = (int16_t)roundf(floatingPointSaturationMatrix[i] * divisor);
-#endif
-                }
-                if (swapEffectImageBuffer) {
-                    vImageMatrixMultiply_ARGB8888(&effectOutBuffer, &effectInBuffer, saturationMatrix, divisor, NULL, NULL, kvImageNoFlags);
-                }else {
-                    vImageMatrixMultiply_ARGB8888(&effectInBuffer, &effectOutBuffer, saturationMatrix, divisor, NULL, NULL, kvImageNoFlags);
+                const CGFloat inputRadius = blurRadius / downscale;
+                boxSize = (size_t)floor(inputRadius * 3. * sqrt(2 * M_PI) / 4 + 0.5);
+                if (boxSize % 2 != 1) {
+                    boxSize += 1; // force box size to be odd so that the three box-blur methodology works.
                 }
             }
 
-            if (!swapEffectImageBuffer) {
-                effectImage = UIGraphicsGetImageFromCurrentImageContext();
+            const float s = (float)saturationDeltaFactor;
+            const float saturationMatrix[] = {
+                0.0722f + (0.9278f * s),  0.0722f - (0.0722f * s),  0.0722f - (0.0722f * s),  0,
+                0.7152f - (0.7152f * s),  0.7152f + (0.2848f * s),  0.7152f - (0.7152f * s),  0,
+                0.2126f - (0.2126f * s),  0.2126f - (0.2126f * s),  0.2126f + (0.7873f * s),  0,
+                                      0,                        0,                        0,  1,
+            };
+
+            // the saturation change is applied as the last blur pass stores its pixels
+            if (!TIPBoxBlurPixels(CGBitmapContextGetData(effectContext),
+                                  effectWidth,
+                                  effectHeight,
+                                  CGBitmapContextGetBytesPerRow(effectContext),
+                                  boxSize,
+                                  3 /* alphaChannelIndex */,
+                                  (hasSaturationChange) ? saturationMatrix : NULL)) {
+                return;
             }
-            UIGraphicsEndImageContext();
 
-            if (swapEffectImageBuffer) {
-                effectImage = UIGraphicsGetImageFromCurrentImageContext();
+            CGImageRef effectImageRef = CGBitmapContextCreateImage(effectContext);
+            TIPDeferRelease(effectImageRef);
+            if (!effectImageRef) {
+                return;
             }
-            UIGraphicsEndImageContext();
+            effectImage = [UIImage imageWithCGImage:effectImageRef];
         }
 
         // Set up output context.
@@ -909,6 +915,7 @@ TIPStaticAssert(sizeof(struct tip_color_pixel) == kRGBAByteCount, MISSMATCH_PIXE
             if (maskImage) {
                 CGContextClipToMask(outputContext, imageRect, maskImage.CGImage);
             }
+            CGContextSetInterpolationQuality(outputContext, kCGInterpolationMedium); // stretches a downscaled blur
             CGContextDrawImage(outputContext, imageRect, effectImage.CGImage);
             CGContextRestoreGState(outputContext);
         }
@@ -925,7 +932,8 @@ TIPStaticAssert(sizeof(struct tip_color_pixel) == kRGBAByteCount, MISSMATCH_PIXE
         outputImage = UIGraphicsGetImageFromCurrentImageContext();
     });
 
-    return outputImage;
+    // the effects could not be rendered, the image is better than no image
+    return outputImage ?: image;
 }
 
 #pragma mark Decode Methods
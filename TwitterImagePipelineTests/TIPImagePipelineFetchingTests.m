@@ -8,10 +8,12 @@
 
 #import "TIP_Project.h"
 #import "TIPImageDiskCache.h"
+#import "TIPImageDownloader.h"
 #import "TIPImageMemoryCache.h"
 #import "TIPImagePipeline+Project.h"
 #import "TIPImageRenderedCache.h"
 #import "TIPTestImageFetchDownloadInternalWithStubbing.h"
+#import "TIPTestURLProtocol.h"
 #import "TIPTests.h"
 #import "TIPTestsSharedUtils.h"
 
@@ -25,6 +27,8 @@ typedef struct _TIPImageFetchTestStruct {
 
 @interface TIPImagePipelineFetchingBaseTests : TIPImagePipelineBaseTests
 - (void)runFetching:(TIPImageFetchTestStruct)imageStruct; // execute fetching test
+- (void)runFetchingWithParallelRanges:(TIPImageFetchTestStruct)imageStruct; // execute fetching test with downloads split into byte ranges
+- (void)runFetchingWithDecodeBacklog:(TIPImageFetchTestStruct)imageStruct; // execute fetching test with reads paused whenever decoding falls behind
 @end
 
 @interface TIPImagePipelineFetchingPNGTests : TIPImagePipelineFetchingBaseTests
@@ -256,6 +260,26 @@ typedef struct _TIPImageFetchTestStruct {
     }
 }
 
+- (void)runFetchingWithParallelRanges:(TIPImageFetchTestStruct)imageStruct
+{
+    // the stub serves each range throttled to the bitrate, so ranges really do load concurrently
+    TIPGlobalConfiguration *config = [TIPGlobalConfiguration sharedInstance];
+    const NSUInteger minimumBytes = config.parallelRangeDownloadMinimumBytes;
+    config.parallelRangeDownloadMinimumBytes = 256 * 1024;
+    [self runFetching:imageStruct];
+    config.parallelRangeDownloadMinimumBytes = minimumBytes;
+}
+
+- (void)runFetchingWithDecodeBacklog:(TIPImageFetchTestStruct)imageStruct
+{
+    // any bytes received while a progressive render is in flight pause the download
+    TIPGlobalConfiguration *config = [TIPGlobalConfiguration sharedInstance];
+    const NSUInteger maxBytes = config.downloadDecodeBacklogMaxBytes;
+    config.downloadDecodeBacklogMaxBytes = 1;
+    [self runFetching:imageStruct];
+    config.downloadDecodeBacklogMaxBytes = maxBytes;
+}
+
 @end
 
 @implementation TIPImagePipelineFetchingPNGTests
@@ -288,6 +312,227 @@ typedef struct _TIPImageFetchTestStruct {
     [self runFetching:imageStruct];
 }
 
+- (void)testFetchingPJPEG_isProgressive_decodeBacklog
+{
+    TIPImageFetchTestStruct imageStruct = { TIPImageTypeJPEG, YES, YES, NO, 1 * kMegaBits };
+    [self runFetchingWithDecodeBacklog:imageStruct];
+}
+
+- (void)testFetchingJPEG_parallelRanges
+{
+    TIPImageFetchTestStruct imageStruct = { TIPImageTypeJPEG, NO, NO, NO, 2 * kMegaBits };
+    [self runFetchingWithParallelRanges:imageStruct];
+}
+
+- (void)testFetchingJPEG_parallelRanges_sendsRangeRequests
+{
+    NSArray<NSURLRequest *> *requests = [self _fetchJPEGWithParallelRangesStallingRange:NO];
+
+    // the original request has no range, every request after it asks for a validated range
+    XCTAssertGreaterThan(requests.count, (NSUInteger)1);
+    XCTAssertNil([requests.firstObject valueForHTTPHeaderField:@"Range"]);
+    NSMutableSet<NSString *> *ranges = [[NSMutableSet alloc] init];
+    for (NSURLRequest *rangeRequest in [requests subarrayWithRange:NSMakeRange(1, requests.count - 1)]) {
+        NSString *range = [rangeRequest valueForHTTPHeaderField:@"Range"];
+        XCTAssertTrue([range hasPrefix:@"bytes="], @"Range: %@", range);
+        XCTAssertNotNil([rangeRequest valueForHTTPHeaderField:@"If-Range"]);
+        if (range) {
+            [ranges addObject:range];
+        }
+    }
+    XCTAssertEqual(ranges.count, requests.count - 1);
+}
+
+- (void)testFetchingJPEG_parallelRanges_reissuesStalledRange
+{
+    NSArray<NSURLRequest *> *requests = [self _fetchJPEGWithParallelRangesStallingRange:YES];
+
+    // the stalled range received nothing, so it is re-issued with the same range
+    NSCountedSet<NSString *> *ranges = [[NSCountedSet alloc] init];
+    for (NSURLRequest *rangeRequest in requests) {
+        NSString *range = [rangeRequest valueForHTTPHeaderField:@"Range"];
+        if (range) {
+            [ranges addObject:range];
+        }
+    }
+    NSUInteger reissuedCount = 0;
+    for (NSString *range in ranges) {
+        if ([ranges countForObject:range] > 1) {
+            reissuedCount++;
+        }
+    }
+    XCTAssertEqual(reissuedCount, (NSUInteger)1, @"%@", requests);
+}
+
+- (NSArray<NSURLRequest *> *)_fetchJPEGWithParallelRangesStallingRange:(BOOL)stallRange
+{
+    TIPImagePipelineTestFetchRequest *request = [[TIPImagePipelineTestFetchRequest alloc] init];
+    request.imageType = TIPImageTypeJPEG;
+    request.imageURL = [TIPImagePipelineBaseTests dummyURLWithPath:[NSUUID UUID].UUIDString];
+    request.targetDimensions = kCarnivalImageDimensions;
+    request.targetContentMode = UIViewContentModeScaleAspectFit;
+
+    // throttled so the original request is still loading when its ranges are issued,
+    // the stalled range (the first one issued) is held far longer than the stall timeout
+    NSData *data = [NSData dataWithContentsOfFile:request.cannedImageFilePath options:NSDataReadingMappedIfSafe error:NULL];
+    TIPTestURLProtocolResponseConfig *responseConfig = [[TIPTestURLProtocolResponseConfig alloc] init];
+    responseConfig.bps = 4 * kMegaBits;
+    if (stallRange) {
+        responseConfig.stall = 60 * 1000;
+        responseConfig.firstStalledRequestIndex = 1;
+        responseConfig.stalledRequestCount = 1;
+    }
+    [TIPTestURLProtocol registerURLResponse:[NSHTTPURLResponse tip_responseWithRequestURL:request.imageURL dataLength:data.length responseMIMEType:@"image/jpeg"]
+                                       body:data
+                                     config:responseConfig
+                               withEndpoint:request.imageURL];
+    tip_defer(^{
+        id<TIPImageFetchDownloadProviderWithStubbingSupport> provider = (id<TIPImageFetchDownloadProviderWithStubbingSupport>)[TIPGlobalConfiguration sharedInstance].imageFetchDownloadProvider;
+        [provider removeDownloadStubForRequestURL:request.imageURL];
+    });
+
+    TIPGlobalConfiguration *config = [TIPGlobalConfiguration sharedInstance];
+    const NSUInteger minimumBytes = config.parallelRangeDownloadMinimumBytes;
+    config.parallelRangeDownloadMinimumBytes = 256 * 1024;
+    tip_defer(^{
+        config.parallelRangeDownloadMinimumBytes = minimumBytes;
+    });
+
+    [[TIPImagePipelineBaseTests sharedPipeline] clearMemoryCaches];
+    [[TIPImagePipelineBaseTests sharedPipeline] clearDiskCache];
+
+    TIPImagePipelineTestContext *context = [[TIPImagePipelineTestContext alloc] init];
+    TIPImageFetchOperation *op = [[TIPImagePipelineBaseTests sharedPipeline] undeprecatedFetchImageWithRequest:request context:context delegate:self];
+    [op waitUntilFinishedWithoutBlockingRunLoop];
+
+    XCTAssertNotNil(context.finalImageContainer);
+    XCTAssertNil(context.finalError);
+    XCTAssertEqual(context.finalSource, TIPImageLoadSourceNetwork);
+    if (stallRange) {
+        // finished on the re-issued range rather than waiting out the stall
+        XCTAssertLessThan(op.metrics.totalDuration, 60.0);
+    }
+
+    NSArray<NSURLRequest *> *requests = [TIPTestURLProtocol requestsForEndpoint:request.imageURL];
+    return requests;
+}
+
+- (void)testFetchingJPEG_hedged
+{
+    TIPImagePipelineTestFetchRequest *request = [[TIPImagePipelineTestFetchRequest alloc] init];
+    request.imageType = TIPImageTypeJPEG;
+    request.imageURL = [TIPImagePipelineBaseTests dummyURLWithPath:[NSUUID UUID].UUIDString];
+    request.targetDimensions = kCarnivalImageDimensions;
+    request.targetContentMode = UIViewContentModeScaleAspectFit;
+
+    // the first request stalls long past the hedge while the hedged request is served right away
+    NSData *data = [NSData dataWithContentsOfFile:request.cannedImageFilePath options:NSDataReadingMappedIfSafe error:NULL];
+    TIPTestURLProtocolResponseConfig *responseConfig = [[TIPTestURLProtocolResponseConfig alloc] init];
+    responseConfig.stall = 10 * 1000;
+    responseConfig.stalledRequestCount = 1;
+    [TIPTestURLProtocol registerURLResponse:[NSHTTPURLResponse tip_responseWithRequestURL:request.imageURL dataLength:data.length responseMIMEType:@"image/jpeg"]
+                                       body:data
+                                     config:responseConfig
+                               withEndpoint:request.imageURL];
+    tip_defer(^{
+        id<TIPImageFetchDownloadProviderWithStubbingSupport> provider = (id<TIPImageFetchDownloadProviderWithStubbingSupport>)[TIPGlobalConfiguration sharedInstance].imageFetchDownloadProvider;
+        [provider removeDownloadStubForRequestURL:request.imageURL];
+    });
+
+    TIPGlobalConfiguration *config = [TIPGlobalConfiguration sharedInstance];
+    const float percentile = config.hedgedDownloadPercentile;
+    const NSTimeInterval minimumDelay = config.hedgedDownloadMinimumDelay;
+    const float budget = config.hedgedDownloadBudget;
+    config.hedgedDownloadPercentile = 0.95f;
+    config.hedgedDownloadMinimumDelay = 0.5;
+    config.hedgedDownloadBudget = 1.0f;
+
+    TIPImagePipelineTestContext *context = [[TIPImagePipelineTestContext alloc] init];
+    TIPImageFetchOperation *op = [[TIPImagePipelineBaseTests sharedPipeline] undeprecatedFetchImageWithRequest:request context:context delegate:self];
+    [op waitUntilFinishedWithoutBlockingRunLoop];
+
+    config.hedgedDownloadPercentile = percentile;
+    config.hedgedDownloadMinimumDelay = minimumDelay;
+    config.hedgedDownloadBudget = budget;
+
+    XCTAssertNotNil(context.finalImageContainer);
+    XCTAssertEqual(context.finalSource, TIPImageLoadSourceNetwork);
+    XCTAssertLessThan(op.metrics.totalDuration, 10.0);
+
+    TIPImageFetchMetricInfo *info = [op.metrics metricInfoForSource:TIPImageLoadSourceNetwork];
+    XCTAssertTrue(info.networkRequestWasHedged);
+    XCTAssertTrue(info.networkHedgedRequestWon);
+}
+
+- (void)_runOnScreenFetchWithPrefetchCount:(NSUInteger)prefetchCount
+                lowPriorityDownloadPausing:(BOOL)pausing
+{
+    TIPGlobalConfiguration *config = [TIPGlobalConfiguration sharedInstance];
+    const NSInteger maxCount = config.maxConcurrentImagePipelineDownloadCount;
+    const BOOL pausingEnabled = config.isLowPriorityDownloadPausingEnabled;
+    config.maxConcurrentImagePipelineDownloadCount = (NSInteger)prefetchCount;
+    config.lowPriorityDownloadPausingEnabled = pausing;
+    [[TIPImagePipelineBaseTests sharedPipeline] clearMemoryCaches];
+    [[TIPImagePipelineBaseTests sharedPipeline] clearDiskCache];
+
+    // heavy prefetch takes every download slot
+    NSMutableArray<TIPImageFetchOperation *> *prefetchOps = [[NSMutableArray alloc] init];
+    NSMutableArray<TIPImagePipelineTestContext *> *prefetchContexts = [[NSMutableArray alloc] init];
+    for (NSUInteger i = 0; i < prefetchCount; i++) {
+        TIPImagePipelineTestFetchRequest *request = [[TIPImagePipelineTestFetchRequest alloc] init];
+        request.imageType = TIPImageTypeJPEG;
+        request.imageURL = [TIPImagePipelineBaseTests dummyURLWithPath:[NSUUID UUID].UUIDString];
+        request.targetDimensions = kCarnivalImageDimensions;
+        request.targetContentMode = UIViewContentModeScaleAspectFit;
+        [TIPImagePipelineTestFetchRequest stubRequest:request bitrate:4 * kMegaBits resumable:YES];
+
+        TIPImagePipelineTestContext *context = [[TIPImagePipelineTestContext alloc] init];
+        TIPImageFetchOperation *op = [[TIPImagePipelineBaseTests sharedPipeline] undeprecatedFetchImageWithRequest:request context:context delegate:self];
+        op.priority = NSOperationQueuePriorityLow;
+        [prefetchOps addObject:op];
+        [prefetchContexts addObject:context];
+    }
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+
+    // the on-screen image
+    TIPImagePipelineTestFetchRequest *request = [[TIPImagePipelineTestFetchRequest alloc] init];
+    request.imageType = TIPImageTypeJPEG;
+    request.imageURL = [TIPImagePipelineBaseTests dummyURLWithPath:[NSUUID UUID].UUIDString];
+    request.targetDimensions = kCarnivalImageDimensions;
+    request.targetContentMode = UIViewContentModeScaleAspectFit;
+    [TIPImagePipelineTestFetchRequest stubRequest:request bitrate:16 * kMegaBits resumable:YES];
+
+    TIPImagePipelineTestContext *context = [[TIPImagePipelineTestContext alloc] init];
+    TIPImageFetchOperation *op = [[TIPImagePipelineBaseTests sharedPipeline] undeprecatedFetchImageWithRequest:request context:context delegate:self];
+    NSUInteger maxPausedCount = 0;
+    while (!op.isFinished) {
+        maxPausedCount = MAX(maxPausedCount, [[TIPImageDownloader sharedInstance] pausedDownloadCount]);
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    XCTAssertNotNil(context.finalImageContainer);
+    XCTAssertEqual(context.finalSource, TIPImageLoadSourceNetwork);
+
+    // the prefetches are paused while the on-screen image loads, and only then
+    XCTAssertEqual(maxPausedCount, (pausing) ? prefetchCount : 0);
+
+    // paused prefetches pick up where they left off
+    for (NSUInteger i = 0; i < prefetchCount; i++) {
+        [prefetchOps[i] waitUntilFinishedWithoutBlockingRunLoop];
+        XCTAssertNotNil(prefetchContexts[i].finalImageContainer);
+        XCTAssertEqual(prefetchContexts[i].finalSource, TIPImageLoadSourceNetwork);
+    }
+    XCTAssertEqual([[TIPImageDownloader sharedInstance] pausedDownloadCount], (NSUInteger)0);
+
+    config.maxConcurrentImagePipelineDownloadCount = maxCount;
+    config.lowPriorityDownloadPausingEnabled = pausingEnabled;
+}
+
+- (void)testFetchingJPEG_pausingLowPriorityDownloads
+{
+    [self _runOnScreenFetchWithPrefetchCount:2 lowPriorityDownloadPausing:NO];
+    [self _runOnScreenFetchWithPrefetchCount:2 lowPriorityDownloadPausing:YES];
+}
+
 @end
 
 @implementation TIPImagePipelineFetchingJPEG2000Tests
@@ -322,6 +567,12 @@ typedef struct _TIPImageFetchTestStruct {
     [self runFetching:imageStruct];
 }
 
+- (void)testFetchingGIF_parallelRanges
+{
+    TIPImageFetchTestStruct imageStruct = { TIPImageTypeGIF, NO, NO, YES, 160 * kKiloBits };
+    [self runFetchingWithParallelRanges:imageStruct];
+}
+
 - (void)testFetchingSingleFrameGIF
 {
     NSBundle *thisBundle = TIPTestsResourceBundle();
@@ -6,8 +6,15 @@
 //  Copyright (c) 2015 Twitter. All rights reserved.
 //
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
 #import "TIPGlobalConfiguration+Project.h"
+#import "TIPImageCacheEntry.h"
 #import "TIPImageDiskCache.h"
+#import "TIPImageFetchDownloadInternal.h"
+#import "TIPImageHotSet.h"
 #import "TIPImageMemoryCache.h"
 #import "TIPImagePipeline+Project.h"
 #import "TIPImageRenderedCache.h"
@@ -35,6 +42,143 @@
 @interface TIPImagePipelineTests_Three : TIPImagePipelineTests_Base
 @end
 
+@interface TIPImagePipelineTests_Pruning : TIPImagePipelineTests_Base
+@end
+
+@interface TIPImagePipelineTests_HotSet : TIPImagePipelineTests_Base
+@end
+
+// A minimal HTTP/1.1 server on the loopback interface that keeps connections alive,
+// for measuring whether requests reuse a connection
+@interface TIPTestLoopbackHTTPServer : NSObject
+@property (nonatomic, readonly) NSURL *origin;
+@property (atomic, readonly) NSUInteger acceptedConnectionCount;
+@property (atomic, readonly, copy) NSArray<NSString *> *requestLines;
+- (void)stop;
+@end
+
+@implementation TIPTestLoopbackHTTPServer
+{
+    int _listenFD;
+    dispatch_source_t _acceptSource;
+    NSMutableArray<NSNumber *> *_connectionFDs;
+    NSMutableArray<NSString *> *_requestLines;
+}
+
+- (instancetype)init
+{
+    if (self = [super init]) {
+        _connectionFDs = [[NSMutableArray alloc] init];
+        _requestLines = [[NSMutableArray alloc] init];
+        _listenFD = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address = { 0 };
+        address.sin_len = sizeof(address);
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addressLength = sizeof(address);
+        if (_listenFD < 0 || bind(_listenFD, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(_listenFD, 8) != 0 || getsockname(_listenFD, (struct sockaddr *)&address, &addressLength) != 0) {
+            return self;
+        }
+        _origin = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%u", ntohs(address.sin_port)]];
+
+        _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, (uintptr_t)_listenFD, 0, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0));
+        __weak typeof(self) weakSelf = self;
+        const int listenFD = _listenFD;
+        dispatch_source_set_event_handler(_acceptSource, ^{
+            const int connectionFD = accept(listenFD, NULL, NULL);
+            if (connectionFD >= 0) {
+                [weakSelf _serveConnection:connectionFD];
+            }
+        });
+        dispatch_resume(_acceptSource);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stop];
+}
+
+- (void)stop
+{
+    @synchronized (self) {
+        if (_acceptSource) {
+            dispatch_source_cancel(_acceptSource);
+            _acceptSource = nil;
+            close(_listenFD);
+        }
+        for (NSNumber *connectionFD in _connectionFDs) {
+            shutdown(connectionFD.intValue, SHUT_RDWR);
+        }
+        [_connectionFDs removeAllObjects];
+    }
+}
+
+- (NSArray<NSString *> *)requestLines
+{
+    @synchronized (self) {
+        return [_requestLines copy];
+    }
+}
+
+- (void)_serveConnection:(int)connectionFD
+{
+    @synchronized (self) {
+        _acceptedConnectionCount++;
+        [_connectionFDs addObject:@(connectionFD)];
+    }
+
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+        NSMutableData *buffer = [[NSMutableData alloc] init];
+        NSData *headerTerminator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+        uint8_t bytes[4096];
+        ssize_t readCount;
+        while ((readCount = read(connectionFD, bytes, sizeof(bytes))) > 0) {
+            [buffer appendBytes:bytes length:(NSUInteger)readCount];
+            NSRange range;
+            while ((range = [buffer rangeOfData:headerTerminator options:0 range:NSMakeRange(0, buffer.length)]).location != NSNotFound) {
+                NSString *header = [[NSString alloc] initWithData:[buffer subdataWithRange:NSMakeRange(0, range.location)] encoding:NSASCIIStringEncoding];
+                [buffer replaceBytesInRange:NSMakeRange(0, NSMaxRange(range)) withBytes:NULL length:0];
+                NSString *requestLine = [header componentsSeparatedByString:@"\r\n"].firstObject ?: @"";
+                @synchronized (self) {
+                    [self->_requestLines addObject:requestLine];
+                }
+                // HEAD responses have the headers of a GET, without the body
+                NSString *response = [requestLine hasPrefix:@"HEAD "] ? @"HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\n" : @"HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nTIP!";
+                NSData *responseData = [response dataUsingEncoding:NSASCIIStringEncoding];
+                (void)write(connectionFD, responseData.bytes, responseData.length);
+            }
+        }
+        close(connectionFD);
+    });
+}
+
+@end
+
+static TIPImageCacheEntry *_TestCacheEntry(NSString *identifier, CGSize imageSize, NSUInteger dataLength);
+static TIPImageCacheEntry *_TestCacheEntry(NSString *identifier, CGSize imageSize, NSUInteger dataLength)
+{
+    UIGraphicsImageRendererFormat *format = [[UIGraphicsImageRendererFormat alloc] init];
+    format.scale = 1;
+    format.preferredRange = UIGraphicsImageRendererFormatRangeStandard;
+    UIGraphicsImageRenderer *renderer = [[UIGraphicsImageRenderer alloc] initWithSize:imageSize format:format];
+    UIImage *image = [renderer imageWithActions:^(UIGraphicsImageRendererContext *rendererContext) {
+        [UIColor.redColor setFill];
+        UIRectFill(CGRectMake(0, 0, imageSize.width, imageSize.height));
+    }];
+
+    TIPImageCacheEntry *entry = [[TIPImageCacheEntry alloc] init];
+    entry.identifier = identifier;
+    entry.completeImage = [[TIPImageContainer alloc] initWithImage:image];
+    entry.completeImageData = [NSMutableData dataWithLength:dataLength];
+    entry.completeImageContext = [[TIPCompleteImageEntryContext alloc] init];
+    entry.completeImageContext.dimensions = imageSize;
+    entry.completeImageContext.TTL = 60.0;
+    entry.completeImageContext.URL = [TIPImagePipelineBaseTests dummyURLWithPath:[@"/" stringByAppendingString:identifier]];
+    return entry;
+}
+
 @implementation TIPImagePipelineTests_Base
 
 - (void)runFillingTheCaches:(TIPImagePipeline *)pipeline bps:(uint64_t)bps testCacheHits:(BOOL)testCacheHits
@@ -106,23 +250,10 @@
 
 - (void)checkFileAttributes:(TIPImagePipeline *)pipeline
 {
-    // Check the file attributes
+    // Check the copied file is just the image (entry metadata is inline in the cache's files, not in xattrs)
     XCTestExpectation *expectation = [self expectationWithDescription:@"wait for inspection to complete expectation"];
-    __block NSDictionary<NSString *, id> *attributes = nil;
     __block NSArray<NSString *> *attributeNames = nil;
-    NSDictionary<NSString *, Class> *attributeKeyKindMap = @{
-                                                             @"ANI" : [NSNumber class] /*BOOL*/,
-                                                             @"LAD" : [NSDate class],
-                                                             @"LMD" : [NSString class],
-                                                             @"TTL" : [NSNumber class],
-                                                             @"URL" : [NSURL class],
-                                                             @"clen" : [NSNumber class],
-                                                             @"dX" : [NSNumber class],
-                                                             @"dY" : [NSNumber class],
-                                                             @"uTTL" : [NSNumber class] /*BOOL*/,
-                                                             // @"pl" : [NSNumber class] /*BOOL*/,
-                                                             };
-    NSArray<NSString *> *expectedAttributeNames = [attributeKeyKindMap.allKeys sortedArrayUsingSelector:@selector(compare:)];
+    __block TIPImageContainer *imageContainer = nil;
 
     [pipeline inspect:^(TIPImagePipelineInspectionResult * _Nullable result) {
         if (!result.completeDiskEntries.count) {
@@ -135,8 +266,13 @@
                                            XCTAssertNil(error);
                                            XCTAssertNotNil(temporaryFilePath);
 
-                                           attributeNames = [TIPListXAttributesForFile(temporaryFilePath) sortedArrayUsingSelector:@selector(compare:)];
-                                           attributes = TIPGetXAttributesForFile(temporaryFilePath, attributeKeyKindMap);
+                                           attributeNames = TIPListXAttributesForFile(temporaryFilePath) ?: @[];
+                                           NSData *data = [NSData dataWithContentsOfFile:temporaryFilePath];
+                                           if (data) {
+                                               imageContainer = [TIPImageContainer imageContainerWithData:data
+                                                                                         decoderConfigMap:nil
+                                                                                           codecCatalogue:nil];
+                                           }
 
                                            // Fulfill async after 1 second.
                                            // If anything allocated in the attributes lookups deallocs we
@@ -150,10 +286,8 @@
     [self waitForExpectations:@[expectation] timeout:10];
 
     XCTAssertNotNil(attributeNames);
-    XCTAssertEqualObjects(attributeNames, expectedAttributeNames);
-    NSArray<NSString *> *parsedAttributeNames = [attributes.allKeys sortedArrayUsingSelector:@selector(compare:)];
-    XCTAssertNotNil(parsedAttributeNames);
-    XCTAssertEqualObjects(parsedAttributeNames, expectedAttributeNames);
+    XCTAssertEqual(attributeNames.count, (NSUInteger)0, @"%@", attributeNames);
+    XCTAssertNotNil(imageContainer);
 }
 
 @end
@@ -439,6 +573,58 @@
     XCTAssertNotNil(copyError);
 }
 
+- (void)testRevalidatingExpiredImage
+{
+    TIPGlobalConfiguration *globalConfig = [TIPGlobalConfiguration sharedInstance];
+    const TIPImageRevalidationMode oldMode = globalConfig.imageRevalidationMode;
+    globalConfig.imageRevalidationMode = TIPImageRevalidationModeRevalidate;
+    TIPImagePipeline *pipeline = [TIPImagePipelineBaseTests sharedPipeline];
+    [pipeline clearMemoryCaches];
+    [pipeline clearDiskCache];
+
+    TIPImagePipelineTestFetchRequest *request = [[TIPImagePipelineTestFetchRequest alloc] init];
+    request.imageURL = [TIPImagePipelineBaseTests dummyURLWithPath:[NSUUID UUID].UUIDString];
+    request.imageType = TIPImageTypeJPEG;
+    request.progressiveSource = NO;
+    request.timeToLive = 2.0;
+
+    // resumable stubs have a Last-Modified, which the stub answers a matching If-Modified-Since with a 304
+    [TIPImagePipelineTestFetchRequest stubRequest:request bitrate:0 resumable:YES];
+
+    TIPImagePipelineTestContext *context = [[TIPImagePipelineTestContext alloc] init];
+    TIPImageFetchOperation *op = [pipeline undeprecatedFetchImageWithRequest:request context:context delegate:self];
+    [op waitUntilFinishedWithoutBlockingRunLoop];
+    XCTAssertEqual(op.state, TIPImageFetchOperationStateSucceeded);
+    XCTAssertEqual(context.finalSource, TIPImageLoadSourceNetwork);
+
+    // Expired, revalidated from the disk cache
+
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:2.5]];
+    [pipeline clearMemoryCaches];
+    context = [[TIPImagePipelineTestContext alloc] init];
+    op = [pipeline undeprecatedFetchImageWithRequest:request context:context delegate:self];
+    [op waitUntilFinishedWithoutBlockingRunLoop];
+    XCTAssertEqual(op.state, TIPImageFetchOperationStateSucceeded);
+    XCTAssertEqual(context.finalSource, TIPImageLoadSourceDiskCache);
+    XCTAssertTrue([context.hitLoadSources containsObject:@(TIPImageLoadSourceNetwork)], @"%@", context.hitLoadSources);
+    XCTAssertNotNil(context.finalImageContainer);
+
+    // Fresh again, no revalidation
+
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    [pipeline clearMemoryCaches];
+    context = [[TIPImagePipelineTestContext alloc] init];
+    op = [pipeline undeprecatedFetchImageWithRequest:request context:context delegate:self];
+    [op waitUntilFinishedWithoutBlockingRunLoop];
+    XCTAssertEqual(op.state, TIPImageFetchOperationStateSucceeded);
+    XCTAssertEqual(context.finalSource, TIPImageLoadSourceDiskCache);
+    XCTAssertFalse([context.hitLoadSources containsObject:@(TIPImageLoadSourceNetwork)], @"%@", context.hitLoadSources);
+
+    id<TIPImageFetchDownloadProviderWithStubbingSupport> provider = (id<TIPImageFetchDownloadProviderWithStubbingSupport>)globalConfig.imageFetchDownloadProvider;
+    [provider removeDownloadStubForRequestURL:request.imageURL];
+    globalConfig.imageRevalidationMode = oldMode;
+}
+
 - (void)testGettingKnownPipelines
 {
     TestImageStoreRequest *storeRequest = [[TestImageStoreRequest alloc] init];
@@ -666,6 +852,86 @@
     (void)metricInfo;
 }
 
+- (void)testPreconnect
+{
+    NSURL *origin = [NSURL URLWithString:@"https://preconnect.tip.test/"];
+    [TIPTestURLProtocol registerURLResponse:[NSHTTPURLResponse tip_responseWithRequestURL:origin dataLength:0 responseMIMEType:nil]
+                                       body:nil
+                               withEndpoint:origin];
+
+    // each host is connected to once, through the download provider
+    NSArray<NSURL *> *URLs = @[ [NSURL URLWithString:@"https://preconnect.tip.test/image1.jpg"],
+                                [NSURL URLWithString:@"https://PRECONNECT.tip.test/image2.jpg?size=large"],
+                                [NSURL URLWithString:@"data:,"] ];
+    [[TIPGlobalConfiguration sharedInstance] preconnectToURLs:URLs];
+
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5.0];
+    while ([TIPTestURLProtocol requestCountForEndpoint:origin] == 0 && timeout.timeIntervalSinceNow > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.25]];
+    XCTAssertEqual([TIPTestURLProtocol requestCountForEndpoint:origin], (NSUInteger)1);
+    XCTAssertEqualObjects([TIPTestURLProtocol requestsForEndpoint:origin].firstObject.HTTPMethod, @"HEAD");
+
+    [TIPTestURLProtocol unregisterEndpoint:origin];
+
+    // the path can be configured for hosts where "/" is not cheap (or valid) to request
+
+    NSURL *pingURL = [NSURL URLWithString:@"https://preconnect.tip.test/ping"];
+    [TIPTestURLProtocol registerURLResponse:[NSHTTPURLResponse tip_responseWithRequestURL:pingURL dataLength:0 responseMIMEType:nil]
+                                       body:nil
+                               withEndpoint:pingURL];
+    [TIPGlobalConfiguration sharedInstance].preconnectPath = @"ping";
+    [[TIPGlobalConfiguration sharedInstance] preconnectToURLs:URLs];
+    [TIPGlobalConfiguration sharedInstance].preconnectPath = nil;
+
+    timeout = [NSDate dateWithTimeIntervalSinceNow:5.0];
+    while ([TIPTestURLProtocol requestCountForEndpoint:pingURL] == 0 && timeout.timeIntervalSinceNow > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+    XCTAssertEqual([TIPTestURLProtocol requestCountForEndpoint:pingURL], (NSUInteger)1);
+
+    [TIPTestURLProtocol unregisterEndpoint:pingURL];
+}
+
+- (void)testPreconnectedConnectionIsReused
+{
+    TIPTestLoopbackHTTPServer *server = [[TIPTestLoopbackHTTPServer alloc] init];
+    tip_defer(^{
+        [server stop];
+    });
+    XCTAssertNotNil(server.origin);
+    if (!server.origin) {
+        return;
+    }
+
+    NSURLSession *session = [TIPImageFetchDownloadInternal defaultURLSession];
+    [TIPImageFetchDownloadInternal preconnectToURLs:@[ [server.origin URLByAppendingPathComponent:@"ping"] ]
+                                            session:session];
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5.0];
+    while (server.requestLines.count == 0 && timeout.timeIntervalSinceNow > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+    // let the session get the response and pool the connection
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.25]];
+
+    // the download that follows goes over the connection the preconnect opened
+    XCTestExpectation *expectation = [self expectationWithDescription:@"download"];
+    __block NSData *downloadedData = nil;
+    NSURLSessionDataTask *task = [session dataTaskWithURL:[server.origin URLByAppendingPathComponent:@"image.jpg"]
+                                        completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        downloadedData = data;
+        [expectation fulfill];
+    }];
+    [task resume];
+    [self waitForExpectations:@[expectation] timeout:10];
+
+    XCTAssertEqualObjects(downloadedData, [@"TIP!" dataUsingEncoding:NSASCIIStringEncoding]);
+    NSArray<NSString *> *expectedRequestLines = @[ @"HEAD /ping HTTP/1.1", @"GET /image.jpg HTTP/1.1" ];
+    XCTAssertEqualObjects(server.requestLines, expectedRequestLines);
+    XCTAssertEqual(server.acceptedConnectionCount, (NSUInteger)1);
+}
+
 @end
 
 @implementation TIPImagePipelineTests_Two
@@ -789,3 +1055,354 @@
 
 @end
 
+@implementation TIPImagePipelineTests_Pruning
+
+- (SInt64)_syncTotalBytesForAllMemoryCaches
+{
+    TIPGlobalConfiguration *globalConfig = [TIPGlobalConfiguration sharedInstance];
+    __block SInt64 totalBytes;
+    dispatch_sync(globalConfig.queueForMemoryCaches, ^{
+        totalBytes = [globalConfig internalTotalBytesForAllCachesOfType:TIPImageCacheTypeMemory];
+    });
+    return totalBytes;
+}
+
+- (void)testPruningMemoryCachesWithWatermarks
+{
+    TIPGlobalConfiguration *globalConfig = [TIPGlobalConfiguration sharedInstance];
+    TIPImageMemoryCache *memoryCache = (TIPImageMemoryCache *)[[TIPImagePipelineBaseTests sharedPipeline] cacheOfType:TIPImageCacheTypeMemory];
+    const NSUInteger entryBytes = 10 * 1024;
+    const SInt64 maxBytes = 10 * entryBytes;
+
+    [globalConfig clearAllMemoryCaches];
+    globalConfig.cachePruneLowWatermarkRatio = 0.5;
+    globalConfig.maxBytesForAllMemoryCaches = maxBytes;
+    XCTAssertEqual([self _syncTotalBytesForAllMemoryCaches], (SInt64)0);
+    const TIPCachePruneStatistics startStats = globalConfig.pruneStatisticsForAllMemoryCaches;
+
+    // Filling up to the high watermark does not prune
+
+    for (NSUInteger i = 0; i < 10; i++) {
+        [memoryCache updateImageEntry:_TestCacheEntry([NSString stringWithFormat:@"watermark.%tu", i], CGSizeMake(1, 1), entryBytes)
+              forciblyReplaceExisting:NO];
+    }
+    XCTAssertEqual([self _syncTotalBytesForAllMemoryCaches], maxBytes);
+    XCTAssertEqual(globalConfig.pruneStatisticsForAllMemoryCaches.pruneCount, startStats.pruneCount);
+
+    // Exceeding the high watermark prunes back under the max right away...
+
+    [memoryCache updateImageEntry:_TestCacheEntry(@"watermark.10", CGSizeMake(1, 1), entryBytes)
+          forciblyReplaceExisting:NO];
+    SInt64 totalBytes = [self _syncTotalBytesForAllMemoryCaches];
+    XCTAssertLessThanOrEqual(totalBytes, maxBytes);
+    XCTAssertGreaterThan(totalBytes, maxBytes / 2);
+
+    // ...and the slices queued behind it prune down to the low watermark
+
+    totalBytes = [self _syncTotalBytesForAllMemoryCaches];
+    XCTAssertEqual(totalBytes, maxBytes / 2);
+    TIPCachePruneStatistics stats = globalConfig.pruneStatisticsForAllMemoryCaches;
+    XCTAssertEqual(stats.pruneCount, startStats.pruneCount + 1);
+    XCTAssertGreaterThan(stats.sliceCount, startStats.sliceCount);
+    XCTAssertEqual(stats.evictedEntryCount, startStats.evictedEntryCount + 6);
+
+    // Refilling the gap between the watermarks does not prune
+
+    for (NSUInteger i = 11; i < 16; i++) {
+        [memoryCache updateImageEntry:_TestCacheEntry([NSString stringWithFormat:@"watermark.%tu", i], CGSizeMake(1, 1), entryBytes)
+              forciblyReplaceExisting:NO];
+    }
+    XCTAssertEqual([self _syncTotalBytesForAllMemoryCaches], maxBytes);
+    XCTAssertEqual(globalConfig.pruneStatisticsForAllMemoryCaches.pruneCount, stats.pruneCount);
+    XCTAssertEqual(globalConfig.pruneStatisticsForAllMemoryCaches.evictedEntryCount, stats.evictedEntryCount);
+
+    globalConfig.cachePruneLowWatermarkRatio = -1;
+    globalConfig.maxBytesForAllMemoryCaches = 12 * 1024 * 1024;
+}
+
+- (void)testPruningRenderedCachesInSlices
+{
+    TIPGlobalConfiguration *globalConfig = [TIPGlobalConfiguration sharedInstance];
+    TIPImageRenderedCache *renderedCache = (TIPImageRenderedCache *)[[TIPImagePipelineBaseTests sharedPipeline] cacheOfType:TIPImageCacheTypeRendered];
+    const CGSize imageSize = CGSizeMake(32, 32);
+    const SInt64 entryBytes = (SInt64)_TestCacheEntry(@"slice", imageSize, 0).completeImage.sizeInMemory;
+    const SInt64 maxBytes = 10 * entryBytes;
+
+    [globalConfig clearAllRenderedMemoryCaches];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    globalConfig.cachePruneLowWatermarkRatio = 0.5;
+    globalConfig.maxBytesForAllRenderedCaches = maxBytes;
+    XCTAssertEqual(globalConfig.totalBytesForAllRenderedCaches, (SInt64)0);
+
+    for (NSUInteger i = 0; i < 10; i++) {
+        [renderedCache storeImageEntry:_TestCacheEntry([NSString stringWithFormat:@"slice.%tu", i], imageSize, 0)
+                 transformerIdentifier:nil
+                 sourceImageDimensions:imageSize];
+    }
+    XCTAssertEqual(globalConfig.totalBytesForAllRenderedCaches, maxBytes);
+    const TIPCachePruneStatistics startStats = globalConfig.pruneStatisticsForAllRenderedCaches;
+
+    // Exceeding the high watermark on the main queue only prunes back under the max...
+
+    [renderedCache storeImageEntry:_TestCacheEntry(@"slice.10", imageSize, 0)
+             transformerIdentifier:nil
+             sourceImageDimensions:imageSize];
+    XCTAssertLessThanOrEqual(globalConfig.totalBytesForAllRenderedCaches, maxBytes);
+    XCTAssertGreaterThan(globalConfig.totalBytesForAllRenderedCaches, maxBytes / 2);
+    XCTAssertEqual(globalConfig.pruneStatisticsForAllRenderedCaches.sliceCount, startStats.sliceCount);
+
+    // ...the rest is pruned in slices once the main queue has been yielded
+
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:2.0];
+    while (globalConfig.totalBytesForAllRenderedCaches > maxBytes / 2 && timeout.timeIntervalSinceNow > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+    XCTAssertEqual(globalConfig.totalBytesForAllRenderedCaches, maxBytes / 2);
+    XCTAssertGreaterThan(globalConfig.pruneStatisticsForAllRenderedCaches.sliceCount, startStats.sliceCount);
+
+    globalConfig.cachePruneLowWatermarkRatio = -1;
+    globalConfig.maxBytesForAllRenderedCaches = 12 * 1024 * 1024;
+}
+
+- (SInt64)_syncTotalCostOfMemoryCache:(TIPImageMemoryCache *)memoryCache
+{
+    __block SInt64 totalCost;
+    dispatch_sync([TIPGlobalConfiguration sharedInstance].queueForMemoryCaches, ^{
+        totalCost = (SInt64)memoryCache.totalCost;
+    });
+    return totalCost;
+}
+
+// call within an autorelease pool so that the pipelines are unregistered once it returns
+- (void)_runPruningSharedCachesWithQuietReservedRatio:(double)reservedRatio
+                                    lowWatermarkRatio:(double)lowWatermarkRatio
+                                            busyBytes:(out SInt64 *)busyBytesOut
+                                           quietBytes:(out SInt64 *)quietBytesOut
+{
+    TIPGlobalConfiguration *globalConfig = [TIPGlobalConfiguration sharedInstance];
+    const NSUInteger entryBytes = 10 * 1024;
+    const SInt64 maxBytes = 10 * entryBytes;
+
+    // the two pipelines split almost all of the budget, other registered pipelines have a negligible share
+    TIPImagePipeline *busyPipeline = [[TIPImagePipeline alloc] initWithIdentifier:@"share.busy"];
+    TIPImagePipeline *quietPipeline = [[TIPImagePipeline alloc] initWithIdentifier:@"share.quiet"];
+    busyPipeline.cacheShareWeight = 1000.0;
+    quietPipeline.cacheShareWeight = 1000.0;
+    quietPipeline.cacheShareReservedRatio = reservedRatio;
+    TIPImageMemoryCache *busyCache = busyPipeline.memoryCache;
+    TIPImageMemoryCache *quietCache = quietPipeline.memoryCache;
+
+    [globalConfig clearAllMemoryCaches];
+    globalConfig.cachePruneLowWatermarkRatio = lowWatermarkRatio;
+    globalConfig.maxBytesForAllMemoryCaches = 10 * maxBytes;
+
+    // busy is at 140% of its share and quiet at 80%
+    for (NSUInteger i = 0; i < 7; i++) {
+        [busyCache updateImageEntry:_TestCacheEntry([NSString stringWithFormat:@"share.busy.%tu", i], CGSizeMake(1, 1), entryBytes)
+            forciblyReplaceExisting:NO];
+    }
+    for (NSUInteger i = 0; i < 4; i++) {
+        [quietCache updateImageEntry:_TestCacheEntry([NSString stringWithFormat:@"share.quiet.%tu", i], CGSizeMake(1, 1), entryBytes)
+             forciblyReplaceExisting:NO];
+    }
+    XCTAssertEqual([self _syncTotalCostOfMemoryCache:busyCache], (SInt64)(7 * entryBytes));
+    XCTAssertEqual([self _syncTotalCostOfMemoryCache:quietCache], (SInt64)(4 * entryBytes));
+
+    // prune (without a priority cache) and let any slices down to the low watermark finish
+    globalConfig.maxBytesForAllMemoryCaches = maxBytes;
+    const SInt64 lowWatermarkBytes = (SInt64)((double)maxBytes * globalConfig.cachePruneLowWatermarkRatio);
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5.0];
+    while ([self _syncTotalBytesForAllMemoryCaches] > lowWatermarkBytes && timeout.timeIntervalSinceNow > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+
+    *busyBytesOut = [self _syncTotalCostOfMemoryCache:busyCache];
+    *quietBytesOut = [self _syncTotalCostOfMemoryCache:quietCache];
+
+    [globalConfig clearAllMemoryCaches];
+    globalConfig.cachePruneLowWatermarkRatio = -1;
+    globalConfig.maxBytesForAllMemoryCaches = 12 * 1024 * 1024;
+}
+
+- (void)testPruningEvictsMostOverShareFirst
+{
+    SInt64 busyBytes, quietBytes;
+
+    // only busy is over its share, it is pruned back to the max on its own
+    @autoreleasepool {
+        [self _runPruningSharedCachesWithQuietReservedRatio:0.0
+                                          lowWatermarkRatio:1.0
+                                                  busyBytes:&busyBytes
+                                                 quietBytes:&quietBytes];
+    }
+    XCTAssertEqual(busyBytes, (SInt64)(6 * 10 * 1024));
+    XCTAssertEqual(quietBytes, (SInt64)(4 * 10 * 1024));
+}
+
+- (void)testPruningNeverEvictsReservedShare
+{
+    SInt64 busyBytes, quietBytes;
+
+    // pruning to the low watermark takes busy down to quiet's ratio of its share,
+    // after which both are evicted from
+    @autoreleasepool {
+        [self _runPruningSharedCachesWithQuietReservedRatio:0.0
+                                          lowWatermarkRatio:0.5
+                                                  busyBytes:&busyBytes
+                                                 quietBytes:&quietBytes];
+    }
+    XCTAssertEqual(busyBytes + quietBytes, (SInt64)(5 * 10 * 1024));
+    XCTAssertLessThan(quietBytes, (SInt64)(4 * 10 * 1024));
+
+    // unless quiet is within its reservation, then it is never evicted from
+    @autoreleasepool {
+        [self _runPruningSharedCachesWithQuietReservedRatio:1.0
+                                          lowWatermarkRatio:0.5
+                                                  busyBytes:&busyBytes
+                                                 quietBytes:&quietBytes];
+    }
+    XCTAssertEqual(busyBytes, (SInt64)(1 * 10 * 1024));
+    XCTAssertEqual(quietBytes, (SInt64)(4 * 10 * 1024));
+}
+
+@end
+
+@implementation TIPImagePipelineTests_HotSet
+
+- (BOOL)_waitForCondition:(BOOL (^)(void))condition
+{
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5.0];
+    while (!condition() && timeout.timeIntervalSinceNow > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+    return condition();
+}
+
+- (void)testHotSetSaveLoadAndPrewarm
+{
+    TIPImagePipeline *pipeline = [[TIPImagePipeline alloc] initWithIdentifier:@"hot.set.prewarm"];
+    [pipeline clearDiskCache];
+    [pipeline clearMemoryCaches];
+
+    NSURL *URL = [TIPImagePipelineBaseTests dummyURLWithPath:@"/hot.set.prewarm.jpg"];
+    NSString *identifier = URL.absoluteString;
+    const CGSize targetDimensions = CGSizeMake(64, 64);
+    TestImageStoreRequest *storeRequest = [[TestImageStoreRequest alloc] init];
+    storeRequest.imageURL = URL;
+    storeRequest.imageFilePath = [[self class] pathForImageOfType:TIPImageTypeJPEG progressive:NO];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Store Image"];
+    [pipeline storeImageWithRequest:storeRequest completion:^(NSObject<TIPDependencyOperation> *storeOp, BOOL succeeded, NSError *error) {
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10.0 handler:NULL];
+    [pipeline clearMemoryCaches];
+
+    // Save
+
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    path = [path stringByAppendingPathComponent:@"hot.set.prewarm.plist"];
+    TIPImageHotSet *hotSet = [[TIPImageHotSet alloc] initWithPath:path];
+    TIPImageHotSetItem *item = [[TIPImageHotSetItem alloc] initWithIdentifier:identifier
+                                                                          URL:URL
+                                                             targetDimensions:targetDimensions
+                                                            targetContentMode:UIViewContentModeScaleAspectFill];
+    [hotSet persistItems:@[ item ] synchronously:YES];
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:path]);
+
+    // Load and prewarm
+
+    TIPImageMemoryCache *memoryCache = pipeline.memoryCache;
+    TIPImageRenderedCache *renderedCache = pipeline.renderedCache;
+    [hotSet prewarmMemoryCache:memoryCache
+                 renderedCache:renderedCache
+                 fromDiskCache:pipeline.diskCache
+                      maxCount:1];
+    XCTAssertTrue([self _waitForCondition:^BOOL{
+        return [memoryCache imageEntryForIdentifier:identifier
+                                   targetDimensions:CGSizeZero
+                                  targetContentMode:UIViewContentModeCenter
+                                   decoderConfigMap:nil].completeImage != nil;
+    }]);
+
+    __block CGSize sourceDimensions = CGSizeZero;
+    XCTAssertTrue([self _waitForCondition:^BOOL{
+        return [renderedCache imageEntryWithIdentifier:identifier
+                                 transformerIdentifier:nil
+                                      targetDimensions:targetDimensions
+                                     targetContentMode:UIViewContentModeScaleAspectFill
+                                 sourceImageDimensions:&sourceDimensions
+                                                 dirty:NULL].completeImage != nil;
+    }]);
+    XCTAssertTrue(CGSizeEqualToSize(sourceDimensions, kCarnivalImageDimensions));
+
+    [[NSFileManager defaultManager] removeItemAtPath:[path stringByDeletingLastPathComponent] error:NULL];
+    [pipeline clearDiskCache];
+    [pipeline clearMemoryCaches];
+}
+
+- (void)testHotSetRemovedOnClear
+{
+    TIPImagePipeline *pipeline = [[TIPImagePipeline alloc] initWithIdentifier:@"hot.set.clear"];
+    NSString *path = pipeline.hotSet.path;
+    TIPImageHotSetItem *item = [[TIPImageHotSetItem alloc] initWithIdentifier:@"hot.set.clear.image"
+                                                                          URL:nil
+                                                             targetDimensions:CGSizeMake(64, 64)
+                                                            targetContentMode:UIViewContentModeScaleAspectFill];
+
+    // Clearing the pipeline's disk cache removes its snapshot
+
+    [pipeline.hotSet persistItems:@[ item ] synchronously:YES];
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:path]);
+    [pipeline clearDiskCache];
+    XCTAssertTrue([self _waitForCondition:^BOOL{
+        return ![[NSFileManager defaultManager] fileExistsAtPath:path];
+    }]);
+
+    // Clearing all disk caches removes every snapshot, even those of pipelines that are gone
+
+    NSString *directoryPath = [path stringByDeletingLastPathComponent];
+    NSString *strayPath = [directoryPath stringByAppendingPathComponent:@"hot.set.gone.plist"];
+    [pipeline.hotSet persistItems:@[ item ] synchronously:YES];
+    [[[TIPImageHotSet alloc] initWithPath:strayPath] persistItems:@[ item ] synchronously:YES];
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:strayPath]);
+    [[TIPGlobalConfiguration sharedInstance] clearAllDiskCaches];
+    XCTAssertTrue([self _waitForCondition:^BOOL{
+        return ![[NSFileManager defaultManager] fileExistsAtPath:directoryPath];
+    }]);
+}
+
+- (void)testTimeToFirstImage
+{
+    TIPGlobalConfiguration *globalConfig = [TIPGlobalConfiguration sharedInstance];
+    TIPImagePipeline *pipeline = [[TIPImagePipeline alloc] initWithIdentifier:@"time.to.first.image"];
+    [pipeline clearDiskCache];
+    XCTAssertFalse([globalConfig getTimeToFirstImageForImagePipeline:pipeline duration:NULL loadSource:NULL]);
+
+    id<TIPImageFetchDownloadProviderWithStubbingSupport> provider = (id<TIPImageFetchDownloadProviderWithStubbingSupport>)globalConfig.imageFetchDownloadProvider;
+    TIPImagePipelineTestFetchRequest *request = [[TIPImagePipelineTestFetchRequest alloc] init];
+    request.imageType = TIPImageTypeJPEG;
+    request.imageURL = [TIPImagePipelineBaseTests dummyURLWithPath:@"/time.to.first.image.jpg"];
+    [TIPImagePipelineTestFetchRequest stubRequest:request bitrate:0 resumable:YES];
+    tip_defer(^{
+        [provider removeDownloadStubForRequestURL:request.imageURL];
+    });
+
+    for (NSUInteger i = 0; i < 2; i++) {
+        TIPImageFetchOperation *op = [pipeline operationWithRequest:request context:nil completion:NULL];
+        [pipeline fetchImageWithOperation:op];
+        [op waitUntilFinishedWithoutBlockingRunLoop];
+        XCTAssertEqual(op.state, TIPImageFetchOperationStateSucceeded);
+    }
+
+    // only the first image counts, later (cache hit) fetches do not change the metric
+    NSTimeInterval duration = 0;
+    TIPImageLoadSource loadSource = TIPImageLoadSourceUnknown;
+    XCTAssertTrue([globalConfig getTimeToFirstImageForImagePipeline:pipeline duration:&duration loadSource:&loadSource]);
+    XCTAssertGreaterThan(duration, 0.0);
+    XCTAssertEqual(loadSource, TIPImageLoadSourceNetwork);
+
+    [pipeline clearDiskCache];
+    [pipeline clearMemoryCaches];
+}
+
+@end
@@ -21,6 +21,7 @@
 #import "UIImage+TIPAdditions.h"
 
 @import Foundation;
+@import ImageIO;
 @import MobileCoreServices;
 @import UIKit;
 @import XCTest;
@@ -131,6 +132,14 @@ NS_INLINE NSData * __nullable UIImagePNGRepresentationUndeprecated(UIImage * __n
 @interface TIPImageTest : XCTestCase
 @end
 
+// the portable codecs (TIPXJPEGTurboCodec, TIPXPNGCodec) are only linked when their libraries are added to the test target
+@protocol TIPTestPortableCodec <TIPImageCodec>
+- (instancetype)initWithPreferredCodec:(id<TIPImageCodec>)preferredCodec;
+@optional
++ (BOOL)isConcurrentDecodingEnabled;
++ (void)setConcurrentDecodingEnabled:(BOOL)concurrentDecodingEnabled;
+@end
+
 #define JPEG_QUALITY_PERFECT (1.0f)
 #define JPEG_QUALITY_GOOD (kTIPAppleQualityValueRepresentingJFIFQuality85)
 #define JPEG_QUALITY_OK (0.15f)
@@ -489,6 +498,61 @@ static NSMutableDictionary<NSString *, NSMutableDictionary<NSString *, NSNumber
     }];
 }
 
+- (void)testProgressiveIPNG
+{
+    // Go through decoding an interlaced PNG a chunk at a time
+    // to ensure each Adam7 pass yields a frame with a preview
+
+    NSData *imageData = [sImageContainer.image tip_writeToDataWithType:TIPImageTypePNG
+                                                       encodingOptions:TIPImageEncodingProgressive
+                                                               quality:1.0f
+                                                    animationLoopCount:0
+                                               animationFrameDurations:nil
+                                                                 error:NULL];
+    XCTAssertNotNil(imageData);
+
+    id<TIPImageDecoder> decoder = [[TIPImageCodecCatalogue sharedInstance] codecForImageType:TIPImageTypePNG].tip_decoder;
+    XCTAssertTrue([decoder tip_supportsProgressiveDecoding]);
+    id<TIPImageDecoderContext> context = [decoder tip_initiateDecoding:nil
+                                                    expectedDataLength:imageData.length
+                                                                buffer:nil];
+
+    const CGSize targetDimensions = CGSizeMake(120, 120);
+    const CGSize expectedDimensions = TIPDimensionsScaledToTargetSizing(sImageContainer.dimensions,
+                                                                        targetDimensions,
+                                                                        UIViewContentModeScaleAspectFit);
+    NSUInteger loadedFrameCount = 0;
+    for (NSRange range = NSMakeRange(0, 4 * 1024); range.location < imageData.length; range.location += range.length) {
+        @autoreleasepool {
+            range.length = MIN(range.length, imageData.length - range.location);
+            const TIPImageDecoderAppendResult result = [decoder tip_append:context
+                                                                      data:[imageData tip_safeSubdataNoCopyWithRange:range error:NULL]];
+            if (TIPImageDecoderAppendResultDidLoadFrame == result) {
+                loadedFrameCount++;
+                XCTAssertTrue(context.tip_isProgressive);
+                TIPImageContainer *progressImage = [decoder tip_renderImage:context
+                                                                 renderMode:TIPImageDecoderRenderModeFullFrameProgress
+                                                           targetDimensions:targetDimensions
+                                                          targetContentMode:UIViewContentModeScaleAspectFit];
+                XCTAssertNotNil(progressImage);
+                XCTAssertTrue(CGSizeEqualToSize(progressImage.dimensions, expectedDimensions));
+            }
+        }
+    }
+
+    // 1 frame per Adam7 pass, except the last pass which completes the image
+    XCTAssertGreaterThan(loadedFrameCount, (NSUInteger)0);
+    XCTAssertEqual(context.tip_frameCount, (NSUInteger)6);
+
+    const TIPImageDecoderAppendResult finalizeResult = [decoder tip_finalizeDecoding:context];
+    XCTAssertEqual(finalizeResult, TIPImageDecoderAppendResultDidCompleteLoading);
+    TIPImageContainer *finalImage = [decoder tip_renderImage:context
+                                                  renderMode:TIPImageDecoderRenderModeCompleteImage
+                                            targetDimensions:CGSizeZero
+                                           targetContentMode:UIViewContentModeCenter];
+    XCTAssertTrue(CGSizeEqualToSize(finalImage.dimensions, sImageContainer.dimensions));
+}
+
 - (void)testSaveTIFF
 {
     [self runMeasurement:@"save" format:@"tiff" block:^{
@@ -1081,6 +1145,331 @@ static NSMutableDictionary<NSString *, NSMutableDictionary<NSString *, NSNumber
     XCTAssertTrue(CGSizeEqualToSize(decodedImage.dimensions, scaledImage.dimensions));
 }
 
+- (void)testJXLDecodeStopsAtTargetDownsampling
+{
+    // TIPXJXLCodec needs libjxl, which is not vendored: only run when both are added to the test target
+    Class jxlCodecClass = NSClassFromString(@"TIPXJXLCodec");
+    if (!jxlCodecClass) {
+        return;
+    }
+
+    id<TIPImageCodec> jxlCodec = [[jxlCodecClass alloc] init];
+    TIPImageContainer *scaledImage = [sImageContainer scaleToTargetDimensions:CGSizeMake(512, 512) contentMode:UIViewContentModeScaleAspectFit];
+    NSError *error = nil;
+    NSData *data = [jxlCodec.tip_encoder tip_writeDataWithImage:scaledImage
+                                                encodingOptions:TIPImageEncodingProgressive
+                                               suggestedQuality:0.8f
+                                                          error:&error];
+    XCTAssertNotNil(data, @"%@", error);
+    if (!data) {
+        return;
+    }
+
+    // an 8th of the dimensions only needs the DC pass: find the shortest prefix of the data
+    // that decodes at that sizing, the decode stopped before the AC passes if the full size can't
+    const CGSize targetDimensions = CGSizeMake(ceil(scaledImage.dimensions.width / 8), ceil(scaledImage.dimensions.height / 8));
+    NSData *prefix = nil;
+    TIPImageContainer *downsampledImage = nil;
+    for (NSUInteger length = data.length / 16; length < data.length && !downsampledImage; length += data.length / 16) {
+        prefix = [data subdataWithRange:NSMakeRange(0, length)];
+        downsampledImage = [jxlCodec.tip_decoder tip_decodeImageWithData:prefix
+                                                        targetDimensions:targetDimensions
+                                                       targetContentMode:UIViewContentModeScaleAspectFit
+                                                                  config:nil];
+    }
+    XCTAssertNotNil(downsampledImage);
+    XCTAssertTrue(CGSizeEqualToSize(downsampledImage.dimensions, targetDimensions));
+    XCTAssertNil([jxlCodec.tip_decoder tip_decodeImageWithData:prefix
+                                              targetDimensions:CGSizeZero
+                                             targetContentMode:UIViewContentModeCenter
+                                                        config:nil]);
+
+    // all of the data decodes at full size
+    TIPImageContainer *fullImage = [jxlCodec.tip_decoder tip_decodeImageWithData:data
+                                                                targetDimensions:CGSizeZero
+                                                               targetContentMode:UIViewContentModeCenter
+                                                                          config:nil];
+    XCTAssertTrue(CGSizeEqualToSize(fullImage.dimensions, scaledImage.dimensions));
+}
+
+#pragma mark Portable Codec Tests
+
+- (TIPImageContainer *)_decodeData:(NSData *)data
+            incrementallyWithCodec:(id<TIPImageCodec>)codec
+                  loadedFrameCount:(NSUInteger *)loadedFrameCountOut
+{
+    id<TIPImageDecoder> decoder = codec.tip_decoder;
+    id<TIPImageDecoderContext> context = [decoder tip_initiateDecoding:nil
+                                                    expectedDataLength:data.length
+                                                                buffer:nil];
+    NSUInteger loadedFrameCount = 0;
+    for (NSRange range = NSMakeRange(0, 512); range.location < data.length; range.location += range.length) {
+        @autoreleasepool {
+            range.length = MIN(range.length, data.length - range.location);
+            const TIPImageDecoderAppendResult result = [decoder tip_append:context
+                                                                      data:[data tip_safeSubdataNoCopyWithRange:range error:NULL]];
+            if (TIPImageDecoderAppendResultDidLoadFrame == result) {
+                loadedFrameCount++;
+                TIPImageContainer *progressImage = [decoder tip_renderImage:context
+                                                                 renderMode:TIPImageDecoderRenderModeFullFrameProgress
+                                                           targetDimensions:CGSizeZero
+                                                          targetContentMode:UIViewContentModeCenter];
+                XCTAssertNotNil(progressImage);
+                XCTAssertTrue(CGSizeEqualToSize(progressImage.dimensions, context.tip_dimensions));
+            }
+        }
+    }
+    *loadedFrameCountOut = loadedFrameCount;
+
+    XCTAssertEqual([decoder tip_finalizeDecoding:context], TIPImageDecoderAppendResultDidCompleteLoading);
+    return [decoder tip_renderImage:context
+                         renderMode:TIPImageDecoderRenderModeCompleteImage
+                   targetDimensions:CGSizeZero
+                  targetContentMode:UIViewContentModeCenter];
+}
+
+- (void)_testRoundTripWithCodec:(id<TIPImageCodec>)codec
+                          image:(TIPImageContainer *)image
+                encodingOptions:(TIPImageEncodingOptions)encodingOptions
+                        quality:(float)quality
+       expectsProgressiveFrames:(BOOL)expectsProgressiveFrames
+{
+    NSError *error = nil;
+    NSData *data = [codec.tip_encoder tip_writeDataWithImage:image
+                                             encodingOptions:encodingOptions
+                                            suggestedQuality:quality
+                                                       error:&error];
+    XCTAssertNotNil(data, @"%@", error);
+    if (!data) {
+        return;
+    }
+
+    XCTAssertEqual([codec.tip_decoder tip_detectDecodableData:data isCompleteData:YES earlyGuessImageType:nil], TIPImageDecoderDetectionResultMatch);
+
+    // all at once
+    TIPImageContainer *decodedImage = TIPDecodeImageFromData(codec, nil, data, CGSizeZero, UIViewContentModeCenter);
+    XCTAssertNotNil(decodedImage);
+    XCTAssertTrue(CGSizeEqualToSize(decodedImage.dimensions, image.dimensions));
+    XCTAssertEqual(decodedImage.frameCount, image.frameCount);
+
+    // as the data arrives
+    NSUInteger loadedFrameCount = 0;
+    decodedImage = [self _decodeData:data incrementallyWithCodec:codec loadedFrameCount:&loadedFrameCount];
+    XCTAssertNotNil(decodedImage);
+    XCTAssertTrue(CGSizeEqualToSize(decodedImage.dimensions, image.dimensions));
+    XCTAssertEqual(decodedImage.frameCount, image.frameCount);
+    if (image.isAnimated) {
+        XCTAssertEqual(decodedImage.loopCount, image.loopCount);
+    }
+    if (expectsProgressiveFrames) {
+        XCTAssertGreaterThan(loadedFrameCount, (NSUInteger)0);
+    }
+}
+
+- (void)testXJPEGTurboCodec
+{
+    // TIPXJPEGTurboCodec needs libjpeg-turbo, which is not vendored: only run when both are added to the test target
+    Class codecClass = NSClassFromString(@"TIPXJPEGTurboCodec");
+    if (!codecClass) {
+        return;
+    }
+
+    id<TIPImageCodec> codec = [[codecClass alloc] init];
+    TIPImageContainer *scaledImage = [sImageContainer scaleToTargetDimensions:CGSizeMake(256, 256) contentMode:UIViewContentModeScaleAspectFit];
+    [self _testRoundTripWithCodec:codec image:scaledImage encodingOptions:0 quality:JPEG_QUALITY_GOOD expectsProgressiveFrames:NO];
+    [self _testRoundTripWithCodec:codec image:scaledImage encodingOptions:TIPImageEncodingProgressive quality:JPEG_QUALITY_GOOD expectsProgressiveFrames:YES];
+    [self _testRoundTripWithCodec:codec image:scaledImage encodingOptions:TIPImageEncodingGrayscale quality:JPEG_QUALITY_GOOD expectsProgressiveFrames:NO];
+}
+
+- (void)testXJPEGTurboCodecFallsBackForCMYK
+{
+    Class codecClass = NSClassFromString(@"TIPXJPEGTurboCodec");
+    if (!codecClass) {
+        return;
+    }
+
+    // libjpeg-turbo can't convert CMYK to RGB, write a CMYK JPEG with ImageIO
+    TIPImageContainer *scaledImage = [sImageContainer scaleToTargetDimensions:CGSizeMake(256, 256) contentMode:UIViewContentModeScaleAspectFit];
+    const size_t width = (size_t)scaledImage.dimensions.width;
+    const size_t height = (size_t)scaledImage.dimensions.height;
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceCMYK();
+    TIPDeferRelease(colorSpace);
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace, (CGBitmapInfo)kCGImageAlphaNone);
+    TIPDeferRelease(context);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), scaledImage.image.CGImage);
+    CGImageRef imageRef = CGBitmapContextCreateImage(context);
+    TIPDeferRelease(imageRef);
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data, kUTTypeJPEG, 1, NULL);
+    TIPDeferRelease(destination);
+    CGImageDestinationAddImage(destination, imageRef, NULL);
+    XCTAssertTrue(CGImageDestinationFinalize(destination));
+
+    // not matched without a preferred codec
+    id<TIPImageCodec> codec = [[codecClass alloc] init];
+    XCTAssertEqual([codec.tip_decoder tip_detectDecodableData:data isCompleteData:YES earlyGuessImageType:nil], TIPImageDecoderDetectionResultNoMatch);
+
+    // decoded by the preferred codec, all at once and as the data arrives
+    codec = [(id<TIPTestPortableCodec>)[codecClass alloc] initWithPreferredCodec:[TIPImageCodecCatalogue defaultCodecs][TIPImageTypeJPEG]];
+    XCTAssertEqual([codec.tip_decoder tip_detectDecodableData:data isCompleteData:YES earlyGuessImageType:nil], TIPImageDecoderDetectionResultMatch);
+    TIPImageContainer *decodedImage = TIPDecodeImageFromData(codec, nil, data, CGSizeZero, UIViewContentModeCenter);
+    XCTAssertTrue(CGSizeEqualToSize(decodedImage.dimensions, scaledImage.dimensions));
+    NSUInteger loadedFrameCount = 0;
+    decodedImage = [self _decodeData:data incrementallyWithCodec:codec loadedFrameCount:&loadedFrameCount];
+    XCTAssertTrue(CGSizeEqualToSize(decodedImage.dimensions, scaledImage.dimensions));
+    decodedImage = TIPDecodeImageRegionFromData(codec, nil, data, CGRectMake(0, 0, 64, 64), CGSizeZero, UIViewContentModeCenter);
+    XCTAssertTrue(CGSizeEqualToSize(decodedImage.dimensions, CGSizeMake(64, 64)));
+}
+
+- (void)testXJPEGTurboCodecBandedDecodeMatchesSequentialDecode
+{
+    Class<TIPTestPortableCodec> codecClass = NSClassFromString(@"TIPXJPEGTurboCodec");
+    if (!codecClass) {
+        return;
+    }
+
+    // large enough to be encoded with a restart marker per MCU row and decoded in bands
+    id<TIPImageCodec> codec = [[(Class)codecClass alloc] init];
+    TIPImageContainer *scaledImage = [sImageContainer scaleToTargetDimensions:CGSizeMake(2048, 2048) contentMode:UIViewContentModeScaleToFill];
+    NSError *error = nil;
+    NSData *data = [codec.tip_encoder tip_writeDataWithImage:scaledImage
+                                             encodingOptions:0
+                                            suggestedQuality:JPEG_QUALITY_GOOD
+                                                       error:&error];
+    XCTAssertNotNil(data, @"%@", error);
+    if (!data) {
+        return;
+    }
+    const Byte restartMarker[] = { 0xFF, 0xD0 };
+    XCTAssertNotEqual([data rangeOfData:[NSData dataWithBytes:restartMarker length:sizeof(restartMarker)] options:0 range:NSMakeRange(0, data.length)].location, (NSUInteger)NSNotFound);
+
+    NSData *(^decodePixels)(CGSize) = ^NSData *(CGSize targetDimensions) {
+        TIPImageContainer *decodedImage = [codec.tip_decoder tip_decodeImageWithData:data
+                                                                    targetDimensions:targetDimensions
+                                                                   targetContentMode:UIViewContentModeScaleAspectFit
+                                                                              config:nil];
+        CGImageRef imageRef = decodedImage.image.CGImage;
+        return (imageRef) ? (NSData *)CFBridgingRelease(CGDataProviderCopyData(CGImageGetDataProvider(imageRef))) : nil;
+    };
+
+    XCTAssertTrue([codecClass isConcurrentDecodingEnabled]);
+    tip_defer(^{
+        [codecClass setConcurrentDecodingEnabled:YES];
+    });
+
+    // full size and DCT scaled, the bands decode the neighboring MCU rows so the seams match too
+    for (NSValue *targetDimensionsValue in @[ [NSValue valueWithCGSize:CGSizeZero], [NSValue valueWithCGSize:CGSizeMake(1024, 1024)] ]) {
+        [codecClass setConcurrentDecodingEnabled:YES];
+        NSData *bandedPixels = decodePixels(targetDimensionsValue.CGSizeValue);
+        [codecClass setConcurrentDecodingEnabled:NO];
+        NSData *sequentialPixels = decodePixels(targetDimensionsValue.CGSizeValue);
+        XCTAssertNotNil(bandedPixels);
+        XCTAssertGreaterThan(bandedPixels.length, (NSUInteger)0);
+        XCTAssertEqualObjects(bandedPixels, sequentialPixels, @"%@", targetDimensionsValue);
+    }
+}
+
+- (void)testXJPEGTurboCodecScaleSelection
+{
+    Class codecClass = NSClassFromString(@"TIPXJPEGTurboCodec");
+    if (!codecClass) {
+        return;
+    }
+
+    // the decoded image has the dimensions of the smallest DCT scaling (1/1, 1/2, 1/4 or 1/8) that
+    // isn't smaller than the target sizing, the rest of the scaling is left to TIP
+    id<TIPImageCodec> codec = [[codecClass alloc] init];
+    TIPImageContainer *scaledImage = [sImageContainer scaleToTargetDimensions:CGSizeMake(1024, 768) contentMode:UIViewContentModeScaleToFill];
+    NSData *data = [codec.tip_encoder tip_writeDataWithImage:scaledImage
+                                             encodingOptions:0
+                                            suggestedQuality:JPEG_QUALITY_GOOD
+                                                       error:NULL];
+    XCTAssertNotNil(data);
+
+    CGSize (^decodedDimensions)(CGSize, UIViewContentMode) = ^CGSize(CGSize targetDimensions, UIViewContentMode targetContentMode) {
+        TIPImageContainer *decodedImage = [codec.tip_decoder tip_decodeImageWithData:data
+                                                                    targetDimensions:targetDimensions
+                                                                   targetContentMode:targetContentMode
+                                                                              config:nil];
+        return decodedImage.dimensions;
+    };
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeZero, UIViewContentModeScaleAspectFit), CGSizeMake(1024, 768)));
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeMake(2048, 2048), UIViewContentModeScaleAspectFit), CGSizeMake(1024, 768)));
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeMake(513, 385), UIViewContentModeScaleAspectFit), CGSizeMake(1024, 768)));
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeMake(512, 384), UIViewContentModeScaleAspectFit), CGSizeMake(512, 384)));
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeMake(200, 200), UIViewContentModeScaleAspectFit), CGSizeMake(256, 192)));
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeMake(100, 100), UIViewContentModeScaleAspectFill), CGSizeMake(256, 192)));
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeMake(128, 96), UIViewContentModeScaleAspectFit), CGSizeMake(128, 96)));
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeMake(16, 16), UIViewContentModeScaleAspectFit), CGSizeMake(128, 96)));
+
+    // the target sizing is of the oriented image
+    UIImage *rotatedImage = [UIImage imageWithCGImage:scaledImage.image.CGImage scale:1.0 orientation:UIImageOrientationLeft];
+    data = [codec.tip_encoder tip_writeDataWithImage:[[TIPImageContainer alloc] initWithImage:rotatedImage]
+                                     encodingOptions:0
+                                    suggestedQuality:JPEG_QUALITY_GOOD
+                                               error:NULL];
+    XCTAssertNotNil(data);
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeMake(96, 128), UIViewContentModeScaleAspectFit), CGSizeMake(96, 128)));
+    XCTAssertTrue(CGSizeEqualToSize(decodedDimensions(CGSizeMake(128, 96), UIViewContentModeScaleAspectFill), CGSizeMake(192, 256)));
+
+    // regions scale by the sizing of the region
+    TIPImageContainer *regionImage = TIPDecodeImageRegionFromData(codec, nil, data, CGRectMake(0, 0, 384, 512), CGSizeMake(96, 128), UIViewContentModeScaleAspectFit);
+    XCTAssertTrue(CGSizeEqualToSize(regionImage.dimensions, CGSizeMake(96, 128)));
+}
+
+- (void)testXPNGCodec
+{
+    // TIPXPNGCodec needs libpng, which is not vendored: only run when both are added to the test target
+    Class codecClass = NSClassFromString(@"TIPXPNGCodec");
+    if (!codecClass) {
+        return;
+    }
+
+    id<TIPImageCodec> codec = [[codecClass alloc] init];
+    TIPImageContainer *scaledImage = [sImageContainer scaleToTargetDimensions:CGSizeMake(256, 256) contentMode:UIViewContentModeScaleAspectFit];
+    [self _testRoundTripWithCodec:codec image:scaledImage encodingOptions:0 quality:1.f expectsProgressiveFrames:NO];
+    [self _testRoundTripWithCodec:codec image:scaledImage encodingOptions:TIPImageEncodingProgressive quality:1.f expectsProgressiveFrames:YES];
+    [self _testRoundTripWithCodec:codec image:scaledImage encodingOptions:TIPImageEncodingGrayscale | TIPImageEncodingNoAlpha quality:0.5f expectsProgressiveFrames:NO];
+}
+
+- (void)testXPNGCodecFallsBackForAPNG
+{
+    Class codecClass = NSClassFromString(@"TIPXPNGCodec");
+    if (!codecClass) {
+        return;
+    }
+
+    // libpng only writes static PNGs
+    id<TIPImageCodec> codec = [[codecClass alloc] init];
+    NSError *error = nil;
+    NSData *data = [codec.tip_encoder tip_writeDataWithImage:sAnimatedImageContainer
+                                             encodingOptions:0
+                                            suggestedQuality:1.f
+                                                       error:&error];
+    XCTAssertNil(data);
+    XCTAssertEqualObjects(error.domain, TIPErrorDomain);
+    XCTAssertEqual(error.code, TIPErrorCodeEncodingUnsupported);
+
+    // encoded and decoded by the preferred codec
+    codec = [(id<TIPTestPortableCodec>)[codecClass alloc] initWithPreferredCodec:[TIPImageCodecCatalogue defaultCodecs][TIPImageTypePNG]];
+    [self _testRoundTripWithCodec:codec image:sAnimatedImageContainer encodingOptions:0 quality:1.f expectsProgressiveFrames:NO];
+}
+
+- (void)testXGIFCodec
+{
+    // TIPXGIFCodec needs giflib, which is not vendored: only run when both are added to the test target
+    Class codecClass = NSClassFromString(@"TIPXGIFCodec");
+    if (!codecClass) {
+        return;
+    }
+
+    id<TIPImageCodec> codec = [[codecClass alloc] init];
+    TIPImageContainer *scaledImage = [sImageContainer scaleToTargetDimensions:CGSizeMake(256, 256) contentMode:UIViewContentModeScaleAspectFit];
+    [self _testRoundTripWithCodec:codec image:scaledImage encodingOptions:0 quality:1.f expectsProgressiveFrames:NO];
+    [self _testRoundTripWithCodec:codec image:scaledImage encodingOptions:TIPImageEncodingProgressive quality:1.f expectsProgressiveFrames:NO];
+    [self _testRoundTripWithCodec:codec image:sAnimatedImageContainer encodingOptions:0 quality:1.f expectsProgressiveFrames:YES];
+}
+
 #pragma mark Test Functions
 
 - (void)testImageWriteToFile
@@ -1122,7 +1511,7 @@ static NSMutableDictionary<NSString *, NSMutableDictionary<NSString *, NSNumber
 {
     XCTAssertEqual([[TIPImageCodecCatalogue sharedInstance] codecWithImageTypeSupportsProgressiveLoading:TIPImageTypeJPEG2000], NO);
     XCTAssertEqual([[TIPImageCodecCatalogue sharedInstance] codecWithImageTypeSupportsProgressiveLoading:TIPImageTypeJPEG], YES);
-    XCTAssertEqual([[TIPImageCodecCatalogue sharedInstance] codecWithImageTypeSupportsProgressiveLoading:TIPImageTypePNG], NO); // for now
+    XCTAssertEqual([[TIPImageCodecCatalogue sharedInstance] codecWithImageTypeSupportsProgressiveLoading:TIPImageTypePNG], YES);
     XCTAssertEqual([[TIPImageCodecCatalogue sharedInstance] codecWithImageTypeSupportsProgressiveLoading:nil], NO);
 }
 
@@ -1135,7 +1524,7 @@ static NSMutableDictionary<NSString *, NSMutableDictionary<NSString *, NSNumber
 {
     XCTAssertEqual([self _typeHasProgressiveVariant:TIPImageTypeJPEG], YES);
     XCTAssertEqual([self _typeHasProgressiveVariant:TIPImageTypeJPEG2000], NO);
-    XCTAssertEqual([self _typeHasProgressiveVariant:TIPImageTypePNG], NO);
+    XCTAssertEqual([self _typeHasProgressiveVariant:TIPImageTypePNG], YES);
     XCTAssertEqual([self _typeHasProgressiveVariant:nil], NO);
 }
 
@@ -1171,6 +1560,17 @@ static NSMutableDictionary<NSString *, NSMutableDictionary<NSString *, NSNumber
     XCTAssertEqualObjects(TIPImageTypeICO, TIPImageTypeFromUTType((__bridge NSString *)kUTTypeICO));
     XCTAssertEqualObjects(TIPImageTypeRAW, TIPImageTypeFromUTType((__bridge NSString *)kUTTypeRawImage));
     XCTAssertEqualObjects(TIPImageTypeRAW, TIPImageTypeFromUTType(@"com.canon.cr2-raw-image"));
+    XCTAssertEqualObjects(TIPImageTypeJXL, TIPImageTypeFromUTType(@"public.jpeg-xl"));
+
+    // magic numbers
+
+    const Byte jxlCodestream[] = { 0xFF, 0x0A, 0xFA, 0x7F };
+    const Byte jxlContainer[] = { 0x00, 0x00, 0x00, 0x0C, 'J', 'X', 'L', ' ', 0x0D, 0x0A, 0x87, 0x0A, 0x00 };
+    XCTAssertEqualObjects(TIPImageTypeJXL, TIPDetectImageTypeViaMagicNumbers([NSData dataWithBytes:jxlCodestream length:sizeof(jxlCodestream)]));
+    XCTAssertEqualObjects(TIPImageTypeJXL, TIPDetectImageTypeViaMagicNumbers([NSData dataWithBytes:jxlContainer length:sizeof(jxlContainer)]));
+    XCTAssertNil(TIPDetectImageTypeViaMagicNumbers([NSData dataWithBytes:jxlContainer length:sizeof(jxlContainer) - 2]));
+    XCTAssertTrue([TIPDetectableImageTypesViaMagicNumbers() containsObject:TIPImageTypeJXL]);
+    XCTAssertGreaterThanOrEqual(TIPMagicNumbersForImageTypeMaximumLength, sizeof(jxlContainer) - 1);
 
     // read
 
@@ -1833,6 +2233,36 @@ static NSMutableDictionary<NSString *, NSMutableDictionary<NSString *, NSNumber
     [self _runTestImageHasAlpha:imageAllAlpha hasAlphaPixel:YES];
 }
 
+- (void)testImageHasAlphaPixelPositions
+{
+    // an odd width covers both the vectorized pixels and the remaining pixels of each row
+    const size_t width = 37;
+    const size_t height = 3;
+    const CGImageAlphaInfo alphaInfos[] = { kCGImageAlphaPremultipliedLast, kCGImageAlphaPremultipliedFirst };
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    TIPDeferRelease(colorSpace);
+
+    for (size_t iAlphaInfo = 0; iAlphaInfo < sizeof(alphaInfos) / sizeof(alphaInfos[0]); iAlphaInfo++) {
+        const CGBitmapInfo bitmapInfo = (CGBitmapInfo)alphaInfos[iAlphaInfo] | kCGBitmapByteOrder32Big;
+        const size_t alphaByteIndex = (kCGImageAlphaPremultipliedLast == alphaInfos[iAlphaInfo]) ? 3 : 0;
+        for (size_t iPixel = 0; iPixel <= width * height; iPixel++) {
+            CGContextRef cgContext = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace, bitmapInfo);
+            TIPDeferRelease(cgContext);
+            UInt8 *bytes = CGBitmapContextGetData(cgContext);
+            const size_t bytesPerRow = CGBitmapContextGetBytesPerRow(cgContext);
+            memset(bytes, 0xFF, bytesPerRow * height);
+            if (iPixel < width * height) {
+                // the last iteration leaves every pixel opaque
+                bytes[((iPixel / width) * bytesPerRow) + ((iPixel % width) * 4) + alphaByteIndex] = 0xFE;
+            }
+
+            CGImageRef cgImage = CGBitmapContextCreateImage(cgContext);
+            TIPDeferRelease(cgImage);
+            XCTAssertEqual(TIPCGImageHasAlpha(cgImage, YES), (BOOL)(iPixel < width * height), @"pixel %zu", iPixel);
+        }
+    }
+}
+
 - (void)testTIPImageTypeMatchesUTType
 {
     XCTAssertEqualObjects((NSString *)kUTTypeJPEG, TIPImageTypeJPEG);
@@ -11,6 +11,8 @@
 
 static NSURLSession *sTIPTestImageFetchDownloadInternalURLSessionWithPseudo = nil;
 
+static NSURLSession *_StubbingURLSession(void);
+
 @interface TIPTestURLProtocol (TIPConvenience)
 
 + (void)tip_registerResponseData:(nullable NSData *)responseData responseMIMEType:(nullable NSString *)MIMEType shouldSupportResuming:(BOOL)shouldSupportResume suggestedBitrate:(uint64_t)suggestedBitrate withEndpoint:(nonnull NSURL *)endpointURL;
@@ -24,6 +26,12 @@ static NSURLSession *sTIPTestImageFetchDownloadInternalURLSessionWithPseudo = ni
     return [[TIPTestImageFetchDownloadInternalWithStubbing alloc] initWithContext:context stub:self.downloadStubbingEnabled];
 }
 
+- (void)preconnectToURLs:(NSArray<NSURL *> *)URLs
+{
+    [TIPImageFetchDownloadInternal preconnectToURLs:URLs
+                                            session:(self.downloadStubbingEnabled) ? _StubbingURLSession() : [TIPImageFetchDownloadInternal defaultURLSession]];
+}
+
 - (void)addDownloadStubForRequestURL:(NSURL *)requestURL responseData:(NSData *)responseData responseMIMEType:(NSString *)MIMEType shouldSupportResuming:(BOOL)shouldSupportResume suggestedBitrate:(uint64_t)suggestedBitrate
 {
     [TIPTestURLProtocol tip_registerResponseData:responseData responseMIMEType:MIMEType shouldSupportResuming:shouldSupportResume suggestedBitrate:suggestedBitrate withEndpoint:requestURL];
@@ -60,21 +68,7 @@ static NSURLSession *sTIPTestImageFetchDownloadInternalURLSessionWithPseudo = ni
         return [super URLSession];
     }
 
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        NSURLSession *session = [super URLSession];
-        NSURLSessionConfiguration *config = [session.configuration copy];
-        id<NSURLSessionDelegate> delegate = session.delegate;
-        NSOperationQueue *queue = session.delegateQueue;
-
-        NSMutableArray *protocols = [config.protocolClasses mutableCopy];
-        [protocols insertObject:[TIPTestURLProtocol class] atIndex:0];
-        config.protocolClasses = protocols;
-
-        sTIPTestImageFetchDownloadInternalURLSessionWithPseudo = [NSURLSession sessionWithConfiguration:config delegate:delegate delegateQueue:queue];
-    });
-
-    return sTIPTestImageFetchDownloadInternalURLSessionWithPseudo;
+    return _StubbingURLSession();
 }
 
 @end
@@ -93,3 +87,22 @@ static NSURLSession *sTIPTestImageFetchDownloadInternalURLSessionWithPseudo = ni
 }
 
 @end
+
+static NSURLSession *_StubbingURLSession()
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSURLSession *session = [TIPImageFetchDownloadInternal defaultURLSession];
+        NSURLSessionConfiguration *config = [session.configuration copy];
+        id<NSURLSessionDelegate> delegate = session.delegate;
+        NSOperationQueue *queue = session.delegateQueue;
+
+        NSMutableArray *protocols = [config.protocolClasses mutableCopy];
+        [protocols insertObject:[TIPTestURLProtocol class] atIndex:0];
+        config.protocolClasses = protocols;
+
+        sTIPTestImageFetchDownloadInternalURLSessionWithPseudo = [NSURLSession sessionWithConfiguration:config delegate:delegate delegateQueue:queue];
+    });
+
+    return sTIPTestImageFetchDownloadInternalURLSessionWithPseudo;
+}
@@ -28,6 +28,8 @@ FOUNDATION_EXTERN NSString * const TIPTestURLProtocolErrorDomain;
 + (void)unregisterAllEndpoints;
 
 + (BOOL)isEndpointRegistered:(NSURL *)endpoint;
++ (NSUInteger)requestCountForEndpoint:(NSURL *)endpoint; // requests loaded since the endpoint was registered
++ (NSArray<NSURLRequest *> *)requestsForEndpoint:(NSURL *)endpoint; // requests loaded since the endpoint was registered, in load order
 
 @end
 
@@ -42,6 +44,9 @@ typedef NS_ENUM(NSUInteger, TIPTestURLProtocolRedirectBehavior) {
 @property (nonatomic) uint64_t bps; // bits per second, 0 == unlimited
 @property (nonatomic) uint64_t latency; // in milliseconds
 @property (nonatomic) uint64_t delay; // in milliseconds
+@property (nonatomic) uint64_t stall; // in milliseconds, added to the delay of `stalledRequestCount` requests starting at `firstStalledRequestIndex`
+@property (nonatomic) NSUInteger stalledRequestCount; // default == 0
+@property (nonatomic) NSUInteger firstStalledRequestIndex; // default == 0
 @property (nonatomic, nullable) NSError *failureError; // nil == no error
 @property (nonatomic) NSInteger statusCode; // 0 == don't override
 @property (nonatomic) BOOL canProvideRange; // default == YES
@@ -23,15 +23,19 @@ do { \
 NSString * const TIPTestURLProtocolErrorDomain = @"TIPTestURLProtocolErrorDomain";
 
 static NSMutableDictionary *sOriginToResponseDictionary;
+static NSMutableDictionary<NSString *, NSMutableArray<NSURLRequest *> *> *sOriginToRequestsDictionary;
 static dispatch_queue_t sOriginQueue;
 
 static NSString * __nullable _UnderlyingURLString(NSURL * __nullable url);
 static NSHTTPURLResponse *_UpdateResponse(NSHTTPURLResponse *response,
                                           NSUInteger contentLength,
-                                          NSInteger statusCode);
+                                          NSInteger statusCode,
+                                          NSString * __nullable contentRange);
 static NSRange _RangeForRequest(NSURLRequest *request,
                                 NSUInteger dataLength,
                                 NSString *stringForIfRange);
+static BOOL _RequestIsNotModified(NSURLRequest *request,
+                                  NSHTTPURLResponse *response);
 
 typedef void(^TIPTestURLProtocolClientBlock)(id<NSURLProtocolClient> client);
 
@@ -77,6 +81,7 @@ TIP_OBJC_DIRECT_MEMBERS
 
     tip_dispatch_barrier_async_autoreleasing(sOriginQueue, ^{
         sOriginToResponseDictionary[_UnderlyingURLString(endpoint)] = cachedResponse;
+        [sOriginToRequestsDictionary removeObjectForKey:_UnderlyingURLString(endpoint)];
     });
 }
 
@@ -84,6 +89,7 @@ TIP_OBJC_DIRECT_MEMBERS
 {
     tip_dispatch_barrier_async_autoreleasing(sOriginQueue, ^{
         [sOriginToResponseDictionary removeObjectForKey:_UnderlyingURLString(endpoint)];
+        [sOriginToRequestsDictionary removeObjectForKey:_UnderlyingURLString(endpoint)];
     });
 }
 
@@ -91,6 +97,7 @@ TIP_OBJC_DIRECT_MEMBERS
 {
     tip_dispatch_barrier_async_autoreleasing(sOriginQueue, ^{
         [sOriginToResponseDictionary removeAllObjects];
+        [sOriginToRequestsDictionary removeAllObjects];
     });
 }
 
@@ -103,11 +110,30 @@ TIP_OBJC_DIRECT_MEMBERS
     return isRegistered;
 }
 
++ (NSUInteger)requestCountForEndpoint:(NSURL *)endpoint
+{
+    __block NSUInteger requestCount = 0;
+    dispatch_sync(sOriginQueue, ^{
+        requestCount = sOriginToRequestsDictionary[_UnderlyingURLString(endpoint)].count;
+    });
+    return requestCount;
+}
+
++ (NSArray<NSURLRequest *> *)requestsForEndpoint:(NSURL *)endpoint
+{
+    __block NSArray<NSURLRequest *> *requests = nil;
+    dispatch_sync(sOriginQueue, ^{
+        requests = [sOriginToRequestsDictionary[_UnderlyingURLString(endpoint)] copy];
+    });
+    return requests ?: @[];
+}
+
 + (void)initialize
 {
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
         sOriginToResponseDictionary = [[NSMutableDictionary alloc] init];
+        sOriginToRequestsDictionary = [[NSMutableDictionary alloc] init];
         sOriginQueue = dispatch_queue_create("tip.test.url.protocol.origin.queue", DISPATCH_QUEUE_CONCURRENT);
     });
 }
@@ -154,8 +180,16 @@ TIP_OBJC_DIRECT_MEMBERS
         NSString *url = _UnderlyingURLString(request.URL);
         TIPAssert(url);
         __block NSCachedURLResponse *response;
-        dispatch_sync(sOriginQueue, ^{
+        __block NSUInteger requestIndex;
+        dispatch_barrier_sync(sOriginQueue, ^{
             response = sOriginToResponseDictionary[url];
+            NSMutableArray<NSURLRequest *> *requests = sOriginToRequestsDictionary[url];
+            if (!requests) {
+                requests = [[NSMutableArray alloc] init];
+                sOriginToRequestsDictionary[url] = requests;
+            }
+            requestIndex = requests.count;
+            [requests addObject:request];
         });
 
         if (response) {
@@ -187,6 +221,9 @@ TIP_OBJC_DIRECT_MEMBERS
 
                 NSTimeInterval delay, latency;
                 delay = ((double)config.delay) / 1000.0;
+                if (requestIndex >= config.firstStalledRequestIndex && (requestIndex - config.firstStalledRequestIndex) < config.stalledRequestCount) {
+                    delay += ((double)config.stall) / 1000.0;
+                }
                 latency = ((double)config.latency) / 1000.0;
 
                 dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)((delay + latency) * NSEC_PER_SEC)), self->_protocolQueue, ^{
@@ -204,6 +241,13 @@ TIP_OBJC_DIRECT_MEMBERS
                         NSHTTPURLResponse *httpResponse = (id)response.response;
                         NSData *data = response.data;
                         NSInteger statusCode = (config.statusCode > 0) ? config.statusCode : httpResponse.statusCode;
+                        NSString *contentRange = nil;
+
+                        // See if we need to change to a 304
+                        if (200 == statusCode && _RequestIsNotModified(request, httpResponse)) {
+                            statusCode = 304;
+                            data = [NSData data];
+                        }
 
                         // See if we need to change to a 206
                         if (200 == statusCode && config.canProvideRange) {
@@ -212,6 +256,7 @@ TIP_OBJC_DIRECT_MEMBERS
                             if (range.location != NSNotFound) {
                                 // subrange requested, provide it
                                 statusCode = 206;
+                                contentRange = [NSString stringWithFormat:@"bytes %tu-%tu/%tu", range.location, NSMaxRange(range) - 1, data.length];
                                 data = [data subdataWithRange:range];
                             }
 
@@ -226,7 +271,7 @@ TIP_OBJC_DIRECT_MEMBERS
                             }
                         }
 
-                        httpResponse = _UpdateResponse(httpResponse, data.length, statusCode);
+                        httpResponse = _UpdateResponse(httpResponse, data.length, statusCode, contentRange);
 
                         tip_dispatch_async_autoreleasing(self->_protocolQueue, ^{
                             ABORT_IF_NECESSARY();
@@ -421,6 +466,9 @@ TIP_OBJC_DIRECT_MEMBERS
     config.bps = self.bps;
     config.latency = self.latency;
     config.delay = self.delay;
+    config.stall = self.stall;
+    config.stalledRequestCount = self.stalledRequestCount;
+    config.firstStalledRequestIndex = self.firstStalledRequestIndex;
     config.failureError = self.failureError;
     config.statusCode = self.statusCode;
     config.canProvideRange = self.canProvideRange;
@@ -438,10 +486,13 @@ static NSString *_UnderlyingURLString(NSURL * __nullable url)
     return url.absoluteString.lowercaseString;
 }
 
-static NSHTTPURLResponse *_UpdateResponse(NSHTTPURLResponse *response, NSUInteger contentLength, NSInteger statusCode)
+static NSHTTPURLResponse *_UpdateResponse(NSHTTPURLResponse *response, NSUInteger contentLength, NSInteger statusCode, NSString * __nullable contentRange)
 {
     NSMutableDictionary *responseHeaderFields = [response.allHeaderFields mutableCopy];
     [responseHeaderFields tip_setObject:[@(contentLength) stringValue] forCaseInsensitiveKey:@"Content-Length"];
+    if (contentRange) {
+        [responseHeaderFields tip_setObject:contentRange forCaseInsensitiveKey:@"Content-Range"];
+    }
     return [[NSHTTPURLResponse alloc] initWithURL:response.URL statusCode:statusCode HTTPVersion:@"HTTP/1.1" headerFields:responseHeaderFields];
 }
 
@@ -459,10 +510,11 @@ static NSRange _RangeForRequest(NSURLRequest *request, NSUInteger dataLength, NS
                 const NSInteger startIndex = [indexes[0] integerValue];
                 NSInteger endIndex = (NSInteger)dataLength - 1;
                 if ([indexes[1] length] > 0) {
-                    endIndex = [indexes[1] integerValue];
+                    endIndex = MIN([indexes[1] integerValue], endIndex);
                 }
+                // ranges are inclusive of the end index
                 if (endIndex >= startIndex) {
-                    return NSMakeRange((NSUInteger)startIndex, (NSUInteger)endIndex - (NSUInteger)startIndex);
+                    return NSMakeRange((NSUInteger)startIndex, (NSUInteger)endIndex - (NSUInteger)startIndex + 1);
                 }
             }
         }
@@ -471,5 +523,17 @@ static NSRange _RangeForRequest(NSURLRequest *request, NSUInteger dataLength, NS
     return NSMakeRange(NSNotFound, 0);
 }
 
-NS_ASSUME_NONNULL_END
+static BOOL _RequestIsNotModified(NSURLRequest *request, NSHTTPURLResponse *response)
+{
+    NSString *ETag = [response.allHeaderFields tip_objectForCaseInsensitiveKey:@"ETag"];
+    NSString *ifNoneMatch = [request.allHTTPHeaderFields tip_objectForCaseInsensitiveKey:@"If-None-Match"];
+    if (ETag && ifNoneMatch) {
+        return [ifNoneMatch isEqualToString:ETag];
+    }
 
+    NSString *lastModified = [response.allHeaderFields tip_objectForCaseInsensitiveKey:@"Last-Modified"];
+    NSString *ifModifiedSince = [request.allHTTPHeaderFields tip_objectForCaseInsensitiveKey:@"If-Modified-Since"];
+    return lastModified && [ifModifiedSince isEqualToString:lastModified];
+}
+
+NS_ASSUME_NONNULL_END
@@ -9,10 +9,34 @@
 #import <XCTest/XCTest.h>
 
 #import "TIP_Project.h"
+#import "TIPColorPalette.h"
+#import "TIPFileUtils.h"
+#import "TIPGlobalConfiguration.h"
+#import "TIPImageBlur.h"
+#import "TIPImageCacheEntry.h"
+#import "TIPImageCacheExpiryIndex.h"
+#import "TIPImageCodecCatalogue.h"
+#import "TIPImageDownloadConcurrencyController.h"
+#import "TIPImageDiskCacheEntryFile.h"
+#import "TIPImageDiskCacheSlabStore.h"
 #import "TIPImageContainer.h"
+#import "TIPImageResampler.h"
+#import "TIPImageTileSource.h"
+#import "TIPImageUtils.h"
 #import "TIPTests.h"
 #import "UIImage+TIPAdditions.h"
 
+// Records the target sizing that entire images are decoded at, decodes with the given codec
+@interface TIPTestTargetRecordingDecoder : NSObject <TIPImageDecoder>
+@property (nonatomic, readonly) NSArray<NSValue *> *decodedTargetDimensions;
+- (instancetype)initWithCodec:(id<TIPImageCodec>)codec;
+@end
+
+@interface TIPTestTargetRecordingCodec : NSObject <TIPImageCodec>
+@property (nonatomic, readonly) TIPTestTargetRecordingDecoder *tip_decoder;
+- (instancetype)initWithCodec:(id<TIPImageCodec>)codec;
+@end
+
 @interface TIPUtilitiesTests : XCTestCase
 
 @end
@@ -70,6 +94,32 @@
     }
 }
 
+- (void)testHashedKeyFromRaw
+{
+    NSArray *entries = @[
+                         @[ @"Twitter", @"0a1752f8ca4a03b62c63cdc556aaacbe" ],
+                         @[ @"https://www.twitter.com/image/192.jpg", @"b0e73a67b10477044f3006d0c655634f" ],
+                        ];
+    for (NSArray *entry in entries) {
+        XCTAssertEqualObjects(TIPHashedKeyFromRaw(entry[0]), entry[1]);
+    }
+
+    // Fixed length regardless of input
+    NSMutableString *longString = [NSMutableString string];
+    while (longString.length < 4096) {
+        [longString appendString:@"https://pbs.twimg.com/media/\u00e9\U0001F426.jpg?name=large&"];
+    }
+    NSArray<NSString *> *strings = @[ @"", @"a", @"b", @"\u00e9\U0001F426", longString ];
+    NSMutableSet<NSString *> *keys = [NSMutableSet set];
+    for (NSString *string in strings) {
+        NSString *key = TIPHashedKeyFromRaw(string);
+        XCTAssertEqual(key.length, (NSUInteger)32);
+        XCTAssertEqualObjects(key, TIPHashedKeyFromRaw([string mutableCopy]));
+        [keys addObject:key];
+    }
+    XCTAssertEqual(keys.count, strings.count);
+}
+
 - (void)testOddBoundaryScaling
 {
     // We see lots of problems like this:
@@ -391,4 +441,697 @@ typedef struct {
     }
 }
 
+static TIPImageMemoryCacheEntry *_ExpiryTestEntry(NSString *identifier, NSTimeInterval age, NSTimeInterval TTL)
+{
+    TIPImageMemoryCacheEntry *entry = [[TIPImageMemoryCacheEntry alloc] init];
+    entry.identifier = identifier;
+    entry.completeImageContext = [[TIPCompleteImageEntryContext alloc] init];
+    entry.completeImageContext.TTL = TTL;
+    entry.completeImageContext.lastAccess = (age >= 0) ? CFAbsoluteTimeGetCurrent() - age : 0;
+    return entry;
+}
+
+- (void)testCacheExpiryIndex
+{
+    dispatch_queue_t queue = dispatch_queue_create("tip.test.expiry.index.queue", DISPATCH_QUEUE_SERIAL);
+    XCTestExpectation *expectation = [self expectationWithDescription:@"expired entries swept"];
+    __block NSArray<TIPImageCacheEntry *> *expiredEntries = nil;
+    TIPImageCacheExpiryIndex *index = [[TIPImageCacheExpiryIndex alloc] initWithQueue:queue
+                                                                        expiryHandler:^(NSArray<TIPImageCacheEntry *> *entries) {
+        expiredEntries = entries;
+        [expectation fulfill];
+    }];
+
+    TIPImageMemoryCacheEntry *expiredLater = _ExpiryTestEntry(@"expiredLater", 30, 10);
+    TIPImageMemoryCacheEntry *expiredSooner = _ExpiryTestEntry(@"expiredSooner", 120, 60);
+    TIPImageMemoryCacheEntry *expiredButRemoved = _ExpiryTestEntry(@"expiredButRemoved", 120, 10);
+    TIPImageMemoryCacheEntry *live = _ExpiryTestEntry(@"live", 0, 3600);
+    TIPImageMemoryCacheEntry *neverAccessed = _ExpiryTestEntry(@"neverAccessed", -1, 10);
+
+    dispatch_sync(queue, ^{
+        for (TIPImageCacheEntry *entry in @[expiredLater, live, expiredButRemoved, expiredSooner, neverAccessed]) {
+            [index updateEntry:entry];
+        }
+        [index removeEntry:expiredButRemoved];
+        XCTAssertEqual(index.numberOfEntries, (NSUInteger)3); // never accessed entries don't expire
+    });
+
+    [self waitForExpectationsWithTimeout:5.0 handler:NULL];
+
+    NSArray<TIPImageCacheEntry *> *expectedEntries = @[expiredSooner, expiredLater];
+    XCTAssertEqualObjects(expiredEntries, expectedEntries);
+    dispatch_sync(queue, ^{
+        XCTAssertEqual(index.numberOfEntries, (NSUInteger)1);
+        XCTAssertEqual(live.expiryIndexPosition, (NSUInteger)1);
+        XCTAssertEqual(expiredSooner.expiryIndexPosition, (NSUInteger)0);
+    });
+}
+
+- (void)testDiskCacheSlabStore
+{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    TIPImageDiskCacheSlabStore *store = [[TIPImageDiskCacheSlabStore alloc] initWithPath:path];
+    [store loadRecordsUsingBlock:^BOOL(TIPImageDiskCacheSlabLocation location, NSUInteger dataLength, CFAbsoluteTime lastAccess, NSData *metadata) {
+        XCTFail(@"nothing to load");
+        return YES;
+    }];
+
+    NSData *data1 = [@"first image data" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *data2 = [@"second image data" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *metadata = [@"metadata" dataUsingEncoding:NSUTF8StringEncoding];
+    TIPImageDiskCacheSlabLocation location1, location2;
+    XCTAssertTrue([store appendRecordWithData:data1 metadata:metadata lastAccess:10 location:&location1]);
+    XCTAssertTrue([store appendRecordWithData:data2 metadata:metadata lastAccess:20 location:&location2]);
+    XCTAssertFalse([store appendRecordWithData:[NSMutableData dataWithLength:TIPImageDiskCacheSlabRecordMaxDataLength + 1] metadata:metadata lastAccess:30 location:&location1]);
+    XCTAssertEqual(location1.slabIdentifier, location2.slabIdentifier);
+    XCTAssertNotEqual(location1.slabIdentifier, (UInt32)0);
+    XCTAssertEqualObjects([store dataForRecordAtLocation:location1 dataLength:data1.length], data1);
+    XCTAssertEqualObjects([store dataForRecordAtLocation:location2 dataLength:data2.length], data2);
+
+    [store setLastAccess:40 forRecordAtLocation:location2];
+    [store freeRecordAtLocation:location1];
+    XCTAssertGreaterThan(store.freedSlabBytes, (UInt64)0);
+    XCTAssertEqual([store slabIdentifierNeedingCompaction], (UInt32)0); // the active slab is never compacted
+
+    // Reload, only the live record remains
+    store = [[TIPImageDiskCacheSlabStore alloc] initWithPath:path];
+    __block NSUInteger loadCount = 0;
+    [store loadRecordsUsingBlock:^BOOL(TIPImageDiskCacheSlabLocation location, NSUInteger dataLength, CFAbsoluteTime lastAccess, NSData *loadedMetadata) {
+        loadCount++;
+        XCTAssertEqual(location.offset, location2.offset);
+        XCTAssertEqual(dataLength, data2.length);
+        XCTAssertEqual(lastAccess, 40);
+        XCTAssertEqualObjects(loadedMetadata, metadata);
+        return YES;
+    }];
+    XCTAssertEqual(loadCount, (NSUInteger)1);
+    XCTAssertEqualObjects([store dataForRecordAtLocation:location2 dataLength:data2.length], data2);
+
+    // Once a slab is full, appends go to a new slab and the full slab can be compacted
+    NSData *largeData = [NSMutableData dataWithLength:TIPImageDiskCacheSlabRecordMaxDataLength];
+    TIPImageDiskCacheSlabLocation location3 = location2;
+    while (location3.slabIdentifier == location2.slabIdentifier) {
+        if (![store appendRecordWithData:largeData metadata:metadata lastAccess:50 location:&location3]) {
+            XCTFail(@"append failed");
+            break;
+        }
+        if (location3.slabIdentifier == location2.slabIdentifier) {
+            [store freeRecordAtLocation:location3];
+        }
+    }
+    XCTAssertEqual([store slabIdentifierNeedingCompaction], location2.slabIdentifier); // mostly freed
+    [store removeSlab:location2.slabIdentifier];
+    XCTAssertNil([store dataForRecordAtLocation:location2 dataLength:data2.length]);
+    XCTAssertEqualObjects([store dataForRecordAtLocation:location3 dataLength:largeData.length], largeData);
+
+    [store resetSlabs];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testDiskCacheEntryFile
+{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    NSData *payload = [@"image data" dataUsingEncoding:NSUTF8StringEncoding];
+    TIPCompleteImageEntryContext *context = [[TIPCompleteImageEntryContext alloc] init];
+    context.URL = [NSURL URLWithString:@"https://www.twitter.com/image/192.jpg"];
+    context.TTL = 60.0;
+    context.lastAccess = 1000;
+    context.dimensions = CGSizeMake(192, 108);
+    context.animated = YES;
+
+    NSError *error = nil;
+    const UInt64 fileLength = TIPImageDiskCacheEntryFileWrite(path, payload, @"identifier", context, &error);
+    XCTAssertNil(error);
+    XCTAssertNil(TIPListXAttributesForFile(path).firstObject);
+
+    // the returned length is the whole file, written beside the destination without leaving anything behind
+    XCTAssertGreaterThan(fileLength, (UInt64)(TIPImageDiskCacheEntryFileHeaderLength + payload.length));
+    XCTAssertEqual(fileLength, (UInt64)TIPFileSizeAtPath(path, NULL));
+    NSArray<NSString *> *siblings = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:[path stringByDeletingLastPathComponent] error:NULL];
+    XCTAssertEqualObjects([siblings filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"self BEGINSWITH %@", path.lastPathComponent]], @[ path.lastPathComponent ]);
+
+    NSString *identifier = nil;
+    TIPImageCacheEntryContext *readContext = TIPImageDiskCacheEntryFileReadContext(path, &identifier);
+    XCTAssertTrue([readContext isKindOfClass:[TIPCompleteImageEntryContext class]]);
+    XCTAssertEqualObjects(identifier, @"identifier");
+    XCTAssertEqualObjects(readContext.URL, context.URL);
+    XCTAssertEqual(readContext.lastAccess, context.lastAccess);
+    XCTAssertEqual(readContext.TTL, context.TTL);
+    XCTAssertTrue(CGSizeEqualToSize(readContext.dimensions, context.dimensions));
+    XCTAssertTrue(readContext.isAnimated);
+    XCTAssertEqualObjects(TIPImageDiskCacheEntryFileReadPayload(path, NO), payload);
+    XCTAssertEqualObjects(TIPImageDiskCacheEntryFileReadPayload(path, YES), payload);
+
+    // Touch (header only) and rename (identifier too)
+    context.lastAccess = 2000;
+    XCTAssertTrue(TIPImageDiskCacheEntryFileUpdate(path, nil, context));
+    XCTAssertEqual(TIPImageDiskCacheEntryFileReadContext(path, &identifier).lastAccess, context.lastAccess);
+    XCTAssertEqualObjects(identifier, @"identifier");
+    XCTAssertTrue(TIPImageDiskCacheEntryFileUpdate(path, @"renamed identifier", context));
+    XCTAssertNotNil(TIPImageDiskCacheEntryFileReadContext(path, &identifier));
+    XCTAssertEqualObjects(identifier, @"renamed identifier");
+    XCTAssertEqualObjects(TIPImageDiskCacheEntryFileReadPayload(path, NO), payload);
+
+    // Partial files reserve the header, append and then finalize
+    TIPPartialImageEntryContext *partialContext = [[TIPPartialImageEntryContext alloc] init];
+    partialContext.URL = context.URL;
+    partialContext.TTL = context.TTL;
+    partialContext.dimensions = context.dimensions;
+    partialContext.lastModified = @"Wed, 21 Oct 2015 07:28:00 GMT";
+    partialContext.expectedContentLength = 100;
+    NSMutableData *appended = [[NSMutableData alloc] initWithLength:TIPImageDiskCacheEntryFileHeaderLength];
+    [appended appendData:payload];
+    XCTAssertTrue([appended writeToFile:path atomically:YES]);
+    XCTAssertNil(TIPImageDiskCacheEntryFileReadContext(path, NULL));
+    XCTAssertEqual(TIPImageDiskCacheEntryFileFinalize(path, @"identifier", partialContext), (UInt64)TIPFileSizeAtPath(path, NULL));
+    readContext = TIPImageDiskCacheEntryFileReadContext(path, NULL);
+    XCTAssertTrue([readContext isKindOfClass:[TIPPartialImageEntryContext class]]);
+    XCTAssertEqualObjects([(TIPPartialImageEntryContext *)readContext lastModified], partialContext.lastModified);
+    XCTAssertEqual([(TIPPartialImageEntryContext *)readContext expectedContentLength], (NSUInteger)100);
+    XCTAssertEqualObjects(TIPImageDiskCacheEntryFileReadPayload(path, NO), payload);
+    XCTAssertTrue(TIPImageDiskCacheEntryFilePrepareForAppending(path));
+    XCTAssertEqual(TIPFileSizeAtPath(path, NULL), TIPImageDiskCacheEntryFileHeaderLength + payload.length);
+
+    // Legacy files are all payload and are not entry files
+    XCTAssertTrue([payload writeToFile:path atomically:YES]);
+    XCTAssertNil(TIPImageDiskCacheEntryFileReadContext(path, NULL));
+    XCTAssertFalse(TIPImageDiskCacheEntryFileUpdate(path, nil, context));
+    XCTAssertEqualObjects(TIPImageDiskCacheEntryFileReadPayload(path, NO), payload);
+
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+// Drive the controller with a simulated link: connections get up to connectionRate each, sharing linkRate,
+// and once the link is saturated requests queue up so the time to first byte grows with the excess
+static double _SimulateConcurrencyLink(TIPImageDownloadConcurrencyController *controller,
+                                       CFAbsoluteTime *time,
+                                       NSTimeInterval duration,
+                                       double linkRate,
+                                       double connectionRate,
+                                       NSTimeInterval roundTripTime)
+{
+    const NSTimeInterval step = 0.05;
+    double byteCount = 0;
+    const CFAbsoluteTime endTime = *time + duration;
+    while (*time < endTime) {
+        const double demand = (double)controller.limit * connectionRate;
+        const double throughput = MIN(linkRate, demand);
+        [controller recordTimeToFirstByte:roundTripTime * MAX(1.0, demand / linkRate)];
+        [controller recordBytes:(NSUInteger)(throughput * step) runningCount:controller.limit time:*time];
+        byteCount += throughput * step;
+        *time += step;
+        [controller evaluateWindowAtTime:*time];
+    }
+    return byteCount / duration;
+}
+
+- (void)testDownloadConcurrencyController
+{
+    TIPImageDownloadConcurrencyController *controller = [[TIPImageDownloadConcurrencyController alloc] initWithMinimumLimit:2 maximumLimit:12];
+    XCTAssertEqual(controller.limit, (NSUInteger)TIPMaxConcurrentImagePipelineDownloadCountDefault);
+    CFAbsoluteTime time = 1000.0;
+
+    // Fast link (Wi-Fi-like), each connection is the bottleneck so more concurrency is more goodput
+    double goodput = _SimulateConcurrencyLink(controller, &time, 60, 8e6, 0.5e6, 0.05);
+    XCTAssertEqual(controller.limit, controller.maximumLimit);
+    XCTAssertGreaterThan(goodput, 5e6);
+
+    // The link degrades (cellular-like), the link is the bottleneck so concurrency only adds latency
+    goodput = _SimulateConcurrencyLink(controller, &time, 120, 0.25e6, 0.5e6, 0.2);
+    XCTAssertLessThanOrEqual(controller.limit, (NSUInteger)3);
+    XCTAssertGreaterThanOrEqual(controller.limit, controller.minimumLimit);
+
+    // Bounds are respected when they change
+    [controller updateMinimumLimit:4 maximumLimit:8];
+    XCTAssertEqual(controller.limit, (NSUInteger)4);
+}
+
+- (void)testColorPalette
+{
+    // large enough to be counted in concurrent bands
+    const size_t width = 1000;
+    const size_t height = 700;
+    uint32_t *pixels = malloc(width * height * sizeof(uint32_t));
+    tip_defer(^{
+        free(pixels);
+    });
+
+    // screenshot-like: runs of 200 opaque colors and fully transparent pixels of any color
+    uint32_t colors[200];
+    for (size_t i = 0; i < 200; i++) {
+        colors[i] = (arc4random() & 0x00FFFFFF) | 0xFF000000; // alpha is the last byte
+    }
+    NSMutableSet<NSNumber *> *expectedColors = [NSMutableSet set];
+    for (size_t i = 0; i < width * height - 1; ) {
+        const uint32_t color = (arc4random_uniform(10) == 0) ? (arc4random() & 0x00FFFFFF) : colors[arc4random_uniform(200)];
+        [expectedColors addObject:@((color & 0xFF000000) ? color : 0)];
+        for (size_t run = 1 + arc4random_uniform(32); run > 0 && i < width * height - 1; run--) {
+            pixels[i++] = color;
+        }
+    }
+    pixels[width * height - 1] = pixels[0];
+
+    uint32_t palette[TIPColorPaletteMaxColorCount];
+    NSUInteger colorCount = 0;
+    XCTAssertTrue(TIPCollectColorPalette(pixels, width, height, width * sizeof(uint32_t), 256, YES, NO, palette, &colorCount));
+    XCTAssertEqual(colorCount, expectedColors.count);
+    NSMutableSet<NSNumber *> *paletteColors = [NSMutableSet set];
+    for (NSUInteger i = 0; i < colorCount; i++) {
+        [paletteColors addObject:@(palette[i])];
+    }
+    XCTAssertEqualObjects(paletteColors, expectedColors);
+
+    // too many colors for the limit
+    XCTAssertFalse(TIPCollectColorPalette(pixels, width, height, width * sizeof(uint32_t), 128, YES, NO, NULL, NULL));
+    // transparency is not supported
+    XCTAssertFalse(TIPCollectColorPalette(pixels, width, height, width * sizeof(uint32_t), 256, NO, NO, NULL, NULL));
+
+    // partial alpha in the last band
+    pixels[width * height - 1] = 0x80808080;
+    XCTAssertFalse(TIPCollectColorPalette(pixels, width, height, width * sizeof(uint32_t), 256, YES, NO, NULL, NULL));
+    XCTAssertTrue(TIPCollectColorPalette(pixels, width, height, width * sizeof(uint32_t), 256, YES, YES, NULL, &colorCount));
+    XCTAssertEqual(colorCount, expectedColors.count + 1);
+
+    // photo-like: too many colors
+    for (size_t i = 0; i < width * height; i++) {
+        pixels[i] = arc4random() | 0xFF000000;
+    }
+    XCTAssertFalse(TIPCollectColorPalette(pixels, width, height, width * sizeof(uint32_t), 256, YES, YES, NULL, NULL));
+}
+
+- (void)testImageResampler
+{
+    const size_t sourceWidth = 600;
+    const size_t sourceHeight = 450;
+    const size_t width = sourceWidth / 3;
+    const size_t height = sourceHeight / 3;
+    Byte *source = malloc(sourceWidth * sourceHeight * 4);
+    Byte *destination = malloc(width * height * 4);
+    tip_defer(^{
+        free(source);
+        free(destination);
+    });
+
+    // a constant image stays constant with every filter
+    for (size_t i = 0; i < sourceWidth * sourceHeight; i++) {
+        const Byte pixel[4] = { 0x40, 0x80, 0x20, 0xFF };
+        memcpy(source + (i * 4), pixel, sizeof(pixel));
+    }
+    for (TIPImageResamplingFilter filter = TIPImageResamplingFilterBox; filter <= TIPImageResamplingFilterLanczos3; filter++) {
+        XCTAssertTrue(TIPResamplePixels(source, sourceWidth, sourceHeight, sourceWidth * 4, destination, width, height, width * 4, 3, filter));
+        size_t constantMismatches = 0;
+        for (size_t i = 0; i < width * height; i++) {
+            if (0 != memcmp(destination + (i * 4), source, 4)) {
+                constantMismatches++;
+            }
+        }
+        XCTAssertEqual(constantMismatches, (size_t)0, @"filter %ld", (long)filter);
+    }
+
+    // a box downscale by a whole factor is the average of each 3x3 block
+    for (size_t i = 0; i < sourceWidth * sourceHeight; i++) {
+        const Byte alpha = (Byte)arc4random_uniform(256);
+        source[i * 4 + 0] = (Byte)arc4random_uniform((uint32_t)alpha + 1);
+        source[i * 4 + 1] = (Byte)arc4random_uniform((uint32_t)alpha + 1);
+        source[i * 4 + 2] = (Byte)arc4random_uniform((uint32_t)alpha + 1);
+        source[i * 4 + 3] = alpha;
+    }
+    XCTAssertTrue(TIPResamplePixels(source, sourceWidth, sourceHeight, sourceWidth * 4, destination, width, height, width * 4, 3, TIPImageResamplingFilterBox));
+    size_t mismatches = 0;
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            for (size_t c = 0; c < 4; c++) {
+                NSUInteger sum = 0;
+                for (size_t dy = 0; dy < 3; dy++) {
+                    for (size_t dx = 0; dx < 3; dx++) {
+                        sum += source[(((y * 3 + dy) * sourceWidth) + (x * 3 + dx)) * 4 + c];
+                    }
+                }
+                const NSInteger expected = (NSInteger)lround((double)sum / 9.0);
+                const NSInteger actual = destination[((y * width) + x) * 4 + c];
+                if (labs(expected - actual) > 1) {
+                    mismatches++;
+                }
+            }
+            // premultiplied colors never exceed alpha
+            const Byte *pixel = destination + (((y * width) + x) * 4);
+            XCTAssertLessThanOrEqual(MAX(pixel[0], MAX(pixel[1], pixel[2])), pixel[3]);
+        }
+    }
+    XCTAssertEqual(mismatches, (size_t)0);
+
+    // invalid arguments
+    XCTAssertFalse(TIPResamplePixels(source, sourceWidth, sourceHeight, sourceWidth * 3, destination, width, height, width * 4, 3, TIPImageResamplingFilterBox));
+    XCTAssertFalse(TIPResamplePixels(source, sourceWidth, sourceHeight, sourceWidth * 4, destination, 0, height, width * 4, 3, TIPImageResamplingFilterBox));
+
+    // scaling an image with the resampler enabled
+    NSString *imagePath = [TIPTestsResourceBundle() pathForResource:@"1538x2048" ofType:@"jpg"];
+    UIImage *image = [UIImage imageWithContentsOfFile:imagePath];
+    XCTAssertNotNil(image);
+    const BOOL wasEnabled = [TIPGlobalConfiguration sharedInstance].isImageResamplerEnabled;
+    [TIPGlobalConfiguration sharedInstance].imageResamplerEnabled = YES;
+    tip_defer(^{
+        [TIPGlobalConfiguration sharedInstance].imageResamplerEnabled = wasEnabled;
+    });
+    for (NSNumber *quality in @[ @(kCGInterpolationLow), @(kCGInterpolationMedium), @(kCGInterpolationHigh) ]) {
+        UIImage *scaledImage = [image tip_scaledImageWithTargetDimensions:CGSizeMake(384, 512)
+                                                              contentMode:UIViewContentModeScaleAspectFit
+                                                     interpolationQuality:quality
+                                                                   decode:NO];
+        XCTAssertNotEqual(scaledImage, image);
+        XCTAssertEqual(scaledImage.imageOrientation, UIImageOrientationUp);
+        XCTAssertEqual(scaledImage.tip_dimensions.width, 384);
+        XCTAssertEqual(scaledImage.tip_dimensions.height, 512);
+    }
+}
+
+
+- (void)testBoxBlur
+{
+    // odd sizes so tiles and bands are partial
+    const size_t width = 77;
+    const size_t height = 301;
+    const size_t bytesPerRow = width * 4 + 12;
+    const size_t radius = 3;
+    Byte *pixels = calloc(bytesPerRow * height, 1);
+    double *expected = calloc(width * height * 4, sizeof(double));
+    double *scratch = calloc(width * height * 4, sizeof(double));
+    tip_defer(^{
+        free(pixels);
+        free(expected);
+        free(scratch);
+    });
+
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            const Byte alpha = (Byte)arc4random_uniform(256);
+            Byte *pixel = pixels + (y * bytesPerRow) + (x * 4);
+            for (size_t c = 0; c < 3; c++) {
+                pixel[c] = (Byte)arc4random_uniform((uint32_t)alpha + 1);
+            }
+            pixel[3] = alpha;
+            for (size_t c = 0; c < 4; c++) {
+                expected[((y * width) + x) * 4 + c] = pixel[c];
+            }
+        }
+    }
+
+    // reference: 3 passes of a 2D box that extends the edges, like vImageBoxConvolve_ARGB8888
+    for (size_t pass = 0; pass < 3; pass++) {
+        for (size_t y = 0; y < height; y++) {
+            for (size_t x = 0; x < width; x++) {
+                for (size_t c = 0; c < 4; c++) {
+                    double sum = 0;
+                    for (NSInteger dy = -(NSInteger)radius; dy <= (NSInteger)radius; dy++) {
+                        for (NSInteger dx = -(NSInteger)radius; dx <= (NSInteger)radius; dx++) {
+                            const NSInteger sampleY = MIN((NSInteger)height - 1, MAX(0, (NSInteger)y + dy));
+                            const NSInteger sampleX = MIN((NSInteger)width - 1, MAX(0, (NSInteger)x + dx));
+                            sum += expected[((sampleY * (NSInteger)width) + sampleX) * 4 + (NSInteger)c];
+                        }
+                    }
+                    scratch[((y * width) + x) * 4 + c] = sum / (double)((radius * 2 + 1) * (radius * 2 + 1));
+                }
+            }
+        }
+        memcpy(expected, scratch, width * height * 4 * sizeof(double));
+    }
+
+    XCTAssertTrue(TIPBoxBlurPixels(pixels, width, height, bytesPerRow, radius * 2 + 1, 3, NULL));
+    double maxDifference = 0;
+    for (size_t y = 0; y < height; y++) {
+        for (size_t x = 0; x < width; x++) {
+            for (size_t c = 0; c < 4; c++) {
+                const double difference = fabs(pixels[(y * bytesPerRow) + (x * 4) + c] - expected[((y * width) + x) * 4 + c]);
+                maxDifference = MAX(maxDifference, difference);
+            }
+        }
+    }
+    // only rounding between the horizontal and vertical passes
+    XCTAssertLessThanOrEqual(maxDifference, 1.5);
+
+    // invalid arguments
+    XCTAssertFalse(TIPBoxBlurPixels(pixels, width, height, bytesPerRow, 4, 3, NULL));
+    XCTAssertFalse(TIPBoxBlurPixels(pixels, width, height, width * 3, 3, 3, NULL));
+
+    // a constant image stays constant, a saturation of 0 makes it gray
+    UIImage *image = TIPRenderImage(nil, ^(id<TIPRenderImageFormat> format) {
+        format.renderSize = CGSizeMake(300, 200);
+        format.scale = 1;
+        format.opaque = YES;
+    }, ^(UIImage *sourceImage, CGContextRef ctx) {
+        CGContextSetRGBFillColor(ctx, 0.8, 0.2, 0.4, 1.0);
+        CGContextFillRect(ctx, CGRectMake(0, 0, 300, 200));
+    });
+    XCTAssertNotNil(image);
+    for (NSNumber *saturation in @[ @1.0, @0.0 ]) {
+        UIImage *blurredImage = [image tip_imageWithBlurWithRadius:20
+                                                         tintColor:nil
+                                             saturationDeltaFactor:saturation.doubleValue
+                                                         maskImage:nil];
+        XCTAssertNotNil(blurredImage);
+        XCTAssertTrue(CGSizeEqualToSize(blurredImage.size, image.size));
+
+        // read the center pixel
+        Byte center[4] = { 0 };
+        CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+        TIPDeferRelease(colorSpace);
+        CGContextRef context = CGBitmapContextCreate(center, 1, 1, 8, 4, colorSpace, kCGImageAlphaPremultipliedLast);
+        TIPDeferRelease(context);
+        CGImageRef blurredImageRef = blurredImage.CGImage;
+        const CGFloat blurredWidth = CGImageGetWidth(blurredImageRef);
+        const CGFloat blurredHeight = CGImageGetHeight(blurredImageRef);
+        CGContextDrawImage(context, CGRectMake(-blurredWidth / 2, -blurredHeight / 2, blurredWidth, blurredHeight), blurredImageRef);
+
+        if (saturation.doubleValue == 1.0) {
+            XCTAssertEqualWithAccuracy(center[0], 204, 3);
+            XCTAssertEqualWithAccuracy(center[1], 51, 3);
+            XCTAssertEqualWithAccuracy(center[2], 102, 3);
+        } else {
+            XCTAssertEqualWithAccuracy(center[0], center[1], 3);
+            XCTAssertEqualWithAccuracy(center[1], center[2], 3);
+        }
+        XCTAssertEqual(center[3], 255);
+    }
+}
+
+- (void)testDecodeImageRegion
+{
+    // left half red, right half blue
+    UIImage *image = TIPRenderImage(nil, ^(id<TIPRenderImageFormat> format) {
+        format.renderSize = CGSizeMake(200, 100);
+        format.scale = 1;
+        format.opaque = YES;
+    }, ^(UIImage *sourceImage, CGContextRef ctx) {
+        CGContextSetRGBFillColor(ctx, 1, 0, 0, 1);
+        CGContextFillRect(ctx, CGRectMake(0, 0, 100, 100));
+        CGContextSetRGBFillColor(ctx, 0, 0, 1, 1);
+        CGContextFillRect(ctx, CGRectMake(100, 0, 100, 100));
+    });
+    NSData *data = UIImagePNGRepresentation(image);
+    XCTAssertNotNil(data);
+    id<TIPImageCodec> codec = [[TIPImageCodecCatalogue sharedInstance] codecForImageType:TIPImageTypePNG];
+    XCTAssertNotNil(codec);
+
+    TIPImageContainer *container = TIPDecodeImageRegionFromData(codec, nil, data, CGRectMake(100, 0, 100, 100), CGSizeZero, UIViewContentModeCenter);
+    XCTAssertNotNil(container);
+    XCTAssertEqual(container.dimensions.width, 100);
+    XCTAssertEqual(container.dimensions.height, 100);
+
+    // read the center pixel
+    Byte center[4] = { 0 };
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    TIPDeferRelease(colorSpace);
+    CGContextRef context = CGBitmapContextCreate(center, 1, 1, 8, 4, colorSpace, kCGImageAlphaPremultipliedLast);
+    TIPDeferRelease(context);
+    CGContextDrawImage(context, CGRectMake(-50, -50, 100, 100), container.image.CGImage);
+    XCTAssertEqualWithAccuracy(center[0], 0, 3);
+    XCTAssertEqualWithAccuracy(center[2], 255, 3);
+
+    // scaled down to the target sizing, never up
+    container = TIPDecodeImageRegionFromData(codec, nil, data, CGRectMake(0, 0, 100, 50), CGSizeMake(50, 50), UIViewContentModeScaleAspectFit);
+    XCTAssertEqual(container.dimensions.width, 50);
+    XCTAssertEqual(container.dimensions.height, 25);
+    container = TIPDecodeImageRegionFromData(codec, nil, data, CGRectMake(0, 0, 100, 50), CGSizeMake(400, 400), UIViewContentModeScaleAspectFit);
+    XCTAssertEqual(container.dimensions.width, 100);
+    XCTAssertEqual(container.dimensions.height, 50);
+
+    // clipped to the image, nothing outside of it
+    container = TIPDecodeImageRegionFromData(codec, nil, data, CGRectMake(150, 50, 100, 100), CGSizeZero, UIViewContentModeCenter);
+    XCTAssertEqual(container.dimensions.width, 50);
+    XCTAssertEqual(container.dimensions.height, 50);
+    XCTAssertNil(TIPDecodeImageRegionFromData(codec, nil, data, CGRectMake(300, 0, 100, 100), CGSizeZero, UIViewContentModeCenter));
+}
+
+- (void)testDecodeImageRegionDecodesAtTheRegionScale
+{
+    UIImage *image = TIPRenderImage(nil, ^(id<TIPRenderImageFormat> format) {
+        format.renderSize = CGSizeMake(300, 200);
+        format.scale = 1;
+        format.opaque = YES;
+    }, ^(UIImage *sourceImage, CGContextRef ctx) {
+        CGContextSetRGBFillColor(ctx, 1, 0, 0, 1);
+        CGContextFillRect(ctx, CGRectMake(0, 0, 300, 200));
+    });
+    NSData *data = UIImagePNGRepresentation(image);
+    XCTAssertNotNil(data);
+    TIPTestTargetRecordingCodec *codec = [[TIPTestTargetRecordingCodec alloc] initWithCodec:[[TIPImageCodecCatalogue sharedInstance] codecForImageType:TIPImageTypePNG]];
+
+    // a region at half resolution (like a tile of level 1) decodes the image at half resolution
+    TIPImageContainer *container = TIPDecodeImageRegionFromData(codec, nil, data, CGRectMake(128, 128, 128, 72), CGSizeMake(64, 36), UIViewContentModeScaleAspectFit);
+    XCTAssertEqual(container.dimensions.width, 64);
+    XCTAssertEqual(container.dimensions.height, 36);
+    XCTAssertEqualObjects(codec.tip_decoder.decodedTargetDimensions.lastObject, [NSValue valueWithCGSize:CGSizeMake(150, 150)]);
+
+    // a region at full resolution decodes the image at full size
+    container = TIPDecodeImageRegionFromData(codec, nil, data, CGRectMake(0, 0, 64, 64), CGSizeZero, UIViewContentModeCenter);
+    XCTAssertEqual(container.dimensions.width, 64);
+    XCTAssertEqual(container.dimensions.height, 64);
+    XCTAssertEqualObjects(codec.tip_decoder.decodedTargetDimensions.lastObject, [NSValue valueWithCGSize:CGSizeZero]);
+    XCTAssertEqual(codec.tip_decoder.decodedTargetDimensions.count, (NSUInteger)2);
+}
+
+- (void)testImageTileSource
+{
+    UIImage *image = TIPRenderImage(nil, ^(id<TIPRenderImageFormat> format) {
+        format.renderSize = CGSizeMake(300, 200);
+        format.scale = 1;
+        format.opaque = YES;
+    }, ^(UIImage *sourceImage, CGContextRef ctx) {
+        CGContextSetRGBFillColor(ctx, 1, 0, 0, 1);
+        CGContextFillRect(ctx, CGRectMake(0, 0, 300, 200));
+    });
+    NSData *data = UIImagePNGRepresentation(image);
+    XCTAssertNotNil(data);
+    id<TIPImageCodec> codec = [[TIPImageCodecCatalogue sharedInstance] codecForImageType:TIPImageTypePNG];
+    TIPImageTileCache *tileCache = [[TIPImageTileCache alloc] initWithMaxBytes:1024 * 1024];
+
+    // 300x200 in 64 pixel tiles: 5x4 tiles at level 0, down to 1 tile at level 3
+    TIPImageTileSource *tileSource = [[TIPImageTileSource alloc] initWithImageData:data
+                                                                         identifier:@"tile.test"
+                                                                              codec:codec
+                                                                         dimensions:CGSizeMake(300, 200)
+                                                                      tileDimension:64
+                                                                          tileCache:tileCache];
+    XCTAssertEqual(tileSource.levelCount, 4);
+    XCTAssertTrue(CGRectEqualToRect([tileSource regionOfTileAtLevel:0 column:4 row:3], CGRectMake(256, 192, 44, 8)));
+    XCTAssertTrue(CGRectEqualToRect([tileSource regionOfTileAtLevel:1 column:1 row:1], CGRectMake(128, 128, 128, 72)));
+    XCTAssertTrue(CGRectIsNull([tileSource regionOfTileAtLevel:0 column:5 row:0]));
+    XCTAssertTrue(CGRectIsNull([tileSource regionOfTileAtLevel:4 column:0 row:0]));
+    XCTAssertEqual([tileSource levelForZoomScale:2], 0);
+    XCTAssertEqual([tileSource levelForZoomScale:0.5], 1);
+    XCTAssertEqual([tileSource levelForZoomScale:0.3], 1);
+    XCTAssertEqual([tileSource levelForZoomScale:0.01], 3);
+
+    // the 4 tiles of the viewport at level 1, each decoded at half resolution
+    XCTestExpectation *expectation = [self expectationWithDescription:@"fetched tiles"];
+    NSMutableArray<TIPImageTile *> *tiles = [[NSMutableArray alloc] init];
+    [tileSource fetchTilesInViewport:CGRectMake(100, 100, 100, 50) level:1 tileHandler:^(TIPImageTile *tile) {
+        XCTAssertTrue([NSThread isMainThread]);
+        [tiles addObject:tile];
+        if (tiles.count == 4) {
+            [expectation fulfill];
+        }
+    }];
+    [self waitForExpectations:@[expectation] timeout:10];
+    for (TIPImageTile *tile in tiles) {
+        XCTAssertEqual(tile.level, 1);
+        XCTAssertEqual(tile.image.size.width, ceil(tile.region.size.width / 2));
+        XCTAssertEqual(tile.image.size.height, ceil(tile.region.size.height / 2));
+        XCTAssertNotNil([tileSource cachedTileAtLevel:1 column:tile.column row:tile.row]);
+    }
+    XCTAssertGreaterThan(tileCache.totalBytes, 0);
+
+    // bounded by the max bytes, least recently used first
+    TIPImageTile *mostRecentTile = [tileSource cachedTileAtLevel:1 column:1 row:1];
+    XCTAssertNotNil(mostRecentTile);
+    tileCache.maxBytes = mostRecentTile.image.tip_estimatedSizeInBytes;
+    XCTAssertLessThanOrEqual(tileCache.totalBytes, tileCache.maxBytes);
+    XCTAssertNotNil([tileSource cachedTileAtLevel:1 column:1 row:1]);
+    XCTAssertNil([tileSource cachedTileAtLevel:1 column:0 row:0]);
+
+    [tileCache clearTilesWithIdentifier:@"tile.test"];
+    XCTAssertEqual(tileCache.totalBytes, 0);
+}
+
+@end
+
+@implementation TIPTestTargetRecordingDecoder
+{
+    id<TIPImageCodec> _codec;
+    NSMutableArray<NSValue *> *_decodedTargetDimensions;
+}
+
+- (instancetype)initWithCodec:(id<TIPImageCodec>)codec
+{
+    if (self = [super init]) {
+        _codec = codec;
+        _decodedTargetDimensions = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (NSArray<NSValue *> *)decodedTargetDimensions
+{
+    return [_decodedTargetDimensions copy];
+}
+
+- (TIPImageDecoderDetectionResult)tip_detectDecodableData:(NSData *)data
+                                           isCompleteData:(BOOL)complete
+                                      earlyGuessImageType:(NSString *)imageType
+{
+    return [_codec.tip_decoder tip_detectDecodableData:data isCompleteData:complete earlyGuessImageType:imageType];
+}
+
+- (id<TIPImageDecoderContext>)tip_initiateDecoding:(id)config
+                                expectedDataLength:(NSUInteger)expectedDataLength
+                                            buffer:(NSMutableData *)buffer
+{
+    return [_codec.tip_decoder tip_initiateDecoding:config expectedDataLength:expectedDataLength buffer:buffer];
+}
+
+- (TIPImageDecoderAppendResult)tip_append:(id<TIPImageDecoderContext>)context
+                                     data:(NSData *)data
+{
+    return [_codec.tip_decoder tip_append:context data:data];
+}
+
+- (TIPImageContainer *)tip_renderImage:(id<TIPImageDecoderContext>)context
+                                     renderMode:(TIPImageDecoderRenderMode)renderMode
+                               targetDimensions:(CGSize)targetDimensions
+                              targetContentMode:(UIViewContentMode)targetContentMode
+{
+    return [_codec.tip_decoder tip_renderImage:context renderMode:renderMode targetDimensions:targetDimensions targetContentMode:targetContentMode];
+}
+
+- (TIPImageDecoderAppendResult)tip_finalizeDecoding:(id<TIPImageDecoderContext>)context
+{
+    return [_codec.tip_decoder tip_finalizeDecoding:context];
+}
+
+- (TIPImageContainer *)tip_decodeImageWithData:(NSData *)imageData
+                                       targetDimensions:(CGSize)targetDimensions
+                                      targetContentMode:(UIViewContentMode)targetContentMode
+                                                 config:(id)config
+{
+    [_decodedTargetDimensions addObject:[NSValue valueWithCGSize:targetDimensions]];
+    return TIPDecodeImageFromData(_codec, config, imageData, targetDimensions, targetContentMode);
+}
+
+@end
+
+@implementation TIPTestTargetRecordingCodec
+
+- (instancetype)initWithCodec:(id<TIPImageCodec>)codec
+{
+    if (self = [super init]) {
+        _tip_decoder = [[TIPTestTargetRecordingDecoder alloc] initWithCodec:codec];
+    }
+    return self;
+}
+
+- (id<TIPImageEncoder>)tip_encoder
+{
+    return nil;
+}
+
 @end